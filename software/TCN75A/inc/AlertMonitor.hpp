@@ -0,0 +1,60 @@
+#ifndef ALERTMONITOR_HPP
+#define ALERTMONITOR_HPP
+
+#include <atomic>
+#include <cstdint>
+#include "Hal.hpp"
+#include "SampleRing.hpp"
+
+//One ALERT pin edge as captured by the GPIO interrupt
+struct AlertEdge{
+    uint64_t timestamp_us; //hal::Clock::nowUs in the ISR
+    bool level; //pin level after the edge
+};
+
+//One period where the alert was active
+struct AlertEpisode{
+    uint64_t assert_us; //alert became active
+    uint64_t deassert_us; //alert cleared, 0 while still active
+};
+
+class AlertMonitor{
+    public:
+        static const uint8_t HISTORY_SIZE = 16; //episodes kept, oldest dropped first
+
+        AlertMonitor(uint8_t pin); //constructor
+        uint8_t pin() const; //ALERT gpio
+
+        //Match the sensor config: ALERT polarity and comparator/interrupt output
+        void configure(bool activeHigh, bool interruptMode);
+
+        //Producer side, core 0
+        void onEdge(uint32_t events, bool level); //GPIO ISR: timestamp and queue the edge
+        void acknowledge(); //request the alert LED to be cleared (button 5)
+
+        //Consumer side, core 1
+        bool process(); //drain the edges into the history, true if the state changed
+        bool asserted() const; //alert currently active
+
+        //History, safe to read from the other core
+        uint8_t snapshot(AlertEpisode *out, uint8_t max) const; //copy episodes, oldest first
+        uint32_t edgesLost() const; //edges dropped because the queue was full
+        void printHistory() const;
+
+    private:
+        void record(bool active, uint64_t timestamp_us);
+
+        const uint8_t ALERT_PIN;
+        std::atomic<bool> active_high;
+        std::atomic<bool> interrupt_mode;
+        std::atomic<bool> ack_requested;
+        SampleRing<AlertEdge, 32> edges; //ISR to core 1
+        std::atomic<bool> alert_active;
+
+        AlertEpisode history[HISTORY_SIZE];
+        uint8_t history_head; //next slot to write
+        uint8_t history_count;
+        std::atomic<uint32_t> history_seq; //odd while core 1 updates the history
+};
+
+#endif
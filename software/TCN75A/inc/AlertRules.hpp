@@ -0,0 +1,131 @@
+#ifndef ALERTRULES_HPP
+#define ALERTRULES_HPP
+
+#include <atomic>
+#include <cstdint>
+#include "SampleRing.hpp"
+
+//What a rule watches
+enum class RuleKind : uint8_t {
+    Above, //reading at or above the limit, clears below limit - hyst
+    Below, //reading at or below the limit, clears above limit + hyst
+    Rate, //|change| per minute at or above the limit, measured over a window
+    TimeAbove //reading at or above the limit for a hold time, clears below limit - hyst
+};
+
+//Outputs a rule lights while it is active
+namespace rule_out{
+    static const uint8_t RED = 1 << 0; //red LED of the TempSensor
+    static const uint8_t GREEN = 1 << 1; //green LED of the TempSensor
+    static const uint8_t ALERT = 1 << 2; //Alert LED of the consumer core
+    static const uint8_t COUNT = 3;
+}
+
+//A rule as the user wrote it, temperatures as Q8.8 register words
+struct RuleSpec{
+    uint8_t addr; //sensor address, ANY_SENSOR for every sensor
+    RuleKind kind;
+    int16_t limit; //C, or C per minute for Rate
+    int16_t hyst; //C, band rules
+    uint32_t time_ms; //hold time (TimeAbove) or measuring window (Rate)
+    uint8_t outputs; //rule_out bits
+};
+
+/**
+ * @brief Software alert rules
+ *
+ * The TCN75A compares against one TSET/THYST pair. This evaluates
+ * any number of rules per sensor on every sample: high and low
+ * bands, rate of change and time above a threshold.
+ *
+ * Rules are compiled into a flat table sorted by sensor, "any
+ * sensor" rules copied into every sensor's slice, so a sample only
+ * walks the rules of its own sensor. Each entry is evaluated by the
+ * function of its kind from a table; state lives in a parallel
+ * array, nothing is allocated per sample.
+ *
+ * Rules are edited and compiled on core 0 into the spare one of
+ * two tables; the consumer (core 1) switches to it at the next
+ * sample, with every rule inactive.
+ */
+class RuleEngine{
+    public:
+        static const uint8_t ANY_SENSOR = 0;
+        static const uint8_t MAX_SENSORS = 8; //TCN75A addresses 0x48 to 0x4F
+        static const uint16_t MAX_RULES = 256;
+        static const uint16_t MAX_COMPILED = 512; //entries once the "any" rules are copied
+
+        RuleEngine(); //constructor
+
+        //Editing side (core 0), compile() publishes the changes
+        bool add(const RuleSpec& spec); //false if full or invalid
+        bool remove(uint16_t index);
+        void clear();
+        bool compile(); //false if the table does not fit or the last one is not taken yet
+        uint16_t count() const;
+        const RuleSpec& rule(uint16_t index) const;
+        bool active(uint16_t index) const; //any compiled copy of the rule active
+
+        //Consumer side
+        uint8_t evaluate(const TempSample& sample); //returns the rule_out bits now lit
+        uint8_t outputs() const; //any core
+
+        //Cost of the evaluations
+        struct Stats{
+            uint32_t samples; //samples evaluated
+            uint32_t checks; //rule entries evaluated
+            uint32_t changes; //rules that became active or inactive
+            uint32_t cpu_us; //time spent in evaluate()
+        };
+        const Stats& stats() const;
+
+    private:
+        //Compiled rule: what the evaluator needs, 12 bytes
+        struct Entry{
+            RuleKind kind;
+            uint8_t outputs;
+            uint16_t rule; //index of the RuleSpec
+            int16_t set; //becomes active
+            int16_t clear; //becomes inactive
+            uint32_t time_ms;
+        };
+
+        //Per entry state
+        struct State{
+            bool active;
+            int16_t ref_raw; //Rate: reading at the start of the window
+            uint32_t ref_ms; //Rate: window start, TimeAbove: first reading above
+            bool started;
+        };
+
+        struct Table{
+            Entry entries[MAX_COMPILED];
+            uint16_t first[MAX_SENSORS + 1]; //slice of sensor i is first[i] to first[i + 1]
+        };
+
+        typedef bool (*Evaluator)(const Entry& entry, State& state, int16_t raw, uint32_t ms);
+        static bool evalAbove(const Entry& entry, State& state, int16_t raw, uint32_t ms);
+        static bool evalBelow(const Entry& entry, State& state, int16_t raw, uint32_t ms);
+        static bool evalRate(const Entry& entry, State& state, int16_t raw, uint32_t ms);
+        static bool evalTimeAbove(const Entry& entry, State& state, int16_t raw, uint32_t ms);
+        static const Evaluator evaluators[];
+
+        void take(uint8_t table); //consumer: switch tables, all rules inactive
+
+        //Specs, core 0 only
+        RuleSpec specs[MAX_RULES];
+        uint16_t spec_count;
+
+        //Compiled tables, the consumer uses tables[current]
+        Table tables[2];
+        std::atomic<uint8_t> current;
+        std::atomic<int8_t> pending; //table waiting for the consumer, -1 if none
+        State state[MAX_COMPILED];
+        uint16_t lit[rule_out::COUNT]; //active rules per output
+        std::atomic<uint8_t> out;
+        std::atomic<uint32_t> seq; //odd while the states change
+
+        Stats stat;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef BUSSCANNER_HPP
+#define BUSSCANNER_HPP
+
+#include <cstdint>
+#include "Hal.hpp"
+#include "I2CEngine.hpp"
+
+//Which addresses a scan probes
+enum class ScanMode : uint8_t {
+    Targeted, //only the TCN75A window 0x48 to 0x4F
+    Full //every non reserved address
+};
+
+class BusScanner{
+    public:
+        BusScanner(hal::BusHandle i2c, I2CEngine& engine); //constructor
+
+        uint8_t scan(ScanMode mode); //probe the bus, returns the number of devices found
+        void render() const; //print the address map of the last scan
+        void setProbeTimeout(uint32_t timeout_us); //time allowed for each probe
+
+        bool found(uint8_t addr) const; //address answered the last scan
+        bool probed(uint8_t addr) const; //address was part of the last scan
+        uint8_t firstFound(uint8_t from, uint8_t to) const; //first answering address in a range, 0 if none
+        uint32_t generation() const; //incremented after every scan, 0 if never scanned
+        uint32_t durationUs(ScanMode mode) const; //wall time of the last scan in that mode
+
+        static bool reserved_address(uint8_t addr); // addresses to be ingnored by I2C
+
+    private:
+        static bool testBit(const uint32_t *map, uint8_t addr);
+        static void setBit(uint32_t *map, uint8_t addr);
+
+        hal::BusHandle I2C_INST;
+        I2CEngine& engine; //held while the SDK probes run
+        uint32_t probe_timeout_us;
+        uint32_t present[4]; //one bit per address, result table
+        uint32_t scanned[4]; //one bit per address, probed in the last scan
+        uint32_t scan_generation;
+        ScanMode last_mode;
+        uint32_t duration_us[2]; //indexed by ScanMode
+};
+
+#endif
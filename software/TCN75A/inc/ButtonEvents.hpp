@@ -0,0 +1,100 @@
+#ifndef BUTTONEVENTS_HPP
+#define BUTTONEVENTS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include "Hal.hpp"
+#include "SampleRing.hpp"
+
+//What the user did with a button
+enum class ButtonGesture : uint8_t {
+    Press, //pressed and released
+    Double, //pressed twice within DOUBLE_US, on buttons that ask for it
+    Long //held for LONG_US, reported while still held
+};
+
+//One gesture, as handed to the main loop
+struct ButtonEvent{
+    uint64_t timestamp_us; //edge that completed the gesture
+    uint8_t button; //0 for the first button pin
+    ButtonGesture gesture;
+};
+
+//One debounced edge as captured by the GPIO interrupt
+struct ButtonEdge{
+    uint64_t timestamp_us; //hal::Clock::nowUs in the ISR
+    uint8_t button;
+    bool pressed; //pin level after the edge, buttons pull the pin low
+};
+
+class ButtonEvents{
+    public:
+        static const uint8_t BUTTON_COUNT = 6; //on consecutive pins
+        static const uint32_t DEBOUNCE_US = 20 * 1000; //edges this close to the last one are bounce
+        static const uint32_t DOUBLE_US = 300 * 1000; //second press must start this soon after the first release
+        static const uint32_t LONG_US = 800 * 1000; //hold time of a long press
+
+        ButtonEvents(uint8_t firstPin); //constructor
+        uint8_t firstPin() const;
+        uint8_t indexOf(unsigned int gpio) const; //BUTTON_COUNT if the pin is not a button
+
+        //Presses of this button wait DOUBLE_US for a second one, the others are reported on release
+        void enableDouble(uint8_t button);
+
+        //Producer side, GPIO ISR
+        void onEdge(uint8_t button, bool level); //debounce, timestamp and queue the edge
+
+        //Consumer side, main loop
+        bool next(ButtonEvent& event, uint64_t now_us); //next gesture, false if none is complete
+        bool pending() const; //edges queued, next() has work
+        uint64_t nextDueUs() const; //next long press, double press or debounce timeout, ~0 if none
+
+        //Activity since power-up
+        struct Stats{
+            uint32_t edges; //debounced edges taken from the queue
+            uint32_t bounces; //edges dropped by the debounce
+            uint32_t resyncs; //releases or presses missed in a bounce, found from the pin level
+            uint32_t presses;
+            uint32_t doubles;
+            uint32_t longs;
+            uint32_t max_wait_us; //longest time an edge waited in the queue
+        };
+        Stats stats() const;
+        uint32_t edgesLost() const; //edges dropped because the queue was full
+
+    private:
+        //Gesture state of one button, main loop only
+        struct Gesture{
+            bool seen; //an edge came in, the pin level can be trusted
+            bool settled; //pin level checked since the last edge
+            bool down;
+            bool long_sent; //Long already reported for this hold
+            bool pending; //a press waits for a possible second one
+            bool second; //the second press of a double is held
+            uint64_t edge_us; //last edge applied
+            uint64_t down_us;
+            uint64_t release_us;
+        };
+
+        void apply(uint8_t button, bool pressed, uint64_t timestamp_us);
+        void expire(uint8_t button, uint64_t now_us);
+        void emit(uint8_t button, ButtonGesture gesture, uint64_t timestamp_us);
+
+        const uint8_t FIRST_PIN;
+        uint8_t double_mask;
+
+        //ISR side
+        std::atomic<uint32_t> last_edge_us[BUTTON_COUNT]; //last edge kept, per button
+        std::atomic<uint32_t> bounces;
+        SampleRing<ButtonEdge, 32> edges; //ISR to main loop
+
+        //Main loop side
+        Gesture gestures[BUTTON_COUNT];
+        static const uint8_t OUT_SIZE = 4;
+        ButtonEvent out[OUT_SIZE]; //gestures completed by one edge or timeout
+        uint8_t out_head;
+        uint8_t out_count;
+        Stats counts;
+};
+
+#endif
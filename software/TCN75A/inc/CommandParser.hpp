@@ -0,0 +1,49 @@
+#ifndef COMMANDPARSER_HPP
+#define COMMANDPARSER_HPP
+
+#include <cstdint>
+
+//Incremental console line parser.
+//Characters are fed one at a time from the poll loop, so nothing waits
+//on the terminal. A complete line is split in place into words; the
+//buffer is fixed, an over-long line is dropped as a whole.
+class CommandParser{
+    public:
+        static const uint8_t LINE_MAX = 48; //characters kept per line
+        static const uint8_t ARG_MAX = 6; //words kept per line
+
+        //Words of the last complete line, pointing into the line buffer
+        struct Command{
+            uint8_t argc;
+            const char* argv[ARG_MAX];
+        };
+
+        CommandParser(); //constructor
+
+        bool feed(char c); //true when c completed a non-empty line
+        const Command& command() const; //valid until the next feed
+        void reset(); //drop the partial line
+
+        static bool equals(const char* a, const char* b); //case insensitive compare
+
+        //Statistics
+        struct Stats{
+            uint32_t lines; //complete lines handed out
+            uint32_t overflows; //lines dropped for being too long
+            uint32_t ignored; //control characters ignored
+        };
+        const Stats& stats() const;
+
+    private:
+        void split(); //cut the finished line into words
+
+        char buf[LINE_MAX + 1];
+        uint8_t len; //characters in buf
+        bool overflow; //current line went past LINE_MAX
+        bool ready; //buf holds a split line, cleared by the next character
+        char last; //previous character, to take CR LF as one end of line
+        Command cmd;
+        Stats stat;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef CONFIGREGISTER_HPP
+#define CONFIGREGISTER_HPP
+
+#include <cstdint>
+
+//Register map of the TCN75A, everything here is resolved at compile time
+namespace tcn75a{
+
+//4 different options for the Register pointers
+constexpr uint8_t TEMP_REG = 0x00;
+constexpr uint8_t CONFIG_REG = 0x01;
+constexpr uint8_t HYST_TEMP_REG = 0x02;
+constexpr uint8_t SET_TEMP_REG = 0x03;
+
+//Config register settings, the enum value is the raw field value
+enum class Shutdown : uint8_t { Disable = 0, Enable = 1 };
+enum class AlertMode : uint8_t { Comparator = 0, Interrupt = 1 };
+enum class Polarity : uint8_t { ActiveLow = 0, ActiveHigh = 1 };
+enum class FaultQueue : uint8_t { One = 0, Two = 1, Four = 2, Six = 3 };
+enum class Resolution : uint8_t { Bits9 = 0, Bits10 = 1, Bits11 = 2, Bits12 = 3 };
+enum class OneShot : uint8_t { Disable = 0, Enable = 1 };
+
+/**
+ * @brief Config register field
+ *
+ * Describes where a setting lives in the config register.
+ * The mask and the encoded value are built at compile time.
+ *
+ * @tparam SHIFT position of the least significant bit
+ * @tparam WIDTH number of bits
+ * @tparam E enum type holding the setting values
+ */
+template<uint8_t SHIFT, uint8_t WIDTH, typename E>
+struct Field{
+    static_assert(SHIFT + WIDTH <= 8, "Field does not fit in the 8 bit config register");
+    typedef E value_type;
+    static constexpr uint8_t shift = SHIFT;
+    static constexpr uint8_t width = WIDTH;
+    static constexpr uint8_t mask = (uint8_t)(((1u << WIDTH) - 1u) << SHIFT);
+
+    static constexpr uint8_t encode(E v){
+        return (uint8_t)(((uint8_t)v << SHIFT) & mask);
+    }
+    static constexpr E decode(uint8_t reg){
+        return (E)((reg & mask) >> SHIFT);
+    }
+};
+
+//Config register layout (datasheet register 5-3)
+typedef Field<0, 1, Shutdown> ShutdownField;
+typedef Field<1, 1, AlertMode> CompIntField;
+typedef Field<2, 1, Polarity> PolarityField;
+typedef Field<3, 2, FaultQueue> FaultQueueField;
+typedef Field<5, 2, Resolution> ResolutionField;
+typedef Field<7, 1, OneShot> OneShotField;
+
+//Maps a setting enum to its field so edits can be written as set(Resolution::Bits12)
+template<typename E> struct FieldOf;
+template<> struct FieldOf<Shutdown> { typedef ShutdownField type; };
+template<> struct FieldOf<AlertMode> { typedef CompIntField type; };
+template<> struct FieldOf<Polarity> { typedef PolarityField type; };
+template<> struct FieldOf<FaultQueue> { typedef FaultQueueField type; };
+template<> struct FieldOf<Resolution> { typedef ResolutionField type; };
+template<> struct FieldOf<OneShot> { typedef OneShotField type; };
+
+/**
+ * @brief Batched config register change
+ *
+ * Collects any number of field changes into one mask/value pair
+ * so they can be applied with a single read-modify-write.
+ * Setting the same field twice keeps the last value.
+ */
+class ConfigEdit{
+    public:
+        constexpr ConfigEdit(): editMask(0), editValue(0) {}
+
+        template<typename E>
+        constexpr ConfigEdit set(E v) const{
+            typedef typename FieldOf<E>::type F;
+            return ConfigEdit(editMask | F::mask, (uint8_t)((editValue & ~F::mask) | F::encode(v)));
+        }
+
+        constexpr uint8_t mask() const { return editMask; }
+        constexpr uint8_t value() const { return editValue; }
+        constexpr bool empty() const { return editMask == 0; }
+
+        //New register value once the edit is applied to the current one
+        constexpr uint8_t apply(uint8_t reg) const{
+            return (uint8_t)((reg & ~editMask) | editValue);
+        }
+
+        //True if every edited field already has the requested value
+        constexpr bool matches(uint8_t reg) const{
+            return (reg & editMask) == editValue;
+        }
+
+    private:
+        constexpr ConfigEdit(uint8_t m, uint8_t v): editMask(m), editValue(v) {}
+        uint8_t editMask;
+        uint8_t editValue;
+};
+
+//Read a setting back out of a config register value
+template<typename E>
+constexpr E get(uint8_t reg){
+    return FieldOf<E>::type::decode(reg);
+}
+
+//Conversion time of one sample, it doubles with every extra bit of resolution
+//(datasheet: 30 ms typical / 75 ms max at 9 bits up to 240 ms / 600 ms at 12 bits)
+constexpr uint16_t conversionTimeMs(Resolution r){
+    return (uint16_t)(30u << (uint8_t)r);
+}
+constexpr uint16_t conversionTimeMaxMs(Resolution r){
+    return (uint16_t)(75u << (uint8_t)r);
+}
+
+//The sensor responds on 0x48 to 0x4F depending on the A2..A0 pins
+constexpr uint8_t FIRST_ADDR = 0x48;
+constexpr uint8_t LAST_ADDR = 0x4F;
+
+static_assert(ResolutionField::mask == 0b01100000, "Resolution field mask");
+static_assert(FaultQueueField::mask == 0b00011000, "Fault queue field mask");
+static_assert(ConfigEdit().set(Resolution::Bits12).set(FaultQueue::Four).set(Polarity::ActiveHigh).mask() == 0b01111100,
+              "Batched edit mask");
+
+}
+
+#endif
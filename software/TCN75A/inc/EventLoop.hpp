@@ -0,0 +1,88 @@
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include <cstdint>
+#include "Hal.hpp"
+
+//Cooperative scheduler of core 0. Timers are kept in a min-heap by due
+//time, event tasks run when their source (a queue filled by an ISR) has
+//work. Every task runs to completion, so a long one delays the others:
+//each task keeps its run time and how late it started. With nothing due
+//the loop sleeps the core until the next timer or interrupt.
+class EventLoop{
+    public:
+        static const uint8_t MAX_TASKS = 10;
+        static const uint8_t NO_TASK = 0xFF;
+        static const uint64_t NEVER = ~0ull;
+
+        //Work of a task. Returns the time it wants to run next: 0 keeps
+        //the period of a timer (an event task then waits for its source),
+        //a time in the past runs it again on the next pass.
+        typedef uint64_t (*TaskFn)(void* context, uint64_t now_us);
+        //Event source: true when work is waiting
+        typedef bool (*ReadyFn)(void* context);
+
+        //Run time and lateness of one task
+        struct TaskStats{
+            const char* name;
+            uint32_t runs;
+            uint64_t busy_us; //total run time
+            uint32_t max_us; //longest run
+            uint64_t late_us; //total start delay past the due time, timers only
+            uint32_t max_late_us; //worst start delay, the jitter of the timer
+            uint32_t misses; //started past the deadline
+            uint32_t skipped; //periods lost to an overrun
+        };
+
+        EventLoop(); //constructor
+
+        //Periodic timer, first run one period from now. deadline_us is the
+        //start delay counted as a miss, 0 for one period.
+        uint8_t addTimer(const char* name, TaskFn fn, void* context, uint32_t period_us, uint32_t deadline_us = 0);
+        //Event task, run when ready() says so or when the time it returned comes
+        uint8_t addEvent(const char* name, ReadyFn ready, TaskFn fn, void* context, uint32_t deadline_us = 0);
+        void setDue(uint8_t task, uint64_t due_us); //run a task at this time, NEVER to wait for its source
+
+        bool runOnce(uint64_t now_us); //run what is ready or due, false if nothing was
+        void runUntil(uint64_t until_us); //run, sleeping when idle, until the time
+        void run(); //never returns
+        uint64_t nextDueUs() const; //earliest timer, NEVER if none
+
+        uint8_t taskCount() const;
+        const TaskStats& stats(uint8_t task) const;
+        uint64_t idleUs() const; //time spent asleep
+        uint32_t wakeups() const;
+        void resetStats();
+        void printStats(); //one line per task, then the idle time
+
+    private:
+        struct Task{
+            TaskFn fn;
+            ReadyFn ready; //nullptr for a timer
+            void* context;
+            uint32_t period_us; //0 for an event task
+            uint32_t deadline_us;
+            uint64_t due_us; //NEVER when not in the heap
+            uint8_t slot; //position in the heap
+            TaskStats stats;
+        };
+
+        uint8_t add(const char* name, ReadyFn ready, TaskFn fn, void* context, uint32_t period_us, uint32_t deadline_us);
+        void execute(uint8_t task, uint64_t now_us, bool timed);
+        void schedule(uint8_t task, uint64_t due_us);
+        void unlink(uint8_t task);
+        void siftUp(uint8_t slot);
+        void siftDown(uint8_t slot);
+        void swap(uint8_t a, uint8_t b);
+        bool before(uint8_t a, uint8_t b) const;
+
+        Task tasks[MAX_TASKS];
+        uint8_t count;
+        uint8_t heap[MAX_TASKS]; //task numbers, earliest due time first
+        uint8_t heap_size;
+        uint64_t idle_us;
+        uint32_t wakeup_count;
+        uint64_t stats_start_us;
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef FIXEDTEMP_HPP
+#define FIXEDTEMP_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+//Units a temperature can be converted or printed in
+enum class TempUnit : uint8_t { Celsius, Fahrenheit, Kelvin };
+
+/**
+ * @brief Fixed-point temperature
+ *
+ * Stores degrees Celsius as a signed integer with FRAC_BITS fractional
+ * bits. The TCN75A registers are Q8.8 two's complement words, so
+ * FixedTemp<8> holds them without any conversion. Unit conversions,
+ * comparisons and formatting are done with integer math only since
+ * the RP2040 has no FPU.
+ *
+ * @tparam FRAC_BITS number of fractional bits
+ */
+template<int FRAC_BITS>
+class FixedTemp{
+    static_assert(FRAC_BITS > 0 && FRAC_BITS <= 16, "FixedTemp supports 1 to 16 fractional bits");
+
+    public:
+        static constexpr int32_t ONE = (int32_t)1 << FRAC_BITS;
+
+        constexpr FixedTemp(): value(0) {}
+
+        //Build from the 16 bit register word (MSB = integer part, LSB = fraction)
+        static constexpr FixedTemp fromRaw(uint16_t raw){
+            return fromFixed(shiftFromQ8((int16_t)raw));
+        }
+
+        //Build from the two register bytes as they come off the bus
+        static constexpr FixedTemp fromBytes(uint8_t msb, uint8_t lsb){
+            return fromRaw((uint16_t)((msb << 8) | lsb));
+        }
+
+        //Build from an already scaled value
+        static constexpr FixedTemp fromFixed(int32_t fixed){
+            FixedTemp t;
+            t.value = fixed;
+            return t;
+        }
+
+        //Build from whole degrees Celsius
+        static constexpr FixedTemp fromCelsius(int32_t degrees){
+            return fromFixed(degrees * ONE);
+        }
+
+        //Build from milli-degrees Celsius, rounded to the nearest step
+        static constexpr FixedTemp fromMilliCelsius(int32_t mdeg){
+            return fromFixed((int32_t)roundDiv((int64_t)mdeg * ONE, 1000));
+        }
+
+        constexpr int32_t fixed() const { return value; }
+
+        //Back to the Q8.8 register word (saturating the fraction bits we do not have)
+        constexpr uint16_t toRaw() const{
+            return (uint16_t)(int16_t)shiftToQ8(value);
+        }
+
+        //Milli-degrees in the requested unit, rounded to nearest
+        constexpr int32_t milli(TempUnit unit = TempUnit::Celsius) const{
+            return (int32_t)roundDiv(numerator(unit) * 1000, denominator(unit));
+        }
+
+        //Whole degrees in the requested unit, rounded to nearest
+        constexpr int32_t whole(TempUnit unit = TempUnit::Celsius) const{
+            return (int32_t)roundDiv(numerator(unit), denominator(unit));
+        }
+
+        /**
+         * @brief Format the temperature
+         *
+         * Writes a decimal string such as "-12.0625" with the requested
+         * number of decimals, rounding half to even like printf does.
+         * 32 bit math only, one division per digit (the M0+ has no 64 bit
+         * divide), and no sign when the rounded value is zero.
+         *
+         * @param out destination buffer
+         * @param size size of the destination buffer
+         * @param unit unit to print in
+         * @param decimals number of digits after the point (0 to 6)
+         *
+         * @return int the number of characters written, excluding the terminator
+         */
+        int format(char* out, size_t size, TempUnit unit = TempUnit::Celsius, uint8_t decimals = 4) const{
+            if(decimals > 6){
+                decimals = 6;
+            }
+            bool negative;
+            uint32_t mag, den;
+            ratio(unit, negative, mag, den);
+
+            //whole part, then the decimals one at a time from the remainder
+            uint32_t whole = mag / den;
+            uint32_t rem = mag % den;
+            char frac[6];
+            for(uint8_t i = 0; i < decimals; i++){
+                rem *= 10;
+                frac[i] = (char)(rem / den);
+                rem %= den;
+            }
+            uint8_t last = decimals ? (uint8_t)frac[decimals - 1] : (uint8_t)(whole & 1);
+            if(rem * 2 > den || (rem * 2 == den && (last & 1))){
+                int i = decimals - 1;
+                while(i >= 0 && frac[i] == 9){
+                    frac[i--] = 0;
+                }
+                if(i >= 0){
+                    frac[i]++;
+                } else {
+                    whole++;
+                }
+            }
+            bool zero = whole == 0;
+            for(uint8_t i = 0; i < decimals; i++){
+                zero = zero && frac[i] == 0;
+            }
+
+            char digits[10];
+            int n = 0;
+            do{
+                digits[n++] = (char)('0' + whole % 10);
+                whole /= 10;
+            } while(whole != 0);
+
+            size_t pos = 0;
+            if(negative && !zero && pos + 1 < size){
+                out[pos++] = '-';
+            }
+            while(n > 0 && pos + 1 < size){
+                out[pos++] = digits[--n];
+            }
+            if(decimals > 0 && pos + 1 < size){
+                out[pos++] = '.';
+            }
+            for(uint8_t i = 0; i < decimals && pos + 1 < size; i++){
+                out[pos++] = (char)('0' + frac[i]);
+            }
+            if(size > 0){
+                out[pos] = '\0';
+            }
+            return (int)pos;
+        }
+
+        //Threshold comparisons, no conversion needed
+        constexpr bool operator<(const FixedTemp& o) const { return value < o.value; }
+        constexpr bool operator>(const FixedTemp& o) const { return value > o.value; }
+        constexpr bool operator<=(const FixedTemp& o) const { return value <= o.value; }
+        constexpr bool operator>=(const FixedTemp& o) const { return value >= o.value; }
+        constexpr bool operator==(const FixedTemp& o) const { return value == o.value; }
+        constexpr bool operator!=(const FixedTemp& o) const { return value != o.value; }
+        constexpr FixedTemp operator-(const FixedTemp& o) const { return fromFixed(value - o.value); }
+        constexpr FixedTemp operator+(const FixedTemp& o) const { return fromFixed(value + o.value); }
+
+    private:
+        int32_t value; //degrees Celsius * 2^FRAC_BITS
+
+        static constexpr int32_t shiftFromQ8(int32_t q8){
+            return FRAC_BITS >= 8 ? q8 * ((int32_t)1 << (FRAC_BITS >= 8 ? FRAC_BITS - 8 : 0))
+                                  : q8 / ((int32_t)1 << (FRAC_BITS < 8 ? 8 - FRAC_BITS : 0));
+        }
+
+        static constexpr int32_t shiftToQ8(int32_t fixed){
+            return FRAC_BITS >= 8 ? fixed / ((int32_t)1 << (FRAC_BITS >= 8 ? FRAC_BITS - 8 : 0))
+                                  : fixed * ((int32_t)1 << (FRAC_BITS < 8 ? 8 - FRAC_BITS : 0));
+        }
+
+        //Temperature in the unit as the exact fraction numerator / denominator
+        //  C = value / 2^F
+        //  F = (9 * value + 160 * 2^F) / (5 * 2^F)
+        //  K = (100 * value + 27315 * 2^F) / (100 * 2^F)
+        constexpr int64_t numerator(TempUnit unit) const{
+            return unit == TempUnit::Fahrenheit ? (int64_t)value * 9 + (int64_t)160 * ONE
+                 : unit == TempUnit::Kelvin ? (int64_t)value * 100 + (int64_t)27315 * ONE
+                 : (int64_t)value;
+        }
+
+        static constexpr int64_t denominator(TempUnit unit){
+            return unit == TempUnit::Fahrenheit ? (int64_t)5 * ONE
+                 : unit == TempUnit::Kelvin ? (int64_t)100 * ONE
+                 : (int64_t)ONE;
+        }
+
+        //Temperature in the unit as sign, magnitude / denominator, in 32 bits:
+        //the register range (-128 C to +128 C) keeps every unit below 2^32
+        //up to 16 fractional bits, and never under 0 K
+        void ratio(TempUnit unit, bool& negative, uint32_t& mag, uint32_t& den) const{
+            int32_t num = value;
+            den = (uint32_t)ONE;
+            if(unit == TempUnit::Kelvin){
+                negative = false;
+                mag = (uint32_t)(value * 100) + (uint32_t)(27315 * ONE);
+                den = 100u * (uint32_t)ONE;
+                return;
+            }
+            if(unit == TempUnit::Fahrenheit){
+                num = value * 9 + 160 * ONE;
+                den = 5u * (uint32_t)ONE;
+            }
+            negative = num < 0;
+            mag = negative ? 0u - (uint32_t)num : (uint32_t)num;
+        }
+
+        //Division rounding half away from zero
+        static constexpr int64_t roundDiv(int64_t num, int64_t den){
+            return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+        }
+};
+
+//Native format of the TCN75A temperature and limit registers
+typedef FixedTemp<8> TempQ8;
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef HAL_HPP
+#define HAL_HPP
+
+//Hardware abstraction layer.
+//
+//Every hardware access of the drivers goes through these policies:
+//  hal::Bus   - I2C controller: blocking transfers for the SDK paths and the
+//               start / irqStatus / readData steps driven by I2CEngine
+//  hal::Gpio  - pin direction, level, pull-ups and edge interrupts
+//  hal::Pwm   - 8 bit brightness of a pin, for the LED effects
+//  hal::Clock - microsecond time base and sleeps
+//  hal::Cycles - cycle counter of the calling core, for the probes (ns on Linux)
+//  hal::Cpu   - interrupt masking, SEV/WFE, idle hint and timed sleep, raw stdio and its input event
+//  hal::Flash - erase / program / read of the on-board flash (a file on Linux)
+//
+//The policies only have static inline members and the backend is picked at
+//compile time, so on the MCU every call compiles to the SDK call it replaces.
+//Build with TCN75A_HOST to run on Linux against the simulated TCN75A.
+
+#if defined(TCN75A_HOST)
+#include "HostHal.hpp"
+#else
+#include "PicoHal.hpp"
+#endif
+
+namespace hal {
+
+#if defined(TCN75A_HOST)
+typedef HostBus Bus;
+typedef HostGpio Gpio;
+typedef HostPwm Pwm;
+typedef HostClock Clock;
+typedef HostCycles Cycles;
+typedef HostCpu Cpu;
+typedef HostFlash Flash;
+#else
+typedef PicoBus Bus;
+typedef PicoGpio Gpio;
+typedef PicoPwm Pwm;
+typedef PicoClock Clock;
+typedef PicoCycles Cycles;
+typedef PicoCpu Cpu;
+typedef PicoFlash Flash;
+#endif
+
+typedef Bus::Handle BusHandle; //i2c controller as seen by the drivers
+
+}
+
+#endif
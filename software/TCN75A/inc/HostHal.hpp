@@ -0,0 +1,230 @@
+#ifndef HOSTHAL_HPP
+#define HOSTHAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+//Linux backend of the HAL. Time is virtual so runs are repeatable:
+//it moves on with sleeps, bus transfers and a small cost per clock read.
+
+//Same error convention as the Pico SDK
+#ifndef PICO_ERROR_GENERIC
+#define PICO_ERROR_GENERIC -1
+#endif
+#ifndef PICO_ERROR_TIMEOUT
+#define PICO_ERROR_TIMEOUT -2
+#endif
+
+class SimTCN75A;
+
+namespace hal {
+
+//Simulated I2C bus with the devices attached to it
+class SimBus{
+    public:
+        SimBus(uint8_t index, uint32_t baud = 100000); //constructor
+        ~SimBus();
+        uint8_t index() const; //controller number, like i2c0 / i2c1
+        void setBaud(uint32_t baud);
+
+        void attach(SimTCN75A* device); //answer on device->address()
+        void detach(uint8_t addr);
+
+        //Blocking transfers, same return values as the SDK
+        int write(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+        int read(uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+        //Controller interrupt emulation used by HostBus::start
+        void (*irq_handler)();
+        uint32_t irq_pending; //HostBus::IRQ_* flags not yet read
+        uint8_t rx[16]; //bytes received by the last started read
+        uint8_t rx_len;
+
+        //Transfers slowed down by clock stretching finish later, and never
+        //while a target holds SDA low. poll() raises their interrupt.
+        static const uint64_t NEVER = ~0ull;
+        void defer(uint32_t flags, uint64_t delay_us); //delay NEVER: the transfer hangs
+        void cancel(); //controller aborted, the deferred interrupt is dropped
+        void poll(); //raise the deferred interrupt once its time has come
+        static void pollAll(); //every bus, called while the CPU idles
+        static uint64_t nextEventUs(); //earliest deferred interrupt of any bus, NEVER if none
+
+        bool stuck() const; //an attached target holds SDA low
+        uint32_t stretchUs(uint8_t addr) const; //clock stretching of a target in one transfer
+        bool recover(); //SCL pulses until SDA is free (nine at most) and a STOP
+
+        //Bus activity since the last reset
+        struct Stats{
+            uint32_t transactions; //START to STOP sequences
+            uint32_t bytes; //address and data bytes clocked
+            uint32_t nacks; //transfers not acknowledged
+            uint64_t bus_ns; //time the bus was busy
+            uint32_t hung; //transfers started while SDA was held
+            uint32_t recoveries; //recovery sequences clocked
+        };
+        const Stats& stats() const;
+        void resetStats();
+
+    private:
+        void account(size_t bytes, bool nostop); //bus time and counters of one transfer
+
+        uint8_t bus_index;
+        uint32_t baud_rate;
+        bool open; //previous transfer ended without STOP
+        SimTCN75A* devices[128];
+        Stats stat;
+
+        bool deferred; //an interrupt is waiting for complete_us
+        uint32_t deferred_flags;
+        uint64_t complete_us;
+        static SimBus* waiting[2]; //buses with a deferred interrupt, by index
+};
+
+//I2C controller policy, the handle is the simulated bus
+struct HostBus{
+    typedef SimBus* Handle;
+
+    static const uint32_t IRQ_STOP = 1u << 0; //transfer finished (STOP seen)
+    static const uint32_t IRQ_ABORT = 1u << 1; //transfer aborted (NACK)
+
+    static void init(Handle bus, uint32_t baud);
+    static inline void pins(uint8_t sda, uint8_t scl){
+        (void)sda;
+        (void)scl;
+    }
+    static int write(Handle bus, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+    static int read(Handle bus, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+    static int readTimeout(Handle bus, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us);
+    static uint8_t index(Handle bus);
+    static void attachIrq(Handle bus, void (*handler)());
+
+    //Runs the transfer right away and calls the handler, like an
+    //interrupt with no latency
+    static void start(Handle bus, uint8_t addr, bool sendPointer, uint8_t reg,
+                      const uint8_t *data, uint8_t nbytes, bool write);
+    static uint32_t irqStatus(Handle bus);
+    static void readData(Handle bus, uint8_t *buf, uint8_t nbytes);
+    static void abort(Handle bus);
+    static bool recover(Handle bus, uint8_t sda, uint8_t scl, uint32_t baud);
+};
+
+//GPIO pins, levels kept in memory. drive() is the external side.
+struct HostGpio{
+    typedef void (*Callback)(unsigned int gpio, uint32_t events);
+
+    static const uint32_t EDGE_FALL = 0x4; //same values as the SDK
+    static const uint32_t EDGE_RISE = 0x8;
+    static const uint8_t PIN_COUNT = 30;
+
+    static void input(uint8_t pin, bool pullUp);
+    static void output(uint8_t pin);
+    static void put(uint8_t pin, bool level);
+    static bool get(uint8_t pin);
+    static void enableIrq(uint8_t pin, uint32_t events);
+    static void enableIrq(uint8_t pin, uint32_t events, Callback cb);
+
+    static void drive(uint8_t pin, bool level); //external device sets an input, fires the edge callback
+};
+
+//PWM levels kept in memory, the pin reads high while the level is not 0
+struct HostPwm{
+    static void init(uint8_t pin);
+    static void set(uint8_t pin, uint8_t level);
+    static uint8_t level(uint8_t pin); //last level set, for the tests
+};
+
+//Virtual microsecond time base
+struct HostClock{
+    static const uint32_t READ_COST_NS = 1000; //time a clock read costs, keeps busy loops moving
+
+    static uint64_t nowUs();
+    static uint32_t nowUs32();
+    static uint32_t nowMs();
+    static void sleepMs(uint32_t ms);
+    static void sleepUs(uint32_t us);
+    static void advanceNs(uint64_t ns); //time spent by the simulated hardware
+};
+
+//Host time in nanoseconds from std::chrono, not the virtual clock: the
+//probes measure what the code costs on this machine, and reading it
+//does not move the simulation on.
+struct HostCycles{
+    typedef uint64_t Stamp;
+
+    static inline void init(){
+    }
+    static Stamp now();
+    static uint32_t since(const Stamp& start); //saturated at ~0u, 4.29 s
+    static inline uint32_t perUs(){
+        return 1000;
+    }
+};
+
+//Flash image in memory, optionally backed by a file. NOR rules: erase
+//sets a sector to 0xFF, program can only clear bits. Erase and program
+//take their typical time on the virtual clock, and power can be cut in
+//the middle of a program to test recovery.
+struct HostFlash{
+    static const uint32_t SECTOR_SIZE = 4096;
+    static const uint32_t PAGE_SIZE = 256;
+    static const uint32_t SIZE = 2 * 1024 * 1024;
+    static const uint32_t ERASE_NS = 45 * 1000 * 1000; //per sector
+    static const uint32_t PROGRAM_NS = 700 * 1000; //per page
+
+    static uint32_t size();
+    static void read(uint32_t offset, uint8_t *dst, size_t len);
+    static void erase(uint32_t offset, size_t len);
+    static void program(uint32_t offset, const uint8_t *src, size_t len);
+
+    static bool open(const char *path); //load the image from a file (created if missing) and write through
+    static void close();
+    static void cutPowerAfter(uint32_t bytes); //the next programs stop after this many bytes, then nothing is written
+    static void restorePower();
+    static bool powerLost();
+
+    //Flash activity since the last reset
+    struct Stats{
+        uint32_t erases; //sectors erased
+        uint32_t pages; //pages programmed
+        uint64_t busy_ns; //time spent erasing and programming
+    };
+    static const Stats& stats();
+    static void resetStats();
+};
+
+//Single core, no interrupts: masking and events are no-ops.
+//Console input comes from a queue filled by the caller, or stdin.
+struct HostCpu{
+    static inline void initStdio(){
+    }
+    static inline void writeRaw(const uint8_t *data, size_t len){
+        fwrite(data, 1, len, stdout);
+        fflush(stdout);
+    }
+    static int readChar(); //queued input first, then stdin if enabled, -1 if none
+    static void feedInput(const char *data, size_t len); //queue console input, for scripted runs
+    static void useStdin(bool enable); //also poll the real stdin (interactive runs)
+    static inline void watchInput(){
+    }
+    static bool inputReady(); //queued input, or stdin readable when enabled
+    static void sleepUntil(uint64_t due_us); //jump to the time or the next bus interrupt
+    static inline uint32_t disableIrq(){
+        return 0;
+    }
+    static inline void restoreIrq(uint32_t state){
+        (void)state;
+    }
+    static inline void signal(){
+    }
+    static inline void waitForEvent(){
+    }
+    static inline void idle(){
+        HostClock::advanceNs(1000);
+        SimBus::pollAll(); //interrupts that came due meanwhile
+    }
+};
+
+}
+
+#endif
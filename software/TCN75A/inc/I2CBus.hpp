@@ -0,0 +1,32 @@
+#ifndef I2CBUS_HPP
+#define I2CBUS_HPP
+
+#include <cstdint>
+#include "Hal.hpp"
+#include "I2CEngine.hpp"
+#include "BusScanner.hpp"
+
+//One I2C controller and everything that belongs to it: the pins, the
+//transaction queue and the scan table. The drivers and sensor arrays on
+//the bus share it, and each controller has its own, so i2c0 and i2c1
+//run their transfers in parallel.
+class I2CBus{
+    public:
+        I2CBus(hal::BusHandle i2c, uint8_t sda, uint8_t scl, uint32_t baud); //constructor
+        void begin(); //set the controller and pins up, take its interrupt
+
+        hal::BusHandle handle() const;
+        uint8_t index() const; //controller number, 0 or 1
+        uint32_t baud() const;
+        I2CEngine& engine();
+        BusScanner& scanner();
+
+    private:
+        const hal::BusHandle I2C_INST;
+        const uint8_t SDA_PIN, SCL_PIN;
+        const uint32_t BAUD_RATE;
+        I2CEngine txn_engine; //queue of register transactions on I2C_INST
+        BusScanner bus_scanner; //address probing and the cached scan table
+};
+
+#endif
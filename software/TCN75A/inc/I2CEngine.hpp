@@ -0,0 +1,127 @@
+#ifndef I2CENGINE_HPP
+#define I2CENGINE_HPP
+
+#include <cstdint>
+#include "Hal.hpp"
+
+struct I2CTransaction;
+
+//Completion callback, runs in interrupt context once the transaction is finished
+typedef void (*I2CCallback)(I2CTransaction& txn, void* context);
+
+//One register access queued on the engine. The caller owns the storage
+//(and the data buffer) until done is set, which makes it act like a future.
+struct I2CTransaction{
+    uint8_t addr; //target address
+    uint8_t reg; //register pointer
+    uint8_t *buf; //data to send or receiving buffer
+    uint8_t nbytes; //number of data bytes
+    bool write; //true: write buf to reg, false: read reg into buf
+    bool reuse_pointer; //read only: skip the pointer byte if the device already points at reg
+    I2CCallback callback; //optional, can be nullptr
+    void* context; //passed back to the callback
+    volatile int result; //bytes transferred, PICO_ERROR_GENERIC (NACK) or PICO_ERROR_TIMEOUT
+    volatile bool done; //set once the transaction is finished
+};
+
+//Error handling of the blocking transfers. Only the failure path reads it,
+//a transfer that succeeds at the first attempt costs the same as without it.
+struct I2CRetryPolicy{
+    uint32_t timeout_us; //one attempt, from submit to STOP
+    uint8_t attempts; //tries before giving up, 1 for no retry
+    uint16_t backoff_us; //wait before the first retry, doubled after each one
+    uint16_t backoff_max_us; //longest wait between two tries
+};
+
+class I2CEngine{
+    public:
+        I2CEngine(hal::BusHandle i2c); //constructor
+        void begin(); //install the I2C interrupt handler, call after hal::Bus::init
+
+        //Fill a transaction for a register read or write
+        static void prepareRead(I2CTransaction& txn, uint8_t addr, uint8_t reg, uint8_t *buf,
+        uint8_t nbytes, I2CCallback cb = nullptr, void* ctx = nullptr);
+        static void prepareWrite(I2CTransaction& txn, uint8_t addr, uint8_t reg, uint8_t *buf,
+        uint8_t nbytes, I2CCallback cb = nullptr, void* ctx = nullptr);
+
+        bool submit(I2CTransaction& txn); //queue a transaction, returns false if full
+        int wait(I2CTransaction& txn, uint32_t timeout_us = DEFAULT_TIMEOUT_US); //block until done or timed out
+        int transfer(I2CTransaction& txn); //submit and wait, retried with backoff on failure
+        void drain(); //block until the queue is empty
+        bool idle() const; //no transaction in flight or queued
+        void acquire(); //drain and hold the queue so the SDK blocking calls can use the bus
+        void release(); //resume the queue after acquire
+        void forgetPointers(); //the device register pointers are unknown (reset, bus error)
+
+        //Bus errors
+        void setRecovery(uint8_t sda, uint8_t scl, uint32_t baud); //pins clocked by recover()
+        bool recover(); //clock a stuck target free and set the controller up again
+        void watchdog(); //fail a transaction stuck on the bus, call periodically for the async users
+        void setRetryPolicy(const I2CRetryPolicy& policy);
+        const I2CRetryPolicy& retryPolicy() const;
+
+        //Errors of one target, counted on the failure path only
+        struct DeviceErrors{
+            uint8_t addr; //0 for a free slot
+            uint16_t nacks; //attempts not acknowledged
+            uint16_t timeouts; //attempts that did not finish in time
+            uint16_t retries; //attempts after the first one
+            uint16_t failures; //blocking transfers that failed every attempt
+        };
+        const DeviceErrors& deviceErrors(uint8_t slot) const; //slot < MAX_DEVICES, addr 0 if unused
+
+        //Statistics used to compare the blocking and async paths
+        struct Stats{
+            uint32_t submitted; //transactions accepted
+            uint32_t completed; //transactions finished successfully
+            uint32_t failed; //transactions aborted (NACK, arbitration...)
+            uint32_t cpu_us; //time spent in submit and in the interrupt handler
+            uint32_t wait_us; //time callers spent blocked in wait()
+            uint32_t pointer_skips; //pointer bytes not sent thanks to reuse_pointer
+            uint32_t timeouts; //transactions given up on the bus
+            uint32_t retries; //attempts after the first one
+            uint32_t recoveries; //bus recoveries run
+            uint32_t stuck; //recoveries that did not free SDA
+        };
+        const Stats& stats() const;
+
+        static const uint8_t QUEUE_SIZE = 8; //pending transactions
+        static const uint8_t MAX_PAYLOAD = 14; //data bytes that fit the TX FIFO with the pointer
+        static const uint32_t DEFAULT_TIMEOUT_US = 5000; //a 14 byte transfer at 100 kHz takes 1.5 ms
+        static const uint8_t MAX_DEVICES = 8; //targets with their own error counters
+
+    private:
+        void startNext(); //load the next queued transaction into the controller
+        void handleIRQ(); //STOP_DET / TX_ABRT handler
+        void expire(); //fail the transaction on the bus and recover it
+        bool cancel(I2CTransaction& txn); //fail a transaction still in the queue
+        void finish(I2CTransaction& txn); //mark done and run the callback
+        int retry(I2CTransaction& txn, int result); //failure path of transfer
+        DeviceErrors* device(uint8_t addr); //counters of a target, nullptr if every slot is taken
+        static void i2c0_irq();
+        static void i2c1_irq();
+
+        hal::BusHandle I2C_INST;
+        I2CTransaction* queue[QUEUE_SIZE];
+        volatile uint8_t head, tail; //queue indexes, head is the active transaction
+        volatile bool busy; //a transaction is on the bus
+        volatile bool aborted; //TX_ABRT seen for the active transaction
+        volatile bool paused; //queue held by acquire
+        volatile bool recovering; //bus being recovered, nothing may start
+        uint8_t pointers[128]; //last register pointer sent to each address, NO_POINTER if unknown
+        static const uint8_t NO_POINTER = 0xFF;
+        Stats stat;
+        volatile uint32_t isr_us; //handler time counted so far, taken out of the calls it ran inside
+
+        I2CRetryPolicy policy;
+        uint8_t sda_pin, scl_pin;
+        uint32_t baud_rate; //0 until setRecovery, recover() then only resets the engine state
+        DeviceErrors devices[MAX_DEVICES];
+        bool watching; //watchdog saw the bus busy
+        uint32_t watch_progress; //transactions finished when it did
+        uint32_t watch_us;
+
+        static I2CEngine* instances[2]; //one engine per I2C controller
+};
+
+#endif
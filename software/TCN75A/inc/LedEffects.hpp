@@ -0,0 +1,96 @@
+#ifndef LEDEFFECTS_HPP
+#define LEDEFFECTS_HPP
+
+#include <atomic>
+#include <cstdint>
+
+//LEDs the effects engine drives
+enum class LedChannel : uint8_t {
+    Red,
+    Green,
+    Alert,
+    COUNT
+};
+
+//Who asked for a pattern, a higher priority one plays first
+enum class LedPriority : uint8_t {
+    Status, //ongoing state, such as a running stream
+    Feedback, //answer to a command: setting applied or refused
+    Alarm //must be seen
+};
+
+//One step of a pattern: a brightness held for a time
+struct LedStep{
+    uint8_t level; //0 off, 255 full
+    uint16_t ms;
+};
+
+struct LedPattern{
+    const LedStep* steps;
+    uint8_t count;
+};
+
+//Built-in patterns
+namespace led_pattern{
+extern const LedPattern BLINK; //250 ms on, 250 ms off
+extern const LedPattern FAST_BLINK; //100 ms on, 100 ms off
+extern const LedPattern BREATHE; //PWM ramp up and down, 1.2 s
+}
+
+//Non-blocking LED effects. Patterns are queued per LED by priority and
+//played by tick(), called from a repeating timer, so the callers return
+//right away and sampling goes on during the feedback. A higher priority
+//pattern takes the LED and the one it interrupted starts over after it.
+//An LED with nothing queued shows its base level. LEDs bound to the same
+//pin (the red and the Alert LED of the board) show the brighter of the two.
+class LedEffects{
+    public:
+        static const uint8_t QUEUE_SIZE = 4; //patterns waiting per LED
+        static const uint8_t NO_PIN = 0xFF;
+        static const uint32_t TICK_MS = 10; //period of the timer calling tick
+
+        LedEffects(); //constructor
+        void bind(LedChannel led, uint8_t pin); //the pin becomes a PWM output
+        bool play(LedChannel led, const LedPattern& pattern, uint8_t repeat, LedPriority priority); //repeat 0: until cancelled
+        void cancel(LedChannel led, LedPriority priority); //drop the patterns of this priority
+        void setBase(LedChannel led, uint8_t level); //level shown when idle, safe from the other core
+        void tick(uint32_t now_ms); //advance the patterns and update the pins
+        bool busy(LedChannel led) const; //a pattern is playing
+        uint8_t level(LedChannel led) const; //brightness the LED shows
+
+        struct Stats{
+            uint32_t played; //patterns finished
+            uint32_t preempted; //patterns interrupted by a higher priority one
+            uint32_t dropped; //patterns refused, queue full of higher priorities
+            uint32_t ticks;
+        };
+        const Stats& stats() const;
+
+    private:
+        struct Request{
+            const LedPattern* pattern;
+            uint8_t repeat; //0 for ever
+            LedPriority priority;
+        };
+        struct Led{
+            uint8_t pin;
+            std::atomic<uint8_t> base;
+            Request queue[QUEUE_SIZE]; //by priority, the head is playing
+            uint8_t queued;
+            uint8_t step; //step of the head pattern
+            uint8_t done; //repeats of the head pattern completed
+            bool started; //step_ms is set
+            uint32_t step_ms; //start of the current step
+            uint8_t shown; //level computed by the last tick
+        };
+
+        void advance(Led& led, uint32_t now_ms);
+        void restart(Led& led);
+        void remove(Led& led, uint8_t index);
+
+        Led leds[(uint8_t)LedChannel::COUNT];
+        uint8_t written[(uint8_t)LedChannel::COUNT]; //level last written to the pin of each LED
+        Stats stat;
+};
+
+#endif
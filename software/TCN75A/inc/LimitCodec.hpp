@@ -0,0 +1,48 @@
+#ifndef LIMITCODEC_HPP
+#define LIMITCODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+//TSET/THYST limit registers of the TCN75A: a 9 bit two's complement
+//temperature in 0.5 C steps, left aligned in a 16 bit word (bits 15..7,
+//the low 7 bits read as 0). Everything is integer, nothing is allocated.
+namespace tcn75a{
+
+constexpr uint16_t LIMIT_MASK = 0xFF80;
+
+//Accepted limits, the operating range of the sensor, in half degrees
+constexpr int16_t LIMIT_MIN_HALF = -40 * 2;
+constexpr int16_t LIMIT_MAX_HALF = 125 * 2;
+
+//Why a typed value was refused
+enum class ParseError : uint8_t {
+    None,
+    Empty, //nothing but a sign
+    Syntax, //not a decimal number
+    Range //outside the accepted limits
+};
+
+//Half degrees to the register word
+constexpr uint16_t encodeLimit(int16_t half){
+    return (uint16_t)(half * 128) & LIMIT_MASK;
+}
+
+//Register word to half degrees, the low 7 bits are ignored
+constexpr int16_t decodeLimit(uint16_t raw){
+    return (int16_t)((int16_t)(raw & LIMIT_MASK) / 128);
+}
+
+//Register bytes as they come off the bus
+constexpr uint16_t limitWord(uint8_t msb, uint8_t lsb){
+    return (uint16_t)((msb << 8) | lsb);
+}
+
+ParseError parseCelsius(const char* text, int32_t& milli); //signed decimal C to milli C
+ParseError parseLimit(const char* text, uint16_t& raw); //to the nearest 0.5 C register word
+int formatLimit(uint16_t raw, char* out, size_t size); //"-12.5", returns the characters written
+const char* parseErrorText(ParseError error);
+
+} //namespace tcn75a
+
+#endif
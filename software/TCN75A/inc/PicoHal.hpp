@@ -0,0 +1,379 @@
+#ifndef PICOHAL_HPP
+#define PICOHAL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/i2c.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/flash.h"
+#include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+
+//RP2040 backend of the HAL, thin inline wrappers around the Pico SDK
+namespace hal {
+
+//I2C controller, blocking SDK calls and the DW register steps of I2CEngine
+struct PicoBus{
+    typedef i2c_inst_t* Handle;
+
+    static const uint32_t IRQ_STOP = 1u << 0; //transfer finished (STOP seen)
+    static const uint32_t IRQ_ABORT = 1u << 1; //transfer aborted (NACK, arbitration...)
+
+    static inline void init(Handle i2c, uint32_t baud){
+        i2c_init(i2c, baud);
+    }
+
+    static inline void pins(uint8_t sda, uint8_t scl){
+        gpio_set_function(sda, GPIO_FUNC_I2C);
+        gpio_set_function(scl, GPIO_FUNC_I2C);
+        gpio_pull_up(sda);
+        gpio_pull_up(scl);
+    }
+
+    static inline int write(Handle i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop){
+        return i2c_write_blocking(i2c, addr, src, len, nostop);
+    }
+
+    static inline int read(Handle i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop){
+        return i2c_read_blocking(i2c, addr, dst, len, nostop);
+    }
+
+    static inline int readTimeout(Handle i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us){
+        return i2c_read_timeout_us(i2c, addr, dst, len, nostop, timeout_us);
+    }
+
+    static inline uint8_t index(Handle i2c){
+        return (uint8_t)i2c_hw_index(i2c);
+    }
+
+    //Route the controller interrupt to handler, sources stay masked until start
+    static inline void attachIrq(Handle i2c, void (*handler)()){
+        uint irq = (index(i2c) == 0) ? I2C0_IRQ : I2C1_IRQ;
+        i2c_get_hw(i2c)->intr_mask = 0;
+        irq_set_exclusive_handler(irq, handler);
+        irq_set_enabled(irq, true);
+    }
+
+    //Load the whole command sequence in the TX FIFO: optional pointer byte,
+    //data bytes or read commands, STOP on the last one. The controller runs
+    //the transfer on its own and interrupts on STOP or abort.
+    static inline void start(Handle i2c, uint8_t addr, bool sendPointer, uint8_t reg,
+                             const uint8_t *data, uint8_t nbytes, bool write){
+        i2c_hw_t *hw = i2c_get_hw(i2c);
+
+        //target address can only be changed while the controller is disabled
+        hw->enable = 0;
+        hw->tar = addr;
+        hw->enable = 1;
+
+        if(sendPointer){
+            hw->data_cmd = reg;
+        }
+        for(int i = 0; i < nbytes; i++){
+            uint32_t cmd = write ? data[i] : (I2C_IC_DATA_CMD_CMD_BITS | (i == 0 ? I2C_IC_DATA_CMD_RESTART_BITS : 0));
+            if(i == nbytes - 1){
+                cmd |= I2C_IC_DATA_CMD_STOP_BITS;
+            }
+            hw->data_cmd = cmd;
+        }
+
+        hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+    }
+
+    //Read and clear the interrupt causes, masks the sources once STOP is seen
+    static inline uint32_t irqStatus(Handle i2c){
+        i2c_hw_t *hw = i2c_get_hw(i2c);
+        uint32_t status = hw->intr_stat;
+        uint32_t flags = 0;
+        if(status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS){
+            (void)hw->clr_tx_abrt;
+            flags |= IRQ_ABORT;
+        }
+        if(status & I2C_IC_INTR_STAT_R_STOP_DET_BITS){
+            (void)hw->clr_stop_det;
+            hw->intr_mask = 0;
+            flags |= IRQ_STOP;
+        }
+        return flags;
+    }
+
+    //Give up on the transfer in progress: mask the sources and disable the
+    //controller, a late STOP must not complete the next transaction
+    static inline void abort(Handle i2c){
+        i2c_hw_t *hw = i2c_get_hw(i2c);
+        hw->intr_mask = 0;
+        hw->enable = 0;
+        (void)hw->clr_intr;
+    }
+
+    //Free a bus held by a target stuck in the middle of a byte: the pins are
+    //taken as open drain GPIOs, SCL pulses (nine at most) until the target
+    //lets SDA go, then a STOP, and the controller is set up again.
+    static inline bool recover(Handle i2c, uint8_t sda, uint8_t scl, uint32_t baud){
+        const uint32_t half_us = 5; //100 kHz, slow enough for any target
+        i2c_deinit(i2c);
+        gpio_init(sda);
+        gpio_init(scl);
+        gpio_pull_up(sda);
+        gpio_pull_up(scl);
+        gpio_put(sda, 0); //low when the pin is an output, released when input
+        gpio_put(scl, 0);
+        for(int i = 0; i < 9 && !gpio_get(sda); i++){
+            gpio_set_dir(scl, GPIO_OUT);
+            sleep_us(half_us);
+            gpio_set_dir(scl, GPIO_IN);
+            sleep_us(half_us);
+        }
+        //STOP: SDA rises while SCL is high
+        gpio_set_dir(sda, GPIO_OUT);
+        sleep_us(half_us);
+        gpio_set_dir(sda, GPIO_IN);
+        sleep_us(half_us);
+        bool released = gpio_get(sda) && gpio_get(scl);
+        i2c_init(i2c, baud);
+        pins(sda, scl);
+        return released;
+    }
+
+    //Copy nbytes from the RX FIFO and discard anything left behind
+    static inline void readData(Handle i2c, uint8_t *buf, uint8_t nbytes){
+        i2c_hw_t *hw = i2c_get_hw(i2c);
+        for(int i = 0; i < nbytes; i++){
+            buf[i] = (uint8_t)hw->data_cmd;
+        }
+        while(hw->rxflr){
+            (void)hw->data_cmd;
+        }
+    }
+};
+
+//GPIO pins and edge interrupts
+struct PicoGpio{
+    typedef gpio_irq_callback_t Callback;
+
+    static const uint32_t EDGE_FALL = GPIO_IRQ_EDGE_FALL;
+    static const uint32_t EDGE_RISE = GPIO_IRQ_EDGE_RISE;
+
+    static inline void input(uint8_t pin, bool pullUp){
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_IN);
+        if(pullUp){
+            gpio_pull_up(pin);
+        }
+    }
+
+    static inline void output(uint8_t pin){
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_OUT);
+    }
+
+    static inline void put(uint8_t pin, bool level){
+        gpio_put(pin, level);
+    }
+
+    static inline bool get(uint8_t pin){
+        return gpio_get(pin);
+    }
+
+    static inline void enableIrq(uint8_t pin, uint32_t events){
+        gpio_set_irq_enabled(pin, events, true);
+    }
+
+    //The RP2040 has one gpio callback per core, shared by every pin
+    static inline void enableIrq(uint8_t pin, uint32_t events, Callback cb){
+        gpio_set_irq_enabled_with_callback(pin, events, true, cb);
+    }
+};
+
+//PWM output of a pin. The 8 bit level is squared so the steps look
+//evenly spaced to the eye, the period is 65025 counts (1.9 kHz).
+struct PicoPwm{
+    static inline void init(uint8_t pin){
+        gpio_set_function(pin, GPIO_FUNC_PWM);
+        uint slice = pwm_gpio_to_slice_num(pin);
+        pwm_set_wrap(slice, 255 * 255);
+        pwm_set_gpio_level(pin, 0);
+        pwm_set_enabled(slice, true);
+    }
+
+    static inline void set(uint8_t pin, uint8_t level){
+        pwm_set_gpio_level(pin, (uint16_t)(level * level));
+    }
+};
+
+//Microsecond time base
+struct PicoClock{
+    static inline uint64_t nowUs(){
+        return time_us_64();
+    }
+
+    static inline uint32_t nowUs32(){
+        return time_us_32();
+    }
+
+    static inline uint32_t nowMs(){
+        return to_ms_since_boot(get_absolute_time());
+    }
+
+    static inline void sleepMs(uint32_t ms){
+        sleep_ms(ms);
+    }
+
+    static inline void sleepUs(uint32_t us){
+        sleep_us(us);
+    }
+};
+
+//Cycle counter of the calling core: the 24 bit SysTick at clk_sys, free
+//running. It wraps every 134 ms at 125 MHz, longer spans are taken from
+//the microsecond timer instead.
+struct PicoCycles{
+    static const uint32_t MASK = 0xFFFFFF;
+    static const uint32_t WRAP_US = 100 * 1000; //spans shorter than this use the cycles
+
+    struct Stamp{
+        uint32_t us;
+        uint32_t cycles;
+    };
+
+    //Each core has its own SysTick: called once on both
+    static inline void init(){
+        systick_hw->csr = 0; //stopped while reloading
+        systick_hw->rvr = MASK;
+        systick_hw->cvr = 0;
+        systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS; //processor clock, no interrupt
+    }
+
+    static inline Stamp now(){
+        Stamp s;
+        s.cycles = systick_hw->cvr;
+        s.us = time_us_32();
+        return s;
+    }
+
+    //Cycles since the stamp, saturated at ~0u
+    static inline uint32_t since(const Stamp& start){
+        uint32_t cycles = systick_hw->cvr;
+        uint32_t us = time_us_32() - start.us;
+        if(us < WRAP_US){
+            return (start.cycles - cycles) & MASK; //counts down
+        }
+        uint64_t ticks = (uint64_t)us * perUs();
+        return ticks > UINT32_MAX ? UINT32_MAX : (uint32_t)ticks;
+    }
+
+    static inline uint32_t perUs(){
+        return clock_get_hz(clk_sys) / 1000000;
+    }
+};
+
+//On-board QSPI flash, offsets from the start of the flash.
+//Erase and program stop the XIP cache: interrupts are disabled and
+//the other core is parked (it must have called multicore_lockout_victim_init).
+struct PicoFlash{
+    static const uint32_t SECTOR_SIZE = FLASH_SECTOR_SIZE;
+    static const uint32_t PAGE_SIZE = FLASH_PAGE_SIZE;
+
+    static inline uint32_t size(){
+        return PICO_FLASH_SIZE_BYTES;
+    }
+
+    static inline void read(uint32_t offset, uint8_t *dst, size_t len){
+        memcpy(dst, (const void*)(uintptr_t)(XIP_BASE + offset), len);
+    }
+
+    static inline void erase(uint32_t offset, size_t len){
+        multicore_lockout_start_blocking();
+        uint32_t state = save_and_disable_interrupts();
+        flash_range_erase(offset, len);
+        restore_interrupts(state);
+        multicore_lockout_end_blocking();
+    }
+
+    static inline void program(uint32_t offset, const uint8_t *src, size_t len){
+        multicore_lockout_start_blocking();
+        uint32_t state = save_and_disable_interrupts();
+        flash_range_program(offset, src, len);
+        restore_interrupts(state);
+        multicore_lockout_end_blocking();
+    }
+};
+
+//Core level primitives
+struct PicoCpu{
+    static inline void initStdio(){
+        stdio_init_all();
+    }
+
+    //Binary output on stdio, without the CR/LF translation
+    static inline void writeRaw(const uint8_t *data, size_t len){
+        for(size_t i = 0; i < len; i++){
+            putchar_raw(data[i]);
+        }
+        stdio_flush();
+    }
+
+    //Next character received on stdio, -1 if nothing is waiting
+    static inline int readChar(){
+        int c = getchar_timeout_us(0);
+        return c < 0 ? -1 : c;
+    }
+
+    //Set by the stdio receive callback, taken by inputReady. Starts set
+    //for whatever came in before the callback was installed.
+    static inline std::atomic<bool>& inputFlag(){
+        static std::atomic<bool> flag(true);
+        return flag;
+    }
+
+    static inline void onInput(void *param){
+        (void)param;
+        inputFlag().store(true, std::memory_order_release);
+    }
+
+    //Call once after stdio_init_all, inputReady then tells when to read
+    static inline void watchInput(){
+        stdio_set_chars_available_callback(&onInput, nullptr);
+    }
+
+    //Characters arrived since the last call
+    static inline bool inputReady(){
+        return inputFlag().exchange(false, std::memory_order_acq_rel);
+    }
+
+    static inline uint32_t disableIrq(){
+        return save_and_disable_interrupts();
+    }
+
+    static inline void restoreIrq(uint32_t state){
+        restore_interrupts(state);
+    }
+
+    static inline void signal(){
+        __sev(); //wake the other core
+    }
+
+    static inline void waitForEvent(){
+        __wfe();
+    }
+
+    static inline void idle(){
+        tight_loop_contents();
+    }
+
+    //Sleep until the time or the next interrupt, whichever comes first
+    static inline void sleepUntil(uint64_t due_us){
+        best_effort_wfe_or_timeout(from_us_since_boot(due_us));
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef PROBE_HPP
+#define PROBE_HPP
+
+#include <cstdint>
+#include "Hal.hpp"
+
+//Timing probes of the hot paths.
+//
+//PROBE_SCOPE(Point) at the top of a function times it until it returns,
+//in hal::Cycles ticks (cycles on the Pico, ns on Linux), into a histogram
+//of that point kept in static storage. "probes" on the console prints
+//them. Without TCN75A_PROBES the macro is empty and no storage is kept.
+//
+//A point is written by one core only, the one its function runs on:
+//the dump from core 0 may be one sample behind for the core 1 points.
+
+namespace probe {
+
+//Probe points, one histogram each
+enum class Point : uint8_t{
+    TempRead, //TempSensor::get_Temp, blocking read and conversion
+    ReadReg, //TempSensor::Read_Reg
+    BusScan, //TempSensor::bus_scan, scan and table
+    MainMenu, //main menu rendering through std::cout
+    TempScreen, //temperature screen redraw
+    Command, //one console line handled
+    SensorPoll, //SensorArray::poll, core 0
+    StatsUpdate, //StatsBank::update, core 1
+    RuleEval, //RuleEngine::evaluate, core 1
+    LogPush, //SampleLog::push, core 1
+    TextLine, //TextStream::push, core 1
+    COUNT
+};
+
+//Log-linear histogram: 4 linear buckets per power of two, so any value
+//is within 25 % of its bucket, from 1 tick to ~0u in 124 counters.
+class Histogram{
+    public:
+        static const uint8_t SUB_BITS = 2;
+        static const uint8_t SUBS = 1 << SUB_BITS;
+        static const uint8_t BUCKETS = (32 - SUB_BITS + 1) * SUBS;
+
+        Histogram(); //constructor
+
+        void record(uint32_t ticks);
+        void reset();
+
+        uint32_t count() const;
+        uint32_t min() const;
+        uint32_t max() const;
+        uint64_t sum() const;
+        uint32_t percentile(uint8_t pct) const; //upper edge of the bucket holding it, capped at max()
+
+        static uint8_t bucketOf(uint32_t ticks);
+        static uint32_t bucketLow(uint8_t bucket); //smallest value of the bucket
+
+    private:
+        uint32_t counts[BUCKETS];
+        uint32_t total;
+        uint32_t lowest;
+        uint32_t highest;
+        uint64_t ticks_sum;
+};
+
+#if defined(TCN75A_PROBES)
+static const bool ENABLED = true;
+#else
+static const bool ENABLED = false;
+#endif
+
+void init(); //start the counter of the calling core, once on each
+const char* name(Point point);
+const Histogram* histogram(Point point); //nullptr without TCN75A_PROBES
+void record(Point point, uint32_t ticks);
+void reset();
+void print(); //one line per point that ran: count, mean, percentiles, in us
+
+//Times its scope into a point
+class Scope{
+    public:
+        explicit Scope(Point point): point(point), start(hal::Cycles::now()){
+        }
+        ~Scope(){
+            record(point, hal::Cycles::since(start));
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Point point;
+        hal::Cycles::Stamp start;
+};
+
+}
+
+#if defined(TCN75A_PROBES)
+#define PROBE_SCOPE(point) probe::Scope probe_scope_(probe::Point::point)
+#else
+#define PROBE_SCOPE(point) do{}while(0)
+#endif
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef SAMPLELOG_HPP
+#define SAMPLELOG_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "Hal.hpp"
+#include "SampleRing.hpp"
+
+//Circular sample log in flash.
+//
+//The log region is a ring of sectors. Records are staged in a RAM copy
+//of one sector and the sector is erased and programmed in one go when
+//it is full (or old), so each sector is erased once per trip around
+//the ring. Sector layout, little endian:
+//
+//  0  magic     u32 MAGIC
+//  4  seq       u32 sector sequence number, +1 per sector written
+//  8  first_ms  u64 log time of the first record
+// 16  last_ms   u64 log time of the last record
+// 24  used      u16 payload bytes
+// 26  count     u16 records
+// 28  crc       u16 CRC-16 of the payload
+// 30  hcrc      u16 CRC-16 of bytes 0..29
+// 32  payload   records
+//
+//A record is varint(dt_ms << 4 | raw_flag << 3 | addr - 0x48) followed by
+//varint(zigzag(delta of raw >> 4)) from the previous reading of the same
+//sensor in the sector, or by the u16 raw word when its 4 low bits are
+//not zero (the TCN75A always reads them as 0). Every sector decodes on
+//its own. The header page is programmed last, so a sector cut by a
+//power loss fails its CRC and is skipped at mount.
+//
+//Log time is milliseconds since the first boot: each boot carries on
+//from the last time found in flash, since the board has no RTC.
+class SampleLog{
+    public:
+        static const uint32_t MAGIC = 0x474F4C54; //"TLOG"
+        static const uint32_t SECTOR_SIZE = hal::Flash::SECTOR_SIZE;
+        static const uint16_t HEADER_SIZE = 32;
+        static const uint16_t MAX_SECTORS = 64;
+        static const uint16_t MAX_RECORD = 13; //largest encoded record
+
+        typedef void (*SampleHandler)(const TempSample& sample, void* context);
+
+        SampleLog(uint32_t offset, uint16_t sectors); //flash offset of the region, sectors in the ring
+
+        uint16_t mount(); //rebuild the index from flash, returns the valid sectors
+        void format(); //erase the whole region
+
+        //Writer side (the sample consumer)
+        bool push(const TempSample& sample); //false if the sample cannot be logged
+        bool flushDue(uint64_t now_us); //commit the staged sector once it is old enough
+        void flush(); //commit the staged records now
+        void setMaxAge(uint32_t ms); //staged records older than this are committed
+        void requestFlush(); //from the other core, served by the next flushDue
+
+        //Reader side, any core
+        uint32_t query(uint64_t from_ms, uint64_t to_ms, SampleHandler handler, void* context);
+        uint64_t logTimeMs(uint64_t now_us) const; //log time of hal::Clock::nowUs
+        uint64_t lastMs() const; //log time of the newest record
+
+        //Statistics
+        struct Stats{
+            uint32_t samples; //records staged since boot
+            uint32_t bytes; //payload bytes of those records
+            uint32_t sectors; //sectors committed since boot
+            uint32_t dropped; //samples that could not be logged
+            uint32_t max_commit_us; //longest erase + program
+            uint16_t mounted; //valid sectors found at mount
+            uint16_t corrupt; //sectors with a bad CRC at mount
+            uint32_t decoded; //sectors decoded by the last query
+            uint32_t skipped; //sectors the index let the last query skip
+        };
+        const Stats& stats() const;
+        uint32_t storedSamples() const; //records in flash and staged
+
+    private:
+        //What the RAM index knows about each sector
+        struct IndexEntry{
+            uint32_t seq;
+            uint64_t first_ms;
+            uint64_t last_ms;
+            uint16_t count;
+            bool valid;
+        };
+
+        bool readHeader(uint16_t sector, uint8_t *buf, IndexEntry& entry); //header check only
+        void commit();
+        void startSector();
+        uint32_t decode(const uint8_t *sector, uint16_t payload, uint64_t first, uint64_t from_ms,
+                        uint64_t to_ms, SampleHandler handler, void* context);
+
+        uint32_t region; //flash offset of sector 0
+        uint16_t sector_count;
+        IndexEntry index[MAX_SECTORS];
+        uint16_t head; //sector the staged records go to
+        uint32_t next_seq;
+        uint64_t boot_ms; //log time at boot
+
+        //Staged sector, records start at HEADER_SIZE
+        uint8_t stage[SECTOR_SIZE];
+        uint16_t used;
+        uint16_t count;
+        uint64_t first_ms;
+        uint64_t last_ms;
+        uint64_t stage_start_us; //when the first staged record arrived
+        uint16_t prev_raw[8]; //previous reading of each sensor in this sector
+        uint32_t max_age_us;
+        std::atomic<bool> flush_request;
+
+        //Reader copies, odd seq while the writer changes the index or the stage
+        std::atomic<uint32_t> seq;
+        IndexEntry index_copy[MAX_SECTORS];
+        uint8_t stage_copy[SECTOR_SIZE];
+        uint8_t read_buf[SECTOR_SIZE];
+
+        Stats stat;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SAMPLEMERGER_HPP
+#define SAMPLEMERGER_HPP
+
+#include <cstdint>
+#include "SampleRing.hpp"
+
+//Consumer side of several sample rings, one per bus, read as a single
+//stream in timestamp order. Every ring is in order already (a bus
+//completes its reads one after the other), so the oldest head is the
+//next sample. An empty ring can still get an older one: a read that
+//completed but whose callback has not pushed yet. A head younger than
+//HOLD_US is kept back while any ring is empty.
+class SampleMerger{
+    public:
+        static const uint8_t MAX_SOURCES = 2; //one per I2C controller
+        static const uint32_t HOLD_US = 200; //longer than a completion callback
+
+        SampleMerger(); //constructor
+        bool addSource(SampleQueue* ring); //false if MAX_SOURCES are already merged
+        bool pop(TempSample& sample, uint64_t now_us); //next sample in time order, false if none is due
+        bool holding() const; //the last pop kept a sample back, call again within HOLD_US
+        uint32_t dropped() const; //samples the producers lost, all rings
+
+        struct Stats{
+            uint32_t merged; //samples handed out
+            uint32_t held; //pops that kept a sample back
+            uint32_t late; //samples older than one already handed out, 0 unless HOLD_US is too short
+            uint32_t per_source[MAX_SOURCES]; //samples handed out from each ring
+        };
+        const Stats& stats() const;
+
+    private:
+        SampleQueue* sources[MAX_SOURCES];
+        uint8_t source_count;
+        bool held_back;
+        uint64_t last_us; //timestamp of the last sample handed out
+        Stats stat;
+};
+
+#endif
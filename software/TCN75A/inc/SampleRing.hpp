@@ -0,0 +1,95 @@
+#ifndef SAMPLERING_HPP
+#define SAMPLERING_HPP
+
+#include <atomic>
+#include <cstdint>
+
+//One temperature reading as it leaves the acquisition core
+struct TempSample{
+    uint64_t timestamp_us; //hal::Clock::nowUs when the read completed
+    uint16_t raw; //raw temperature register word
+    uint8_t addr; //sensor address the sample came from
+};
+
+/**
+ * @brief Lock-free single producer / single consumer ring
+ *
+ * Core 0 pushes, core 1 pops. The indexes are free-running counters:
+ * the producer only writes head, the consumer only writes tail.
+ * The slot is filled before head is released and read before tail is
+ * released, so a sample is never seen half written. On the RP2040 the
+ * acquire/release accesses compile to plain loads/stores with a DMB,
+ * which is what orders SRAM accesses between the two Cortex-M0+ cores.
+ *
+ * @tparam T element type, copied in and out
+ * @tparam N capacity, must be a power of two
+ */
+template<typename T, uint32_t N>
+class SampleRing{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SampleRing size must be a power of two");
+
+    public:
+        SampleRing(): head(0), tail(0), drops(0) {}
+
+        //Producer side: returns false (and counts a drop) if the ring is full
+        bool push(const T& item){
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) == N){
+                drops.store(drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+            slots[h & (N - 1)] = item;
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        //Consumer side: returns false if the ring is empty
+        bool pop(T& item){
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            if(t == head.load(std::memory_order_acquire)){
+                return false;
+            }
+            item = slots[t & (N - 1)];
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        //Consumer side: copy the oldest element without taking it, false if empty
+        bool peek(T& item) const{
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            if(t == head.load(std::memory_order_acquire)){
+                return false;
+            }
+            item = slots[t & (N - 1)];
+            return true;
+        }
+
+        //Number of queued elements, exact only when called from one of the two sides
+        uint32_t size() const{
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+
+        bool empty() const{
+            return size() == 0;
+        }
+
+        //Elements rejected because the consumer fell behind
+        uint32_t dropped() const{
+            return drops.load(std::memory_order_relaxed);
+        }
+
+        static constexpr uint32_t capacity(){
+            return N;
+        }
+
+    private:
+        T slots[N];
+        std::atomic<uint32_t> head; //next slot to write, owned by the producer
+        std::atomic<uint32_t> tail; //next slot to read, owned by the consumer
+        std::atomic<uint32_t> drops; //written by the producer only
+};
+
+//Ring used between the acquisition core and the consumer core
+typedef SampleRing<TempSample, 64> SampleQueue;
+
+#endif
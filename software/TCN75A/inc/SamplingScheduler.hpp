@@ -0,0 +1,71 @@
+#ifndef SAMPLINGSCHEDULER_HPP
+#define SAMPLINGSCHEDULER_HPP
+
+#include <cstdint>
+#include "TempSensor.hpp"
+#include "ConfigRegister.hpp"
+
+//How the scheduler paces the temperature reads
+enum class SamplePolicy : uint8_t {
+    FixedRate, //one read per period, never faster than a conversion
+    MaxRate, //one read per conversion, as soon as even a slow part has it ready
+    OneShotBurst //sensor in shutdown, a burst of one-shot conversions every period (low power logging)
+};
+
+class SamplingScheduler{
+    public:
+        SamplingScheduler(TempSensor& sensor); //constructor
+
+        void setPolicy(SamplePolicy policy, uint32_t period_ms = 1000, uint8_t burst = 4);
+        SamplePolicy getPolicy() const;
+        void refreshResolution(); //reload the conversion time from the config register
+
+        bool poll(uint64_t now_us); //start or finish a read when due, true when a sample arrived
+        bool runUntil(uint64_t deadline_us); //poll until the deadline, true if a sample arrived
+        bool waitForSample(uint32_t timeout_ms); //poll until the next sample arrives
+        uint64_t nextDueUs() const; //time the next read is scheduled for
+        bool readPending() const; //a read is in flight, poll() takes it once the sensor has it
+        bool readDone(); //the read in flight completed, poll() has a sample to take
+
+        //Statistics
+        uint32_t samples() const; //reads that returned a temperature
+        uint32_t staleSamples() const; //readings that may repeat the previous conversion
+        uint32_t failedReads() const; //reads that failed on the bus, not counted as samples
+        uint32_t samplesPerSecondX100(uint64_t now_us) const; //achieved rate, 2 decimals
+        uint32_t busTransactions() const; //triggers and reads sent since the last reset
+        uint64_t sensorOnUs(uint64_t now_us) const; //estimated time the sensor was converting
+        void resetStats();
+        void printStats();
+
+    private:
+        void schedule(uint64_t from_us); //compute next_due_us after a read
+        void startRead();
+        bool startConversion(); //queue a one-shot trigger
+        bool finishRead(uint64_t now_us); //true if the read returned a sample
+
+        TempSensor& sensor;
+        SamplePolicy policy;
+        uint32_t period_us; //FixedRate / OneShotBurst period
+        uint8_t burst_size; //OneShotBurst samples per period
+        uint8_t burst_left; //samples left in the current burst
+        uint32_t conversion_us; //conversion time of the current resolution
+        uint32_t oneshot_wait_us; //worst case conversion time, a one-shot is read after it
+        tcn75a::Resolution resolution;
+
+        uint64_t next_due_us; //next read (or one-shot trigger)
+        uint64_t burst_start_us; //start of the current burst period
+        uint64_t change_us; //time of the last read that returned a new temperature
+        TempQ8 last_temp; //temperature of the last read
+        bool converting; //one-shot triggered, waiting for the conversion
+        bool chained; //next one-shot queued behind the read in flight
+        bool reading; //async read in flight
+
+        uint32_t sample_count;
+        uint32_t stale_count;
+        uint32_t failed_count;
+        uint32_t bus_txns;
+        uint32_t conversions; //one-shot conversions triggered
+        uint64_t stats_start_us;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SENSORARRAY_HPP
+#define SENSORARRAY_HPP
+
+#include <cstdint>
+#include "Hal.hpp"
+#include "I2CEngine.hpp"
+#include "ConfigRegister.hpp"
+#include "SampleRing.hpp"
+#include "BusScanner.hpp"
+
+//State kept for every TCN75A found on the bus
+struct SensorNode{
+    uint8_t addr; //I2C address
+    bool present; //answered the last discovery
+    uint8_t config; //config register as last read or written
+    uint16_t raw; //last raw temperature word
+    uint64_t last_us; //time of the last reading
+    uint64_t next_due_us; //when the next conversion is ready
+    uint32_t samples; //readings taken
+    uint32_t errors; //failed transactions
+    volatile bool in_flight; //a read is queued on the engine
+    I2CTransaction txn; //storage for the queued read
+    uint8_t buf[2]; //receiving buffer for the queued read
+};
+
+class SensorArray{
+    public:
+        static const uint8_t MAX_SENSORS = 8; //one per A2..A0 combination
+
+        SensorArray(I2CEngine& engine); //constructor
+        uint8_t discover(const BusScanner* scan = nullptr); //probe 0x48 to 0x4F, returns the number of sensors found
+        void exclude(uint8_t addr); //address read by another driver, left out of discovery and polls, 0: none
+        uint8_t count() const; //sensors found by the last discovery
+        const SensorNode& node(uint8_t index) const; //node by index in 0..count()-1
+
+        bool configure(uint8_t index, const tcn75a::ConfigEdit& edit); //one read-modify-write on one sensor
+        bool configureAll(const tcn75a::ConfigEdit& edit); //same change on every sensor
+        void resync(uint8_t addr, uint8_t config); //config written by another driver, follow its resolution
+
+        void poll(uint64_t now_us); //queue reads for every sensor with a new conversion ready
+        void setSampleSink(SampleQueue* sink); //ring that receives every reading
+
+        uint32_t totalSamples() const; //readings taken by all sensors
+        uint32_t samplesPerSecond(uint64_t now_us) const; //aggregate rate since discovery
+        void printStatus(); //table of every sensor
+
+    private:
+        static void onRead(I2CTransaction& txn, void* context);
+        int transfer(I2CTransaction& txn); //submit and wait
+
+        I2CEngine& engine;
+        SensorNode nodes[MAX_SENSORS];
+        uint8_t nodeCount;
+        uint8_t nextNode; //round-robin start for the next poll
+        uint64_t start_us; //time of the last discovery
+        uint8_t excluded; //address left to another driver, 0 if none
+        SampleQueue* sample_sink;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef SIMTCN75A_HPP
+#define SIMTCN75A_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+//Simulated TCN75A for the host build.
+//Models the four registers, the register pointer, the conversion time of
+//each resolution, shutdown / one-shot, the fault queue and the ALERT output,
+//and counts every register access and the time spent converting.
+class SimTCN75A{
+    public:
+        static const int8_t NO_PIN = -1;
+
+        SimTCN75A(uint8_t addr, int8_t alertPin = NO_PIN); //constructor
+        uint8_t address() const;
+
+        void setTemperature(int32_t milli_c); //ambient seen by the next conversions
+        void setResponding(bool ack); //false: NACK every transfer
+        void setWorstCaseTiming(bool slow); //true: convert in the maximum time of the datasheet
+
+        //Fault injection, for the bus error tests
+        static const uint8_t HOLD_FOREVER = 0xFF;
+        void injectNacks(uint8_t count); //NACK the next count transfers
+        void setStretchUs(uint32_t us); //hold SCL low this long in every transfer
+        void holdSda(uint8_t clocks); //hold SDA low until this many SCL pulses, HOLD_FOREVER: never
+        bool sdaHeld() const;
+        uint32_t stretchUs() const;
+        void clockScl(); //one SCL pulse of a bus recovery
+
+        //Bus side, called by SimBus. The first written byte is the pointer.
+        bool write(const uint8_t *src, size_t len);
+        bool read(uint8_t *dst, size_t len);
+
+        //Register content, without going through the bus
+        uint16_t reg(uint8_t ptr);
+        bool alertActive() const;
+
+        //Cycle accounting
+        struct Stats{
+            uint32_t reads[4]; //register reads by pointer
+            uint32_t writes[4]; //register writes by pointer
+            uint32_t pointer_writes; //pointer byte received
+            uint32_t conversions; //temperature conversions completed
+            uint64_t on_us; //time spent converting
+        };
+        const Stats& stats() const;
+        void resetStats();
+
+    private:
+        void update(); //run the conversions due at the current time
+        void convert(); //latch one conversion and evaluate the alert
+        void setAlert(bool active);
+        uint32_t conversionUs() const;
+
+        const uint8_t ADDR;
+        const int8_t ALERT_PIN;
+        bool responding;
+        int32_t ambient_milli;
+        bool worst_case; //conversions take the maximum time instead of the typical one
+        uint8_t nacks_left; //injected NACKs still to answer
+        uint32_t stretch_us;
+        uint8_t sda_clocks; //SCL pulses before SDA is released, 0 when free
+
+        uint8_t pointer;
+        uint8_t config;
+        uint16_t temp, thyst, tset;
+
+        uint64_t conv_start_us; //start of the conversion in progress
+        bool converting;
+        uint8_t faults; //consecutive conversions past the limit
+        bool above; //interrupt mode: TSET crossed, waiting for THYST
+        bool alert;
+
+        Stats stat;
+};
+
+#endif
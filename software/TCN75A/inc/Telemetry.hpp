@@ -0,0 +1,93 @@
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "SampleRing.hpp"
+#include "TempStats.hpp"
+
+//Binary telemetry frame, little endian:
+//
+//  0  sync      0xA5 0x5A
+//  2  version   VERSION
+//  3  count     records in the frame, 1 to MAX_BATCH
+//  4  seq       u32 sequence number of the first record, +1 per record
+//  8  base_us   u64 timestamp of the first record
+// 16  records   count x { i32 dt_us from base_us, u8 addr, u16 raw }
+//  .. crc       u16 CRC-16/CCITT-FALSE over version..last record
+//
+//Statistics frames use the same header with version SUMMARY_VERSION,
+//seq is the sequence number of the next sample and base_us the time
+//of the summary. The records are, one per sensor:
+//  { u8 addr, u32 samples, u8 window, i16 min, i16 max, i16 mean,
+//    u16 stddev, i16 ewma, i16 total_mean, u16 total_stddev }
+//with the temperatures as Q8.8 register words.
+namespace telemetry{
+
+constexpr uint8_t SYNC0 = 0xA5;
+constexpr uint8_t SYNC1 = 0x5A;
+constexpr uint8_t VERSION = 1;
+constexpr uint8_t MAX_BATCH = 32;
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t RECORD_SIZE = 7;
+constexpr size_t CRC_SIZE = 2;
+constexpr size_t MAX_FRAME = HEADER_SIZE + MAX_BATCH * RECORD_SIZE + CRC_SIZE;
+
+constexpr uint8_t SUMMARY_VERSION = 0x81;
+constexpr uint8_t MAX_SUMMARY = StatsBank::MAX_SENSORS;
+constexpr size_t SUMMARY_SIZE = 20;
+static_assert(HEADER_SIZE + MAX_SUMMARY * SUMMARY_SIZE + CRC_SIZE <= MAX_FRAME, "summary frame too large");
+
+constexpr size_t frameSize(uint8_t count){
+    return HEADER_SIZE + count * RECORD_SIZE + CRC_SIZE;
+}
+
+constexpr size_t summaryFrameSize(uint8_t count){
+    return HEADER_SIZE + count * SUMMARY_SIZE + CRC_SIZE;
+}
+
+//CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), table driven
+uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF);
+
+}
+
+//Batches samples into frames and hands them to a raw writer
+class TelemetryStream{
+    public:
+        typedef void (*Writer)(const uint8_t *data, size_t len);
+
+        TelemetryStream(Writer writer); //constructor
+
+        void setEnabled(bool enable); //start/stop streaming, safe from the other core
+        bool enabled() const;
+        void setMaxLatency(uint32_t ms); //a partial batch is sent after this long
+
+        bool push(const TempSample& sample); //add a sample, true if a frame was sent
+        bool flushDue(uint64_t now_us); //send the partial batch once it is old enough
+        void flush(); //send the partial batch now
+        void sendSummary(const StatsSummary *summaries, uint8_t count, uint64_t now_us); //statistics frame
+
+        //Statistics
+        struct Stats{
+            uint32_t frames; //frames sent
+            uint32_t samples; //samples sent
+            uint32_t bytes; //bytes sent
+            uint32_t summaries; //statistics frames sent
+            uint32_t cpu_us; //time spent encoding and writing
+        };
+        const Stats& stats() const;
+
+    private:
+        Writer writer;
+        std::atomic<bool> streaming;
+        uint32_t max_latency_us;
+
+        uint8_t frame[telemetry::MAX_FRAME]; //records are encoded in place
+        uint8_t count; //records in the frame being filled
+        uint64_t base_us; //timestamp of the first record
+        uint32_t next_seq;
+        Stats stat;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef TELEMETRYDECODER_HPP
+#define TELEMETRYDECODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "Telemetry.hpp"
+
+//Host side reader of the binary telemetry stream.
+//Bytes can arrive in any chunk size; text mixed in the stream (menus,
+//debug prints) is skipped by resynchronizing on the sync word and CRC.
+class TelemetryDecoder{
+    public:
+        //One decoded reading
+        struct Sample{
+            uint32_t seq; //sequence number, +1 per sample sent
+            uint64_t timestamp_us; //time of the reading on the MCU
+            uint8_t addr; //sensor address
+            uint16_t raw; //temperature register word
+        };
+        typedef void (*SampleHandler)(const Sample& sample, void* context);
+        typedef void (*SummaryHandler)(const StatsSummary& summary, uint64_t timestamp_us, void* context);
+
+        TelemetryDecoder(SampleHandler handler, void* context = nullptr); //constructor
+
+        size_t feed(const uint8_t *data, size_t len); //returns the samples decoded
+        void reset(); //drop any partial frame
+        void setSummaryHandler(SummaryHandler handler, void* context = nullptr); //statistics frames
+
+        //Statistics
+        struct Stats{
+            uint32_t frames; //frames with a good CRC
+            uint32_t samples; //samples handed to the handler
+            uint32_t summaries; //statistics records handed to the summary handler
+            uint32_t crc_errors; //frames dropped on a CRC mismatch
+            uint32_t skipped; //bytes discarded while looking for a frame
+            uint32_t lost; //samples missing from the sequence numbers
+        };
+        const Stats& stats() const;
+
+    private:
+        size_t scan(); //drop garbage, decode a complete frame
+        size_t decodeFrame(); //frame in buf passed the CRC, hand out its samples
+        void decodeSummary(); //statistics frame in buf passed the CRC
+        void drop(size_t n); //remove n bytes from the front of buf
+
+        SampleHandler handler;
+        void* context;
+        SummaryHandler summary_handler;
+        void* summary_context;
+        uint8_t buf[telemetry::MAX_FRAME];
+        size_t fill; //bytes in buf
+        bool have_seq; //expected_seq is valid
+        uint32_t expected_seq;
+        Stats stat;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef TEMPDECODER_HPP
+#define TEMPDECODER_HPP
+
+#include <cstdint>
+#include "ConfigRegister.hpp"
+#include "FixedTemp.hpp"
+
+//Temperature register decoding, one specialization per resolution.
+//The register is a Q8.8 two's complement word left aligned to the
+//resolution: 9 bits use bits 15..7 (0.5 C), 12 bits use 15..4 (0.0625 C).
+//The unused low bits are masked, the word is sign extended, and every
+//conversion is integer only: one step is an exact number of micro degrees.
+namespace tcn75a{
+
+/**
+ * @brief Decoder of one resolution
+ *
+ * @tparam R resolution the sensor is configured for
+ */
+template<Resolution R>
+struct TempDecoder{
+    static constexpr uint8_t bits = 9 + (uint8_t)R;
+    static constexpr uint8_t shift = 16 - bits; //unused low bits
+    static constexpr uint16_t mask = (uint16_t)(0xFFFFu << shift);
+    static constexpr int32_t step_micro = 1000000 >> (bits - 8); //one step in micro degrees C
+
+    //Q8.8 value with the unused bits cleared
+    static constexpr int16_t q8(uint16_t raw){
+        return (int16_t)(raw & mask);
+    }
+
+    //Signed number of steps
+    static constexpr int16_t steps(uint16_t raw){
+        return (int16_t)(q8(raw) >> shift);
+    }
+
+    static constexpr int32_t micro(uint16_t raw){
+        return steps(raw) * step_micro;
+    }
+
+    //Milli degrees, 12 bit halves rounded away from zero
+    static constexpr int32_t milli(uint16_t raw){
+        return micro(raw) >= 0 ? (micro(raw) + 500) / 1000 : -((-micro(raw) + 500) / 1000);
+    }
+
+    static constexpr TempQ8 temp(uint16_t raw){
+        return TempQ8::fromRaw((uint16_t)q8(raw));
+    }
+};
+
+//Decoder picked at run time from the configured resolution, each
+//entry is one of the compile time specializations
+struct Decoder{
+    int16_t (*q8)(uint16_t raw);
+    int32_t (*micro)(uint16_t raw);
+    int32_t (*milli)(uint16_t raw);
+};
+
+#define TCN75A_DECODER(R) {&TempDecoder<R>::q8, &TempDecoder<R>::micro, &TempDecoder<R>::milli}
+static constexpr Decoder DECODERS[] = {
+    TCN75A_DECODER(Resolution::Bits9),
+    TCN75A_DECODER(Resolution::Bits10),
+    TCN75A_DECODER(Resolution::Bits11),
+    TCN75A_DECODER(Resolution::Bits12),
+};
+#undef TCN75A_DECODER
+
+constexpr const Decoder& decoderFor(Resolution r){
+    return DECODERS[(uint8_t)r];
+}
+
+//Datasheet range, -40 C to +125 C, and the sign bit
+static_assert(TempDecoder<Resolution::Bits9>::micro(0xD800) == -40000000, "-40 C at 9 bits");
+static_assert(TempDecoder<Resolution::Bits12>::micro(0x7D00) == 125000000, "125 C at 12 bits");
+static_assert(TempDecoder<Resolution::Bits12>::micro(0xFFF0) == -62500, "-0.0625 C at 12 bits");
+static_assert(TempDecoder<Resolution::Bits9>::micro(0xFFFF) == -500000, "unused bits masked at 9 bits");
+static_assert(TempDecoder<Resolution::Bits12>::milli(0xFFF0) == -63, "milli rounded away from zero");
+
+}
+
+#endif
@@ -5,33 +5,97 @@
 #include <stdio.h>
 #include <string>
 #include <iostream>
-#include "pico/stdlib.h"
-#include "hardware/i2c.h"
-#include "pico/binary_info.h"
+#include "Hal.hpp"
 #include "led.hpp"
+#include "I2CEngine.hpp"
+#include "I2CBus.hpp"
+#include "SampleRing.hpp"
+#include "FixedTemp.hpp"
+#include "ConfigRegister.hpp"
+#include "BusScanner.hpp"
+#include "CommandParser.hpp"
 
 
+class SensorArray;
+class AlertMonitor;
+class SamplingScheduler;
+class TelemetryStream;
+class TextStream;
+class StatsBank;
+class SampleLog;
+class RuleEngine;
+class ButtonEvents;
+class EventLoop;
+struct ButtonEvent;
+
+//Screen the next console answer belongs to
+enum class MenuState : uint8_t {
+    Main,
+    Config,
+    DeviceID,
+    Alert,
+    Temperature, //live temperature screen
+    Stream, //binary stream running until x
+    Shutdown,
+    CompInt,
+    Polarity,
+    FaultQueue,
+    Resolution,
+    OneShot,
+    SetLimit, //next line is the MAX temp limit
+    HystLimit //next line is the MIN temp limit
+};
+
+//Firmware copy of a sensor register, so reads can be served from memory
+struct ShadowReg{
+    uint8_t data[2]; //last value written or read
+    bool valid; //false until read/written, or after an invalidate
+    uint32_t hits; //reads served from memory
+    uint32_t misses; //reads that had to go on the bus
+};
 
 class TempSensor{
     public:
-        TempSensor(i2c_inst_t *i2c, int sda, int scl, int freq, int redLED, int greenLED, int alert); //constructor
-        void proj_init(); //initialize I2C
+        TempSensor(I2CBus& bus, int redLED, int greenLED, int alert); //constructor, the bus must be started
         void initialiseAlert(); //Initialize the Alert Gpio to handle the alerts and send an interrupt
 
-        uint8_t bus_scan(); //bus scan will retreive temp sensor address
+        uint8_t bus_scan(ScanMode mode = ScanMode::Full); //bus scan will retreive temp sensor address
+        BusScanner& getScanner(); //cached result of the last scan
         bool reserved_address(uint8_t addr); // addresses to be ingnored by I2C
         
-        //Read and Write from any register
-        int Read_Reg(i2c_inst_t *i2c_inst, const uint8_t addr, const uint8_t reg,
-        uint8_t *buf, const uint8_t nbytes);
-        int Write_Reg(i2c_inst_t *i2c_inst, const uint8_t addr, const uint8_t reg,
-        uint8_t *buf, const uint8_t nbytes);
+        //Read and Write from any register, on the bus of the engine
+        int Read_Reg(const uint8_t addr, const uint8_t reg, uint8_t *buf, const uint8_t nbytes);
+        int Write_Reg(const uint8_t addr, const uint8_t reg, uint8_t *buf, const uint8_t nbytes);
+
+        //Non-blocking register access through the transaction engine
+        bool Read_Reg_Async(I2CTransaction& txn, const uint8_t reg, uint8_t *buf,
+        const uint8_t nbytes, I2CCallback cb = nullptr, void* ctx = nullptr);
+        bool Write_Reg_Async(I2CTransaction& txn, const uint8_t reg, uint8_t *buf,
+        const uint8_t nbytes, I2CCallback cb = nullptr, void* ctx = nullptr);
+        I2CEngine& getEngine(); //access to the engine stats and queue
+        I2CBus& getBus(); //controller the sensor is on
         
         //Temperature register functions
         //convert sensor data to readable temp
         float convert_raw_temp(int16_t raw_temp); 
         
-        void Raw_Temp_Read(); // get the Raw sensor temp
+        bool Raw_Temp_Read(); // get the Raw sensor temp, false if the read failed
+        bool Raw_Temp_Read_Async(); // start a temp read, returns false if the queue is full
+        bool Temp_Ready(); // true once the async temp read has completed
+        bool Temp_Ok(); // the completed async temp read returned the register
+        void setSampleSink(SampleQueue* sink); // ring that receives every raw reading
+        void setSensorArray(SensorArray* array); // the other sensors on the bus, shown from the main menu
+        void setSampler(SamplingScheduler* scheduler); // paces the reads shown by the Temp menu
+        void setTelemetry(TelemetryStream* stream); // binary sample output, started from the main menu
+        void setTextStream(TextStream* stream); // readable sample lines formatted on core 1, "stream text"
+        void setStatistics(StatsBank* stats); // per sensor statistics fed by the sample consumer
+        void setSampleLog(SampleLog* log); // flash sample log written by the sample consumer
+        void setRuleEngine(RuleEngine* rules); // software alert rules evaluated by the sample consumer
+        void setLedEffects(LedEffects* effects); // red and green LEDs driven without blocking
+        void setButtonEvents(ButtonEvents* events); // board buttons, their actions run from pollConsole
+        void setEventLoop(EventLoop* loop); // task statistics shown by "read tasks"
+        TempQ8 get_Temp(); //read the sensor and return the fixed-point temp
+        TempQ8 last_Temp() const; //last reading without touching the bus
         float get_Temp_C();//return the converted temp in Celsius
         float get_Temp_F(); //return the converted temp in Fahreneheit
         void displayTemp(); // display the temperature on the terminal
@@ -40,30 +104,41 @@ class TempSensor{
         //Methods to configure settings
         uint8_t readConfigRegister(); // read the config register 
         void modifyConfigRegister(uint8_t mask, uint8_t value); // modify the config register to change settings
+        bool applyConfig(const tcn75a::ConfigEdit& edit); // apply several field changes in one read-modify-write
+        void changeConfig(const tcn75a::ConfigEdit& edit, const char* msg); // apply, print and verify with LEDs
+        bool triggerOneShot_Async(); // start one conversion while in shutdown, queued behind any pending read
         float fixedToFloat(uint8_t integerPart, uint8_t decimalPart);
+        tcn75a::Resolution activeResolution() const; // resolution the temperature is decoded with
 
         //Hysteresis register functions
         //Read and write the minimum temp limit
         void Read_Hyst_Reg();
-        void Write_Hyst_Reg();
+        bool Write_Hyst_Reg(); //true if the sensor took hyst_limit
 
         //Set register functions
         //Read and write the maximum temp limit
         void Read_Set_Reg();
-        void Write_Set_Reg();
+        bool Write_Set_Reg(); //true if the sensor took set_limit
+
+        //Shadow register cache for CONFIG, THYST and TSET
+        int Read_Cached(const uint8_t reg, uint8_t *buf, const uint8_t nbytes);
+        int Write_Cached(const uint8_t reg, uint8_t *buf, const uint8_t nbytes);
+        void invalidateShadow(); //forget every cached register
+        void resyncShadow(); //reload the cache from the sensor
+        void setShadowVerify(bool enable); //read back after every cached write
+        const ShadowReg& getShadow(const uint8_t reg) const;
+        void printShadowStats();
+        void printBusErrors(); // engine and per address bus error counters
 
         //Changing the sensor address without rebooting
         void Modify_DeviceID(int address);
 
-        //Function to verify config register was properly configured
+        //Function to verify config register was properly configured, the LEDs show the result later
         void VerifyReg(uint8_t mask, uint8_t data);
 
-        //Function to read user input lines for temp limits
-        std::string get_input();
-
-        //Alert pin state
-        static bool AlertState;
-        static int pulseCount;
+        //Alert edges are decoded by the monitor, kept in sync with the config register
+        void setAlertMonitor(AlertMonitor* monitor);
+        void syncAlertMonitor();
         //Alert gpio
         const uint8_t Alert_pin;
         //static const uint8_t Alert_pin;
@@ -72,13 +147,36 @@ class TempSensor{
         //***********INTERFACE FUNCTIONS************//
         //******************************************//
 
-        //Menu functions
+        //Console, fed from the poll loop: nothing waits for the terminal
+        void pollConsole(); //run the lines typed since the last call, redraw the screen when due
+        bool pollInput(); //read the console, true if characters may be left for the next call
+        void pollButtons(); //run the button gestures decoded since the last call
+        void refreshDisplay(); //screens due for a redraw, config feedback, rule LEDs, bus watchdog
+        void handleLine(const CommandParser::Command& cmd);
+        void processMenuChoice(const char& choice); //single character answer to the screen shown
+        bool runCommand(const CommandParser::Command& cmd); //scripted command such as "set res 12"
+        void processConsole(const char& choice); //console only actions: temp, config, stream, help
+        void processButton(const ButtonEvent& event); //press, double press or long press of a board button
+        void printHelp();
+        MenuState getMenuState() const;
+        const CommandParser& getConsole() const;
+
+        //Menu functions, they print the screen and set the menu state
         void MainMenu();
         void ANSI_Codes();
         void DeviceID_Menu();
         void AlertConfig_Menu();
         void Temperature_Read_Menu();
         void Config_Menu();
+        void Stream_Menu();
+        void Text_Stream_Menu();
+        void Stats_Menu();
+        void Log_Menu();
+        void dumpLog(uint64_t from_ms, uint64_t to_ms, uint16_t max_lines); //print the logged samples of a range
+        void Rules_Menu();
+        bool addRule(const CommandParser::Command& cmd); //"rule <addr|any> <kind> <value> <param> <leds>"
+        void updateRuleLeds(); //red and green LEDs follow the rule outputs
+        void showMenu(); //print the screen of the current menu state
 
         //Menu choice handlers
         void processMainMenu(const char& choice);
@@ -106,25 +204,96 @@ class TempSensor{
 
         void TestingMsg();
     private:
-        const int SDA_PIN, SCL_PIN, BAUD_RATE;
-        i2c_inst_t *I2C_PIN;
+        I2CBus& i2c_bus; //controller the sensor is on, shared with the arrays on it
+        hal::BusHandle I2C_PIN;
+        I2CEngine& engine; //queue of register transactions on I2C_PIN
+        BusScanner& scanner; //address probing and the cached scan table
         uint8_t sensor_addr;
         uint16_t raw_temperature; 
         float temp_C, temp_F;
+        TempQ8 temp_fixed; //last reading, Q8.8 Celsius
         //uint8_t buf[2];
         uint8_t integerPart, decimalPart;
         uint8_t hyst_limit[2];
         uint8_t set_limit[2];
 
+        //Shadow copies indexed by register pointer, TEMP_REG is never cached
+        ShadowReg shadow[4];
+        bool shadow_verify;
+        static bool cacheable(const uint8_t reg, const uint8_t nbytes);
+        static uint8_t cachedConfig(uint8_t config); //CONFIG value as the shadow copy keeps it
+
+        //Async temperature read state
+        I2CTransaction temp_txn;
+        uint8_t temp_buf[2];
+        volatile bool temp_ready;
+        volatile bool temp_ok; //false when the last async read failed on the bus
+        static void onTempRead(I2CTransaction& txn, void* context);
+
+        //Async one-shot trigger state
+        I2CTransaction oneshot_txn;
+        uint8_t oneshot_buf[1];
+
+        //Async read-back of a menu config change, its feedback is shown by refreshDisplay
+        I2CTransaction verify_txn;
+        uint8_t verify_buf[1];
+        uint8_t verify_mask, verify_data; //bits changed and the value they must hold
+        uint8_t verify_shadow; //shadow copy when the read-back was queued
+        volatile bool verify_landed; //read-back done, feedback not shown yet
+        static void onVerifyRead(I2CTransaction& txn, void* context);
+        void finishVerify(); //compare the read-back, update the shadow copy and blink
+
+        //Raw readings handed to the consumer core
+        SampleQueue* sample_sink;
+        void publishSample();
+
+        //All the sensors on the bus, nullptr if not used
+        SensorArray* sensor_array;
+
+        //ALERT pin decoder and history, nullptr if not used
+        AlertMonitor* alert_monitor;
+
+        //Read pacing, nullptr to read on demand
+        SamplingScheduler* sampler;
+
+        //Binary sample stream, nullptr if not used
+        TelemetryStream* telemetry;
+
+        //Sample lines, formatted by the consumer core, nullptr if not used
+        TextStream* text_stream;
+
+        //Rolling statistics of every sensor, nullptr if not used
+        StatsBank* stats_bank;
+
+        //Flash sample log, nullptr if not used
+        SampleLog* sample_log;
+
+        //Software alert rules, nullptr if not used
+        RuleEngine* rule_engine;
+        uint8_t rule_leds; //rule outputs shown on the LEDs
+
+        //Board buttons, gestures queued by the gpio ISR, nullptr if not used
+        ButtonEvents* button_events;
+
+        //Scheduler of core 0, nullptr if not used
+        EventLoop* event_loop;
+
 
         //LED objects
         LED red_led;
         LED green_led;
 
         //Interface members:
-        char menu_choice, Alert_choice, Temp_choice, 
-        config_choice, ADC_choice, Shutdown_choice, Polarity_choice,
-        Comp_Int_Choice, Fault_choice, OneShot_choice, ID_choice;
+        static const uint32_t MENU_HOLD_MS = 1000; //a message stays up this long before the main menu
+        static const uint32_t TEMP_REFRESH_MS = 500; //live temperature screen refresh
+        static const uint8_t CONSOLE_BURST = 64; //characters read per pollConsole call
+        CommandParser console;
+        MenuState menu_state;
+        uint64_t redraw_us; //time to redraw the current screen, 0 if none
+        void holdScreen(uint32_t ms); //leave the output up, then redraw
+        void stopStream();
+        bool parseTypedLimit(const char* text, uint8_t* limit); //parse a typed limit into register bytes, false if refused
+        void setLimit(bool max, const char* text); //parse, write and confirm a typed MAX or MIN limit
 };
 
 #endif
\ No newline at end of file
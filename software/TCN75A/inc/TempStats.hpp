@@ -0,0 +1,133 @@
+#ifndef TEMPSTATS_HPP
+#define TEMPSTATS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include "SampleRing.hpp"
+
+//Statistics of one sensor, temperatures as Q8.8 register words
+//(TempQ8::fromRaw prints them)
+struct StatsSummary{
+    uint8_t addr; //sensor address
+    uint32_t samples; //readings since the last reset
+    uint8_t window; //readings in the rolling window
+    int16_t min; //rolling window minimum
+    int16_t max; //rolling window maximum
+    int16_t mean; //rolling window mean
+    uint16_t stddev; //rolling window standard deviation
+    int16_t ewma; //exponentially weighted moving average
+    int16_t total_mean; //mean since the last reset (Welford)
+    uint16_t total_stddev; //standard deviation since the last reset (Welford)
+};
+
+/**
+ * @brief Incremental statistics of one sensor
+ *
+ * Every update is O(1) and integer only (the RP2040 has no FPU):
+ * - rolling min/max over the last `window` readings with two
+ *   monotonic deques,
+ * - rolling mean/variance from exact integer sums over the window,
+ * - mean/variance since the last reset with Welford's update, the
+ *   mean kept with WELFORD_FRAC extra fraction bits,
+ * - EWMA with alpha = 1 / 2^shift, kept with EWMA_FRAC extra bits.
+ */
+class RollingStats{
+    public:
+        static const uint8_t MAX_WINDOW = 64; //power of two, size of the rings
+        static const uint8_t WELFORD_FRAC = 12;
+        static const uint8_t EWMA_FRAC = 8;
+
+        RollingStats(uint8_t window = 16, uint8_t ewma_shift = 3); //constructor
+
+        void setWindow(uint8_t window); //1 to MAX_WINDOW readings, resets the window
+        void setEwmaShift(uint8_t shift); //alpha = 1 / 2^shift, 0 to 8
+        void reset();
+        void update(int16_t raw); //add a reading
+
+        //Reading the results
+        uint32_t samples() const;
+        uint8_t windowFill() const; //readings in the window, up to the window size
+        int16_t min() const;
+        int16_t max() const;
+        int32_t windowSum() const; //sum of the window, in raw units
+        int64_t windowSumSq() const; //sum of the squares, in raw units squared
+        int32_t ewmaFixed() const; //EWMA with EWMA_FRAC extra bits
+        int32_t totalMeanFixed() const; //Welford mean with WELFORD_FRAC extra bits
+        uint64_t totalM2() const; //Welford sum of squared deviations, raw units squared << WELFORD_FRAC
+        StatsSummary summary(uint8_t addr) const; //means and deviations rounded to Q8.8
+
+        static uint32_t isqrt(uint64_t value); //floor of the square root
+
+    private:
+        //Ring of readings for the window sums
+        int16_t ring[MAX_WINDOW];
+        uint8_t window_size;
+        uint8_t fill;
+        uint32_t seq; //index of the next reading
+
+        //Monotonic deques, values increasing (min) or decreasing (max) from the front
+        struct Entry{
+            int16_t value;
+            uint32_t index;
+        };
+        Entry min_q[MAX_WINDOW];
+        Entry max_q[MAX_WINDOW];
+        uint8_t min_head, min_tail; //free running, masked with MAX_WINDOW - 1
+        uint8_t max_head, max_tail;
+
+        int32_t sum;
+        int64_t sum_sq;
+
+        uint8_t ewma_shift;
+        int32_t ewma;
+
+        uint32_t total; //readings since reset
+        int32_t total_mean; //fits 32 bits, so the division uses the hardware divider
+        int32_t total_carry; //division remainder not yet added to the mean
+        uint64_t total_m2;
+};
+
+/**
+ * @brief Statistics of every sensor on the bus
+ *
+ * Updated by the sample consumer (core 1), read by the menus
+ * (core 0). A sequence counter, odd while an update runs, lets the
+ * reader retry until it has a consistent copy. Window changes and
+ * resets are requests applied by the updating core.
+ */
+class StatsBank{
+    public:
+        static const uint8_t MAX_SENSORS = 8; //TCN75A addresses 0x48 to 0x4F
+
+        StatsBank(); //constructor
+
+        void update(const TempSample& sample); //consumer side
+        uint8_t summaries(StatsSummary *out, uint8_t max) const; //sensors with readings, any core
+        bool summary(uint8_t addr, StatsSummary& out) const;
+
+        //Requests from the other core, applied at the next update
+        void setWindow(uint8_t window);
+        void setEwmaShift(uint8_t shift);
+        void reset();
+        uint8_t window() const;
+        uint8_t ewmaShift() const;
+
+        //Cost of the updates
+        uint32_t updates() const;
+        uint32_t cpuUs() const; //time spent in update()
+
+    private:
+        void applyRequests();
+
+        RollingStats sensors[MAX_SENSORS];
+        std::atomic<uint32_t> seq; //odd while an update runs
+        std::atomic<uint8_t> req_window;
+        std::atomic<uint8_t> req_shift;
+        std::atomic<bool> req_reset;
+        uint8_t cur_window;
+        uint8_t cur_shift;
+        uint32_t update_count;
+        uint32_t cpu_us;
+};
+
+#endif
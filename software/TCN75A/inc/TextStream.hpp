@@ -0,0 +1,76 @@
+#ifndef TEXTSTREAM_HPP
+#define TEXTSTREAM_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "SampleRing.hpp"
+
+//Readable sample lines, converted, formatted and sent by core 1:
+//
+//     1234.567 s  0x48  26.3125 C  79.3625 F
+//
+//Lines are batched and written in one call when the buffer is full or
+//the oldest line reaches the maximum latency. The link rate is a byte
+//budget: a line that does not fit is dropped and counted instead of
+//blocking core 1, which also keeps the statistics and the log. The
+//first line of the next write says how many were dropped:
+//
+//  # 12 lines dropped
+class TextStream{
+    public:
+        typedef void (*Writer)(const uint8_t *data, size_t len);
+
+        static const size_t BUFFER_SIZE = 256; //lines written per call at most
+        static const size_t MAX_LINE = 48;
+        static const size_t MAX_NOTE = 32; //"# N lines dropped"
+        static const uint32_t USB_RATE = 64000; //bytes/s: one 64 byte packet per 1 ms USB frame
+        static const uint32_t UNLIMITED = 0; //no budget, the writer blocks
+
+        TextStream(Writer writer, uint32_t bytes_per_s = USB_RATE); //constructor
+
+        void setEnabled(bool enable); //start/stop, safe from the other core
+        bool enabled() const;
+        void setMaxLatency(uint32_t ms); //a partial buffer is sent after this long, 0 sends every line
+        void setLinkRate(uint32_t bytes_per_s);
+
+        bool push(const TempSample& sample, uint64_t now_us); //format a line, false if it was dropped
+        bool flushDue(uint64_t now_us); //send the buffer once its oldest line is old enough
+        void flush(uint64_t now_us); //send the buffer now
+        uint64_t nextDueUs() const; //time flushDue sends the buffer, ~0 if it is empty
+
+        //Statistics
+        struct Stats{
+            uint32_t lines; //lines sent
+            uint32_t dropped; //lines over the link budget
+            uint32_t bytes; //bytes sent
+            uint32_t writes; //calls to the writer
+            uint32_t cpu_us; //time spent formatting and writing
+            uint32_t max_latency_us; //sample timestamp to its line written, worst
+            uint64_t latency_us; //sum over the lines sent
+        };
+        const Stats& stats() const;
+        void resetStats();
+
+    private:
+        bool reserve(size_t len, uint64_t now_us); //take len bytes of the link budget
+
+        Writer writer;
+        std::atomic<bool> streaming;
+        uint32_t max_latency_us;
+        uint32_t link_rate; //bytes per second, UNLIMITED for none
+
+        //Link budget, in bytes x 1e6 so the refill stays exact
+        uint64_t credit;
+        uint64_t refill_us;
+        uint32_t pending_drops; //dropped since the last line sent, reported in the stream
+
+        char buffer[BUFFER_SIZE];
+        size_t used;
+        uint8_t lines; //lines in the buffer
+        uint64_t first_us; //timestamp of the oldest sample in the buffer
+        uint64_t stamp_sum; //timestamps of the samples in the buffer, for the latency
+        Stats stat;
+};
+
+#endif
@@ -1,17 +1,22 @@
 #ifndef LED_HPP
 #define LED_HPP
 
-#include "hardware/i2c.h"
-#include "pico/stdlib.h"
+#include <cstdint>
+#include "Hal.hpp"
+#include "LedEffects.hpp"
 
 class LED{
     public:
         LED(uint8_t pin); //Constructor
+        void attach(LedEffects* effects, LedChannel channel); //drive the LED through the effects engine
         void changeState(uint8_t led_state); //change LED state
-        void blinkLED(); //Blink LED once
+        void blink(uint8_t times); //blink, returns right away once attached
+        void blinkLED(); //Blink LED once, blocks for 500 ms
     private:
         uint8_t LED_PIN; // LED gpio pin number
         const int LED_SLEEP_TIME = 250; //delay time between blink
+        LedEffects* effects; //nullptr: the pin is driven directly
+        LedChannel channel;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,212 @@
+#include "../inc/AlertMonitor.hpp"
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief AlertMonitor Constructor
+ *
+ * Constructor initializes an empty history. The defaults match the
+ * sensor power-up config: active low, comparator mode.
+ *
+ * @param pin the gpio pin number of the alert
+ *
+ */
+AlertMonitor::AlertMonitor(uint8_t pin): ALERT_PIN(pin), active_high(false), interrupt_mode(false),
+ack_requested(false), edges(), alert_active(false), history(), history_head(0), history_count(0),
+history_seq(0){
+}
+
+/**
+ * @brief Alert pin
+ *
+ * @return uint8_t the gpio pin number of the alert
+ */
+uint8_t AlertMonitor::pin() const{
+    return ALERT_PIN;
+}
+
+/**
+ * @brief Configure the alert decoding
+ *
+ * In comparator mode the pin level is the alert state. In interrupt
+ * mode the sensor pulses the pin each time a limit is crossed, so
+ * every active edge toggles the alert state.
+ *
+ * @param activeHigh ALERT POLARITY bit of the config register
+ * @param interruptMode COMP/INT bit of the config register
+ *
+ * @return void
+ */
+void AlertMonitor::configure(bool activeHigh, bool interruptMode){
+    active_high.store(activeHigh, std::memory_order_relaxed);
+    interrupt_mode.store(interruptMode, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Interrupt Handler/ISR side.
+ *
+ * Only timestamps the edge and queues it, then wakes core 1.
+ * When both edges are reported at once the pin pulsed faster than the
+ * interrupt latency, and both edges are queued in order.
+ *
+ * @param events the gpio event(s) that triggered the interrupt
+ * @param level the pin level read in the ISR
+ *
+ * @return void
+ */
+void AlertMonitor::onEdge(uint32_t events, bool level){
+    AlertEdge edge;
+    edge.timestamp_us = hal::Clock::nowUs();
+    if((events & hal::Gpio::EDGE_FALL) && (events & hal::Gpio::EDGE_RISE)){
+        edge.level = !level;
+        edges.push(edge);
+    }
+    edge.level = level;
+    edges.push(edge);
+    hal::Cpu::signal();
+}
+
+/**
+ * @brief Acknowledge the alert
+ *
+ * Asks core 1 to clear the alert until the next active edge.
+ *
+ * @return void
+ */
+void AlertMonitor::acknowledge(){
+    ack_requested.store(true, std::memory_order_release);
+    hal::Cpu::signal();
+}
+
+/**
+ * @brief Process the queued edges
+ *
+ * Runs on core 1 after it wakes up. Turns the edges into
+ * assert/deassert events and records them in the history.
+ *
+ * @return bool true if the alert state changed
+ */
+bool AlertMonitor::process(){
+    bool changed = false;
+    bool activeHigh = active_high.load(std::memory_order_relaxed);
+    bool interruptMode = interrupt_mode.load(std::memory_order_relaxed);
+
+    AlertEdge edge;
+    while(edges.pop(edge)){
+        bool atActiveLevel = (edge.level == activeHigh);
+        bool active = alert_active.load(std::memory_order_relaxed);
+        if(interruptMode){
+            if(atActiveLevel){
+                record(!active, edge.timestamp_us);
+                changed = true;
+            }
+        } else if(atActiveLevel != active){
+            record(atActiveLevel, edge.timestamp_us);
+            changed = true;
+        }
+    }
+
+    if(ack_requested.exchange(false, std::memory_order_acquire) && alert_active.load(std::memory_order_relaxed)){
+        record(false, hal::Clock::nowUs());
+        changed = true;
+    }
+    return changed;
+}
+
+/**
+ * @brief Record an alert change
+ *
+ * Opens a new episode on assert, closes the open one on deassert.
+ * The sequence counter lets the other core take a consistent copy.
+ *
+ * @param active new alert state
+ * @param timestamp_us time of the edge
+ *
+ * @return void
+ */
+void AlertMonitor::record(bool active, uint64_t timestamp_us){
+    history_seq.fetch_add(1, std::memory_order_acq_rel);
+    if(active){
+        history[history_head].assert_us = timestamp_us;
+        history[history_head].deassert_us = 0;
+        history_head = (history_head + 1) % HISTORY_SIZE;
+        if(history_count < HISTORY_SIZE){
+            history_count++;
+        }
+    } else if(history_count){
+        AlertEpisode& last = history[(history_head + HISTORY_SIZE - 1) % HISTORY_SIZE];
+        if(last.deassert_us == 0){
+            last.deassert_us = timestamp_us;
+        }
+    }
+    alert_active.store(active, std::memory_order_relaxed);
+    history_seq.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * @brief Alert state
+ *
+ * @return bool true while the alert is active
+ */
+bool AlertMonitor::asserted() const{
+    return alert_active.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Copy the history
+ *
+ * Retries if core 1 updated the history during the copy.
+ *
+ * @param out destination array
+ * @param max size of the destination array
+ *
+ * @return uint8_t the number of episodes copied, oldest first
+ */
+uint8_t AlertMonitor::snapshot(AlertEpisode *out, uint8_t max) const{
+    uint32_t before, after;
+    uint8_t n;
+    do{
+        before = history_seq.load(std::memory_order_acquire);
+        n = history_count < max ? history_count : max;
+        uint8_t first = (history_head + HISTORY_SIZE - n) % HISTORY_SIZE;
+        for(uint8_t i = 0; i < n; i++){
+            out[i] = history[(first + i) % HISTORY_SIZE];
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = history_seq.load(std::memory_order_relaxed);
+    } while((before & 1) || before != after);
+    return n;
+}
+
+/**
+ * @brief Edges lost
+ *
+ * @return uint32_t edges dropped because core 1 did not drain the queue in time
+ */
+uint32_t AlertMonitor::edgesLost() const{
+    return edges.dropped();
+}
+
+/**
+ * @brief Print the alert history
+ *
+ * Shows when each alert started and cleared and how long it lasted.
+ *
+ * @return void
+ */
+void AlertMonitor::printHistory() const{
+    AlertEpisode list[HISTORY_SIZE];
+    uint8_t n = snapshot(list, HISTORY_SIZE);
+    printf(" #  | Assert (ms) | Clear (ms)  | Duration (ms)\n");
+    for(uint8_t i = 0; i < n; i++){
+        if(list[i].deassert_us){
+            printf("%3d | %11llu | %11llu | %llu\n", i, (unsigned long long)(list[i].assert_us / 1000),
+                   (unsigned long long)(list[i].deassert_us / 1000),
+                   (unsigned long long)((list[i].deassert_us - list[i].assert_us) / 1000));
+        } else {
+            printf("%3d | %11llu |      active | %llu\n", i, (unsigned long long)(list[i].assert_us / 1000),
+                   (unsigned long long)((hal::Clock::nowUs() - list[i].assert_us) / 1000));
+        }
+    }
+    printf("Alert is %s, %lu edge(s) lost\n", asserted() ? "ACTIVE" : "clear", (unsigned long)edgesLost());
+}
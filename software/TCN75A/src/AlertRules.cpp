@@ -0,0 +1,338 @@
+#include "../inc/AlertRules.hpp"
+#include "../inc/ConfigRegister.hpp"
+#include "../inc/Hal.hpp"
+#include "../inc/Probe.hpp"
+#include <cstdint>
+
+//Indexed by RuleKind
+const RuleEngine::Evaluator RuleEngine::evaluators[] = {
+    &RuleEngine::evalAbove,
+    &RuleEngine::evalBelow,
+    &RuleEngine::evalRate,
+    &RuleEngine::evalTimeAbove,
+};
+
+/**
+ * @brief RuleEngine Constructor
+ *
+ * No rules, both tables empty.
+ *
+ */
+RuleEngine::RuleEngine(): specs(), spec_count(0), tables(), current(0), pending(-1), state(), lit(), out(0),
+seq(0), stat(){
+}
+
+//******************************************************//
+//***********************EVALUATORS*********************//
+//******************************************************//
+
+/**
+ * @brief High band
+ *
+ * @param entry compiled rule
+ * @param state state of the rule
+ * @param raw reading, Q8.8
+ * @param ms reading time
+ *
+ * @return bool true while the rule is active
+ */
+bool RuleEngine::evalAbove(const Entry& entry, State& state, int16_t raw, uint32_t ms){
+    (void)ms;
+    return state.active ? raw >= entry.clear : raw >= entry.set;
+}
+
+bool RuleEngine::evalBelow(const Entry& entry, State& state, int16_t raw, uint32_t ms){
+    (void)ms;
+    return state.active ? raw <= entry.clear : raw <= entry.set;
+}
+
+/**
+ * @brief Rate of change
+ *
+ * The change is measured once per window, from the reading that
+ * started it, and kept until the next window ends.
+ *
+ * @param entry compiled rule, limits in Q8.8 C per minute
+ * @param state state of the rule
+ * @param raw reading, Q8.8
+ * @param ms reading time
+ *
+ * @return bool true while the rule is active
+ */
+bool RuleEngine::evalRate(const Entry& entry, State& state, int16_t raw, uint32_t ms){
+    if(!state.started){
+        state.started = true;
+        state.ref_raw = raw;
+        state.ref_ms = ms;
+        return false;
+    }
+    uint32_t dt = ms - state.ref_ms;
+    if(dt < entry.time_ms || dt == 0){
+        return state.active;
+    }
+    int32_t rate = (int32_t)(((int64_t)(raw - state.ref_raw) * 60000) / dt);
+    if(rate < 0){
+        rate = -rate;
+    }
+    state.ref_raw = raw;
+    state.ref_ms = ms;
+    return state.active ? rate >= entry.clear : rate >= entry.set;
+}
+
+/**
+ * @brief Time above a threshold
+ *
+ * @param entry compiled rule
+ * @param state state of the rule, ref_ms is when the reading went above
+ * @param raw reading, Q8.8
+ * @param ms reading time
+ *
+ * @return bool true while the rule is active
+ */
+bool RuleEngine::evalTimeAbove(const Entry& entry, State& state, int16_t raw, uint32_t ms){
+    if(raw < (state.started ? entry.clear : entry.set)){
+        state.started = false;
+        return false;
+    }
+    if(!state.started){
+        state.started = true;
+        state.ref_ms = ms;
+    }
+    return ms - state.ref_ms >= entry.time_ms;
+}
+
+//******************************************************//
+//************************CONSUMER**********************//
+//******************************************************//
+
+/**
+ * @brief Evaluate the rules of a sample
+ *
+ * Walks the slice of the sample's sensor only. Outputs are counted
+ * per rule, so a LED stays lit while any of its rules is active.
+ *
+ * @param sample reading from the sample ring
+ *
+ * @return uint8_t the rule_out bits now lit
+ */
+uint8_t RuleEngine::evaluate(const TempSample& sample){
+    PROBE_SCOPE(RuleEval);
+    uint32_t start = hal::Clock::nowUs32();
+    int8_t next = pending.load(std::memory_order_acquire);
+    if(next >= 0){
+        take((uint8_t)next);
+    }
+    uint8_t sensor = sample.addr - tcn75a::FIRST_ADDR;
+    if(sensor >= MAX_SENSORS){
+        return out.load(std::memory_order_relaxed);
+    }
+
+    const Table& table = tables[current.load(std::memory_order_relaxed)];
+    int16_t raw = (int16_t)sample.raw;
+    uint32_t ms = (uint32_t)(sample.timestamp_us / 1000);
+    uint16_t end = table.first[sensor + 1];
+    uint8_t bits = out.load(std::memory_order_relaxed);
+
+    seq.fetch_add(1, std::memory_order_acq_rel);
+    for(uint16_t i = table.first[sensor]; i < end; i++){
+        const Entry& entry = table.entries[i];
+        State& st = state[i];
+        bool now = evaluators[(uint8_t)entry.kind](entry, st, raw, ms);
+        if(now == st.active){
+            continue;
+        }
+        st.active = now;
+        stat.changes++;
+        for(uint8_t o = 0; o < rule_out::COUNT; o++){
+            if(entry.outputs & (1 << o)){
+                lit[o] += now ? 1 : -1;
+                bits = lit[o] ? bits | (1 << o) : bits & ~(1 << o);
+            }
+        }
+    }
+    seq.fetch_add(1, std::memory_order_release);
+    out.store(bits, std::memory_order_release);
+
+    stat.samples++;
+    stat.checks += end - table.first[sensor];
+    stat.cpu_us += hal::Clock::nowUs32() - start;
+    return bits;
+}
+
+/**
+ * @brief Switch to a new table
+ *
+ * @param table index of the compiled table to use
+ *
+ * @return void
+ */
+void RuleEngine::take(uint8_t table){
+    seq.fetch_add(1, std::memory_order_acq_rel);
+    for(State& st : state){
+        st = State();
+    }
+    for(uint16_t& n : lit){
+        n = 0;
+    }
+    current.store(table, std::memory_order_relaxed);
+    seq.fetch_add(1, std::memory_order_release);
+    out.store(0, std::memory_order_relaxed);
+    pending.store(-1, std::memory_order_release);
+}
+
+uint8_t RuleEngine::outputs() const{
+    return out.load(std::memory_order_acquire);
+}
+
+const RuleEngine::Stats& RuleEngine::stats() const{
+    return stat;
+}
+
+//******************************************************//
+//*************************EDITING**********************//
+//******************************************************//
+
+/**
+ * @brief Add a rule
+ *
+ * Takes effect at the next compile().
+ *
+ * @param spec the rule, addr ANY_SENSOR or 0x48 to 0x4F
+ *
+ * @return bool false if the list is full or the rule invalid
+ */
+bool RuleEngine::add(const RuleSpec& spec){
+    bool sensorOk = spec.addr == ANY_SENSOR || (uint8_t)(spec.addr - tcn75a::FIRST_ADDR) < MAX_SENSORS;
+    if(spec_count >= MAX_RULES || !sensorOk || (uint8_t)spec.kind > (uint8_t)RuleKind::TimeAbove || spec.hyst < 0){
+        return false;
+    }
+    specs[spec_count++] = spec;
+    return true;
+}
+
+/**
+ * @brief Remove a rule
+ *
+ * @param index position in the list, the rules after it move up
+ *
+ * @return bool false if there is no such rule
+ */
+bool RuleEngine::remove(uint16_t index){
+    if(index >= spec_count){
+        return false;
+    }
+    for(uint16_t i = index + 1; i < spec_count; i++){
+        specs[i - 1] = specs[i];
+    }
+    spec_count--;
+    return true;
+}
+
+void RuleEngine::clear(){
+    spec_count = 0;
+}
+
+/**
+ * @brief Compile the rules
+ *
+ * Counting sort of the rules by sensor into the spare table, the
+ * "any sensor" rules once per sensor, thresholds turned into the
+ * set / clear pair of each kind. The consumer takes the table at its
+ * next sample.
+ *
+ * @return bool false if the table is full or the previous one is still waiting
+ */
+bool RuleEngine::compile(){
+    if(pending.load(std::memory_order_acquire) >= 0){
+        return false;
+    }
+    uint8_t spare = current.load(std::memory_order_relaxed) ^ 1;
+    Table& table = tables[spare];
+
+    uint16_t perSensor[MAX_SENSORS] = {0};
+    uint16_t any = 0;
+    for(uint16_t i = 0; i < spec_count; i++){
+        if(specs[i].addr == ANY_SENSOR){
+            any++;
+        } else {
+            perSensor[specs[i].addr - tcn75a::FIRST_ADDR]++;
+        }
+    }
+    uint16_t total = 0;
+    for(uint8_t s = 0; s < MAX_SENSORS; s++){
+        table.first[s] = total;
+        total += perSensor[s] + any;
+    }
+    table.first[MAX_SENSORS] = total;
+    if(total > MAX_COMPILED){
+        return false;
+    }
+
+    uint16_t fill[MAX_SENSORS];
+    for(uint8_t s = 0; s < MAX_SENSORS; s++){
+        fill[s] = table.first[s];
+    }
+    for(uint16_t i = 0; i < spec_count; i++){
+        const RuleSpec& spec = specs[i];
+        Entry entry;
+        entry.kind = spec.kind;
+        entry.outputs = spec.outputs;
+        entry.rule = i;
+        entry.set = spec.limit;
+        entry.time_ms = spec.time_ms;
+        switch (spec.kind) {
+            case RuleKind::Below:
+                entry.clear = (int16_t)(spec.limit + spec.hyst);
+                break;
+            case RuleKind::Rate:
+                entry.clear = spec.limit > spec.hyst ? (int16_t)(spec.limit - spec.hyst) : 0;
+                break;
+            default:
+                entry.clear = (int16_t)(spec.limit - spec.hyst);
+                break;
+        }
+        if(spec.addr == ANY_SENSOR){
+            for(uint8_t s = 0; s < MAX_SENSORS; s++){
+                table.entries[fill[s]++] = entry;
+            }
+        } else {
+            table.entries[fill[spec.addr - tcn75a::FIRST_ADDR]++] = entry;
+        }
+    }
+    pending.store((int8_t)spare, std::memory_order_release);
+    hal::Cpu::signal();
+    return true;
+}
+
+uint16_t RuleEngine::count() const{
+    return spec_count;
+}
+
+const RuleSpec& RuleEngine::rule(uint16_t index) const{
+    return specs[index];
+}
+
+/**
+ * @brief Is a rule active
+ *
+ * Only meaningful once the consumer has taken the last compile.
+ *
+ * @param index position in the list
+ *
+ * @return bool true if any sensor has the rule active
+ */
+bool RuleEngine::active(uint16_t index) const{
+    uint32_t before, after;
+    bool found;
+    do{
+        before = seq.load(std::memory_order_acquire);
+        const Table& table = tables[current.load(std::memory_order_relaxed)];
+        found = false;
+        for(uint16_t i = 0; i < table.first[MAX_SENSORS] && !found; i++){
+            found = table.entries[i].rule == index && state[i].active;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = seq.load(std::memory_order_relaxed);
+    } while((before & 1) || before != after);
+    return found;
+}
@@ -0,0 +1,188 @@
+#include "../inc/BusScanner.hpp"
+#include "../inc/ConfigRegister.hpp"
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief BusScanner Constructor
+ *
+ * Constructor initializes an empty result table.
+ * The default probe timeout covers one 1-byte read at 100 kHz
+ * with margin, a missing device NACKs well before that.
+ *
+ * @param i2c the i2c instance to scan
+ * @param engine the transaction engine of that bus
+ *
+ */
+BusScanner::BusScanner(hal::BusHandle i2c, I2CEngine& engine): I2C_INST(i2c), engine(engine),
+probe_timeout_us(500), present(), scanned(), scan_generation(0), last_mode(ScanMode::Targeted),
+duration_us(){
+}
+
+bool BusScanner::testBit(const uint32_t *map, uint8_t addr){
+    return (map[(addr >> 5) & 3] >> (addr & 31)) & 1u;
+}
+
+void BusScanner::setBit(uint32_t *map, uint8_t addr){
+    map[(addr >> 5) & 3] |= 1u << (addr & 31);
+}
+
+/**
+ * @brief Reserved Addresses
+ *
+ * This function reserves addreses from being used.
+ *
+ * @param addr address to verify if reserved
+ *
+ * @return bool
+ */
+bool BusScanner::reserved_address(uint8_t addr){
+    return (addr & 0x78) == 0 || (addr & 0x78) == 0x78;
+}
+
+/**
+ * @brief Bus Scan
+ *
+ * Performs a 1-byte dummy read on every address of the mode.
+ * A slave acknowledging the address returns the byte, a missing
+ * one NACKs; the probe timeout bounds the time spent on a device
+ * stretching the clock. Nothing is printed here, see render.
+ *
+ * @param mode Targeted for the TCN75A window only, Full for every address
+ *
+ * @return uint8_t the number of devices found
+ */
+uint8_t BusScanner::scan(ScanMode mode){
+    uint8_t first = (mode == ScanMode::Targeted) ? tcn75a::FIRST_ADDR : 0x08;
+    uint8_t last = (mode == ScanMode::Targeted) ? tcn75a::LAST_ADDR : 0x77;
+    uint8_t count = 0;
+
+    for(int i = 0; i < 4; i++){
+        present[i] = 0;
+        scanned[i] = 0;
+    }
+
+    //the probes use the SDK calls, hold the transaction queue meanwhile
+    engine.acquire();
+    uint32_t start = hal::Clock::nowUs32();
+    for(uint8_t addr = first; addr <= last; addr++){
+        if(reserved_address(addr)){
+            continue;
+        }
+        uint8_t rxdata; //receiving buffer location
+        int ret = hal::Bus::readTimeout(I2C_INST, addr, &rxdata, 1, false, probe_timeout_us);
+        setBit(scanned, addr);
+        if(ret == 1){
+            setBit(present, addr);
+            count++;
+        }
+    }
+    duration_us[(int)mode] = hal::Clock::nowUs32() - start;
+    engine.release();
+
+    last_mode = mode;
+    scan_generation++;
+    return count;
+}
+
+/**
+ * @brief Print the address map
+ *
+ * This function prints all the availables addresses the sensor
+ * bus has and also the addresses being used are shown with an @.
+ * Addresses not probed by a targeted scan are shown with a -.
+ *
+ * @return void
+ */
+void BusScanner::render() const{
+    printf("\nI2C Bus Scan (%s, generation %lu, %lu us)\n",
+           last_mode == ScanMode::Full ? "full" : "targeted",
+           (unsigned long)scan_generation, (unsigned long)duration_us[(int)last_mode]);
+    printf("   0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F\n");
+
+    //iterate through all I2C addresses from 0x00 to 0x7F reaching 128
+    for(int addr = 0; addr < (1 << 7); addr++){
+        //if the address is a multiple of 16 then its the end of the row
+        if(addr % 16 == 0){
+            printf("%02x", addr);
+        }
+        if(!testBit(scanned, addr)){
+            printf(reserved_address(addr) ? "." : "-");
+        } else {
+            printf(testBit(present, addr) ? "@" : "."); // print . if address not found and @ if found
+        }
+        printf(addr % 16 == 15 ? "\n" : "  "); // newline if end or row or space if not
+    }
+}
+
+/**
+ * @brief Set the probe timeout
+ *
+ * @param timeout_us time allowed for each 1-byte probe
+ *
+ * @return void
+ */
+void BusScanner::setProbeTimeout(uint32_t timeout_us){
+    probe_timeout_us = timeout_us;
+}
+
+/**
+ * @brief Address found
+ *
+ * @param addr address to check
+ *
+ * @return bool true if the address answered the last scan
+ */
+bool BusScanner::found(uint8_t addr) const{
+    return testBit(present, addr);
+}
+
+/**
+ * @brief Address probed
+ *
+ * @param addr address to check
+ *
+ * @return bool true if the last scan probed the address
+ */
+bool BusScanner::probed(uint8_t addr) const{
+    return testBit(scanned, addr);
+}
+
+/**
+ * @brief First device in a range
+ *
+ * @param from first address of the range
+ * @param to last address of the range
+ *
+ * @return uint8_t the first answering address, 0 if none
+ */
+uint8_t BusScanner::firstFound(uint8_t from, uint8_t to) const{
+    for(int addr = from; addr <= to; addr++){
+        if(found(addr)){
+            return addr;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Scan generation
+ *
+ * Lets users of the cached table know when it changed.
+ *
+ * @return uint32_t number of scans done, 0 if never scanned
+ */
+uint32_t BusScanner::generation() const{
+    return scan_generation;
+}
+
+/**
+ * @brief Scan duration
+ *
+ * @param mode the scan mode
+ *
+ * @return uint32_t wall time of the last scan in that mode, in us
+ */
+uint32_t BusScanner::durationUs(ScanMode mode) const{
+    return duration_us[(int)mode];
+}
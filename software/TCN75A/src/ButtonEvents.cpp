@@ -0,0 +1,298 @@
+#include "../inc/ButtonEvents.hpp"
+#include <cstdint>
+
+/**
+ * @brief ButtonEvents Constructor
+ *
+ * Every button starts released, with no double press detection.
+ *
+ * @param firstPin gpio of the first button, the others follow one by one
+ *
+ */
+ButtonEvents::ButtonEvents(uint8_t firstPin): FIRST_PIN(firstPin), double_mask(0), bounces(0), edges(),
+gestures(), out(), out_head(0), out_count(0), counts(){
+    for(uint8_t i = 0; i < BUTTON_COUNT; i++){
+        last_edge_us[i].store(0u - DEBOUNCE_US, std::memory_order_relaxed); //the first edge is never bounce
+    }
+}
+
+/**
+ * @brief First button pin
+ *
+ * @return uint8_t the gpio of button 0
+ */
+uint8_t ButtonEvents::firstPin() const{
+    return FIRST_PIN;
+}
+
+/**
+ * @brief Button of a pin
+ *
+ * @param gpio the pin number of the gpio
+ *
+ * @return uint8_t the button number, BUTTON_COUNT if the pin is not a button
+ */
+uint8_t ButtonEvents::indexOf(unsigned int gpio) const{
+    if(gpio < FIRST_PIN || gpio >= (unsigned int)FIRST_PIN + BUTTON_COUNT){
+        return BUTTON_COUNT;
+    }
+    return (uint8_t)(gpio - FIRST_PIN);
+}
+
+/**
+ * @brief Detect double presses
+ *
+ * A press of this button is only reported DOUBLE_US after it is
+ * released, once it is known no second press followed.
+ *
+ * @param button the button number
+ *
+ * @return void
+ */
+void ButtonEvents::enableDouble(uint8_t button){
+    if(button < BUTTON_COUNT){
+        double_mask |= (uint8_t)(1u << button);
+    }
+}
+
+/**
+ * @brief Interrupt Handler/ISR side.
+ *
+ * Only debounces, timestamps and queues the edge: the action runs
+ * later in the main loop. Each button has its own debounce window,
+ * edges closer than DEBOUNCE_US to the last one kept are dropped.
+ *
+ * @param button the button number
+ * @param level the pin level read in the ISR
+ *
+ * @return void
+ */
+void ButtonEvents::onEdge(uint8_t button, bool level){
+    if(button >= BUTTON_COUNT){
+        return;
+    }
+    uint64_t now = hal::Clock::nowUs();
+    if((uint32_t)now - last_edge_us[button].load(std::memory_order_relaxed) < DEBOUNCE_US){
+        bounces.store(bounces.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    last_edge_us[button].store((uint32_t)now, std::memory_order_relaxed);
+
+    ButtonEdge edge;
+    edge.timestamp_us = now;
+    edge.button = button;
+    edge.pressed = !level;
+    edges.push(edge);
+}
+
+/**
+ * @brief Next gesture
+ *
+ * Called from the main loop. Turns the queued edges into gestures,
+ * then the timeouts: a long press is reported while the button is
+ * still held, a single press once the double press window is over.
+ * A button whose pin no longer matches its state after a bounce is
+ * brought back in line.
+ *
+ * @param event destination
+ * @param now_us current time
+ *
+ * @return bool true if a gesture was written to event
+ */
+bool ButtonEvents::next(ButtonEvent& event, uint64_t now_us){
+    ButtonEdge edge;
+    while(out_count == 0 && edges.pop(edge)){
+        uint64_t wait = now_us - edge.timestamp_us;
+        if(wait > counts.max_wait_us){
+            counts.max_wait_us = (uint32_t)wait;
+        }
+        counts.edges++;
+        apply(edge.button, edge.pressed, edge.timestamp_us);
+    }
+
+    //each button adds two gestures at most
+    for(uint8_t i = 0; i < BUTTON_COUNT && out_count + 2 <= OUT_SIZE; i++){
+        expire(i, now_us);
+    }
+
+    if(out_count == 0){
+        return false;
+    }
+    event = out[out_head];
+    out_head = (out_head + 1) % OUT_SIZE;
+    out_count--;
+    return true;
+}
+
+/**
+ * @brief Edges waiting
+ *
+ * Event source of the main loop, set by the ISR.
+ *
+ * @return bool true if edges are queued
+ */
+bool ButtonEvents::pending() const{
+    return !edges.empty();
+}
+
+/**
+ * @brief Next timeout
+ *
+ * Between the edges, next() only has work at these times: a long
+ * press coming due, the end of a double press window, the end of a
+ * debounce window where the pin level is checked.
+ *
+ * @return uint64_t the earliest of them, ~0 if no button is busy
+ */
+uint64_t ButtonEvents::nextDueUs() const{
+    uint64_t due = ~0ull;
+    for(const Gesture& g : gestures){
+        if(g.seen && !g.settled && g.edge_us + DEBOUNCE_US < due){
+            due = g.edge_us + DEBOUNCE_US;
+        }
+        if(g.down && !g.long_sent && g.down_us + LONG_US < due){
+            due = g.down_us + LONG_US;
+        }
+        if(g.pending && !g.down && g.release_us + DOUBLE_US < due){
+            due = g.release_us + DOUBLE_US;
+        }
+    }
+    return due;
+}
+
+/**
+ * @brief Apply an edge
+ *
+ * Edges that do not change the state (both edges reported at once,
+ * or a resync already applied) are ignored.
+ *
+ * @param button the button number
+ * @param pressed true if the button went down
+ * @param timestamp_us time of the edge
+ *
+ * @return void
+ */
+void ButtonEvents::apply(uint8_t button, bool pressed, uint64_t timestamp_us){
+    Gesture& g = gestures[button];
+    g.seen = true;
+    if(pressed == g.down){
+        return;
+    }
+    g.down = pressed;
+    g.edge_us = timestamp_us;
+    g.settled = false;
+
+    if(pressed){
+        g.down_us = timestamp_us;
+        g.long_sent = false;
+        g.second = g.pending && timestamp_us - g.release_us < DOUBLE_US;
+        if(g.pending && !g.second){
+            g.pending = false;
+            emit(button, ButtonGesture::Press, g.release_us);
+        }
+        return;
+    }
+
+    g.release_us = timestamp_us;
+    if(g.long_sent){
+        g.pending = false;
+        g.second = false;
+    } else if(g.second){
+        g.pending = false;
+        g.second = false;
+        emit(button, ButtonGesture::Double, timestamp_us);
+    } else if(double_mask & (1u << button)){
+        g.pending = true;
+    } else {
+        emit(button, ButtonGesture::Press, timestamp_us);
+    }
+}
+
+/**
+ * @brief Check the timeouts of a button
+ *
+ * @param button the button number
+ * @param now_us current time
+ *
+ * @return void
+ */
+void ButtonEvents::expire(uint8_t button, uint64_t now_us){
+    Gesture& g = gestures[button];
+
+    //a bounce hid the last edge: the pin settled without the ISR seeing it
+    if(g.seen && !g.settled && now_us - g.edge_us >= DEBOUNCE_US){
+        g.settled = true;
+        bool pressed = !hal::Gpio::get((uint8_t)(FIRST_PIN + button));
+        if(pressed != g.down){
+            counts.resyncs++;
+            apply(button, pressed, now_us);
+        }
+    }
+
+    if(g.down && !g.long_sent && now_us - g.down_us >= LONG_US){
+        if(g.second){
+            //the second press is held: the first was a press of its own
+            g.pending = false;
+            g.second = false;
+            emit(button, ButtonGesture::Press, g.release_us);
+        }
+        g.long_sent = true;
+        emit(button, ButtonGesture::Long, g.down_us + LONG_US);
+    }
+    if(g.pending && !g.down && now_us - g.release_us >= DOUBLE_US){
+        g.pending = false;
+        emit(button, ButtonGesture::Press, g.release_us);
+    }
+}
+
+/**
+ * @brief Report a gesture
+ *
+ * @param button the button number
+ * @param gesture what was done
+ * @param timestamp_us time the gesture completed
+ *
+ * @return void
+ */
+void ButtonEvents::emit(uint8_t button, ButtonGesture gesture, uint64_t timestamp_us){
+    if(out_count == OUT_SIZE){
+        return;
+    }
+    ButtonEvent& e = out[(out_head + out_count) % OUT_SIZE];
+    e.timestamp_us = timestamp_us;
+    e.button = button;
+    e.gesture = gesture;
+    out_count++;
+
+    switch (gesture) {
+        case ButtonGesture::Press:
+            counts.presses++;
+            break;
+        case ButtonGesture::Double:
+            counts.doubles++;
+            break;
+        case ButtonGesture::Long:
+            counts.longs++;
+            break;
+    }
+}
+
+/**
+ * @brief Button statistics
+ *
+ * @return Stats the counters since power-up
+ */
+ButtonEvents::Stats ButtonEvents::stats() const{
+    Stats s = counts;
+    s.bounces = bounces.load(std::memory_order_relaxed);
+    return s;
+}
+
+/**
+ * @brief Edges lost
+ *
+ * @return uint32_t edges dropped because the main loop did not drain the queue in time
+ */
+uint32_t ButtonEvents::edgesLost() const{
+    return edges.dropped();
+}
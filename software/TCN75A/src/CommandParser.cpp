@@ -0,0 +1,148 @@
+#include "../inc/CommandParser.hpp"
+#include <cstdint>
+
+/**
+ * @brief CommandParser Constructor
+ *
+ * Constructor starts with an empty line.
+ *
+ */
+CommandParser::CommandParser(): buf(), len(0), overflow(false), ready(false), last(0), cmd(), stat(){
+}
+
+/**
+ * @brief Feed one character
+ *
+ * Adds the character to the current line. CR, LF or CR LF end the
+ * line; backspace and DEL remove the last character, other control
+ * characters are ignored. Nothing is blocking, the caller feeds what
+ * the terminal has sent and goes on with its loop.
+ *
+ * @param c character read from the console
+ *
+ * @return bool true when the line is complete, read it with command()
+ */
+bool CommandParser::feed(char c){
+    char prev = last;
+    last = c;
+    if(ready){
+        //the previous line was handed out, start a new one
+        ready = false;
+        len = 0;
+    }
+
+    if(c == '\r' || c == '\n'){
+        if(c == '\n' && prev == '\r'){
+            return false; //second half of CR LF
+        }
+        if(overflow){
+            overflow = false;
+            len = 0;
+            stat.overflows++;
+            return false;
+        }
+        if(len == 0){
+            return false; //empty line, like cin skipping whitespace
+        }
+        buf[len] = '\0';
+        split();
+        if(cmd.argc == 0){
+            len = 0;
+            return false; //only spaces
+        }
+        ready = true;
+        stat.lines++;
+        return true;
+    }
+
+    if(c == '\b' || c == 0x7F){
+        if(len && !overflow){
+            len--;
+        }
+        return false;
+    }
+    if((uint8_t)c < ' '){
+        stat.ignored++;
+        return false;
+    }
+    if(len == LINE_MAX){
+        overflow = true; //drop the whole line at its end
+        return false;
+    }
+    buf[len++] = c;
+    return false;
+}
+
+/**
+ * @brief Cut the line into words
+ *
+ * Spaces and tabs are replaced by terminators in place, so the
+ * words need no copy. Words past ARG_MAX are ignored.
+ *
+ * @return void
+ */
+void CommandParser::split(){
+    cmd.argc = 0;
+    bool inWord = false;
+    for(uint8_t i = 0; i < len; i++){
+        if(buf[i] == ' ' || buf[i] == '\t'){
+            buf[i] = '\0';
+            inWord = false;
+        } else if(!inWord){
+            inWord = true;
+            if(cmd.argc < ARG_MAX){
+                cmd.argv[cmd.argc++] = &buf[i];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Last complete line
+ *
+ * @return const Command& the words of the line, argc is 0 before the first line
+ */
+const CommandParser::Command& CommandParser::command() const{
+    return cmd;
+}
+
+/**
+ * @brief Drop the partial line
+ *
+ * @return void
+ */
+void CommandParser::reset(){
+    len = 0;
+    overflow = false;
+    ready = false;
+}
+
+/**
+ * @brief Compare two words ignoring case
+ *
+ * @param a first word
+ * @param b second word
+ *
+ * @return bool true if the words are the same
+ */
+bool CommandParser::equals(const char* a, const char* b){
+    while(*a && *b){
+        char ca = (*a >= 'A' && *a <= 'Z') ? *a + 32 : *a;
+        char cb = (*b >= 'A' && *b <= 'Z') ? *b + 32 : *b;
+        if(ca != cb){
+            return false;
+        }
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+/**
+ * @brief Parser statistics
+ *
+ * @return const Stats& lines, overflows and ignored characters
+ */
+const CommandParser::Stats& CommandParser::stats() const{
+    return stat;
+}
@@ -0,0 +1,428 @@
+#include "../inc/EventLoop.hpp"
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief EventLoop Constructor
+ *
+ * Constructor initializes an empty loop.
+ *
+ */
+EventLoop::EventLoop(): tasks(), count(0), heap(), heap_size(0), idle_us(0), wakeup_count(0),
+stats_start_us(hal::Clock::nowUs()){
+}
+
+/**
+ * @brief Add a periodic timer
+ *
+ * The next run is counted from the due time, not from the end of
+ * the last run, so the period does not drift.
+ *
+ * @param name printed in the statistics
+ * @param fn work of the task
+ * @param context passed to fn
+ * @param period_us time between two runs
+ * @param deadline_us start delay counted as a miss, 0 for one period
+ *
+ * @return uint8_t the task number, NO_TASK if the table is full
+ */
+uint8_t EventLoop::addTimer(const char* name, TaskFn fn, void* context, uint32_t period_us, uint32_t deadline_us){
+    uint8_t task = add(name, nullptr, fn, context, period_us, deadline_us ? deadline_us : period_us);
+    if(task != NO_TASK){
+        schedule(task, hal::Clock::nowUs() + period_us);
+    }
+    return task;
+}
+
+/**
+ * @brief Add an event task
+ *
+ * ready() is checked on every pass, it must be cheap: an atomic flag
+ * or the fill level of a queue.
+ *
+ * @param name printed in the statistics
+ * @param ready event source, true when work is waiting
+ * @param fn work of the task
+ * @param context passed to ready and fn
+ * @param deadline_us start delay of a timed run counted as a miss, 0 for none
+ *
+ * @return uint8_t the task number, NO_TASK if the table is full
+ */
+uint8_t EventLoop::addEvent(const char* name, ReadyFn ready, TaskFn fn, void* context, uint32_t deadline_us){
+    return add(name, ready, fn, context, 0, deadline_us ? deadline_us : UINT32_MAX);
+}
+
+/**
+ * @brief Add a task to the table
+ *
+ * @param name printed in the statistics
+ * @param ready event source, nullptr for a timer
+ * @param fn work of the task
+ * @param context passed to ready and fn
+ * @param period_us time between two runs, 0 for an event task
+ * @param deadline_us start delay counted as a miss
+ *
+ * @return uint8_t the task number, NO_TASK if the table is full
+ */
+uint8_t EventLoop::add(const char* name, ReadyFn ready, TaskFn fn, void* context, uint32_t period_us, uint32_t deadline_us){
+    if(count == MAX_TASKS){
+        return NO_TASK;
+    }
+    Task& t = tasks[count];
+    t.fn = fn;
+    t.ready = ready;
+    t.context = context;
+    t.period_us = period_us;
+    t.deadline_us = deadline_us;
+    t.due_us = NEVER;
+    t.slot = NO_TASK;
+    t.stats = TaskStats();
+    t.stats.name = name;
+    return count++;
+}
+
+/**
+ * @brief Set when a task runs
+ *
+ * @param task the task number
+ * @param due_us hal::Clock::nowUs to run at, NEVER to take it off the timers
+ *
+ * @return void
+ */
+void EventLoop::setDue(uint8_t task, uint64_t due_us){
+    if(task < count){
+        schedule(task, due_us);
+    }
+}
+
+/**
+ * @brief One pass of the loop
+ *
+ * First the event tasks whose source has work, in the order they
+ * were added, then the timers that are due, earliest first. A timer
+ * runs once per pass at most, so a task asking to run again right
+ * away cannot starve the others.
+ *
+ * @param now_us current time
+ *
+ * @return bool true if a task ran
+ */
+bool EventLoop::runOnce(uint64_t now_us){
+    bool ran = false;
+    for(uint8_t i = 0; i < count; i++){
+        if(tasks[i].ready && tasks[i].ready(tasks[i].context)){
+            execute(i, hal::Clock::nowUs(), false);
+            ran = true;
+        }
+    }
+    for(uint8_t n = 0; n < count && heap_size && tasks[heap[0]].due_us <= now_us; n++){
+        execute(heap[0], hal::Clock::nowUs(), true);
+        ran = true;
+    }
+    return ran;
+}
+
+/**
+ * @brief Run until a time
+ *
+ * The idle task: when a pass ran nothing, the core sleeps until the
+ * next timer. Any interrupt wakes it early, so the event sources it
+ * fills are seen on the next pass.
+ *
+ * @param until_us hal::Clock::nowUs to return at
+ *
+ * @return void
+ */
+void EventLoop::runUntil(uint64_t until_us){
+    uint64_t now;
+    while((now = hal::Clock::nowUs()) < until_us){
+        if(!runOnce(now)){
+            uint64_t due = nextDueUs() < until_us ? nextDueUs() : until_us;
+            hal::Cpu::sleepUntil(due);
+            idle_us += hal::Clock::nowUs() - now;
+            wakeup_count++;
+        }
+    }
+}
+
+/**
+ * @brief Run for ever
+ *
+ * @return void
+ */
+void EventLoop::run(){
+    runUntil(NEVER);
+}
+
+/**
+ * @brief Run a task
+ *
+ * A timer's lateness is measured against its due time. After the run
+ * it is rescheduled at the time it asked for, or one period after the
+ * due time, skipping the periods an overrun made it miss.
+ *
+ * @param task the task number
+ * @param now_us start time
+ * @param timed true if it runs because its time came, false for its event source
+ *
+ * @return void
+ */
+void EventLoop::execute(uint8_t task, uint64_t now_us, bool timed){
+    Task& t = tasks[task];
+    uint64_t due = t.due_us;
+    if(timed){
+        uint64_t late = now_us - due;
+        t.stats.late_us += late;
+        if(late > t.stats.max_late_us){
+            t.stats.max_late_us = (uint32_t)late;
+        }
+        if(late > t.deadline_us){
+            t.stats.misses++;
+        }
+        unlink(task);
+    }
+
+    uint64_t next = t.fn(t.context, now_us);
+    uint64_t end = hal::Clock::nowUs();
+    uint32_t took = (uint32_t)(end - now_us);
+    t.stats.runs++;
+    t.stats.busy_us += took;
+    if(took > t.stats.max_us){
+        t.stats.max_us = took;
+    }
+
+    if(next){
+        schedule(task, next);
+    } else if(t.period_us){
+        next = (timed ? due : now_us) + t.period_us;
+        if(next <= end){
+            uint32_t lost = (uint32_t)((end - next) / t.period_us) + 1;
+            t.stats.skipped += lost;
+            next += (uint64_t)lost * t.period_us;
+        }
+        schedule(task, next);
+    } else if(timed){
+        schedule(task, NEVER); //event task, back to its source
+    }
+}
+
+/**
+ * @brief Earliest timer
+ *
+ * @return uint64_t the due time of the next timer, NEVER if none
+ */
+uint64_t EventLoop::nextDueUs() const{
+    return heap_size ? tasks[heap[0]].due_us : NEVER;
+}
+
+/**
+ * @brief Number of tasks
+ *
+ * @return uint8_t the tasks added
+ */
+uint8_t EventLoop::taskCount() const{
+    return count;
+}
+
+/**
+ * @brief Task statistics
+ *
+ * @param task the task number, below taskCount()
+ *
+ * @return const TaskStats& the counters since the last reset
+ */
+const EventLoop::TaskStats& EventLoop::stats(uint8_t task) const{
+    return tasks[task].stats;
+}
+
+/**
+ * @brief Idle time
+ *
+ * @return uint64_t time the core slept since the last reset
+ */
+uint64_t EventLoop::idleUs() const{
+    return idle_us;
+}
+
+/**
+ * @brief Wakeups
+ *
+ * @return uint32_t the times the core went to sleep since the last reset
+ */
+uint32_t EventLoop::wakeups() const{
+    return wakeup_count;
+}
+
+/**
+ * @brief Reset the statistics
+ *
+ * @return void
+ */
+void EventLoop::resetStats(){
+    for(uint8_t i = 0; i < count; i++){
+        const char* name = tasks[i].stats.name;
+        tasks[i].stats = TaskStats();
+        tasks[i].stats.name = name;
+    }
+    idle_us = 0;
+    wakeup_count = 0;
+    stats_start_us = hal::Clock::nowUs();
+}
+
+/**
+ * @brief Print the task statistics
+ *
+ * Run time and start delay of every task, then the share of time
+ * the core slept.
+ *
+ * @return void
+ */
+void EventLoop::printStats(){
+    uint64_t elapsed = hal::Clock::nowUs() - stats_start_us;
+    printf(" Task      |   Runs   | Avg us | Max us | Avg late | Max late | Misses | Skipped\n");
+    for(uint8_t i = 0; i < count; i++){
+        const TaskStats& s = tasks[i].stats;
+        bool timer = tasks[i].deadline_us != UINT32_MAX;
+        printf(" %-9s | %8lu | %6lu | %6lu | ", s.name, (unsigned long)s.runs,
+               (unsigned long)(s.runs ? s.busy_us / s.runs : 0), (unsigned long)s.max_us);
+        if(timer){
+            printf("%8lu | %8lu | ", (unsigned long)(s.runs ? s.late_us / s.runs : 0), (unsigned long)s.max_late_us);
+        } else {
+            printf("%8s | %8s | ", "-", "-");
+        }
+        printf("%6lu | %7lu\n", (unsigned long)s.misses, (unsigned long)s.skipped);
+    }
+    printf(" Idle: %lu.%lu %% of %lu ms, %lu wakeups\n", (unsigned long)(elapsed ? idle_us * 100 / elapsed : 0),
+           (unsigned long)(elapsed ? idle_us * 1000 / elapsed % 10 : 0), (unsigned long)(elapsed / 1000),
+           (unsigned long)wakeup_count);
+}
+
+//******************************************************//
+//*************************HEAP*************************//
+//******************************************************//
+
+/**
+ * @brief Put a task on the timers
+ *
+ * @param task the task number
+ * @param due_us time to run it, NEVER takes it off
+ *
+ * @return void
+ */
+void EventLoop::schedule(uint8_t task, uint64_t due_us){
+    Task& t = tasks[task];
+    if(due_us == NEVER){
+        unlink(task);
+        return;
+    }
+    if(t.slot == NO_TASK){
+        t.slot = heap_size;
+        heap[heap_size++] = task;
+        t.due_us = due_us;
+        siftUp(t.slot);
+        return;
+    }
+    bool earlier = due_us < t.due_us;
+    t.due_us = due_us;
+    if(earlier){
+        siftUp(t.slot);
+    } else {
+        siftDown(t.slot);
+    }
+}
+
+/**
+ * @brief Take a task off the timers
+ *
+ * @param task the task number
+ *
+ * @return void
+ */
+void EventLoop::unlink(uint8_t task){
+    Task& t = tasks[task];
+    uint8_t slot = t.slot;
+    if(slot == NO_TASK){
+        return;
+    }
+    heap_size--;
+    if(slot != heap_size){
+        swap(slot, heap_size);
+        siftDown(slot);
+        siftUp(slot);
+    }
+    t.slot = NO_TASK;
+    t.due_us = NEVER;
+}
+
+/**
+ * @brief Move a heap entry towards the root while it is due earlier than its parent
+ *
+ * @param slot position in the heap
+ *
+ * @return void
+ */
+void EventLoop::siftUp(uint8_t slot){
+    while(slot > 0){
+        uint8_t parent = (slot - 1) / 2;
+        if(!before(heap[slot], heap[parent])){
+            break;
+        }
+        swap(slot, parent);
+        slot = parent;
+    }
+}
+
+/**
+ * @brief Move a heap entry towards the leaves while a child is due earlier
+ *
+ * @param slot position in the heap
+ *
+ * @return void
+ */
+void EventLoop::siftDown(uint8_t slot){
+    while(true){
+        uint8_t first = slot;
+        uint8_t left = 2 * slot + 1, right = 2 * slot + 2;
+        if(left < heap_size && before(heap[left], heap[first])){
+            first = left;
+        }
+        if(right < heap_size && before(heap[right], heap[first])){
+            first = right;
+        }
+        if(first == slot){
+            break;
+        }
+        swap(slot, first);
+        slot = first;
+    }
+}
+
+/**
+ * @brief Swap two heap entries and their slots
+ *
+ * @param a position in the heap
+ * @param b position in the heap
+ *
+ * @return void
+ */
+void EventLoop::swap(uint8_t a, uint8_t b){
+    uint8_t task = heap[a];
+    heap[a] = heap[b];
+    heap[b] = task;
+    tasks[heap[a]].slot = a;
+    tasks[heap[b]].slot = b;
+}
+
+/**
+ * @brief Heap order
+ *
+ * Earlier due time first, the task added first on a tie.
+ *
+ * @param a task number
+ * @param b task number
+ *
+ * @return bool true if a runs before b
+ */
+bool EventLoop::before(uint8_t a, uint8_t b) const{
+    return tasks[a].due_us < tasks[b].due_us || (tasks[a].due_us == tasks[b].due_us && a < b);
+}
@@ -0,0 +1,690 @@
+#include "../inc/Hal.hpp"
+#include "../inc/SimTCN75A.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+
+namespace hal {
+
+//******************************************************//
+//**********************SIMULATED BUS*******************//
+//******************************************************//
+
+/**
+ * @brief SimBus Constructor
+ *
+ * Constructor initializes an empty bus.
+ *
+ * @param index controller number the engine registers under (0 or 1)
+ * @param baud bus clock, used for the bus time accounting
+ *
+ */
+SimBus* SimBus::waiting[2] = {nullptr, nullptr};
+
+SimBus::SimBus(uint8_t index, uint32_t baud): irq_handler(nullptr), irq_pending(0), rx(), rx_len(0),
+bus_index(index), baud_rate(baud), open(false), devices(), stat(), deferred(false), deferred_flags(0), complete_us(0){
+}
+
+SimBus::~SimBus(){
+    cancel();
+}
+
+uint8_t SimBus::index() const{
+    return bus_index;
+}
+
+void SimBus::setBaud(uint32_t baud){
+    baud_rate = baud ? baud : 100000;
+}
+
+void SimBus::attach(SimTCN75A* device){
+    devices[device->address() & 0x7F] = device;
+}
+
+void SimBus::detach(uint8_t addr){
+    devices[addr & 0x7F] = nullptr;
+}
+
+/**
+ * @brief Bus time of one transfer
+ *
+ * Every byte (address included) takes 9 SCL clocks, the START
+ * or repeated START and the STOP about one more each. A transfer
+ * that follows one ended without STOP is part of the same transaction.
+ *
+ * @param bytes data bytes of the transfer
+ * @param nostop true if the transfer ends with a repeated START
+ *
+ * @return void
+ */
+void SimBus::account(size_t bytes, bool nostop){
+    uint32_t clocks = (uint32_t)(bytes + 1) * 9 + (nostop ? 1 : 2);
+    uint64_t ns = (uint64_t)clocks * 1000000000ull / baud_rate;
+    if(!open){
+        stat.transactions++;
+    }
+    stat.bytes += bytes + 1;
+    stat.bus_ns += ns;
+    open = nostop;
+    HostClock::advanceNs(ns);
+}
+
+/**
+ * @brief Blocking write
+ *
+ * @param addr 7-bit target address
+ * @param src bytes to send, the first one is the register pointer
+ * @param len number of bytes
+ * @param nostop true to keep the bus for a repeated START
+ *
+ * @return int bytes written or PICO_ERROR_GENERIC on NACK
+ */
+int SimBus::write(uint8_t addr, const uint8_t *src, size_t len, bool nostop){
+    if(stuck()){
+        stat.hung++;
+        return PICO_ERROR_GENERIC;
+    }
+    SimTCN75A* dev = devices[addr & 0x7F];
+    if(!dev || !dev->write(src, len)){
+        account(0, false);
+        stat.nacks++;
+        return PICO_ERROR_GENERIC;
+    }
+    account(len, nostop);
+    return (int)len;
+}
+
+/**
+ * @brief Blocking read
+ *
+ * @param addr 7-bit target address
+ * @param dst receiving buffer
+ * @param len number of bytes
+ * @param nostop true to keep the bus for a repeated START
+ *
+ * @return int bytes read or PICO_ERROR_GENERIC on NACK
+ */
+int SimBus::read(uint8_t addr, uint8_t *dst, size_t len, bool nostop){
+    if(stuck()){
+        stat.hung++;
+        return PICO_ERROR_GENERIC;
+    }
+    SimTCN75A* dev = devices[addr & 0x7F];
+    if(!dev || !dev->read(dst, len)){
+        account(0, false);
+        stat.nacks++;
+        return PICO_ERROR_GENERIC;
+    }
+    account(len, nostop);
+    return (int)len;
+}
+
+/**
+ * @brief Finish a transfer later
+ *
+ * @param flags HostBus::IRQ_* flags raised when it finishes
+ * @param delay_us time from now, NEVER if it cannot finish
+ *
+ * @return void
+ */
+void SimBus::defer(uint32_t flags, uint64_t delay_us){
+    deferred = true;
+    deferred_flags = flags;
+    complete_us = delay_us == NEVER ? NEVER : HostClock::nowUs() + delay_us;
+    if(delay_us == NEVER){
+        stat.hung++;
+    }
+    waiting[bus_index & 1] = this;
+}
+
+void SimBus::cancel(){
+    if(waiting[bus_index & 1] == this){
+        waiting[bus_index & 1] = nullptr;
+    }
+    deferred = false;
+    irq_pending = 0;
+    rx_len = 0;
+}
+
+/**
+ * @brief Raise a deferred interrupt
+ *
+ * @return void
+ */
+void SimBus::poll(){
+    if(!deferred || complete_us == NEVER || HostClock::nowUs() < complete_us){
+        return;
+    }
+    deferred = false;
+    waiting[bus_index & 1] = nullptr;
+    irq_pending = deferred_flags;
+    if(irq_handler){
+        irq_handler();
+    }
+}
+
+void SimBus::pollAll(){
+    for(SimBus* bus : waiting){
+        if(bus){
+            bus->poll();
+        }
+    }
+}
+
+uint64_t SimBus::nextEventUs(){
+    uint64_t next = NEVER;
+    for(SimBus* bus : waiting){
+        if(bus && bus->deferred && bus->complete_us < next){
+            next = bus->complete_us;
+        }
+    }
+    return next;
+}
+
+bool SimBus::stuck() const{
+    for(SimTCN75A* dev : devices){
+        if(dev && dev->sdaHeld()){
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t SimBus::stretchUs(uint8_t addr) const{
+    SimTCN75A* dev = devices[addr & 0x7F];
+    return dev ? dev->stretchUs() : 0;
+}
+
+/**
+ * @brief Bus recovery
+ *
+ * Every SCL pulse shifts one bit out of the targets holding SDA,
+ * at most nine pulses (a byte and its acknowledge), then a STOP.
+ *
+ * @return bool true if SDA is free afterwards
+ */
+bool SimBus::recover(){
+    stat.recoveries++;
+    for(int i = 0; i < 9 && stuck(); i++){
+        for(SimTCN75A* dev : devices){
+            if(dev){
+                dev->clockScl();
+            }
+        }
+        HostClock::advanceNs(1000000000ull / baud_rate);
+    }
+    HostClock::advanceNs(2000000000ull / baud_rate); //STOP
+    open = false;
+    return !stuck();
+}
+
+const SimBus::Stats& SimBus::stats() const{
+    return stat;
+}
+
+void SimBus::resetStats(){
+    stat = Stats();
+}
+
+//******************************************************//
+//***********************BUS POLICY*********************//
+//******************************************************//
+
+void HostBus::init(Handle bus, uint32_t baud){
+    bus->setBaud(baud);
+}
+
+int HostBus::write(Handle bus, uint8_t addr, const uint8_t *src, size_t len, bool nostop){
+    return bus->write(addr, src, len, nostop);
+}
+
+int HostBus::read(Handle bus, uint8_t addr, uint8_t *dst, size_t len, bool nostop){
+    return bus->read(addr, dst, len, nostop);
+}
+
+int HostBus::readTimeout(Handle bus, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint32_t timeout_us){
+    if(bus->stuck() || bus->stretchUs(addr) > timeout_us){
+        HostClock::advanceNs((uint64_t)timeout_us * 1000);
+        return PICO_ERROR_TIMEOUT;
+    }
+    HostClock::advanceNs((uint64_t)bus->stretchUs(addr) * 1000);
+    return bus->read(addr, dst, len, nostop);
+}
+
+uint8_t HostBus::index(Handle bus){
+    return bus->index();
+}
+
+void HostBus::attachIrq(Handle bus, void (*handler)()){
+    bus->irq_handler = handler;
+}
+
+/**
+ * @brief Start an engine transfer
+ *
+ * Runs the pointer write and the data phase as one transaction,
+ * then raises STOP (and ABORT on NACK) and calls the handler.
+ * A stretching target delays the interrupt, a held SDA hangs it.
+ *
+ * @return void
+ */
+void HostBus::start(Handle bus, uint8_t addr, bool sendPointer, uint8_t reg,
+                    const uint8_t *data, uint8_t nbytes, bool write){
+    uint8_t frame[16];
+    int ret;
+    if(bus->stuck()){
+        bus->defer(IRQ_STOP | IRQ_ABORT, SimBus::NEVER);
+        return;
+    }
+    if(write){
+        frame[0] = reg;
+        memcpy(&frame[1], data, nbytes);
+        ret = bus->write(addr, frame, nbytes + 1, false);
+    } else {
+        ret = 0;
+        if(sendPointer){
+            ret = bus->write(addr, &reg, 1, true);
+        }
+        if(ret >= 0){
+            ret = bus->read(addr, bus->rx, nbytes, false);
+        }
+        bus->rx_len = ret > 0 ? nbytes : 0;
+    }
+    uint32_t flags = IRQ_STOP | (ret < 0 ? IRQ_ABORT : 0);
+    uint32_t stretch = ret < 0 ? 0 : bus->stretchUs(addr);
+    if(stretch){
+        bus->defer(flags, stretch);
+        return;
+    }
+    bus->irq_pending = flags;
+    if(bus->irq_handler){
+        bus->irq_handler();
+    }
+}
+
+uint32_t HostBus::irqStatus(Handle bus){
+    uint32_t flags = bus->irq_pending;
+    bus->irq_pending = 0;
+    return flags;
+}
+
+void HostBus::abort(Handle bus){
+    bus->cancel();
+}
+
+bool HostBus::recover(Handle bus, uint8_t sda, uint8_t scl, uint32_t baud){
+    (void)sda;
+    (void)scl;
+    bus->setBaud(baud);
+    return bus->recover();
+}
+
+void HostBus::readData(Handle bus, uint8_t *buf, uint8_t nbytes){
+    for(uint8_t i = 0; i < nbytes && i < bus->rx_len; i++){
+        buf[i] = bus->rx[i];
+    }
+    bus->rx_len = 0;
+}
+
+//******************************************************//
+//*************************GPIO*************************//
+//******************************************************//
+
+static bool pinLevel[HostGpio::PIN_COUNT];
+static uint32_t pinIrq[HostGpio::PIN_COUNT];
+static HostGpio::Callback gpioCallback = nullptr;
+
+void HostGpio::input(uint8_t pin, bool pullUp){
+    if(pin < PIN_COUNT && pullUp){
+        pinLevel[pin] = true;
+    }
+}
+
+void HostGpio::output(uint8_t pin){
+    if(pin < PIN_COUNT){
+        pinLevel[pin] = false;
+    }
+}
+
+void HostGpio::put(uint8_t pin, bool level){
+    if(pin < PIN_COUNT){
+        pinLevel[pin] = level;
+    }
+}
+
+bool HostGpio::get(uint8_t pin){
+    return pin < PIN_COUNT && pinLevel[pin];
+}
+
+void HostGpio::enableIrq(uint8_t pin, uint32_t events){
+    if(pin < PIN_COUNT){
+        pinIrq[pin] |= events;
+    }
+}
+
+void HostGpio::enableIrq(uint8_t pin, uint32_t events, Callback cb){
+    enableIrq(pin, events);
+    gpioCallback = cb;
+}
+
+/**
+ * @brief Drive an input from outside
+ *
+ * Sets the pin level and calls the gpio callback if the edge
+ * interrupt is enabled, like the RP2040 IO bank interrupt.
+ *
+ * @param pin gpio number
+ * @param level new level
+ *
+ * @return void
+ */
+void HostGpio::drive(uint8_t pin, bool level){
+    if(pin >= PIN_COUNT || pinLevel[pin] == level){
+        return;
+    }
+    pinLevel[pin] = level;
+    uint32_t event = level ? EDGE_RISE : EDGE_FALL;
+    if((pinIrq[pin] & event) && gpioCallback){
+        gpioCallback(pin, event);
+    }
+}
+
+//******************************************************//
+//**************************PWM*************************//
+//******************************************************//
+
+static uint8_t pwmLevel[HostGpio::PIN_COUNT];
+
+void HostPwm::init(uint8_t pin){
+    set(pin, 0);
+}
+
+void HostPwm::set(uint8_t pin, uint8_t level){
+    if(pin < HostGpio::PIN_COUNT){
+        pwmLevel[pin] = level;
+        pinLevel[pin] = level != 0;
+    }
+}
+
+uint8_t HostPwm::level(uint8_t pin){
+    return pin < HostGpio::PIN_COUNT ? pwmLevel[pin] : 0;
+}
+
+//******************************************************//
+//*************************CLOCK************************//
+//******************************************************//
+
+static uint64_t virtualNs = 0;
+
+uint64_t HostClock::nowUs(){
+    virtualNs += READ_COST_NS;
+    return virtualNs / 1000;
+}
+
+uint32_t HostClock::nowUs32(){
+    return (uint32_t)nowUs();
+}
+
+uint32_t HostClock::nowMs(){
+    return (uint32_t)(nowUs() / 1000);
+}
+
+void HostClock::sleepMs(uint32_t ms){
+    virtualNs += (uint64_t)ms * 1000000ull;
+}
+
+void HostClock::sleepUs(uint32_t us){
+    virtualNs += (uint64_t)us * 1000ull;
+}
+
+void HostClock::advanceNs(uint64_t ns){
+    virtualNs += ns;
+}
+
+HostCycles::Stamp HostCycles::now(){
+    return (Stamp)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t HostCycles::since(const Stamp& start){
+    uint64_t ns = now() - start;
+    return ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+}
+
+
+//******************************************************//
+//************************CONSOLE***********************//
+//******************************************************//
+
+static char inputQueue[4096];
+static size_t inputHead = 0, inputTail = 0;
+static bool stdinEnabled = false;
+
+/**
+ * @brief Read one console character
+ *
+ * Takes the queued input first, then stdin when it is enabled.
+ * Never waits, like getchar_timeout_us(0) on the Pico.
+ *
+ * @return int the character, -1 if none is waiting
+ */
+int HostCpu::readChar(){
+    if(inputHead != inputTail){
+        return (uint8_t)inputQueue[inputHead++ % sizeof(inputQueue)];
+    }
+    if(stdinEnabled){
+        struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        char c;
+        if(poll(&pfd, 1, 0) > 0 && read(STDIN_FILENO, &c, 1) == 1){
+            return (uint8_t)c;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Queue console input
+ *
+ * @param data characters, as a terminal would send them
+ * @param len number of characters, the excess is dropped when the queue is full
+ *
+ * @return void
+ */
+void HostCpu::feedInput(const char *data, size_t len){
+    for(size_t i = 0; i < len && inputTail - inputHead < sizeof(inputQueue); i++){
+        inputQueue[inputTail++ % sizeof(inputQueue)] = data[i];
+    }
+}
+
+void HostCpu::useStdin(bool enable){
+    stdinEnabled = enable;
+}
+
+/**
+ * @brief Console input waiting
+ *
+ * Like the stdio callback of the Pico, without taking anything.
+ *
+ * @return bool true if readChar would return a character
+ */
+bool HostCpu::inputReady(){
+    if(inputHead != inputTail){
+        return true;
+    }
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+    return stdinEnabled && poll(&pfd, 1, 0) > 0;
+}
+
+/**
+ * @brief Sleep the CPU
+ *
+ * The virtual clock jumps to the time, or to the next bus interrupt
+ * if it comes first, and the interrupt is delivered, as the Pico
+ * wakes from WFE.
+ *
+ * @param due_us hal::Clock::nowUs to wake at
+ *
+ * @return void
+ */
+void HostCpu::sleepUntil(uint64_t due_us){
+    uint64_t wake = SimBus::nextEventUs() < due_us ? SimBus::nextEventUs() : due_us;
+    uint64_t now = HostClock::nowUs();
+    if(wake > now){
+        HostClock::advanceNs((wake - now) * 1000);
+    }
+    SimBus::pollAll();
+}
+
+
+//******************************************************//
+//*************************FLASH************************//
+//******************************************************//
+
+static uint8_t flashImage[HostFlash::SIZE];
+static bool flashReady = false;
+static FILE *flashFile = nullptr;
+static bool powerCut = false;
+static uint32_t powerBudget = 0; //bytes programmed before the cut
+static bool powerArmed = false;
+static HostFlash::Stats flashStat;
+
+//Blank flash on first use
+static void flashInit(){
+    if(!flashReady){
+        memset(flashImage, 0xFF, sizeof(flashImage));
+        flashReady = true;
+    }
+}
+
+//Write a range of the image through to the backing file
+static void flashSync(uint32_t offset, size_t len){
+    if(flashFile){
+        fseek(flashFile, offset, SEEK_SET);
+        fwrite(&flashImage[offset], 1, len, flashFile);
+        fflush(flashFile);
+    }
+}
+
+uint32_t HostFlash::size(){
+    return SIZE;
+}
+
+void HostFlash::read(uint32_t offset, uint8_t *dst, size_t len){
+    flashInit();
+    memcpy(dst, &flashImage[offset], len);
+}
+
+/**
+ * @brief Erase sectors
+ *
+ * @param offset start, sector aligned
+ * @param len bytes, a multiple of SECTOR_SIZE
+ *
+ * @return void
+ */
+void HostFlash::erase(uint32_t offset, size_t len){
+    flashInit();
+    if(powerCut || offset % SECTOR_SIZE || len % SECTOR_SIZE || offset + len > SIZE){
+        return;
+    }
+    memset(&flashImage[offset], 0xFF, len);
+    flashSync(offset, len);
+    flashStat.erases += len / SECTOR_SIZE;
+    flashStat.busy_ns += (uint64_t)ERASE_NS * (len / SECTOR_SIZE);
+    HostClock::advanceNs((uint64_t)ERASE_NS * (len / SECTOR_SIZE));
+}
+
+/**
+ * @brief Program pages
+ *
+ * Bits can only go from 1 to 0. With a power cut armed, the
+ * bytes past the budget are not written and power stays off.
+ *
+ * @param offset start, page aligned
+ * @param src data
+ * @param len bytes, a multiple of PAGE_SIZE
+ *
+ * @return void
+ */
+void HostFlash::program(uint32_t offset, const uint8_t *src, size_t len){
+    flashInit();
+    if(powerCut || offset % PAGE_SIZE || len % PAGE_SIZE || offset + len > SIZE){
+        return;
+    }
+    size_t n = len;
+    if(powerArmed && powerBudget < n){
+        n = powerBudget;
+        powerCut = true;
+    }
+    if(powerArmed){
+        powerBudget -= n;
+    }
+    for(size_t i = 0; i < n; i++){
+        flashImage[offset + i] &= src[i];
+    }
+    flashSync(offset, n);
+    flashStat.pages += len / PAGE_SIZE;
+    flashStat.busy_ns += (uint64_t)PROGRAM_NS * (len / PAGE_SIZE);
+    HostClock::advanceNs((uint64_t)PROGRAM_NS * (len / PAGE_SIZE));
+}
+
+/**
+ * @brief Back the image with a file
+ *
+ * @param path image file, created blank if missing
+ *
+ * @return bool false if the file cannot be opened
+ */
+bool HostFlash::open(const char *path){
+    flashInit();
+    close();
+    flashFile = fopen(path, "r+b");
+    if(flashFile){
+        size_t got = fread(flashImage, 1, SIZE, flashFile);
+        if(got < SIZE){
+            memset(&flashImage[got], 0xFF, SIZE - got);
+            flashSync(got, SIZE - got);
+        }
+        return true;
+    }
+    flashFile = fopen(path, "w+b");
+    if(!flashFile){
+        return false;
+    }
+    memset(flashImage, 0xFF, SIZE);
+    flashSync(0, SIZE);
+    return true;
+}
+
+void HostFlash::close(){
+    if(flashFile){
+        fclose(flashFile);
+        flashFile = nullptr;
+    }
+}
+
+void HostFlash::cutPowerAfter(uint32_t bytes){
+    powerArmed = true;
+    powerBudget = bytes;
+}
+
+void HostFlash::restorePower(){
+    powerArmed = false;
+    powerCut = false;
+}
+
+bool HostFlash::powerLost(){
+    return powerCut;
+}
+
+const HostFlash::Stats& HostFlash::stats(){
+    return flashStat;
+}
+
+void HostFlash::resetStats(){
+    flashStat = HostFlash::Stats();
+}
+
+}
@@ -0,0 +1,53 @@
+#include "../inc/I2CBus.hpp"
+#include <cstdint>
+
+/**
+ * @brief I2CBus Constructor
+ *
+ * Nothing touches the hardware until begin is called.
+ *
+ * @param i2c the i2c instance, i2c0 or i2c1
+ * @param sda Serial Data Line gpio pin number
+ * @param scl Serial Clock Line gpio pin number
+ * @param baud baudrate of the I2C
+ *
+ */
+I2CBus::I2CBus(hal::BusHandle i2c, uint8_t sda, uint8_t scl, uint32_t baud): I2C_INST(i2c), SDA_PIN(sda),
+SCL_PIN(scl), BAUD_RATE(baud), txn_engine(i2c), bus_scanner(i2c, txn_engine){
+}
+
+/**
+ * @brief Start the bus
+ *
+ * Sets the controller up, gives the pins their I2C function and
+ * pull ups, and hands the controller interrupt to the transaction
+ * engine along with the pins it clocks to recover a stuck bus.
+ *
+ * @return void
+ */
+void I2CBus::begin(){
+    hal::Bus::init(I2C_INST, BAUD_RATE);
+    hal::Bus::pins(SDA_PIN, SCL_PIN);
+    txn_engine.setRecovery(SDA_PIN, SCL_PIN, BAUD_RATE);
+    txn_engine.begin();
+}
+
+hal::BusHandle I2CBus::handle() const{
+    return I2C_INST;
+}
+
+uint8_t I2CBus::index() const{
+    return hal::Bus::index(I2C_INST);
+}
+
+uint32_t I2CBus::baud() const{
+    return BAUD_RATE;
+}
+
+I2CEngine& I2CBus::engine(){
+    return txn_engine;
+}
+
+BusScanner& I2CBus::scanner(){
+    return bus_scanner;
+}
@@ -0,0 +1,583 @@
+#include "../inc/I2CEngine.hpp"
+#include <cstdint>
+
+I2CEngine* I2CEngine::instances[2] = {nullptr, nullptr};
+
+/**
+ * @brief I2CEngine Constructor
+ *
+ * Constructor initializes the transaction queue for one I2C controller.
+ * The controller itself still has to be set up with hal::Bus::init.
+ *
+ * @param i2c the i2c instance the engine drives
+ *
+ */
+I2CEngine::I2CEngine(hal::BusHandle i2c): I2C_INST(i2c), head(0), tail(0), busy(false), aborted(false),
+paused(false), recovering(false), stat(), isr_us(0), policy{DEFAULT_TIMEOUT_US, 4, 250, 4000}, sda_pin(0), scl_pin(0), baud_rate(0), devices(),
+watching(false), watch_progress(0), watch_us(0){
+    forgetPointers();
+}
+
+/**
+ * @brief Install the interrupt handler
+ *
+ * Registers the engine as the owner of the controller interrupt.
+ * Interrupt sources stay masked until a transaction is started so
+ * the SDK blocking functions can still be used while the engine is idle.
+ *
+ * @return void
+ */
+void I2CEngine::begin(){
+    uint8_t index = hal::Bus::index(I2C_INST);
+    instances[index] = this;
+    hal::Bus::attachIrq(I2C_INST, (index == 0) ? &i2c0_irq : &i2c1_irq);
+}
+
+/**
+ * @brief Prepare a register read
+ *
+ * Fills a transaction that writes the register pointer and then
+ * reads nbytes back with a repeated start.
+ *
+ * @param txn the transaction to fill
+ * @param addr The I2C address to read from.
+ * @param reg The register address to read from.
+ * @param buf A pointer to the buffer to store the read data.
+ * @param nbytes The number of bytes to read from the register.
+ * @param cb completion callback, can be nullptr
+ * @param ctx context handed to the callback
+ *
+ * @return void
+ */
+void I2CEngine::prepareRead(I2CTransaction& txn, uint8_t addr, uint8_t reg, uint8_t *buf,
+                            uint8_t nbytes, I2CCallback cb, void* ctx){
+    txn.addr = addr;
+    txn.reg = reg;
+    txn.buf = buf;
+    txn.nbytes = nbytes;
+    txn.write = false;
+    txn.reuse_pointer = false;
+    txn.callback = cb;
+    txn.context = ctx;
+    txn.result = 0;
+    txn.done = false;
+}
+
+/**
+ * @brief Prepare a register write
+ *
+ * Fills a transaction that writes the register pointer followed
+ * by nbytes of data.
+ *
+ * @param txn the transaction to fill
+ * @param addr The I2C address to write to.
+ * @param reg The register address to write to.
+ * @param buf A pointer to the buffer containing the data to write.
+ * @param nbytes The number of bytes to write to the register.
+ * @param cb completion callback, can be nullptr
+ * @param ctx context handed to the callback
+ *
+ * @return void
+ */
+void I2CEngine::prepareWrite(I2CTransaction& txn, uint8_t addr, uint8_t reg, uint8_t *buf,
+                             uint8_t nbytes, I2CCallback cb, void* ctx){
+    prepareRead(txn, addr, reg, buf, nbytes, cb, ctx);
+    txn.write = true;
+}
+
+/**
+ * @brief Queue a transaction
+ *
+ * Adds the transaction to the queue and starts it right away
+ * if the bus is free. Safe to call from a completion callback.
+ *
+ * @param txn the transaction to queue, must stay valid until done
+ *
+ * @return bool true if queued, false if the queue is full or the payload is too big,
+ * the transaction is then done with PICO_ERROR_GENERIC and no callback runs
+ */
+bool I2CEngine::submit(I2CTransaction& txn){
+    if(txn.nbytes < 1 || txn.nbytes > MAX_PAYLOAD){
+        txn.result = PICO_ERROR_GENERIC;
+        txn.done = true; //not queued, nothing left to wait for
+        return false;
+    }
+    uint32_t start = hal::Clock::nowUs32();
+    uint32_t isr_start = isr_us;
+    txn.done = false;
+
+    uint32_t irq_state = hal::Cpu::disableIrq();
+    uint8_t next = (tail + 1) % QUEUE_SIZE;
+    if(next == head){
+        hal::Cpu::restoreIrq(irq_state);
+        txn.result = PICO_ERROR_GENERIC;
+        txn.done = true;
+        return false;
+    }
+    queue[tail] = &txn;
+    tail = next;
+    stat.submitted++;
+    if(!busy && !paused && !recovering){
+        startNext();
+    }
+    hal::Cpu::restoreIrq(irq_state);
+
+    //a transfer that completes in here (host backend, or an interrupt
+    //right after the restore) is already counted by the handler
+    stat.cpu_us += hal::Clock::nowUs32() - start - (isr_us - isr_start);
+    return true;
+}
+
+/**
+ * @brief Wait for a transaction
+ *
+ * Blocking wrapper used by the synchronous register functions.
+ * A transaction that stays on the bus past the timeout (stuck SDA,
+ * endless clock stretching) is failed and the bus recovered, so the
+ * wait is bounded even when the bus is not; one queued behind it
+ * gets its own timeout once it is on the bus. A transaction that
+ * cannot reach the bus (queue held by acquire, or still queued after
+ * a timeout per queue slot) is taken out of the queue and failed.
+ *
+ * @param txn a transaction previously accepted by submit
+ * @param timeout_us longest time the transaction may hold the bus
+ *
+ * @return int the number of bytes transferred, PICO_ERROR_GENERIC or PICO_ERROR_TIMEOUT
+ */
+int I2CEngine::wait(I2CTransaction& txn, uint32_t timeout_us){
+    uint32_t start = hal::Clock::nowUs32();
+    uint32_t since = start;
+    while(!txn.done){
+        uint32_t now = hal::Clock::nowUs32();
+        if(now - since >= timeout_us){
+            bool onBus = busy && queue[head] == &txn;
+            if(!onBus && (paused || now - start >= timeout_us * QUEUE_SIZE)){
+                cancel(txn);
+                break;
+            }
+            expire();
+            since = now;
+        }
+        hal::Cpu::idle();
+    }
+    stat.wait_us += hal::Clock::nowUs32() - start;
+    return txn.result;
+}
+
+/**
+ * @brief Blocking transfer
+ *
+ * Submit and wait. A failed attempt goes to retry(), so a
+ * transfer that works the first time pays nothing for it.
+ *
+ * @param txn prepared transaction
+ *
+ * @return int the number of bytes transferred, or the error of the last attempt
+ */
+int I2CEngine::transfer(I2CTransaction& txn){
+    int result = submit(txn) ? wait(txn, policy.timeout_us) : PICO_ERROR_GENERIC;
+    if(result >= 0){
+        return result;
+    }
+    return retry(txn, result);
+}
+
+/**
+ * @brief Retry a failed transfer
+ *
+ * Tries again after a wait that doubles each time, up to the
+ * attempts of the policy. A timeout already recovered the bus.
+ *
+ * @param txn the transaction that failed
+ * @param result the error of the first attempt
+ *
+ * @return int the number of bytes transferred, or the error of the last attempt
+ */
+int I2CEngine::retry(I2CTransaction& txn, int result){
+    DeviceErrors* dev = device(txn.addr);
+    uint32_t backoff = policy.backoff_us;
+    for(uint8_t attempt = 1; attempt < policy.attempts && result < 0; attempt++){
+        hal::Clock::sleepUs(backoff);
+        backoff = backoff * 2 > policy.backoff_max_us ? policy.backoff_max_us : backoff * 2;
+        stat.retries++;
+        if(dev){
+            dev->retries++;
+        }
+        result = submit(txn) ? wait(txn, policy.timeout_us) : PICO_ERROR_GENERIC;
+    }
+    if(result < 0 && dev){
+        dev->failures++;
+    }
+    return result;
+}
+
+/**
+ * @brief Wait for the queue to empty
+ *
+ * Used before handing the controller to the SDK blocking functions.
+ *
+ * @return void
+ */
+void I2CEngine::drain(){
+    while(!idle()){
+        hal::Cpu::idle();
+    }
+}
+
+/**
+ * @brief Engine idle
+ *
+ * @return bool true if nothing is queued or on the bus
+ */
+bool I2CEngine::idle() const{
+    return !busy && head == tail;
+}
+
+/**
+ * @brief Take the bus
+ *
+ * Holds new transactions in the queue and waits for the one on the
+ * bus to finish, so the SDK blocking functions can use the controller
+ * without a timer or callback starting a transfer underneath them.
+ *
+ * @return void
+ */
+void I2CEngine::acquire(){
+    paused = true;
+    while(busy){
+        hal::Cpu::idle();
+    }
+}
+
+/**
+ * @brief Give the bus back
+ *
+ * Starts whatever was queued while the bus was held.
+ *
+ * @return void
+ */
+void I2CEngine::release(){
+    uint32_t irq_state = hal::Cpu::disableIrq();
+    paused = false;
+    if(!busy && !recovering){
+        startNext();
+    }
+    hal::Cpu::restoreIrq(irq_state);
+}
+
+/**
+ * @brief Forget the register pointers
+ *
+ * The next access to every address sends its pointer byte again.
+ *
+ * @return void
+ */
+void I2CEngine::forgetPointers(){
+    for(int i = 0; i < 128; i++){
+        pointers[i] = NO_POINTER;
+    }
+}
+
+/**
+ * @brief Give up on the transaction on the bus
+ *
+ * Its owner sees PICO_ERROR_TIMEOUT (and its callback runs), the
+ * bus is recovered and the queue moves on. Only taking the
+ * transaction off the bus is done with interrupts disabled: the
+ * recovery sleeps while it clocks the pins and the callback is user
+ * code, both run with interrupts on while the queue is held.
+ *
+ * @return void
+ */
+void I2CEngine::expire(){
+    uint32_t irq_state = hal::Cpu::disableIrq();
+    if(!busy){
+        hal::Cpu::restoreIrq(irq_state);
+        return;
+    }
+    hal::Bus::abort(I2C_INST);
+    I2CTransaction& txn = *queue[head];
+    head = (head + 1) % QUEUE_SIZE;
+    busy = false;
+    recovering = true;
+
+    txn.result = PICO_ERROR_TIMEOUT;
+    stat.failed++;
+    stat.timeouts++;
+    DeviceErrors* dev = device(txn.addr);
+    if(dev){
+        dev->timeouts++;
+    }
+    hal::Cpu::restoreIrq(irq_state);
+
+    recover();
+    finish(txn);
+
+    irq_state = hal::Cpu::disableIrq();
+    recovering = false;
+    if(!busy && !paused){
+        startNext();
+    }
+    hal::Cpu::restoreIrq(irq_state);
+}
+
+/**
+ * @brief Take a transaction out of the queue
+ *
+ * Fails a transaction that is queued but not on the bus, the ones
+ * behind it move up. Its owner sees PICO_ERROR_TIMEOUT.
+ *
+ * @param txn the transaction to fail
+ *
+ * @return bool true if it was found in the queue
+ */
+bool I2CEngine::cancel(I2CTransaction& txn){
+    uint32_t irq_state = hal::Cpu::disableIrq();
+    uint8_t first = busy ? (head + 1) % QUEUE_SIZE : head;
+    uint8_t slot = first;
+    while(slot != tail && queue[slot] != &txn){
+        slot = (slot + 1) % QUEUE_SIZE;
+    }
+    if(slot == tail){
+        hal::Cpu::restoreIrq(irq_state);
+        return false;
+    }
+    for(uint8_t next = (slot + 1) % QUEUE_SIZE; next != tail; next = (next + 1) % QUEUE_SIZE){
+        queue[slot] = queue[next];
+        slot = next;
+    }
+    tail = slot;
+
+    txn.result = PICO_ERROR_TIMEOUT;
+    stat.failed++;
+    stat.timeouts++;
+    DeviceErrors* dev = device(txn.addr);
+    if(dev){
+        dev->timeouts++;
+    }
+    hal::Cpu::restoreIrq(irq_state);
+
+    finish(txn);
+    return true;
+}
+
+/**
+ * @brief Complete a failed transaction
+ *
+ * @param txn the transaction, already out of the queue
+ *
+ * @return void
+ */
+void I2CEngine::finish(I2CTransaction& txn){
+    txn.done = true;
+    if(txn.callback){
+        txn.callback(txn, txn.context);
+    }
+}
+
+/**
+ * @brief Bus recovery
+ *
+ * Clocks SCL until the target holding SDA lets it go, sends a
+ * STOP and sets the controller up again. Every register pointer
+ * is forgotten since a target may have been reset half way.
+ * Nothing may be on the bus.
+ *
+ * @return bool true if SDA is free, false if a target still holds it
+ */
+bool I2CEngine::recover(){
+    bool released = true;
+    if(baud_rate){
+        released = hal::Bus::recover(I2C_INST, sda_pin, scl_pin, baud_rate);
+    }
+    forgetPointers();
+    stat.recoveries++;
+    if(!released){
+        stat.stuck++;
+    }
+    return released;
+}
+
+/**
+ * @brief Set the recovery pins
+ *
+ * @param sda data pin of the bus
+ * @param scl clock pin of the bus
+ * @param baud bus clock the controller is set up with again
+ *
+ * @return void
+ */
+void I2CEngine::setRecovery(uint8_t sda, uint8_t scl, uint32_t baud){
+    sda_pin = sda;
+    scl_pin = scl;
+    baud_rate = baud;
+}
+
+/**
+ * @brief Bus watchdog
+ *
+ * The async users (poll, scheduler) never wait, so a transaction
+ * stuck on the bus would block the queue for good. Fails it once
+ * no transaction has finished for a whole timeout while the bus
+ * was busy. Only compares counters, the transfers are not touched.
+ *
+ * @return void
+ */
+void I2CEngine::watchdog(){
+    uint32_t progress = stat.completed + stat.failed;
+    if(!busy){
+        watching = false;
+        return;
+    }
+    uint32_t now = hal::Clock::nowUs32();
+    if(!watching || progress != watch_progress){
+        watching = true;
+        watch_progress = progress;
+        watch_us = now;
+    } else if(now - watch_us >= policy.timeout_us){
+        expire();
+        watching = false;
+    }
+}
+
+void I2CEngine::setRetryPolicy(const I2CRetryPolicy& retry){
+    policy = retry;
+    if(policy.attempts < 1){
+        policy.attempts = 1;
+    }
+}
+
+const I2CRetryPolicy& I2CEngine::retryPolicy() const{
+    return policy;
+}
+
+/**
+ * @brief Error counters of a target
+ *
+ * Takes a free slot the first time the address fails.
+ *
+ * @param addr 7-bit target address
+ *
+ * @return DeviceErrors* the counters, nullptr if every slot is taken
+ */
+I2CEngine::DeviceErrors* I2CEngine::device(uint8_t addr){
+    for(DeviceErrors& dev : devices){
+        if(dev.addr == addr || dev.addr == 0){
+            dev.addr = addr;
+            return &dev;
+        }
+    }
+    return nullptr;
+}
+
+const I2CEngine::DeviceErrors& I2CEngine::deviceErrors(uint8_t slot) const{
+    return devices[slot % MAX_DEVICES];
+}
+
+/**
+ * @brief Engine statistics
+ *
+ * @return const Stats& the transaction and CPU time counters
+ */
+const I2CEngine::Stats& I2CEngine::stats() const{
+    return stat;
+}
+
+/**
+ * @brief Start the next transaction
+ *
+ * Loads the whole command sequence (pointer byte, data or read
+ * commands, STOP) into the TX FIFO at once, so the controller runs
+ * the transfer on its own and only interrupts on STOP or abort.
+ * A read flagged reuse_pointer leaves out the pointer byte when the
+ * device still points at the register (TCN75A keeps its pointer).
+ * Must be called with interrupts disabled.
+ *
+ * @return void
+ */
+void I2CEngine::startNext(){
+    if(head == tail){
+        busy = false;
+        return;
+    }
+    busy = true;
+    aborted = false;
+    I2CTransaction& txn = *queue[head];
+
+    bool sendPointer = true;
+    if(!txn.write && txn.reuse_pointer && pointers[txn.addr & 0x7F] == txn.reg){
+        stat.pointer_skips++;
+        sendPointer = false;
+    } else {
+        pointers[txn.addr & 0x7F] = txn.reg;
+    }
+    //nothing may follow: on the host backend the transfer completes in here
+    hal::Bus::start(I2C_INST, txn.addr, sendPointer, txn.reg, txn.buf, txn.nbytes, txn.write);
+}
+
+/**
+ * @brief Interrupt Handler/ISR.
+ *
+ * An abort is latched and the transaction completes on the STOP that
+ * follows it. On STOP the received bytes are drained from the RX FIFO,
+ * the callback runs and the next queued transaction is started.
+ *
+ * @return void
+ */
+void I2CEngine::handleIRQ(){
+    uint32_t start = hal::Clock::nowUs32();
+    uint32_t isr_start = isr_us;
+    uint32_t status = hal::Bus::irqStatus(I2C_INST);
+
+    if(status & hal::Bus::IRQ_ABORT){
+        aborted = true;
+    }
+
+    if((status & hal::Bus::IRQ_STOP) && busy){
+        I2CTransaction& txn = *queue[head];
+        head = (head + 1) % QUEUE_SIZE;
+
+        if(aborted){
+            txn.result = PICO_ERROR_GENERIC;
+            pointers[txn.addr & 0x7F] = NO_POINTER;
+            stat.failed++;
+            DeviceErrors* dev = device(txn.addr);
+            if(dev){
+                dev->nacks++;
+            }
+            hal::Bus::readData(I2C_INST, txn.buf, 0); //leave nothing behind for the next transaction
+        } else if(txn.write){
+            txn.result = txn.nbytes + 1; //pointer byte + data, like i2c_write_blocking
+            stat.completed++;
+        } else {
+            hal::Bus::readData(I2C_INST, txn.buf, txn.nbytes);
+            txn.result = txn.nbytes;
+            stat.completed++;
+        }
+
+        busy = false;
+        txn.done = true;
+        if(txn.callback){
+            txn.callback(txn, txn.context);
+        }
+        if(!busy && !paused){
+            startNext();
+        }
+    }
+    //the next transfer may have completed inside startNext, its handler counted itself
+    uint32_t spent = hal::Clock::nowUs32() - start - (isr_us - isr_start);
+    stat.cpu_us += spent;
+    isr_us += spent;
+}
+
+void I2CEngine::i2c0_irq(){
+    if(instances[0]){
+        instances[0]->handleIRQ();
+    }
+}
+
+void I2CEngine::i2c1_irq(){
+    if(instances[1]){
+        instances[1]->handleIRQ();
+    }
+}
@@ -0,0 +1,227 @@
+#include "../inc/LedEffects.hpp"
+#include "../inc/Hal.hpp"
+#include <cstdint>
+
+namespace led_pattern{
+
+static const LedStep blinkSteps[] = {{255, 250}, {0, 250}};
+static const LedStep fastBlinkSteps[] = {{255, 100}, {0, 100}};
+static const LedStep breatheSteps[] = {
+    {32, 60}, {64, 60}, {96, 60}, {128, 60}, {160, 60}, {192, 60}, {224, 60}, {255, 120},
+    {224, 60}, {192, 60}, {160, 60}, {128, 60}, {96, 60}, {64, 60}, {32, 60}, {0, 120},
+};
+
+const LedPattern BLINK = {blinkSteps, 2};
+const LedPattern FAST_BLINK = {fastBlinkSteps, 2};
+const LedPattern BREATHE = {breatheSteps, 16};
+
+}
+
+/**
+ * @brief LedEffects Constructor
+ *
+ * No LED bound, nothing queued.
+ *
+ */
+LedEffects::LedEffects(): stat(){
+    for(uint8_t i = 0; i < (uint8_t)LedChannel::COUNT; i++){
+        leds[i].pin = NO_PIN;
+        leds[i].base.store(0, std::memory_order_relaxed);
+        leds[i].queued = 0;
+        leds[i].shown = 0;
+        restart(leds[i]);
+        written[i] = 0;
+    }
+}
+
+/**
+ * @brief Bind an LED to a pin
+ *
+ * @param led the LED
+ * @param pin gpio number, set up as a PWM output
+ *
+ * @return void
+ */
+void LedEffects::bind(LedChannel led, uint8_t pin){
+    leds[(uint8_t)led].pin = pin;
+    hal::Pwm::init(pin);
+}
+
+/**
+ * @brief Queue a pattern
+ *
+ * Goes behind the patterns of the same or a higher priority. If it
+ * goes first, the pattern that was playing starts over once it ends.
+ * When the queue is full the lowest priority pattern is dropped.
+ *
+ * @param led the LED
+ * @param pattern steps to play, must stay valid while queued
+ * @param repeat times to play it, 0 until cancelled
+ * @param priority who is asking
+ *
+ * @return bool false if the queue is full of patterns at least as important
+ */
+bool LedEffects::play(LedChannel led, const LedPattern& pattern, uint8_t repeat, LedPriority priority){
+    Led& l = leds[(uint8_t)led];
+    uint32_t irq_state = hal::Cpu::disableIrq();
+    if(l.queued == QUEUE_SIZE){
+        if(l.queue[QUEUE_SIZE - 1].priority >= priority){
+            stat.dropped++;
+            hal::Cpu::restoreIrq(irq_state);
+            return false;
+        }
+        l.queued--;
+        stat.dropped++;
+    }
+    uint8_t index = 0;
+    while(index < l.queued && l.queue[index].priority >= priority){
+        index++;
+    }
+    for(uint8_t i = l.queued; i > index; i--){
+        l.queue[i] = l.queue[i - 1];
+    }
+    l.queue[index] = {&pattern, repeat, priority};
+    l.queued++;
+    if(index == 0){
+        if(l.queued > 1){
+            stat.preempted++;
+        }
+        restart(l);
+    }
+    hal::Cpu::restoreIrq(irq_state);
+    return true;
+}
+
+/**
+ * @brief Cancel patterns
+ *
+ * @param led the LED
+ * @param priority the patterns of this priority are dropped
+ *
+ * @return void
+ */
+void LedEffects::cancel(LedChannel led, LedPriority priority){
+    Led& l = leds[(uint8_t)led];
+    uint32_t irq_state = hal::Cpu::disableIrq();
+    for(uint8_t i = l.queued; i > 0; i--){
+        if(l.queue[i - 1].priority == priority){
+            remove(l, i - 1);
+        }
+    }
+    hal::Cpu::restoreIrq(irq_state);
+}
+
+void LedEffects::setBase(LedChannel led, uint8_t level){
+    leds[(uint8_t)led].base.store(level, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Advance the effects
+ *
+ * Runs from the repeating timer. Steps are timed from the end of
+ * the previous one, so a late tick does not stretch the pattern.
+ * A pin is only written when its level changes.
+ *
+ * @param now_ms current time in ms
+ *
+ * @return void
+ */
+void LedEffects::tick(uint32_t now_ms){
+    const uint8_t count = (uint8_t)LedChannel::COUNT;
+    stat.ticks++;
+    for(Led& l : leds){
+        advance(l, now_ms);
+        l.shown = l.queued ? l.queue[0].pattern->steps[l.step].level : l.base.load(std::memory_order_relaxed);
+    }
+    for(uint8_t i = 0; i < count; i++){
+        uint8_t pin = leds[i].pin;
+        bool first = pin != NO_PIN;
+        uint8_t out = 0;
+        for(uint8_t j = 0; j < count && first; j++){
+            if(leds[j].pin != pin){
+                continue;
+            }
+            first = j >= i;
+            out = leds[j].shown > out ? leds[j].shown : out;
+        }
+        if(first && out != written[i]){
+            hal::Pwm::set(pin, out);
+            written[i] = out;
+        }
+    }
+}
+
+/**
+ * @brief Advance one LED
+ *
+ * @param led the LED
+ * @param now_ms current time in ms
+ *
+ * @return void
+ */
+void LedEffects::advance(Led& led, uint32_t now_ms){
+    if(!led.queued){
+        return;
+    }
+    if(!led.started){
+        led.started = true;
+        led.step_ms = now_ms;
+        return;
+    }
+    while(led.queued){
+        const Request& req = led.queue[0];
+        uint16_t ms = req.pattern->steps[led.step].ms;
+        if(now_ms - led.step_ms < ms){
+            return;
+        }
+        led.step_ms += ms;
+        if(++led.step < req.pattern->count){
+            continue;
+        }
+        led.step = 0;
+        if(req.repeat && ++led.done >= req.repeat){
+            uint32_t end = led.step_ms;
+            remove(led, 0);
+            stat.played++;
+            //the next one starts where this one ended
+            led.started = true;
+            led.step_ms = end;
+        }
+    }
+}
+
+void LedEffects::restart(Led& led){
+    led.step = 0;
+    led.done = 0;
+    led.started = false;
+}
+
+/**
+ * @brief Remove a queued pattern
+ *
+ * @param led the LED
+ * @param index position in the queue, 0 is the one playing
+ *
+ * @return void
+ */
+void LedEffects::remove(Led& led, uint8_t index){
+    for(uint8_t i = index + 1; i < led.queued; i++){
+        led.queue[i - 1] = led.queue[i];
+    }
+    led.queued--;
+    if(index == 0){
+        restart(led);
+    }
+}
+
+bool LedEffects::busy(LedChannel led) const{
+    return leds[(uint8_t)led].queued != 0;
+}
+
+uint8_t LedEffects::level(LedChannel led) const{
+    return leds[(uint8_t)led].shown;
+}
+
+const LedEffects::Stats& LedEffects::stats() const{
+    return stat;
+}
@@ -0,0 +1,166 @@
+#include "../inc/LimitCodec.hpp"
+#include <cstdint>
+
+namespace tcn75a{
+
+/**
+ * @brief Parse a decimal number
+ *
+ * Milli degrees truncated towards zero, plus the first digit that
+ * was dropped, so each caller rounds once.
+ *
+ * @param text typed value
+ * @param mag destination, magnitude in milli degrees, truncated
+ * @param negative set if the value has a minus sign
+ * @param dropped first digit past the third decimal, 0 if none
+ *
+ * @return ParseError None, or why the text is not a number
+ */
+static ParseError parseMilli(const char* text, int32_t& mag, bool& negative, int32_t& dropped){
+    const char* p = text;
+    negative = *p == '-';
+    if(*p == '-' || *p == '+'){
+        p++;
+    }
+    int32_t value = 0;
+    int32_t scale = 1000;
+    bool digits = false, point = false;
+    dropped = 0;
+    for(; *p; p++){
+        if(*p >= '0' && *p <= '9'){
+            int32_t d = *p - '0';
+            if(!point){
+                value = value * 10 + d * 1000;
+                if(value > 1000000){
+                    return ParseError::Range; //past any register, stop before it overflows
+                }
+            } else if(scale > 1){
+                scale /= 10;
+                value += d * scale;
+            } else if(scale == 1){
+                dropped = d;
+                scale = 0;
+            }
+            digits = true;
+        } else if(*p == '.' && !point){
+            point = true;
+        } else {
+            return ParseError::Syntax;
+        }
+    }
+    if(!digits){
+        return point ? ParseError::Syntax : ParseError::Empty;
+    }
+    mag = value;
+    return ParseError::None;
+}
+
+/**
+ * @brief Parse a temperature
+ *
+ * Signed decimal Celsius such as "-12.5", "+30" or "0.0625",
+ * rounded to the nearest milli degree.
+ *
+ * @param text typed value, no spaces
+ * @param milli destination, milli degrees C
+ *
+ * @return ParseError None, or why the text is not a temperature
+ */
+ParseError parseCelsius(const char* text, int32_t& milli){
+    int32_t mag, dropped;
+    bool negative;
+    ParseError error = parseMilli(text, mag, negative, dropped);
+    if(error != ParseError::None){
+        return error;
+    }
+    mag += dropped >= 5;
+    milli = negative ? -mag : mag;
+    return ParseError::None;
+}
+
+/**
+ * @brief Parse a limit
+ *
+ * Rounds to the nearest 0.5 C, halfway values away from zero
+ * (29.75 is 30.0, -29.75 is -30.0), then checks the range.
+ *
+ * @param text typed value
+ * @param raw destination, the register word
+ *
+ * @return ParseError None, or why the value was refused
+ */
+ParseError parseLimit(const char* text, uint16_t& raw){
+    //from the truncated value: anything past the milli degree cannot
+    //move it across a half way point
+    int32_t mag, dropped;
+    bool negative;
+    ParseError error = parseMilli(text, mag, negative, dropped);
+    if(error != ParseError::None){
+        return error;
+    }
+    int32_t half = (mag + 250) / 500;
+    if(negative){
+        half = -half;
+    }
+    if(half < LIMIT_MIN_HALF || half > LIMIT_MAX_HALF){
+        return ParseError::Range;
+    }
+    raw = encodeLimit((int16_t)half);
+    return ParseError::None;
+}
+
+/**
+ * @brief Format a limit
+ *
+ * @param raw register word
+ * @param out destination buffer, 7 characters hold any limit
+ * @param size size of the destination buffer
+ *
+ * @return int the number of characters written, excluding the terminator
+ */
+int formatLimit(uint16_t raw, char* out, size_t size){
+    int16_t half = decodeLimit(raw);
+    bool negative = half < 0;
+    uint16_t mag = (uint16_t)(negative ? -half : half);
+
+    char text[8];
+    int n = 0;
+    if(negative){
+        text[n++] = '-';
+    }
+    uint16_t whole = mag / 2;
+    if(whole >= 100){
+        text[n++] = (char)('0' + whole / 100);
+    }
+    if(whole >= 10){
+        text[n++] = (char)('0' + whole / 10 % 10);
+    }
+    text[n++] = (char)('0' + whole % 10);
+    text[n++] = '.';
+    text[n++] = mag & 1 ? '5' : '0';
+
+    int written = 0;
+    for(; written < n && (size_t)written + 1 < size; written++){
+        out[written] = text[written];
+    }
+    if(size > 0){
+        out[written] = '\0';
+    }
+    return written;
+}
+
+const char* parseErrorText(ParseError error){
+    switch (error) {
+        case ParseError::None:
+            return "ok";
+        case ParseError::Empty:
+            return "no value";
+        case ParseError::Syntax:
+            return "not a number";
+        case ParseError::Range:
+            return "out of range (-40 to 125 C)";
+    }
+    return "";
+}
+
+} //namespace tcn75a
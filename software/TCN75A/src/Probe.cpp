@@ -0,0 +1,241 @@
+#include "../inc/Probe.hpp"
+#include <cstdint>
+#include <cstdio>
+
+namespace probe {
+
+static const char* const names[] = {"get_Temp", "Read_Reg", "bus_scan", "MainMenu", "TempScreen", "Command",
+                                    "SensorPoll", "StatsUpdate", "RuleEval", "LogPush", "TextLine"};
+static_assert(sizeof(names) / sizeof(names[0]) == (size_t)Point::COUNT, "one name per probe point");
+
+#if defined(TCN75A_PROBES)
+static Histogram table[(size_t)Point::COUNT];
+#endif
+
+/**
+ * @brief Histogram Constructor
+ *
+ * Constructor initializes an empty histogram.
+ *
+ */
+Histogram::Histogram(): counts(), total(0), lowest(UINT32_MAX), highest(0), ticks_sum(0){
+}
+
+/**
+ * @brief Bucket of a value
+ *
+ * Values below SUBS have a bucket each. Above, the top bit picks the
+ * power of two and the SUB_BITS bits under it the linear step.
+ *
+ * @param ticks the value
+ *
+ * @return uint8_t the bucket number, below BUCKETS
+ */
+uint8_t Histogram::bucketOf(uint32_t ticks){
+    if(ticks < SUBS){
+        return (uint8_t)ticks;
+    }
+    uint8_t top = (uint8_t)(31 - __builtin_clz(ticks));
+    uint8_t step = (uint8_t)((ticks >> (top - SUB_BITS)) & (SUBS - 1));
+    return (uint8_t)((top - SUB_BITS + 1) * SUBS + step);
+}
+
+/**
+ * @brief Smallest value of a bucket
+ *
+ * @param bucket the bucket number
+ *
+ * @return uint32_t the first value counted in it
+ */
+uint32_t Histogram::bucketLow(uint8_t bucket){
+    if(bucket < SUBS){
+        return bucket;
+    }
+    uint8_t top = (uint8_t)(bucket / SUBS + SUB_BITS - 1);
+    return (uint32_t)(SUBS + bucket % SUBS) << (top - SUB_BITS);
+}
+
+/**
+ * @brief Count a value
+ *
+ * @param ticks the measured time
+ *
+ * @return void
+ */
+void Histogram::record(uint32_t ticks){
+    counts[bucketOf(ticks)]++;
+    total++;
+    ticks_sum += ticks;
+    if(ticks < lowest){
+        lowest = ticks;
+    }
+    if(ticks > highest){
+        highest = ticks;
+    }
+}
+
+void Histogram::reset(){
+    *this = Histogram();
+}
+
+uint32_t Histogram::count() const{
+    return total;
+}
+
+uint32_t Histogram::min() const{
+    return total ? lowest : 0;
+}
+
+uint32_t Histogram::max() const{
+    return highest;
+}
+
+uint64_t Histogram::sum() const{
+    return ticks_sum;
+}
+
+/**
+ * @brief Percentile
+ *
+ * @param pct 0 to 100
+ *
+ * @return uint32_t the value pct % of the counts are at or below, to the bucket width
+ */
+uint32_t Histogram::percentile(uint8_t pct) const{
+    if(total == 0){
+        return 0;
+    }
+    uint64_t rank = ((uint64_t)total * pct + 99) / 100;
+    if(rank == 0){
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for(uint8_t b = 0; b < BUCKETS; b++){
+        seen += counts[b];
+        if(seen >= rank){
+            uint32_t upper = b + 1 < BUCKETS ? bucketLow((uint8_t)(b + 1)) - 1 : UINT32_MAX;
+            return upper < highest ? upper : highest;
+        }
+    }
+    return highest;
+}
+
+//******************************************************//
+//************************PROBES************************//
+//******************************************************//
+
+/**
+ * @brief Start the cycle counter
+ *
+ * Called at the start of main() and of core1(): each core has its own.
+ *
+ * @return void
+ */
+void init(){
+    if(ENABLED){
+        hal::Cycles::init();
+    }
+}
+
+/**
+ * @brief Name of a point
+ *
+ * @param point the probe point
+ *
+ * @return const char* the name printed in the dump
+ */
+const char* name(Point point){
+    return point < Point::COUNT ? names[(size_t)point] : "?";
+}
+
+/**
+ * @brief Histogram of a point
+ *
+ * @param point the probe point
+ *
+ * @return const Histogram* its counters, nullptr when the probes are not built in
+ */
+const Histogram* histogram(Point point){
+#if defined(TCN75A_PROBES)
+    return point < Point::COUNT ? &table[(size_t)point] : nullptr;
+#else
+    (void)point;
+    return nullptr;
+#endif
+}
+
+/**
+ * @brief Count a run of a point
+ *
+ * @param point the probe point
+ * @param ticks time it took, in hal::Cycles ticks
+ *
+ * @return void
+ */
+void record(Point point, uint32_t ticks){
+#if defined(TCN75A_PROBES)
+    table[(size_t)point].record(ticks);
+#else
+    (void)point;
+    (void)ticks;
+#endif
+}
+
+/**
+ * @brief Clear every histogram
+ *
+ * @return void
+ */
+void reset(){
+#if defined(TCN75A_PROBES)
+    for(Histogram& h : table){
+        h.reset();
+    }
+#endif
+}
+
+/**
+ * @brief Print a time in us
+ *
+ * @param ticks hal::Cycles ticks
+ * @param perUs ticks per microsecond
+ *
+ * @return void
+ */
+static void printUs(uint64_t ticks, uint32_t perUs){
+    uint64_t hundredths = ticks * 100 / perUs;
+    printf(" | %7lu.%02lu", (unsigned long)(hundredths / 100), (unsigned long)(hundredths % 100));
+}
+
+/**
+ * @brief Dump the probes
+ *
+ * Times in us, with the resolution of the counter: the percentiles
+ * are bucket edges, within 25 % of the true value.
+ *
+ * @return void
+ */
+void print(){
+    if(!ENABLED){
+        printf("Probes not built in, configure with -DTCN75A_PROBES=ON\n");
+        return;
+    }
+    uint32_t perUs = hal::Cycles::perUs();
+    printf(" Probe       |   Count  |    Min us  |   Mean us  |    p50 us  |    p90 us  |    p99 us  |    Max us\n");
+    for(uint8_t i = 0; i < (uint8_t)Point::COUNT; i++){
+        const Histogram* h = histogram((Point)i);
+        if(!h || h->count() == 0){
+            continue;
+        }
+        printf(" %-11s | %8lu", names[i], (unsigned long)h->count());
+        printUs(h->min(), perUs);
+        printUs(h->sum() / h->count(), perUs);
+        printUs(h->percentile(50), perUs);
+        printUs(h->percentile(90), perUs);
+        printUs(h->percentile(99), perUs);
+        printUs(h->max(), perUs);
+        printf("\n");
+    }
+}
+
+}
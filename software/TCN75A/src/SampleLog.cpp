@@ -0,0 +1,501 @@
+#include "../inc/SampleLog.hpp"
+#include "../inc/ConfigRegister.hpp"
+#include "../inc/Telemetry.hpp"
+#include "../inc/Probe.hpp"
+#include <cstdint>
+#include <cstring>
+
+static void put16(uint8_t *p, uint16_t v){
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v){
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void put64(uint8_t *p, uint64_t v){
+    put32(p, (uint32_t)v);
+    put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t get16(const uint8_t *p){
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p){
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+static uint64_t get64(const uint8_t *p){
+    return get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+//LEB128: 7 bits per byte, low bits first, top bit set on all but the last
+static uint8_t putVarint(uint8_t *p, uint64_t v){
+    uint8_t n = 0;
+    while(v >= 0x80){
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t& v){
+    v = 0;
+    for(uint8_t shift = 0; p < end && shift < 64; shift += 7){
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if(!(b & 0x80)){
+            return true;
+        }
+    }
+    return false;
+}
+
+//Small signed values to small unsigned ones: 0, -1, 1, -2... -> 0, 1, 2, 3...
+static uint32_t zigzag(int32_t v){
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v){
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/**
+ * @brief SampleLog Constructor
+ *
+ * Constructor only sets the region up, mount() reads the flash.
+ *
+ * @param offset flash offset of the first sector, sector aligned
+ * @param sectors sectors in the ring, up to MAX_SECTORS
+ *
+ */
+SampleLog::SampleLog(uint32_t offset, uint16_t sectors): region(offset),
+sector_count(sectors > MAX_SECTORS ? MAX_SECTORS : sectors), index(), head(0), next_seq(1), boot_ms(0),
+stage(), used(HEADER_SIZE), count(0), first_ms(0), last_ms(0), stage_start_us(0), prev_raw(),
+max_age_us(10 * 60 * 1000 * 1000u), flush_request(false), seq(0), index_copy(), stage_copy(), read_buf(), stat(){
+    startSector();
+}
+
+//******************************************************//
+//*************************MOUNT************************//
+//******************************************************//
+
+/**
+ * @brief Check a sector
+ *
+ * Reads the sector into read_buf and checks the magic, the header
+ * CRC and the payload CRC.
+ *
+ * @param sector sector number in the ring
+ * @param buf destination, SECTOR_SIZE bytes
+ * @param entry filled from the header
+ *
+ * @return bool true if the sector holds a complete record batch
+ */
+bool SampleLog::readHeader(uint16_t sector, uint8_t *buf, IndexEntry& entry){
+    entry = IndexEntry();
+    hal::Flash::read(region + sector * SECTOR_SIZE, buf, HEADER_SIZE);
+    if(get32(buf) != MAGIC){
+        return false; //erased, or the header page never got programmed
+    }
+    uint16_t payload = get16(&buf[24]);
+    if(telemetry::crc16(buf, 30) != get16(&buf[30]) || payload > SECTOR_SIZE - HEADER_SIZE){
+        stat.corrupt++;
+        return false;
+    }
+    hal::Flash::read(region + sector * SECTOR_SIZE + HEADER_SIZE, &buf[HEADER_SIZE], payload);
+    if(telemetry::crc16(&buf[HEADER_SIZE], payload) != get16(&buf[28])){
+        stat.corrupt++;
+        return false;
+    }
+    entry.seq = get32(&buf[4]);
+    entry.first_ms = get64(&buf[8]);
+    entry.last_ms = get64(&buf[16]);
+    entry.count = get16(&buf[26]);
+    entry.valid = true;
+    return true;
+}
+
+/**
+ * @brief Rebuild the index
+ *
+ * Called once at boot, before the writer starts. The newest valid
+ * sector gives the next sequence number and the log time to carry
+ * on from; writing resumes in the sector after it, the oldest.
+ *
+ * @return uint16_t valid sectors found
+ */
+uint16_t SampleLog::mount(){
+    stat.mounted = 0;
+    stat.corrupt = 0;
+    bool found = false;
+    uint32_t newest = 0;
+    uint16_t newestSector = 0;
+    for(uint16_t s = 0; s < sector_count; s++){
+        if(!readHeader(s, read_buf, index[s])){
+            continue;
+        }
+        stat.mounted++;
+        if(!found || index[s].seq > newest){
+            found = true;
+            newest = index[s].seq;
+            newestSector = s;
+        }
+    }
+
+    if(found){
+        head = (newestSector + 1) % sector_count;
+        next_seq = newest + 1;
+        boot_ms = index[newestSector].last_ms + 1;
+    } else {
+        head = 0;
+        next_seq = 1;
+        boot_ms = 0;
+    }
+    last_ms = boot_ms;
+    startSector();
+    return stat.mounted;
+}
+
+/**
+ * @brief Erase the log
+ *
+ * @return void
+ */
+void SampleLog::format(){
+    seq.fetch_add(1, std::memory_order_acq_rel);
+    for(uint16_t s = 0; s < sector_count; s++){
+        index[s] = IndexEntry();
+    }
+    head = 0;
+    startSector();
+    seq.fetch_add(1, std::memory_order_release);
+    hal::Flash::erase(region, sector_count * SECTOR_SIZE);
+}
+
+//******************************************************//
+//*************************WRITER***********************//
+//******************************************************//
+
+/**
+ * @brief Empty the staged sector
+ *
+ * @return void
+ */
+void SampleLog::startSector(){
+    memset(stage, 0xFF, sizeof(stage));
+    used = HEADER_SIZE;
+    count = 0;
+    memset(prev_raw, 0, sizeof(prev_raw));
+}
+
+/**
+ * @brief Log a sample
+ *
+ * Encodes the sample into the staged sector. A full sector is
+ * committed first, which takes an erase and a program.
+ *
+ * @param sample reading from the sample ring
+ *
+ * @return bool false if the address is not a TCN75A one
+ */
+bool SampleLog::push(const TempSample& sample){
+    PROBE_SCOPE(LogPush);
+    uint8_t sensor = sample.addr - tcn75a::FIRST_ADDR;
+    if(sensor >= 8 || sector_count == 0){
+        stat.dropped++;
+        return false;
+    }
+    if((uint32_t)used + MAX_RECORD > SECTOR_SIZE){
+        commit();
+    }
+
+    //log time never goes back, samples of the two paths can cross by a few ms
+    uint64_t t = logTimeMs(sample.timestamp_us);
+    if(t < last_ms){
+        t = last_ms;
+    }
+    uint64_t dt = count ? t - last_ms : 0;
+
+    uint8_t rec[MAX_RECORD];
+    uint8_t n;
+    if(sample.raw & 0x0F){
+        n = putVarint(rec, (dt << 4) | 0x08 | sensor);
+        put16(&rec[n], sample.raw);
+        n += 2;
+    } else {
+        n = putVarint(rec, (dt << 4) | sensor);
+        int32_t delta = ((int16_t)sample.raw >> 4) - ((int16_t)prev_raw[sensor] >> 4);
+        n += putVarint(&rec[n], zigzag(delta));
+    }
+
+    seq.fetch_add(1, std::memory_order_acq_rel);
+    memcpy(&stage[used], rec, n);
+    used += n;
+    if(count == 0){
+        first_ms = t;
+        stage_start_us = sample.timestamp_us;
+    }
+    count++;
+    last_ms = t;
+    prev_raw[sensor] = sample.raw;
+    seq.fetch_add(1, std::memory_order_release);
+
+    stat.samples++;
+    stat.bytes += n;
+    return true;
+}
+
+/**
+ * @brief Commit the staged sector when due
+ *
+ * Bounds what a power loss can take: at most max age of records.
+ * Also serves the flush requests of the other core.
+ *
+ * @param now_us current hal::Clock::nowUs
+ *
+ * @return bool true if a sector was written
+ */
+bool SampleLog::flushDue(uint64_t now_us){
+    bool requested = flush_request.exchange(false, std::memory_order_acq_rel);
+    if(count == 0 || (!requested && now_us - stage_start_us < max_age_us)){
+        return false;
+    }
+    commit();
+    return true;
+}
+
+void SampleLog::flush(){
+    commit();
+}
+
+void SampleLog::requestFlush(){
+    flush_request.store(true, std::memory_order_release);
+    hal::Cpu::signal();
+}
+
+void SampleLog::setMaxAge(uint32_t ms){
+    max_age_us = ms * 1000u;
+}
+
+/**
+ * @brief Write the staged sector
+ *
+ * Erase, program the payload pages, then the header page: the
+ * header is only valid once everything it covers is in flash. Only
+ * the pages holding data are programmed. The index entry is dropped
+ * before the erase so a reader does not trust the old content.
+ *
+ * @return void
+ */
+void SampleLog::commit(){
+    if(count == 0){
+        return;
+    }
+    uint32_t start = hal::Clock::nowUs32();
+
+    uint16_t payload = used - HEADER_SIZE;
+    put32(&stage[0], MAGIC);
+    put32(&stage[4], next_seq);
+    put64(&stage[8], first_ms);
+    put64(&stage[16], last_ms);
+    put16(&stage[24], payload);
+    put16(&stage[26], count);
+    put16(&stage[28], telemetry::crc16(&stage[HEADER_SIZE], payload));
+    put16(&stage[30], telemetry::crc16(stage, 30));
+
+    seq.fetch_add(1, std::memory_order_acq_rel);
+    index[head].valid = false;
+    seq.fetch_add(1, std::memory_order_release);
+
+    const uint32_t page = hal::Flash::PAGE_SIZE;
+    uint32_t addr = region + head * SECTOR_SIZE;
+    uint32_t pages = (used + page - 1) / page;
+    hal::Flash::erase(addr, SECTOR_SIZE);
+    if(pages > 1){
+        hal::Flash::program(addr + page, &stage[page], (pages - 1) * page);
+    }
+    hal::Flash::program(addr, stage, page);
+
+    seq.fetch_add(1, std::memory_order_acq_rel);
+    IndexEntry& entry = index[head];
+    entry.seq = next_seq;
+    entry.first_ms = first_ms;
+    entry.last_ms = last_ms;
+    entry.count = count;
+    entry.valid = true;
+    head = (head + 1) % sector_count;
+    next_seq++;
+    startSector();
+    seq.fetch_add(1, std::memory_order_release);
+
+    stat.sectors++;
+    uint32_t took = hal::Clock::nowUs32() - start;
+    if(took > stat.max_commit_us){
+        stat.max_commit_us = took;
+    }
+}
+
+//******************************************************//
+//*************************READER***********************//
+//******************************************************//
+
+/**
+ * @brief Samples in a time range
+ *
+ * Takes a consistent copy of the index and of the staged records,
+ * then decodes only the sectors whose time span overlaps the range,
+ * oldest first. A sector rewritten while it is read fails its
+ * sequence or CRC check and is skipped.
+ * Uses the reader buffers of the object, one query at a time.
+ *
+ * @param from_ms first log time, inclusive
+ * @param to_ms last log time, inclusive
+ * @param handler called for every sample in the range, in time order
+ * @param context passed back to the handler
+ *
+ * @return uint32_t samples handed to the handler
+ */
+uint32_t SampleLog::query(uint64_t from_ms, uint64_t to_ms, SampleHandler handler, void* context){
+    uint32_t before, after;
+    uint16_t stageUsed, stageCount, start;
+    uint64_t stageFirst, stageLast;
+    do{
+        before = seq.load(std::memory_order_acquire);
+        memcpy(index_copy, index, sizeof(index));
+        stageUsed = used;
+        stageCount = count;
+        stageFirst = first_ms;
+        stageLast = last_ms;
+        start = head;
+        memcpy(stage_copy, stage, stageUsed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = seq.load(std::memory_order_relaxed);
+    } while((before & 1) || before != after);
+
+    uint32_t found = 0;
+    stat.decoded = 0;
+    stat.skipped = 0;
+    //the sector at head is the oldest one, the ring goes forward in time
+    for(uint16_t i = 0; i < sector_count; i++){
+        uint16_t s = (start + i) % sector_count;
+        const IndexEntry& entry = index_copy[s];
+        if(!entry.valid){
+            continue;
+        }
+        if(entry.last_ms < from_ms || entry.first_ms > to_ms){
+            stat.skipped++;
+            continue;
+        }
+        IndexEntry check;
+        if(!readHeader(s, read_buf, check) || check.seq != entry.seq){
+            continue;
+        }
+        stat.decoded++;
+        found += decode(read_buf, get16(&read_buf[24]), entry.first_ms, from_ms, to_ms, handler, context);
+    }
+    if(stageCount && stageLast >= from_ms && stageFirst <= to_ms){
+        stat.decoded++;
+        found += decode(stage_copy, stageUsed - HEADER_SIZE, stageFirst, from_ms, to_ms, handler, context);
+    }
+    return found;
+}
+
+/**
+ * @brief Decode the records of a sector
+ *
+ * @param sector sector image, records from HEADER_SIZE
+ * @param payload bytes of records
+ * @param first time of the first record
+ * @param from_ms first log time handed out
+ * @param to_ms last log time handed out
+ * @param handler called for every sample in the range
+ * @param context passed back to the handler
+ *
+ * @return uint32_t samples handed to the handler
+ */
+uint32_t SampleLog::decode(const uint8_t *sector, uint16_t payload, uint64_t first, uint64_t from_ms,
+                           uint64_t to_ms, SampleHandler handler, void* context){
+    const uint8_t *p = &sector[HEADER_SIZE];
+    const uint8_t *end = p + payload;
+    uint16_t prev[8] = {0};
+    uint64_t t = first;
+    uint32_t n = 0;
+    while(p < end){
+        uint64_t tag, value;
+        if(!getVarint(p, end, tag)){
+            break;
+        }
+        t += tag >> 4;
+        uint8_t sensor = tag & 0x07;
+        uint16_t raw;
+        if(tag & 0x08){
+            if(end - p < 2){
+                break;
+            }
+            raw = get16(p);
+            p += 2;
+        } else {
+            if(!getVarint(p, end, value)){
+                break;
+            }
+            raw = (uint16_t)((((int16_t)prev[sensor] >> 4) + unzigzag((uint32_t)value)) << 4);
+        }
+        prev[sensor] = raw;
+        if(t > to_ms){
+            break;
+        }
+        if(t >= from_ms){
+            TempSample sample;
+            sample.timestamp_us = t * 1000;
+            sample.raw = raw;
+            sample.addr = tcn75a::FIRST_ADDR + sensor;
+            handler(sample, context);
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Log time
+ *
+ * @param now_us a hal::Clock::nowUs time of this boot
+ *
+ * @return uint64_t milliseconds of log time
+ */
+uint64_t SampleLog::logTimeMs(uint64_t now_us) const{
+    return boot_ms + now_us / 1000;
+}
+
+uint64_t SampleLog::lastMs() const{
+    return last_ms;
+}
+
+/**
+ * @brief Samples kept
+ *
+ * @return uint32_t records in the valid sectors and in the staged one
+ */
+uint32_t SampleLog::storedSamples() const{
+    uint32_t n = count;
+    for(uint16_t s = 0; s < sector_count; s++){
+        if(index[s].valid){
+            n += index[s].count;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Log statistics
+ *
+ * @return const Stats& samples, bytes, sectors and the last query
+ */
+const SampleLog::Stats& SampleLog::stats() const{
+    return stat;
+}
@@ -0,0 +1,85 @@
+#include "../inc/SampleMerger.hpp"
+#include <cstdint>
+
+/**
+ * @brief SampleMerger Constructor
+ *
+ * No source, pop returns nothing until one is added.
+ *
+ */
+SampleMerger::SampleMerger(): sources(), source_count(0), held_back(false), last_us(0), stat(){
+}
+
+/**
+ * @brief Add a ring
+ *
+ * @param ring sample ring of one bus, the merger becomes its consumer
+ *
+ * @return bool false if the merger is full
+ */
+bool SampleMerger::addSource(SampleQueue* ring){
+    if(source_count >= MAX_SOURCES || !ring){
+        return false;
+    }
+    sources[source_count++] = ring;
+    return true;
+}
+
+/**
+ * @brief Next sample
+ *
+ * Peeks the head of every ring and takes the oldest one. With a
+ * single ring this is a plain pop.
+ *
+ * @param sample destination
+ * @param now_us current hal::Clock::nowUs, ages the samples kept back
+ *
+ * @return bool true if a sample was taken
+ */
+bool SampleMerger::pop(TempSample& sample, uint64_t now_us){
+    held_back = false;
+    int8_t oldest = -1;
+    bool anyEmpty = false;
+    TempSample head;
+    for(uint8_t i = 0; i < source_count; i++){
+        if(!sources[i]->peek(head)){
+            anyEmpty = true;
+        } else if(oldest < 0 || head.timestamp_us < sample.timestamp_us){
+            oldest = (int8_t)i;
+            sample = head;
+        }
+    }
+    if(oldest < 0){
+        return false;
+    }
+    if(anyEmpty && source_count > 1 && now_us < sample.timestamp_us + HOLD_US){
+        held_back = true;
+        stat.held++;
+        return false;
+    }
+
+    sources[oldest]->pop(sample);
+    if(sample.timestamp_us < last_us){
+        stat.late++;
+    }
+    last_us = sample.timestamp_us;
+    stat.merged++;
+    stat.per_source[oldest]++;
+    return true;
+}
+
+bool SampleMerger::holding() const{
+    return held_back;
+}
+
+uint32_t SampleMerger::dropped() const{
+    uint32_t drops = 0;
+    for(uint8_t i = 0; i < source_count; i++){
+        drops += sources[i]->dropped();
+    }
+    return drops;
+}
+
+const SampleMerger::Stats& SampleMerger::stats() const{
+    return stat;
+}
@@ -0,0 +1,411 @@
+#include "../inc/SamplingScheduler.hpp"
+#include <cstdint>
+#include <cstdio>
+
+using namespace tcn75a;
+
+/**
+ * @brief SamplingScheduler Constructor
+ *
+ * Constructor initializes the scheduler in MaxRate mode.
+ * The conversion time is read from the sensor on the first poll.
+ *
+ * @param sensor the sensor to sample
+ *
+ */
+SamplingScheduler::SamplingScheduler(TempSensor& sensor): sensor(sensor), policy(SamplePolicy::MaxRate),
+period_us(1000000), burst_size(1), burst_left(1), conversion_us(conversionTimeMs(Resolution::Bits9) * 1000),
+oneshot_wait_us(conversionTimeMaxMs(Resolution::Bits9) * 1000), resolution(Resolution::Bits9), next_due_us(0),
+burst_start_us(0), change_us(0), last_temp(), converting(false), chained(false), reading(false), sample_count(0),
+stale_count(0), failed_count(0), bus_txns(0), conversions(0), stats_start_us(0){
+}
+
+/**
+ * @brief Select the sampling policy
+ *
+ * Switching to OneShotBurst puts the sensor in shutdown, switching
+ * away from it wakes the sensor back up in continuous mode.
+ *
+ * @param newPolicy the policy to use
+ * @param period_ms FixedRate period, or time between OneShotBurst bursts
+ * @param burst number of samples per burst in OneShotBurst
+ *
+ * @return void
+ */
+void SamplingScheduler::setPolicy(SamplePolicy newPolicy, uint32_t period_ms, uint8_t burst){
+    //let a read in flight land before changing the sensor mode,
+    //the watchdog fails it if the bus is stuck
+    while(reading && !sensor.Temp_Ready()){
+        sensor.getEngine().watchdog();
+        hal::Cpu::idle();
+    }
+    reading = false;
+    converting = false;
+    chained = false;
+
+    if(newPolicy == SamplePolicy::OneShotBurst && policy != SamplePolicy::OneShotBurst){
+        //one write, after it only the triggers and the reads go on the bus
+        sensor.applyConfig(ConfigEdit().set(Shutdown::Enable).set(OneShot::Disable));
+    } else if(newPolicy != SamplePolicy::OneShotBurst && policy == SamplePolicy::OneShotBurst){
+        sensor.applyConfig(ConfigEdit().set(Shutdown::Disable).set(OneShot::Disable));
+    }
+
+    policy = newPolicy;
+    period_us = period_ms * 1000;
+    burst_size = burst ? burst : 1;
+    burst_left = burst_size;
+    refreshResolution();
+
+    uint64_t now = hal::Clock::nowUs();
+    next_due_us = now;
+    burst_start_us = now;
+    resetStats();
+}
+
+/**
+ * @brief Current policy
+ *
+ * @return SamplePolicy the policy in use
+ */
+SamplePolicy SamplingScheduler::getPolicy() const{
+    return policy;
+}
+
+/**
+ * @brief Reload the conversion time
+ *
+ * Reads the resolution from the config register. The read comes
+ * from the shadow copy, so this costs no bus transaction and is done
+ * before every scheduling decision to follow menu changes.
+ *
+ * @return void
+ */
+void SamplingScheduler::refreshResolution(){
+    resolution = get<Resolution>(sensor.readConfigRegister());
+    conversion_us = conversionTimeMs(resolution) * 1000u;
+    oneshot_wait_us = conversionTimeMaxMs(resolution) * 1000u;
+}
+
+/**
+ * @brief Compute the next read
+ *
+ * @param from_us time of the read that just completed
+ *
+ * @return void
+ */
+void SamplingScheduler::schedule(uint64_t from_us){
+    refreshResolution();
+    switch(policy){
+        case SamplePolicy::MaxRate:
+            //a new conversion is ready at the latest one worst case
+            //conversion time later, the typical time may be too soon
+            next_due_us = from_us + oneshot_wait_us;
+            break;
+        case SamplePolicy::FixedRate:{
+            //stay on the period grid, never faster than a conversion
+            uint32_t period = period_us > conversion_us ? period_us : conversion_us;
+            next_due_us += period;
+            if(next_due_us < from_us){
+                next_due_us = from_us + period;
+            }
+            break;
+        }
+        case SamplePolicy::OneShotBurst:
+            if(burst_left > 1){
+                burst_left--;
+                //the next conversion was queued behind the read and started with it
+                next_due_us = converting ? from_us + oneshot_wait_us : from_us;
+            } else {
+                burst_left = burst_size;
+                burst_start_us += period_us;
+                if(burst_start_us < from_us){
+                    burst_start_us = from_us;
+                }
+                next_due_us = burst_start_us;
+            }
+            break;
+    }
+}
+
+/**
+ * @brief Start a read
+ *
+ * @return void
+ */
+void SamplingScheduler::startRead(){
+    if(sensor.Raw_Temp_Read_Async()){
+        reading = true;
+        bus_txns++;
+    }
+}
+
+/**
+ * @brief Start a one-shot conversion
+ *
+ * @return bool true if the trigger was queued
+ */
+bool SamplingScheduler::startConversion(){
+    if(!sensor.triggerOneShot_Async()){
+        return false;
+    }
+    bus_txns++;
+    conversions++;
+    return true;
+}
+
+/**
+ * @brief Finish a read
+ *
+ * A failed read is counted apart and is not a sample. The sensor
+ * has no conversion counter, a new value is the only sign that a
+ * conversion completed. The next one completes at the latest one
+ * worst case conversion time after that: a read before then that
+ * returns the same temperature may be the same conversion read
+ * again, it is counted stale. Later reads are past a conversion
+ * boundary whatever they return.
+ *
+ * @param now_us current time
+ *
+ * @return bool true if the read returned a sample
+ */
+bool SamplingScheduler::finishRead(uint64_t now_us){
+    bool ok = sensor.Temp_Ok();
+    if(ok){
+        TempQ8 temp = sensor.last_Temp();
+        if(!sample_count || temp != last_temp){
+            change_us = now_us;
+        } else if(policy != SamplePolicy::OneShotBurst && now_us - change_us < oneshot_wait_us){
+            stale_count++;
+        }
+        sample_count++;
+        last_temp = temp;
+    } else {
+        failed_count++;
+    }
+    converting = chained;
+    chained = false;
+    schedule(now_us);
+    return ok;
+}
+
+/**
+ * @brief Poll the scheduler
+ *
+ * Non-blocking: starts the async read when it is due, and
+ * picks up its result on a later call. In OneShotBurst the due time
+ * first triggers the conversion and the read follows once the
+ * worst case conversion time has passed. Inside a burst the next
+ * trigger is queued right behind the read, so each sample costs
+ * two bus transactions and a single wake-up.
+ *
+ * @param now_us current hal::Clock::nowUs
+ *
+ * @return bool true when a new sample was completed by this call
+ */
+bool SamplingScheduler::poll(uint64_t now_us){
+    if(reading){
+        if(!sensor.Temp_Ready()){
+            return false;
+        }
+        reading = false;
+        return finishRead(now_us);
+    }
+    if(now_us < next_due_us){
+        return false;
+    }
+    if(policy == SamplePolicy::OneShotBurst && !converting){
+        if(startConversion()){
+            converting = true;
+            next_due_us = now_us + oneshot_wait_us;
+        }
+        return false;
+    }
+    startRead();
+    if(reading && policy == SamplePolicy::OneShotBurst && burst_left > 1){
+        chained = startConversion();
+    }
+    return false;
+}
+
+/**
+ * @brief Poll until a deadline
+ *
+ * Replaces the fixed sleeps of the menus: samples keep being taken
+ * at the scheduled times while waiting.
+ *
+ * @param deadline_us hal::Clock::nowUs to return at
+ *
+ * @return bool true if at least one sample arrived
+ */
+bool SamplingScheduler::runUntil(uint64_t deadline_us){
+    bool got = false;
+    uint64_t now;
+    while((now = hal::Clock::nowUs()) < deadline_us){
+        got = poll(now) || got;
+    }
+    return got;
+}
+
+/**
+ * @brief Wait for the next sample
+ *
+ * Polls until the next scheduled read completes, so the caller
+ * gets a fresh conversion instead of sleeping a fixed time.
+ *
+ * @param timeout_ms maximum time to wait
+ *
+ * @return bool true if a sample arrived before the timeout
+ */
+bool SamplingScheduler::waitForSample(uint32_t timeout_ms){
+    uint64_t deadline = hal::Clock::nowUs() + timeout_ms * 1000ull;
+    uint64_t now;
+    while((now = hal::Clock::nowUs()) < deadline){
+        if(poll(now)){
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Next scheduled read
+ *
+ * @return uint64_t hal::Clock::nowUs of the next read or one-shot trigger
+ */
+uint64_t SamplingScheduler::nextDueUs() const{
+    return next_due_us;
+}
+
+/**
+ * @brief Read in flight
+ *
+ * @return bool true between the start of an async read and the poll that takes the result
+ */
+bool SamplingScheduler::readPending() const{
+    return reading;
+}
+
+/**
+ * @brief Read completed
+ *
+ * Event source of the main loop: the I2C interrupt finished the read.
+ *
+ * @return bool true if the next poll() takes a sample
+ */
+bool SamplingScheduler::readDone(){
+    return reading && sensor.Temp_Ready();
+}
+
+/**
+ * @brief Samples taken
+ *
+ * @return uint32_t reads that returned a temperature since the last reset
+ */
+uint32_t SamplingScheduler::samples() const{
+    return sample_count;
+}
+
+/**
+ * @brief Stale samples
+ *
+ * @return uint32_t readings that could only repeat the previous conversion
+ */
+uint32_t SamplingScheduler::staleSamples() const{
+    return stale_count;
+}
+
+/**
+ * @brief Failed reads
+ *
+ * @return uint32_t async reads the bus failed since the last reset
+ */
+uint32_t SamplingScheduler::failedReads() const{
+    return failed_count;
+}
+
+/**
+ * @brief Achieved sample rate
+ *
+ * @param now_us current hal::Clock::nowUs
+ *
+ * @return uint32_t samples per second times 100
+ */
+uint32_t SamplingScheduler::samplesPerSecondX100(uint64_t now_us) const{
+    uint64_t elapsed = now_us - stats_start_us;
+    if(elapsed == 0){
+        return 0;
+    }
+    return (uint32_t)((uint64_t)sample_count * 100000000ull / elapsed);
+}
+
+/**
+ * @brief Bus transactions
+ *
+ * @return uint32_t one-shot triggers and temperature reads since the last reset
+ */
+uint32_t SamplingScheduler::busTransactions() const{
+    return bus_txns;
+}
+
+/**
+ * @brief Estimated sensor on-time
+ *
+ * In continuous modes the sensor converts all the time. In
+ * OneShotBurst it is only on for the typical conversion time of
+ * each triggered one-shot.
+ *
+ * @param now_us current hal::Clock::nowUs
+ *
+ * @return uint64_t microseconds the sensor spent converting since the last reset
+ */
+uint64_t SamplingScheduler::sensorOnUs(uint64_t now_us) const{
+    if(policy == SamplePolicy::OneShotBurst){
+        return (uint64_t)conversions * conversion_us;
+    }
+    return now_us - stats_start_us;
+}
+
+/**
+ * @brief Reset the statistics
+ *
+ * @return void
+ */
+void SamplingScheduler::resetStats(){
+    sample_count = 0;
+    stale_count = 0;
+    failed_count = 0;
+    bus_txns = 0;
+    conversions = 0;
+    stats_start_us = hal::Clock::nowUs();
+}
+
+/**
+ * @brief Print the statistics
+ *
+ * Shows the policy, the conversion time of the current
+ * resolution, the achieved rate, the share of stale readings and
+ * the failed reads, then the bus transactions and sensor on-time per sample.
+ *
+ * @return void
+ */
+void SamplingScheduler::printStats(){
+    const char* names[3] = {"fixed rate", "max rate", "one-shot burst"};
+    uint64_t now = hal::Clock::nowUs();
+    uint32_t rate = samplesPerSecondX100(now);
+    uint32_t stalePct = sample_count ? (stale_count * 100u / sample_count) : 0;
+    printf("Sampling: %s, %d bit (%lu ms/conversion)\n", names[(int)policy], 9 + (int)resolution,
+           (unsigned long)(conversion_us / 1000));
+    printf("%lu.%02lu samples/s, %lu of %lu stale (%lu%%), %lu failed reads\n", (unsigned long)(rate / 100),
+           (unsigned long)(rate % 100), (unsigned long)stale_count, (unsigned long)sample_count, (unsigned long)stalePct,
+           (unsigned long)failed_count);
+    if(sample_count){
+        uint64_t elapsed = now - stats_start_us;
+        uint64_t on = sensorOnUs(now);
+        uint32_t txnX100 = bus_txns * 100u / sample_count;
+        uint32_t onUs = (uint32_t)(on / sample_count);
+        uint32_t dutyX100 = elapsed ? (uint32_t)(on * 10000ull / elapsed) : 0;
+        printf("%lu.%02lu bus transactions/sample, sensor on %lu.%lu ms/sample (%lu.%02lu%% duty)\n",
+               (unsigned long)(txnX100 / 100), (unsigned long)(txnX100 % 100), (unsigned long)(onUs / 1000),
+               (unsigned long)(onUs % 1000 / 100), (unsigned long)(dutyX100 / 100), (unsigned long)(dutyX100 % 100));
+    }
+}
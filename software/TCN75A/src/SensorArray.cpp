@@ -0,0 +1,342 @@
+#include "../inc/SensorArray.hpp"
+#include "../inc/FixedTemp.hpp"
+#include "../inc/TempDecoder.hpp"
+#include "../inc/Probe.hpp"
+#include <cstdint>
+#include <cstdio>
+
+using namespace tcn75a;
+
+/**
+ * @brief SensorArray Constructor
+ *
+ * Constructor initializes the sensor array, no bus access is done
+ * until discover is called.
+ *
+ * @param engine the transaction engine of the bus the sensors are on
+ *
+ */
+SensorArray::SensorArray(I2CEngine& engine): engine(engine), nodes(), nodeCount(0), nextNode(0),
+start_us(0), excluded(0), sample_sink(nullptr){
+}
+
+/**
+ * @brief Submit and wait
+ *
+ * @param txn prepared transaction
+ *
+ * @return int the number of bytes transferred or PICO_ERROR_GENERIC
+ */
+int SensorArray::transfer(I2CTransaction& txn){
+    if(!engine.submit(txn)){
+        return PICO_ERROR_GENERIC;
+    }
+    return engine.wait(txn);
+}
+
+/**
+ * @brief Discover the sensors
+ *
+ * Reads the config register of every TCN75A address. Each one that
+ * answers gets a node holding its config, so the poll rate can follow
+ * its resolution. Addresses the cached scan already saw missing are
+ * skipped instead of waiting for their NACK again.
+ *
+ * @param scan result of a previous bus scan, nullptr to probe everything
+ *
+ * @return uint8_t the number of sensors found
+ */
+uint8_t SensorArray::discover(const BusScanner* scan){
+    //wait for reads queued with the previous node list
+    engine.drain();
+    nodeCount = 0;
+    nextNode = 0;
+    start_us = hal::Clock::nowUs();
+
+    for(uint8_t addr = FIRST_ADDR; addr <= LAST_ADDR; addr++){
+        if(addr == excluded){
+            continue;
+        }
+        if(scan && scan->generation() && scan->probed(addr) && !scan->found(addr)){
+            continue;
+        }
+        SensorNode& n = nodes[nodeCount];
+        uint8_t config = 0;
+        I2CEngine::prepareRead(n.txn, addr, CONFIG_REG, &config, 1);
+        if(transfer(n.txn) != 1){
+            continue;
+        }
+        n.addr = addr;
+        n.present = true;
+        n.config = config;
+        n.raw = 0;
+        n.last_us = 0;
+        n.next_due_us = start_us;
+        n.samples = 0;
+        n.errors = 0;
+        n.in_flight = false;
+        nodeCount++;
+    }
+    return nodeCount;
+}
+
+/**
+ * @brief Leave a sensor to another driver
+ *
+ * The sensor shown by the menus is read by its own SamplingScheduler:
+ * polling it here as well would publish every conversion twice.
+ * Drops its node if it was already discovered and skips it in the
+ * next discoveries.
+ *
+ * @param addr address of that sensor, 0 to poll every address again on the next discovery
+ *
+ * @return void
+ */
+void SensorArray::exclude(uint8_t addr){
+    excluded = addr;
+    for(uint8_t i = 0; i < nodeCount; i++){
+        if(nodes[i].addr != addr){
+            continue;
+        }
+        //nodes move down, the reads queued with them must land first
+        engine.drain();
+        for(uint8_t j = i; j + 1 < nodeCount; j++){
+            nodes[j] = nodes[j + 1];
+        }
+        nodeCount--;
+        nextNode = 0;
+        return;
+    }
+}
+
+/**
+ * @brief Number of sensors
+ *
+ * @return uint8_t sensors found by the last discovery
+ */
+uint8_t SensorArray::count() const{
+    return nodeCount;
+}
+
+/**
+ * @brief Sensor node
+ *
+ * @param index node index, 0 to count()-1
+ *
+ * @return const SensorNode& the state kept for that sensor
+ */
+const SensorNode& SensorArray::node(uint8_t index) const{
+    return nodes[index < nodeCount ? index : 0];
+}
+
+/**
+ * @brief Configure one sensor
+ *
+ * The config register is known from discovery, so the change
+ * is a single write on the bus.
+ *
+ * @param index node index
+ * @param edit the field changes to apply
+ *
+ * @return bool true if the sensor acknowledged the new config
+ */
+bool SensorArray::configure(uint8_t index, const ConfigEdit& edit){
+    if(index >= nodeCount){
+        return false;
+    }
+    SensorNode& n = nodes[index];
+    while(n.in_flight){
+        hal::Cpu::idle();
+    }
+    if(edit.matches(n.config)){
+        return true;
+    }
+    uint8_t config = edit.apply(n.config);
+    I2CTransaction txn;
+    I2CEngine::prepareWrite(txn, n.addr, CONFIG_REG, &config, 1);
+    if(transfer(txn) != 2){
+        n.errors++;
+        return false;
+    }
+    n.config = config;
+    //a new resolution restarts the conversion
+    n.next_due_us = hal::Clock::nowUs() + conversionTimeMs(get<Resolution>(config)) * 1000ull;
+    return true;
+}
+
+/**
+ * @brief Configure every sensor
+ *
+ * @param edit the field changes to apply
+ *
+ * @return bool true if every sensor acknowledged the new config
+ */
+bool SensorArray::configureAll(const ConfigEdit& edit){
+    bool ok = true;
+    for(uint8_t i = 0; i < nodeCount; i++){
+        ok = configure(i, edit) && ok;
+    }
+    return ok;
+}
+
+/**
+ * @brief Follow a config written elsewhere
+ *
+ * TempSensor::applyConfig writes the config register without going
+ * through configure. The cached copy must follow it, or the readings
+ * are decoded with the old resolution mask and paced with its
+ * conversion time. No bus access.
+ *
+ * @param addr address of the sensor written to
+ * @param config the config register it now holds
+ *
+ * @return void
+ */
+void SensorArray::resync(uint8_t addr, uint8_t config){
+    for(uint8_t i = 0; i < nodeCount; i++){
+        SensorNode& n = nodes[i];
+        if(n.addr != addr || n.config == config){
+            continue;
+        }
+        n.config = config;
+        //a new resolution restarts the conversion
+        n.next_due_us = hal::Clock::nowUs() + conversionTimeMs(get<Resolution>(config)) * 1000ull;
+    }
+}
+
+/**
+ * @brief Poll the sensors
+ *
+ * Round-robin over the sensors starting after the one served first
+ * last time. A read is queued only when the sensor has finished a new
+ * conversion for its resolution, so the bus only carries fresh samples.
+ * Reads reuse the register pointer: after the first one the TCN75A
+ * still points at TEMP_REG and only the address and two data bytes
+ * go on the bus. Safe to call from a timer callback.
+ *
+ * @param now_us current hal::Clock::nowUs
+ *
+ * @return void
+ */
+void SensorArray::poll(uint64_t now_us){
+    PROBE_SCOPE(SensorPoll);
+    for(uint8_t i = 0; i < nodeCount; i++){
+        SensorNode& n = nodes[(nextNode + i) % nodeCount];
+        if(!n.present || n.in_flight || now_us < n.next_due_us){
+            continue;
+        }
+        I2CEngine::prepareRead(n.txn, n.addr, TEMP_REG, n.buf, 2, &onRead, this);
+        n.txn.reuse_pointer = true;
+        n.in_flight = true;
+        if(!engine.submit(n.txn)){
+            //engine queue full, try the rest on the next poll
+            n.in_flight = false;
+            break;
+        }
+    }
+    if(nodeCount){
+        nextNode = (nextNode + 1) % nodeCount;
+    }
+}
+
+/**
+ * @brief Read finished
+ *
+ * Completion callback of the reads queued by poll, runs in interrupt
+ * context. Schedules the next read one conversion time later and
+ * publishes the sample.
+ *
+ * @param txn the finished transaction
+ * @param context the SensorArray that queued the read
+ *
+ * @return void
+ */
+void SensorArray::onRead(I2CTransaction& txn, void* context){
+    SensorArray* self = static_cast<SensorArray*>(context);
+    for(uint8_t i = 0; i < self->nodeCount; i++){
+        SensorNode& n = self->nodes[i];
+        if(&n.txn != &txn){
+            continue;
+        }
+        uint64_t now = hal::Clock::nowUs();
+        if(txn.result == 2){
+            n.raw = (uint16_t)decoderFor(get<Resolution>(n.config)).q8((n.buf[0] << 8) | n.buf[1]);
+            n.last_us = now;
+            n.samples++;
+            n.next_due_us = now + conversionTimeMs(get<Resolution>(n.config)) * 1000ull;
+            if(self->sample_sink){
+                TempSample sample;
+                sample.timestamp_us = now;
+                sample.raw = n.raw;
+                sample.addr = n.addr;
+                self->sample_sink->push(sample);
+                hal::Cpu::signal(); //wake the consumer core
+            }
+        } else {
+            //back off one conversion before trying again
+            n.errors++;
+            n.next_due_us = now + conversionTimeMs(get<Resolution>(n.config)) * 1000ull;
+        }
+        n.in_flight = false;
+        return;
+    }
+}
+
+/**
+ * @brief Set the sample sink
+ *
+ * @param sink the ring to push every reading to, nullptr to disable
+ *
+ * @return void
+ */
+void SensorArray::setSampleSink(SampleQueue* sink){
+    sample_sink = sink;
+}
+
+/**
+ * @brief Total samples
+ *
+ * @return uint32_t readings taken by all sensors since discovery
+ */
+uint32_t SensorArray::totalSamples() const{
+    uint32_t total = 0;
+    for(uint8_t i = 0; i < nodeCount; i++){
+        total += nodes[i].samples;
+    }
+    return total;
+}
+
+/**
+ * @brief Aggregate sample rate
+ *
+ * @param now_us current hal::Clock::nowUs
+ *
+ * @return uint32_t samples per second over all sensors since discovery
+ */
+uint32_t SensorArray::samplesPerSecond(uint64_t now_us) const{
+    uint64_t elapsed = now_us - start_us;
+    if(elapsed == 0){
+        return 0;
+    }
+    return (uint32_t)((uint64_t)totalSamples() * 1000000ull / elapsed);
+}
+
+/**
+ * @brief Print the sensor table
+ *
+ * Shows the address, resolution, last temperature and
+ * counters of every sensor, then the aggregate rate.
+ *
+ * @return void
+ */
+void SensorArray::printStatus(){
+    char text[16];
+    printf("Addr | Res | Temp C     | Samples | Errors\n");
+    for(uint8_t i = 0; i < nodeCount; i++){
+        const SensorNode& n = nodes[i];
+        TempQ8::fromRaw(n.raw).format(text, sizeof(text));
+        printf("0x%02X | %2d  | %-10s | %7lu | %6lu\n", n.addr, 9 + (int)get<Resolution>(n.config), text,
+               (unsigned long)n.samples, (unsigned long)n.errors);
+    }
+    printf("%d sensor(s), %lu samples/s\n", nodeCount, (unsigned long)samplesPerSecond(hal::Clock::nowUs()));
+}
@@ -0,0 +1,365 @@
+#include "../inc/SimTCN75A.hpp"
+#include "../inc/Hal.hpp"
+#include "../inc/ConfigRegister.hpp"
+#include <cstdint>
+
+using namespace tcn75a;
+
+/**
+ * @brief SimTCN75A Constructor
+ *
+ * Constructor puts the sensor in its power-up state: config 0x00,
+ * THYST 75C, TSET 80C, continuous conversions at 9 bit and the
+ * ALERT output inactive (active low, so the pin is high).
+ *
+ * @param addr the I2C address, 0x48 to 0x4F
+ * @param alertPin the gpio the ALERT output drives, NO_PIN if not wired
+ *
+ */
+SimTCN75A::SimTCN75A(uint8_t addr, int8_t alertPin): ADDR(addr), ALERT_PIN(alertPin), responding(true),
+ambient_milli(25000), worst_case(false), nacks_left(0), stretch_us(0), sda_clocks(0), pointer(TEMP_REG), config(0), temp(0), thyst(0x4B00), tset(0x5000), conv_start_us(0),
+converting(false), faults(0), above(false), alert(false), stat(){
+    setAlert(false);
+    conv_start_us = hal::Clock::nowUs();
+    converting = true;
+}
+
+/**
+ * @brief Sensor address
+ *
+ * @return uint8_t the I2C address
+ */
+uint8_t SimTCN75A::address() const{
+    return ADDR;
+}
+
+/**
+ * @brief Set the ambient temperature
+ *
+ * Only seen by the register once a conversion completes.
+ *
+ * @param milli_c temperature in thousandths of a degree Celsius
+ *
+ * @return void
+ */
+void SimTCN75A::setTemperature(int32_t milli_c){
+    ambient_milli = milli_c;
+}
+
+/**
+ * @brief Acknowledge or not
+ *
+ * @param ack false to NACK every transfer, like a disconnected sensor
+ *
+ * @return void
+ */
+void SimTCN75A::setResponding(bool ack){
+    responding = ack;
+}
+
+/**
+ * @brief Conversion timing
+ *
+ * A real part may take up to the maximum conversion time of the
+ * datasheet, a reader paced on the typical time then sees the same
+ * conversion more than once.
+ *
+ * @param slow true for the maximum conversion time, false for the typical one
+ *
+ * @return void
+ */
+void SimTCN75A::setWorstCaseTiming(bool slow){
+    update();
+    worst_case = slow;
+}
+
+/**
+ * @brief Inject NACKs
+ *
+ * @param count number of transfers to refuse before answering again
+ *
+ * @return void
+ */
+void SimTCN75A::injectNacks(uint8_t count){
+    nacks_left = count;
+}
+
+/**
+ * @brief Clock stretching
+ *
+ * @param us time SCL is held low in every transfer, 0 for none
+ *
+ * @return void
+ */
+void SimTCN75A::setStretchUs(uint32_t us){
+    stretch_us = us;
+}
+
+uint32_t SimTCN75A::stretchUs() const{
+    return stretch_us;
+}
+
+/**
+ * @brief Hold SDA low
+ *
+ * Like a sensor left in the middle of a read byte by a controller
+ * reset: it keeps SDA low until enough SCL pulses shift the byte out.
+ *
+ * @param clocks SCL pulses before SDA is released, HOLD_FOREVER for a dead sensor
+ *
+ * @return void
+ */
+void SimTCN75A::holdSda(uint8_t clocks){
+    sda_clocks = clocks;
+}
+
+bool SimTCN75A::sdaHeld() const{
+    return sda_clocks != 0;
+}
+
+void SimTCN75A::clockScl(){
+    if(sda_clocks != 0 && sda_clocks != HOLD_FOREVER){
+        sda_clocks--;
+    }
+}
+
+/**
+ * @brief Conversion time
+ *
+ * @return uint32_t typical or worst case conversion time of the current resolution in us
+ */
+uint32_t SimTCN75A::conversionUs() const{
+    Resolution res = get<Resolution>(config);
+    return (worst_case ? conversionTimeMaxMs(res) : conversionTimeMs(res)) * 1000u;
+}
+
+/**
+ * @brief Run the conversions
+ *
+ * In continuous mode one conversion completes every conversion
+ * time. A one-shot completes once, then ONE-SHOT clears and the
+ * sensor stays in shutdown. After a long idle time only the last
+ * few conversions are evaluated, they all see the same ambient.
+ *
+ * @return void
+ */
+void SimTCN75A::update(){
+    uint64_t now = hal::Clock::nowUs();
+    uint32_t conv = conversionUs();
+    uint8_t evaluated = 0;
+
+    while(converting && now - conv_start_us >= conv){
+        conv_start_us += conv;
+        stat.conversions++;
+        stat.on_us += conv;
+        if(evaluated < 8){
+            convert();
+            evaluated++;
+        }
+        if(get<Shutdown>(config) == Shutdown::Enable){
+            converting = false;
+            config &= (uint8_t)~OneShotField::mask; //ONE-SHOT clears itself
+        }
+    }
+}
+
+/**
+ * @brief Latch a conversion
+ *
+ * Quantizes the ambient to the resolution and runs the fault
+ * queue: the alert only changes after 1, 2, 4 or 6 conversions
+ * in a row past the limit.
+ *
+ * @return void
+ */
+void SimTCN75A::convert(){
+    static const uint8_t faultCount[4] = {1, 2, 4, 6};
+
+    int32_t milli = ambient_milli;
+    if(milli > 125000){
+        milli = 125000;
+    } else if(milli < -55000){
+        milli = -55000;
+    }
+    //floor to Q8.8, then clear the bits below the resolution
+    int32_t q8 = (milli * 256 - (milli < 0 ? 999 : 0)) / 1000;
+    uint16_t mask = (uint16_t)(0xFFFFu << (7 - (uint8_t)get<Resolution>(config)));
+    temp = (uint16_t)q8 & mask;
+
+    int16_t t = (int16_t)temp;
+    bool interruptMode = get<AlertMode>(config) == AlertMode::Interrupt;
+    bool state = interruptMode ? above : alert;
+    bool crossing = state ? (t < (int16_t)thyst) : (t >= (int16_t)tset);
+
+    faults = crossing ? faults + 1 : 0;
+    if(faults < faultCount[(uint8_t)get<FaultQueue>(config)]){
+        return;
+    }
+    faults = 0;
+    if(interruptMode){
+        //each crossing pulses the output until a register is read
+        above = !above;
+        setAlert(true);
+    } else {
+        setAlert(!alert);
+    }
+}
+
+/**
+ * @brief Drive the ALERT output
+ *
+ * @param active new alert state, the pin level follows the polarity
+ *
+ * @return void
+ */
+void SimTCN75A::setAlert(bool active){
+    alert = active;
+    if(ALERT_PIN != NO_PIN){
+        bool activeHigh = get<Polarity>(config) == Polarity::ActiveHigh;
+        hal::HostGpio::drive((uint8_t)ALERT_PIN, activeHigh ? active : !active);
+    }
+}
+
+/**
+ * @brief Bus write
+ *
+ * The first byte sets the register pointer, the next ones are
+ * the register data, MSB first. The limits keep 0.5C resolution
+ * and TEMP is read only.
+ *
+ * @param src bytes sent by the controller
+ * @param len number of bytes
+ *
+ * @return bool true if acknowledged
+ */
+bool SimTCN75A::write(const uint8_t *src, size_t len){
+    if(!responding){
+        return false;
+    }
+    if(nacks_left){
+        nacks_left--;
+        return false;
+    }
+    update();
+    if(len == 0){
+        return true;
+    }
+    pointer = src[0] & 0x03;
+    stat.pointer_writes++;
+    if(len == 1){
+        return true;
+    }
+
+    stat.writes[pointer]++;
+    if(pointer == CONFIG_REG){
+        uint8_t old = config;
+        config = src[1];
+        bool shutdown = get<Shutdown>(config) == Shutdown::Enable;
+        if(!shutdown && get<Shutdown>(old) == Shutdown::Enable && !converting){
+            converting = true; //back to continuous conversions
+            conv_start_us = hal::Clock::nowUs();
+        } else if(shutdown && get<OneShot>(config) == OneShot::Enable && !converting){
+            converting = true; //one-shot from shutdown
+            conv_start_us = hal::Clock::nowUs();
+        } else if(shutdown && get<OneShot>(config) == OneShot::Disable){
+            converting = false; //conversion in progress is dropped
+        }
+        if(get<Polarity>(old) != get<Polarity>(config)){
+            setAlert(alert);
+        }
+    } else if(pointer != TEMP_REG && len >= 3){
+        uint16_t value = (uint16_t)((src[1] << 8) | src[2]) & 0xFF80;
+        if(pointer == HYST_TEMP_REG){
+            thyst = value;
+        } else {
+            tset = value;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Bus read
+ *
+ * Returns the register the pointer selects. In interrupt mode any
+ * register read clears the ALERT output.
+ *
+ * @param dst receiving buffer
+ * @param len number of bytes
+ *
+ * @return bool true if acknowledged
+ */
+bool SimTCN75A::read(uint8_t *dst, size_t len){
+    if(!responding){
+        return false;
+    }
+    if(nacks_left){
+        nacks_left--;
+        return false;
+    }
+    update();
+    stat.reads[pointer]++;
+    uint16_t value = reg(pointer);
+    for(size_t i = 0; i < len; i++){
+        if(pointer == CONFIG_REG){
+            dst[i] = (uint8_t)value;
+        } else {
+            dst[i] = (i % 2 == 0) ? (uint8_t)(value >> 8) : (uint8_t)value;
+        }
+    }
+    if(get<AlertMode>(config) == AlertMode::Interrupt && alert){
+        setAlert(false);
+    }
+    return true;
+}
+
+/**
+ * @brief Register content
+ *
+ * Runs the conversions due first, so the content is the one a bus
+ * read would see now.
+ *
+ * @param ptr register pointer
+ *
+ * @return uint16_t the register, CONFIG in the low byte
+ */
+uint16_t SimTCN75A::reg(uint8_t ptr){
+    update();
+    switch(ptr & 0x03){
+        case TEMP_REG:
+            return temp;
+        case CONFIG_REG:
+            return config;
+        case HYST_TEMP_REG:
+            return thyst;
+        default:
+            return tset;
+    }
+}
+
+/**
+ * @brief Alert state
+ *
+ * @return bool true while the ALERT output is active
+ */
+bool SimTCN75A::alertActive() const{
+    return alert;
+}
+
+/**
+ * @brief Access counters
+ *
+ * @return const Stats& register accesses and conversions since the last reset
+ */
+const SimTCN75A::Stats& SimTCN75A::stats() const{
+    return stat;
+}
+
+/**
+ * @brief Reset the access counters
+ *
+ * @return void
+ */
+void SimTCN75A::resetStats(){
+    stat = Stats();
+}
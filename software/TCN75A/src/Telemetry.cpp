@@ -0,0 +1,236 @@
+#include "../inc/Telemetry.hpp"
+#include "../inc/Hal.hpp"
+#include <cstdint>
+
+namespace telemetry{
+
+//CRC table, generated at compile time
+struct CrcTable{
+    uint16_t entry[256];
+    constexpr CrcTable(): entry(){
+        for(int i = 0; i < 256; i++){
+            uint16_t crc = (uint16_t)(i << 8);
+            for(int bit = 0; bit < 8; bit++){
+                crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+            }
+            entry[i] = crc;
+        }
+    }
+};
+
+static constexpr CrcTable table;
+
+/**
+ * @brief CRC-16/CCITT-FALSE
+ *
+ * One table lookup per byte. Chain calls by passing the
+ * previous result as crc.
+ *
+ * @param data bytes to check
+ * @param len number of bytes
+ * @param crc running value, 0xFFFF to start
+ *
+ * @return uint16_t the CRC
+ */
+uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc){
+    for(size_t i = 0; i < len; i++){
+        crc = (uint16_t)((crc << 8) ^ table.entry[((crc >> 8) ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+}
+
+using namespace telemetry;
+
+static void put16(uint8_t *p, uint16_t v){
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v){
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+/**
+ * @brief TelemetryStream Constructor
+ *
+ * Constructor initializes an empty batch, streaming is off.
+ *
+ * @param writer sends the raw frame bytes (no text translation)
+ *
+ */
+TelemetryStream::TelemetryStream(Writer writer): writer(writer), streaming(false), max_latency_us(100000),
+frame(), count(0), base_us(0), next_seq(0), stat(){
+}
+
+/**
+ * @brief Start or stop streaming
+ *
+ * Called from the menu on core 0, the samples are pushed on core 1.
+ * The consumer core is woken so it sends the last partial batch.
+ *
+ * @param enable true to stream
+ *
+ * @return void
+ */
+void TelemetryStream::setEnabled(bool enable){
+    streaming.store(enable, std::memory_order_release);
+    hal::Cpu::signal();
+}
+
+bool TelemetryStream::enabled() const{
+    return streaming.load(std::memory_order_acquire);
+}
+
+void TelemetryStream::setMaxLatency(uint32_t ms){
+    max_latency_us = ms * 1000u;
+}
+
+/**
+ * @brief Add a sample
+ *
+ * The record is written straight into the frame. The frame is
+ * sent when it is full, or first if the sample is too far in time
+ * from the first record to be stored as an offset.
+ *
+ * @param sample the reading to send
+ *
+ * @return bool true if a frame was sent
+ */
+bool TelemetryStream::push(const TempSample& sample){
+    uint32_t start = hal::Clock::nowUs32();
+    bool sent = false;
+
+    int64_t dt = (int64_t)(sample.timestamp_us - base_us);
+    if(count && (dt > INT32_MAX || dt < INT32_MIN)){
+        flush();
+        sent = true;
+    }
+    if(count == 0){
+        base_us = sample.timestamp_us;
+        dt = 0;
+        put32(&frame[4], next_seq);
+        put32(&frame[8], (uint32_t)base_us);
+        put32(&frame[12], (uint32_t)(base_us >> 32));
+    }
+
+    uint8_t *rec = &frame[HEADER_SIZE + count * RECORD_SIZE];
+    put32(rec, (uint32_t)(int32_t)dt);
+    rec[4] = sample.addr;
+    put16(rec + 5, sample.raw);
+    count++;
+    next_seq++;
+
+    if(count == MAX_BATCH){
+        flush();
+        sent = true;
+    }
+    stat.cpu_us += hal::Clock::nowUs32() - start;
+    return sent;
+}
+
+/**
+ * @brief Send a partial batch when it gets old
+ *
+ * Bounds the latency when samples come slowly.
+ *
+ * @param now_us current hal::Clock::nowUs
+ *
+ * @return bool true if a frame was sent
+ */
+bool TelemetryStream::flushDue(uint64_t now_us){
+    if(count == 0 || now_us - base_us < max_latency_us){
+        return false;
+    }
+    flush();
+    return true;
+}
+
+/**
+ * @brief Send the batch
+ *
+ * Completes the header, appends the CRC and writes the frame
+ * in one call.
+ *
+ * @return void
+ */
+void TelemetryStream::flush(){
+    if(count == 0){
+        return;
+    }
+    frame[0] = SYNC0;
+    frame[1] = SYNC1;
+    frame[2] = VERSION;
+    frame[3] = count;
+    size_t len = frameSize(count);
+    put16(&frame[len - CRC_SIZE], crc16(&frame[2], len - CRC_SIZE - 2));
+    writer(frame, len);
+
+    stat.frames++;
+    stat.samples += count;
+    stat.bytes += len;
+    count = 0;
+}
+
+/**
+ * @brief Send a statistics frame
+ *
+ * The pending samples go first so the frames stay in time order.
+ * The frame is built in the sample buffer, which is empty by then.
+ *
+ * @param summaries statistics of each sensor
+ * @param count number of sensors, at most MAX_SUMMARY are sent
+ * @param now_us time of the summary
+ *
+ * @return void
+ */
+void TelemetryStream::sendSummary(const StatsSummary *summaries, uint8_t count, uint64_t now_us){
+    uint32_t start = hal::Clock::nowUs32();
+    flush();
+    if(count == 0){
+        return;
+    }
+    if(count > MAX_SUMMARY){
+        count = MAX_SUMMARY;
+    }
+
+    frame[0] = SYNC0;
+    frame[1] = SYNC1;
+    frame[2] = SUMMARY_VERSION;
+    frame[3] = count;
+    put32(&frame[4], next_seq);
+    put32(&frame[8], (uint32_t)now_us);
+    put32(&frame[12], (uint32_t)(now_us >> 32));
+    for(uint8_t i = 0; i < count; i++){
+        const StatsSummary& s = summaries[i];
+        uint8_t *rec = &frame[HEADER_SIZE + i * SUMMARY_SIZE];
+        rec[0] = s.addr;
+        put32(rec + 1, s.samples);
+        rec[5] = s.window;
+        put16(rec + 6, (uint16_t)s.min);
+        put16(rec + 8, (uint16_t)s.max);
+        put16(rec + 10, (uint16_t)s.mean);
+        put16(rec + 12, s.stddev);
+        put16(rec + 14, (uint16_t)s.ewma);
+        put16(rec + 16, (uint16_t)s.total_mean);
+        put16(rec + 18, s.total_stddev);
+    }
+    size_t len = summaryFrameSize(count);
+    put16(&frame[len - CRC_SIZE], crc16(&frame[2], len - CRC_SIZE - 2));
+    writer(frame, len);
+
+    stat.summaries++;
+    stat.bytes += len;
+    stat.cpu_us += hal::Clock::nowUs32() - start;
+}
+
+/**
+ * @brief Stream statistics
+ *
+ * @return const Stats& frames, samples and bytes sent
+ */
+const TelemetryStream::Stats& TelemetryStream::stats() const{
+    return stat;
+}
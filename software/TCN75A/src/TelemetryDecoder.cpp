@@ -0,0 +1,189 @@
+#include "../inc/TelemetryDecoder.hpp"
+#include <cstdint>
+#include <cstring>
+
+using namespace telemetry;
+
+static uint16_t get16(const uint8_t *p){
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p){
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+//Size of the frame starting in buf, from its version and count
+static size_t frameLength(const uint8_t *buf){
+    return buf[2] == SUMMARY_VERSION ? summaryFrameSize(buf[3]) : frameSize(buf[3]);
+}
+
+/**
+ * @brief TelemetryDecoder Constructor
+ *
+ * @param handler called for every decoded sample, in order
+ * @param context passed back to the handler
+ *
+ */
+TelemetryDecoder::TelemetryDecoder(SampleHandler handler, void* context): handler(handler), context(context),
+summary_handler(nullptr), summary_context(nullptr), buf(), fill(0), have_seq(false), expected_seq(0), stat(){
+}
+
+/**
+ * @brief Feed stream bytes
+ *
+ * Collects the bytes of the current frame. The buffered prefix is
+ * checked after every byte so garbage is dropped as early as possible.
+ *
+ * @param data bytes read from the serial port
+ * @param len number of bytes
+ *
+ * @return size_t the number of samples decoded from these bytes
+ */
+size_t TelemetryDecoder::feed(const uint8_t *data, size_t len){
+    size_t decoded = 0;
+    for(size_t i = 0; i < len; i++){
+        buf[fill++] = data[i];
+        decoded += scan();
+    }
+    return decoded;
+}
+
+/**
+ * @brief Check the buffered bytes
+ *
+ * Drops bytes from the front until they could be the start of a
+ * frame, and decodes the frame once it is complete. A frame with a
+ * bad CRC only drops its first byte: a real frame may start inside it.
+ *
+ * @return size_t samples decoded
+ */
+size_t TelemetryDecoder::scan(){
+    size_t decoded = 0;
+    while(fill){
+        bool summary = fill > 2 && buf[2] == SUMMARY_VERSION;
+        bool bad = buf[0] != SYNC0 || (fill > 1 && buf[1] != SYNC1) || (fill > 2 && buf[2] != VERSION && !summary) ||
+                   (fill > 3 && (buf[3] == 0 || buf[3] > (summary ? MAX_SUMMARY : MAX_BATCH)));
+        if(!bad && (fill < HEADER_SIZE || fill < frameLength(buf))){
+            break; //plausible so far, wait for more bytes
+        }
+        if(!bad){
+            size_t len = frameLength(buf);
+            if(crc16(&buf[2], len - CRC_SIZE - 2) == get16(&buf[len - CRC_SIZE])){
+                if(summary){
+                    decodeSummary();
+                } else {
+                    decoded += decodeFrame();
+                }
+                drop(len);
+                continue;
+            }
+            stat.crc_errors++;
+        }
+        stat.skipped++;
+        drop(1);
+    }
+    return decoded;
+}
+
+/**
+ * @brief Hand out a checked frame
+ *
+ * @return size_t samples decoded
+ */
+size_t TelemetryDecoder::decodeFrame(){
+    uint8_t count = buf[3];
+    uint32_t seq = get32(&buf[4]);
+    uint64_t base = get32(&buf[8]) | ((uint64_t)get32(&buf[12]) << 32);
+    if(have_seq && seq != expected_seq){
+        stat.lost += seq - expected_seq;
+    }
+
+    for(uint8_t i = 0; i < count; i++){
+        const uint8_t *rec = &buf[HEADER_SIZE + i * RECORD_SIZE];
+        Sample s;
+        s.seq = seq + i;
+        s.timestamp_us = base + (int64_t)(int32_t)get32(rec);
+        s.addr = rec[4];
+        s.raw = get16(rec + 5);
+        handler(s, context);
+    }
+    have_seq = true;
+    expected_seq = seq + count;
+    stat.frames++;
+    stat.samples += count;
+    return count;
+}
+
+/**
+ * @brief Hand out a checked statistics frame
+ *
+ * Statistics frames carry no samples, the sample sequence is not checked.
+ *
+ * @return void
+ */
+void TelemetryDecoder::decodeSummary(){
+    uint8_t count = buf[3];
+    uint64_t timestamp = get32(&buf[8]) | ((uint64_t)get32(&buf[12]) << 32);
+    for(uint8_t i = 0; i < count; i++){
+        const uint8_t *rec = &buf[HEADER_SIZE + i * SUMMARY_SIZE];
+        StatsSummary s;
+        s.addr = rec[0];
+        s.samples = get32(rec + 1);
+        s.window = rec[5];
+        s.min = (int16_t)get16(rec + 6);
+        s.max = (int16_t)get16(rec + 8);
+        s.mean = (int16_t)get16(rec + 10);
+        s.stddev = get16(rec + 12);
+        s.ewma = (int16_t)get16(rec + 14);
+        s.total_mean = (int16_t)get16(rec + 16);
+        s.total_stddev = get16(rec + 18);
+        if(summary_handler){
+            summary_handler(s, timestamp, summary_context);
+        }
+        stat.summaries++;
+    }
+}
+
+/**
+ * @brief Remove bytes from the front of the buffer
+ *
+ * @param n number of bytes
+ *
+ * @return void
+ */
+void TelemetryDecoder::drop(size_t n){
+    fill -= n;
+    memmove(buf, &buf[n], fill);
+}
+
+/**
+ * @brief Drop the partial frame
+ *
+ * @return void
+ */
+void TelemetryDecoder::reset(){
+    fill = 0;
+    have_seq = false;
+}
+
+/**
+ * @brief Set the statistics frame handler
+ *
+ * @param handler called for every sensor of a statistics frame, nullptr to ignore them
+ * @param context passed back to the handler
+ *
+ * @return void
+ */
+void TelemetryDecoder::setSummaryHandler(SummaryHandler handler, void* context){
+    summary_handler = handler;
+    summary_context = context;
+}
+
+/**
+ * @brief Decoder statistics
+ *
+ * @return const Stats& frames, errors and lost samples
+ */
+const TelemetryDecoder::Stats& TelemetryDecoder::stats() const{
+    return stat;
+}
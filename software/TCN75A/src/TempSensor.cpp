@@ -1,57 +1,46 @@
 #include "../inc/TempSensor.hpp"
-#include "hardware/i2c.h"
+#include "../inc/AlertMonitor.hpp"
+#include "../inc/LimitCodec.hpp"
+#include "../inc/TempDecoder.hpp"
+#include "../inc/Probe.hpp"
+#include "../inc/SensorArray.hpp"
 #include <cstdint>
 #include <cstdio>
 #include <string>
 
 
 //4 different options for the Register pointers
-const uint8_t TEMP_REG = 0x00;
-const uint8_t CONFIG_REG = 0x01;
-const uint8_t HYST_TEMP_REG = 0x02;
-const uint8_t SET_TEMP_REG = 0x03;
-
-//Gpio pin used for the alert
-bool TempSensor::AlertState = false;
-int TempSensor::pulseCount = 0;
+using tcn75a::TEMP_REG;
+using tcn75a::CONFIG_REG;
+using tcn75a::HYST_TEMP_REG;
+using tcn75a::SET_TEMP_REG;
 
 
 /**
  * @brief TempSensor Constructor
  *
  * Constructor initializes TempSensor objects and variables.
+ * The bus belongs to the caller and must already be started, so
+ * several drivers and arrays can share it. stdio is set up by main.
  *
- * @param i2c the i2c instance to use since RPI Pico has i2c0 and i2c1
- * @param sda Serial Data Line gpio pin number
- * @param scl Serial Clock Line gpio pin number
- * @param freq baudrate of the I2C
+ * @param bus the I2C bus the sensor is on, RPI Pico has i2c0 and i2c1
  * @param redLED the gpio pin number of the red LED
  * @param greenLED the gpio pin number of the green LED
  * @param alert the gpio pin number of the alert
  *
  */
-TempSensor::TempSensor(i2c_inst_t *i2c, int sda, int scl, int freq,int redLED, int greenLED, int alert): 
-I2C_PIN(i2c), SDA_PIN(sda), SCL_PIN(scl), BAUD_RATE(freq), red_led(redLED), green_led(greenLED), Alert_pin(alert){
-    stdio_init_all();
-    proj_init();
+TempSensor::TempSensor(I2CBus& bus, int redLED, int greenLED, int alert): 
+Alert_pin(alert), i2c_bus(bus), I2C_PIN(bus.handle()), engine(bus.engine()), scanner(bus.scanner()), sensor_addr(tcn75a::FIRST_ADDR),
+shadow(), shadow_verify(false), temp_ready(false), temp_ok(false), verify_mask(0), verify_data(0),
+verify_shadow(0), verify_landed(false), sample_sink(nullptr), sensor_array(nullptr),
+alert_monitor(nullptr), sampler(nullptr), telemetry(nullptr), text_stream(nullptr), stats_bank(nullptr), sample_log(nullptr), rule_engine(nullptr), rule_leds(0), button_events(nullptr), event_loop(nullptr),
+red_led(redLED), green_led(greenLED), console(), menu_state(MenuState::Main), redraw_us(0){
+    oneshot_txn.done = true; //no trigger queued yet
+    temp_txn.done = true; //no read queued yet
+    verify_txn.done = true; //no read-back queued yet
     initialiseAlert();
-    sensor_addr = bus_scan();
-}
-
-/**
- * @brief Initialize I2C pins
- *
- * This function simply initializes the pins used
- * by the I2C by setting their function and adding pull up resistors.
- *
- * @return void.
- */
-void TempSensor::proj_init(){
-    i2c_init(I2C_PIN, BAUD_RATE);
-    gpio_set_function(SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(SCL_PIN, GPIO_FUNC_I2C);
-    gpio_pull_up(SDA_PIN);
-    gpio_pull_up(SCL_PIN);
+    //only the TCN75A window at boot, a full scan is on the main menu
+    sensor_addr = bus_scan(ScanMode::Targeted);
 }
 
 /**
@@ -59,15 +48,14 @@ void TempSensor::proj_init(){
  *
  * This function simply initializes the Alert pin
  * by choosing the direction, enabling the interrupt and adding pull up a resistor.
+ * Both edges interrupt so the monitor can time how long each alert lasts.
  *
  * @return void
  */
 void TempSensor::initialiseAlert(){
     //Initialize alert gpio: direction: input, pull up resistor used
-    gpio_init(Alert_pin);
-    gpio_set_dir(Alert_pin, GPIO_IN);
-    gpio_pull_up(Alert_pin);
-    gpio_set_irq_enabled(Alert_pin, GPIO_IRQ_EDGE_FALL, true);
+    hal::Gpio::input(Alert_pin, true);
+    hal::Gpio::enableIrq(Alert_pin, hal::Gpio::EDGE_FALL | hal::Gpio::EDGE_RISE);
 }
 
 /**
@@ -80,7 +68,7 @@ void TempSensor::initialiseAlert(){
  * @return bool
  */
 bool TempSensor::reserved_address(uint8_t addr){
-    return (addr & 0x78) == 0 || (addr & 0x78) == 0x78;
+    return BusScanner::reserved_address(addr);
 }
 
 
@@ -89,43 +77,29 @@ bool TempSensor::reserved_address(uint8_t addr){
  *
  * This function prints all the availables addresses the sensor
  * bus has and also the addresses being used are shown with an @.
+ * A targeted scan only probes the TCN75A addresses.
+ *
+ * @param mode Targeted or Full scan
  *
  * @return uint8_t real_addr: the sensor address
  */
-uint8_t TempSensor::bus_scan(){
-    printf("\nI2C Bus Scan\n");
-    printf("   0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F\n");
-    uint8_t real_addr;
-
-    //iterate through all I2C addresses from 0x00 to 0x7F reaching 128
-    for(int addr = 0; addr < (1 << 7); addr++){
-        //if the address is a multiple of 16 then its the end of the row
-        if( addr % 16 == 0){
-            printf("%02x", addr);
-        }
-
-        // Perform a 1-byte dummy read from the probe address. If a slave
-        // acknowledges this address, the function returns the number of bytes
-        // transferred. If the address byte is ignored, the function returns
-        // -1.
- 
-        // Skip over any reserved addresses.
-        int ret; // will retain the result
-        uint8_t rxdata; //receiving buffer location
-        if(reserved_address(addr)){
-            ret = PICO_ERROR_GENERIC;
-        } else {
-            ret = i2c_read_blocking(I2C_PIN, addr, &rxdata, 1, false);
-        }
-        printf(ret < 0 ? "." : "@"); // print . if address not found and @ if found
-        printf(addr % 16 == 15 ? "\n" : "  "); // newline if end or row or space if not
+uint8_t TempSensor::bus_scan(ScanMode mode){
+    PROBE_SCOPE(BusScan);
+    scanner.scan(mode);
+    scanner.render();
 
-        if(ret == 1){
-            real_addr = addr; // take the I2C address
-        }
+    uint8_t real_addr = scanner.firstFound(tcn75a::FIRST_ADDR, tcn75a::LAST_ADDR);
+    //keep the current address if no sensor answered
+    return real_addr ? real_addr : sensor_addr;
+}
 
-    }
-    return real_addr;
+/**
+ * @brief Bus scanner
+ *
+ * @return BusScanner& the scanner and its cached result table
+ */
+BusScanner& TempSensor::getScanner(){
+    return scanner;
 }
 
 /**
@@ -142,19 +116,25 @@ uint8_t TempSensor::bus_scan(){
 void TempSensor::Modify_DeviceID(int address){
     int ret; // will retain the result
     uint8_t rxdata; //receiving buffer location
-    ret = i2c_read_blocking(I2C_PIN, address, &rxdata, 1, false);
+    engine.acquire();
+    ret = hal::Bus::readTimeout(I2C_PIN, address, &rxdata, 1, false, engine.retryPolicy().timeout_us);
+    engine.release();
 
+    //cached registers belong to the old address
+    invalidateShadow();
     if(ret == 1){
         sensor_addr = address; // take the I2C address
-        std::cout << "[ID WAS SUCCESSFULLY CHANGED]" << std::endl;
-        for(int i = 0; i < 4; i++){
-            green_led.blinkLED();
+        resyncShadow();
+        if(sensor_array){
+            //the array polls the previous sensor again, and not this one
+            sensor_array->exclude(sensor_addr);
+            sensor_array->discover(&scanner);
         }
+        std::cout << "[ID WAS SUCCESSFULLY CHANGED]" << std::endl;
+        green_led.blink(4);
     } else{
         std::cout << "[ID WAS NOT CHANGED, PLEASE TRY AGAIN]" << std::endl;
-        for(int i = 0; i < 4; i++){
-            red_led.blinkLED();
-        }
+        red_led.blink(4);
     }
 }
 
@@ -169,17 +149,19 @@ void TempSensor::Modify_DeviceID(int address){
  * This function reads data from a register over I2C. The register address is
  * sent to the specified I2C address, and the resulting data is read into the
  * provided buffer. The function returns the number of bytes read.
+ * The transfer goes through the transaction engine and this call waits for it,
+ * a NACK or a timeout is retried per the engine retry policy.
  *
- * @param i2c_inst A pointer to the I2C instance to use for the read.
  * @param addr The I2C address to read from.
  * @param reg The register address to read from.
  * @param buf A pointer to the buffer to store the read data.
  * @param nbytes The number of bytes to read from the register.
  *
- * @return The number of bytes read from the register.
+ * @return The number of bytes read from the register, or a negative error.
  */
-int TempSensor::Read_Reg(i2c_inst_t *i2c_inst, const uint8_t addr, const uint8_t reg,
-                            uint8_t *buf, const uint8_t nbytes){
+int TempSensor::Read_Reg(const uint8_t addr, const uint8_t reg, uint8_t *buf, const uint8_t nbytes){
+    PROBE_SCOPE(ReadReg);
+    I2CTransaction txn;
     int num_bytes_read = 0;
 
     // Check to make sure caller is asking for 1 or more bytes
@@ -188,9 +170,11 @@ int TempSensor::Read_Reg(i2c_inst_t *i2c_inst, const uint8_t addr, const uint8_t
     }
 
     // Read data from register(s) over I2C
-    i2c_write_blocking(I2C_PIN, addr, &reg, 1, true);
-    num_bytes_read = i2c_read_blocking(I2C_PIN, addr, buf, nbytes, false);
-
+    I2CEngine::prepareRead(txn, addr, reg, buf, nbytes);
+    num_bytes_read = engine.transfer(txn);
+    if(num_bytes_read < 0 && addr == sensor_addr){
+        invalidateShadow(); //bus error on this sensor, the cache can no longer be trusted
+    }
     return num_bytes_read;
 }
 
@@ -202,8 +186,9 @@ int TempSensor::Read_Reg(i2c_inst_t *i2c_inst, const uint8_t addr, const uint8_t
  * appended to the front of the data packet, and the resulting message is sent
  * to the specified I2C address. The function returns the number of bytes
  * written.
+ * The transfer goes through the transaction engine and this call waits for it,
+ * a NACK or a timeout is retried per the engine retry policy.
  *
- * @param i2c_inst A pointer to the I2C instance to use for the write.
  * @param addr The I2C address to write to.
  * @param reg The register address to write to.
  * @param buf A pointer to the buffer containing the data to write.
@@ -211,27 +196,76 @@ int TempSensor::Read_Reg(i2c_inst_t *i2c_inst, const uint8_t addr, const uint8_t
  *
  * @return The number of bytes written to the register.
  */
-int TempSensor::Write_Reg(i2c_inst_t *i2c_inst, const uint8_t addr, const uint8_t reg,
-                uint8_t *buf, const uint8_t nbytes){
-                 
-    int num_bytes_read = 0;
-    uint8_t msg[nbytes + 1];
+int TempSensor::Write_Reg(const uint8_t addr, const uint8_t reg, uint8_t *buf, const uint8_t nbytes){
+    I2CTransaction txn;
+    int num_bytes_written = 0;
 
     // Check to make sure caller is sending 1 or more bytes
     if (nbytes < 1) {
         return 0;
     }
 
-    // Append register address to front of data packet
-    msg[0] = reg;
-    for (int i = 0; i < nbytes; i++) {
-        msg[i + 1] = buf[i];
+    // Write data to register(s) over I2C
+    I2CEngine::prepareWrite(txn, addr, reg, buf, nbytes);
+    num_bytes_written = engine.transfer(txn);
+    if(num_bytes_written < 0 && addr == sensor_addr){
+        invalidateShadow(); //bus error on this sensor, the cache can no longer be trusted
     }
+    return num_bytes_written;
+}
 
-    // Write data to register(s) over I2C
-    num_bytes_read = i2c_write_blocking(I2C_PIN, addr, msg, (nbytes + 1), false);
+/**
+ * @brief Queue a register read
+ *
+ * Starts a read of the sensor register and returns right away.
+ * The result is available once txn.done is set or the callback runs.
+ *
+ * @param txn transaction storage, must stay valid until done
+ * @param reg The register address to read from.
+ * @param buf A pointer to the buffer to store the read data.
+ * @param nbytes The number of bytes to read from the register.
+ * @param cb completion callback, runs in interrupt context
+ * @param ctx context handed to the callback
+ *
+ * @return bool true if the transaction was queued
+ */
+bool TempSensor::Read_Reg_Async(I2CTransaction& txn, const uint8_t reg, uint8_t *buf,
+                                const uint8_t nbytes, I2CCallback cb, void* ctx){
+    I2CEngine::prepareRead(txn, sensor_addr, reg, buf, nbytes, cb, ctx);
+    return engine.submit(txn);
+}
 
-    return num_bytes_read;
+/**
+ * @brief Queue a register write
+ *
+ * Starts a write of the sensor register and returns right away.
+ *
+ * @param txn transaction storage, must stay valid until done
+ * @param reg The register address to write to.
+ * @param buf A pointer to the buffer containing the data to write.
+ * @param nbytes The number of bytes to write to the register.
+ * @param cb completion callback, runs in interrupt context
+ * @param ctx context handed to the callback
+ *
+ * @return bool true if the transaction was queued
+ */
+bool TempSensor::Write_Reg_Async(I2CTransaction& txn, const uint8_t reg, uint8_t *buf,
+                                 const uint8_t nbytes, I2CCallback cb, void* ctx){
+    I2CEngine::prepareWrite(txn, sensor_addr, reg, buf, nbytes, cb, ctx);
+    return engine.submit(txn);
+}
+
+/**
+ * @brief Transaction engine
+ *
+ * @return I2CEngine& the engine driving the sensor bus
+ */
+I2CEngine& TempSensor::getEngine(){
+    return engine;
+}
+
+I2CBus& TempSensor::getBus(){
+    return i2c_bus;
 }
 
 //******************************************************//
@@ -244,17 +278,270 @@ int TempSensor::Write_Reg(i2c_inst_t *i2c_inst, const uint8_t addr, const uint8_
  * Reads from the temperature register from the sensor.
  * This function retreives the raw temperature data
  * before any conversion and saves it as two bytes.
+ * A failed read keeps the last good value and publishes nothing.
  *
- * @return void
+ * @return bool false if the read failed
  */
-void TempSensor::Raw_Temp_Read(){
+bool TempSensor::Raw_Temp_Read(){
     uint8_t buf[2];
-    Read_Reg(I2C_PIN, sensor_addr,TEMP_REG, buf, 2);
-    // // Combine two bytes into a 16-bit unsigned integer
-    raw_temperature = (buf[0] << 8) | buf[1];
+    if(Read_Reg(sensor_addr, TEMP_REG, buf, 2) != 2){
+        return false;
+    }
+    // Combine the two bytes, bits below the resolution cleared
+    raw_temperature = (uint16_t)tcn75a::decoderFor(activeResolution()).q8((buf[0] << 8) | buf[1]);
     
     integerPart  = buf[0];
     decimalPart = buf[1];
+    publishSample();
+    return true;
+}
+
+/**
+ * @brief Start an async Temp Register read
+ *
+ * Queues a read of the temperature register. The CPU is free while
+ * the bytes move on the bus; the raw value is updated by onTempRead.
+ * The transaction is queued once at a time: while it is in flight
+ * the call does nothing.
+ *
+ * @return bool true if the read was queued, false if the last one is not done
+ */
+bool TempSensor::Raw_Temp_Read_Async(){
+    if(!temp_txn.done){
+        return false; //previous read still queued
+    }
+    temp_ready = false;
+    return Read_Reg_Async(temp_txn, TEMP_REG, temp_buf, 2, &onTempRead, this);
+}
+
+/**
+ * @brief Async Temp Register read finished
+ *
+ * Completion callback of Raw_Temp_Read_Async, runs in interrupt context.
+ *
+ * @param txn the finished transaction
+ * @param context the TempSensor that queued the read
+ *
+ * @return void
+ */
+void TempSensor::onTempRead(I2CTransaction& txn, void* context){
+    TempSensor* self = static_cast<TempSensor*>(context);
+    if(txn.result == 2){
+        self->raw_temperature = (uint16_t)tcn75a::decoderFor(self->activeResolution()).q8((self->temp_buf[0] << 8) | self->temp_buf[1]);
+        self->integerPart = self->temp_buf[0];
+        self->decimalPart = self->temp_buf[1];
+        self->temp_fixed = TempQ8::fromRaw(self->raw_temperature);
+        self->publishSample();
+    }
+    self->temp_ok = txn.result == 2;
+    self->temp_ready = true;
+}
+
+/**
+ * @brief Async temp read state
+ *
+ * @return bool true once the last Raw_Temp_Read_Async has completed
+ */
+bool TempSensor::Temp_Ready(){
+    return temp_ready;
+}
+
+/**
+ * @brief Async temp read result
+ *
+ * A failed read leaves the last temperature untouched and publishes nothing.
+ *
+ * @return bool true if the last completed Raw_Temp_Read_Async returned the register
+ */
+bool TempSensor::Temp_Ok(){
+    return temp_ok;
+}
+
+/**
+ * @brief Set the sample sink
+ *
+ * Every raw temperature reading is pushed, with a timestamp,
+ * to this ring so the other core can consume it.
+ *
+ * @param sink the ring to push to, nullptr to disable
+ *
+ * @return void
+ */
+void TempSensor::setSampleSink(SampleQueue* sink){
+    sample_sink = sink;
+}
+
+/**
+ * @brief Set the sensor array
+ *
+ * The array leaves this sensor out: its reads come from the sampler.
+ *
+ * @param array the manager of every sensor on the bus, nullptr if not used
+ *
+ * @return void
+ */
+void TempSensor::setSensorArray(SensorArray* array){
+    sensor_array = array;
+    if(sensor_array){
+        sensor_array->exclude(sensor_addr); //read by the sampler only
+    }
+}
+
+/**
+ * @brief Set the telemetry stream
+ *
+ * @param stream the binary output fed by the sample consumer, nullptr if not used
+ *
+ * @return void
+ */
+void TempSensor::setTelemetry(TelemetryStream* stream){
+    telemetry = stream;
+}
+
+/**
+ * @brief Set the text stream
+ *
+ * @param stream the sample lines fed by the sample consumer, nullptr if not used
+ *
+ * @return void
+ */
+void TempSensor::setTextStream(TextStream* stream){
+    text_stream = stream;
+}
+
+/**
+ * @brief Set the statistics
+ *
+ * @param stats the statistics updated by the sample consumer, nullptr if not used
+ *
+ * @return void
+ */
+void TempSensor::setStatistics(StatsBank* stats){
+    stats_bank = stats;
+}
+
+/**
+ * @brief Set the sample log
+ *
+ * @param log the flash log written by the sample consumer, nullptr if not used
+ *
+ * @return void
+ */
+void TempSensor::setSampleLog(SampleLog* log){
+    sample_log = log;
+}
+
+/**
+ * @brief Set the alert rules
+ *
+ * @param rules the rules evaluated by the sample consumer, nullptr if not used
+ *
+ * @return void
+ */
+void TempSensor::setRuleEngine(RuleEngine* rules){
+    rule_engine = rules;
+}
+
+/**
+ * @brief Set the LED effects engine
+ *
+ * The red and green LEDs are driven by it from then on, so the
+ * setting feedback blinks no longer hold the caller.
+ *
+ * @param effects engine whose tick runs from a timer
+ *
+ * @return void
+ */
+void TempSensor::setLedEffects(LedEffects* effects){
+    red_led.attach(effects, LedChannel::Red);
+    green_led.attach(effects, LedChannel::Green);
+}
+
+/**
+ * @brief Set the button events
+ *
+ * The button actions run from pollConsole, outside the gpio
+ * interrupt, so they may use the bus and the console.
+ *
+ * @param events the gestures decoded from the button edges, nullptr for none
+ *
+ * @return void
+ */
+void TempSensor::setButtonEvents(ButtonEvents* events){
+    button_events = events;
+}
+
+/**
+ * @brief Set the event loop
+ *
+ * @param loop the scheduler running the tasks of core 0, nullptr for none
+ *
+ * @return void
+ */
+void TempSensor::setEventLoop(EventLoop* loop){
+    event_loop = loop;
+}
+
+/**
+ * @brief Set the sampling scheduler
+ *
+ * @param scheduler the scheduler pacing the temperature reads, nullptr to read on demand
+ *
+ * @return void
+ */
+void TempSensor::setSampler(SamplingScheduler* scheduler){
+    sampler = scheduler;
+}
+
+/**
+ * @brief Set the alert monitor
+ *
+ * @param monitor the ALERT pin decoder, nullptr if not used
+ *
+ * @return void
+ */
+void TempSensor::setAlertMonitor(AlertMonitor* monitor){
+    alert_monitor = monitor;
+    syncAlertMonitor();
+}
+
+/**
+ * @brief Sync the alert monitor
+ *
+ * Hands the polarity and comparator/interrupt settings of the
+ * config register to the monitor so it decodes the edges right.
+ *
+ * @return void
+ */
+void TempSensor::syncAlertMonitor(){
+    if(alert_monitor){
+        uint8_t config = readConfigRegister();
+        alert_monitor->configure(tcn75a::get<tcn75a::Polarity>(config) == tcn75a::Polarity::ActiveHigh,
+                                 tcn75a::get<tcn75a::AlertMode>(config) == tcn75a::AlertMode::Interrupt);
+    }
+}
+
+/**
+ * @brief Publish the last reading
+ *
+ * Pushes the current raw temperature to the sample sink.
+ * If the consumer is behind, the sample is dropped and counted by the ring.
+ * Both the blocking path and the async callback publish from core 0, so
+ * interrupts are masked to keep a single producer on the ring.
+ *
+ * @return void
+ */
+void TempSensor::publishSample(){
+    if(sample_sink){
+        TempSample sample;
+        sample.timestamp_us = hal::Clock::nowUs();
+        sample.raw = raw_temperature;
+        sample.addr = sensor_addr;
+        uint32_t irq_state = hal::Cpu::disableIrq();
+        sample_sink->push(sample);
+        hal::Cpu::restoreIrq(irq_state);
+        hal::Cpu::signal(); //wake the consumer core
+    }
 }
 
 /**
@@ -262,7 +549,9 @@ void TempSensor::Raw_Temp_Read(){
  *
  * Takes the raw temperature value and converts it
  * to a human readable float value. The conversion
- * is in Ceslius.
+ * is in Ceslius. The word is a signed number: the decoder
+ * of the configured resolution masks the unused bits and
+ * keeps the sign, the float is only made from the result.
  *
  * @param integerPart the most significant byte of the temperature data 
  * @param decimalPart the least significant byte of the temperature data
@@ -270,33 +559,58 @@ void TempSensor::Raw_Temp_Read(){
  * @return float floatValue: new converted temperature value
  */
 float TempSensor::fixedToFloat(uint8_t integerPart, uint8_t decimalPart) {
-  // Combine the integer and decimal parts into a 16-bit fixed point number
+  // Combine the integer and decimal parts into the 16-bit register word
   uint16_t fixedPoint = (static_cast<uint16_t>(integerPart) << 8) | decimalPart;
 
-  // Convert the fixed point number to a float
-  float floatValue = static_cast<float>(fixedPoint) / 256.0f;
+  // Signed and masked in integer math, the float is exact: a 16 bit value over a power of two
+  float floatValue = static_cast<float>(tcn75a::decoderFor(activeResolution()).q8(fixedPoint)) / 256.0f;
 
   return floatValue;
 }
 
-//Same as fixedToFloat function, also works but not being used
+//Same as fixedToFloat function, from the combined register word
 float TempSensor::convert_raw_temp(int16_t raw_temp) {
-    // Extract upper and lower bytes
-    int8_t upper_byte = raw_temp >> 8;  // Get the upper byte
-    uint8_t lower_byte = raw_temp & 0xFF;  // Get the lower byte
-    // Calculate the fractional part
-    uint8_t fractional_part = lower_byte;
+    temp_C = static_cast<float>(tcn75a::decoderFor(activeResolution()).q8((uint16_t)raw_temp)) / 256.0f;
+    return temp_C;
+}
 
-    // Get the integer part of the temperature
-    uint8_t integer_part = static_cast<uint8_t>(upper_byte);
-    // Combine the integer and decimal parts into a 16-bit fixed point number
-    uint16_t fixedPoint = (integer_part << 8) | fractional_part;
+/**
+ * @brief Configured resolution
+ *
+ * From the shadow config register, without touching the bus (this
+ * also runs in the I2C interrupt). Until the config is known, 12 bits:
+ * nothing is masked.
+ *
+ * @return tcn75a::Resolution resolution of the temperature register
+ */
+tcn75a::Resolution TempSensor::activeResolution() const{
+    const ShadowReg& sh = shadow[tcn75a::CONFIG_REG];
+    return sh.valid ? tcn75a::get<tcn75a::Resolution>(sh.data[0]) : tcn75a::Resolution::Bits12;
+}
 
-    
-    // Calculate the temperature
-    temp_C = static_cast<float>(fixedPoint)/256.0f;
+/**
+ * @brief Get Temperature
+ *
+ * Reads the temperature register and keeps the value in
+ * fixed point. No float math is involved, the register bytes
+ * are already a Q8.8 two's complement number.
+ *
+ * @return TempQ8 temp_fixed: the temperature in Celsius
+ */
+TempQ8 TempSensor::get_Temp(){
+    PROBE_SCOPE(TempRead);
+    Raw_Temp_Read();
+    temp_fixed = TempQ8::fromRaw(raw_temperature);
+    return temp_fixed;
+}
 
-    return temp_C;
+/**
+ * @brief Last Temperature
+ *
+ * @return TempQ8 temp_fixed: the last temperature read, in Celsius
+ */
+TempQ8 TempSensor::last_Temp() const{
+    return temp_fixed;
 }
 
 /**
@@ -310,7 +624,7 @@ float TempSensor::convert_raw_temp(int16_t raw_temp) {
  */
 //Call the Raw_temp_read to get data, then convert it to Celsius
 float TempSensor::get_Temp_C(){
-    Raw_Temp_Read();
+    get_Temp();
     temp_C = fixedToFloat(integerPart, decimalPart);
     //temp_C = convert_raw_temp(raw_temperature);
     return temp_C;
@@ -319,12 +633,13 @@ float TempSensor::get_Temp_C(){
 /**
  * @brief Get Temperature in F
  *
- * This function converts the Celsius to Fahrenheit
+ * This function converts the last reading to Fahrenheit,
+ * in integer math from the register word
  *
  * @return float temp_F: the final converted temperature in Fahrenheit
  */
 float TempSensor::get_Temp_F(){
-    temp_F = (temp_C * 9/5) + 32;
+    temp_F = static_cast<float>(TempQ8::fromRaw(raw_temperature).milli(TempUnit::Fahrenheit)) / 1000.0f;
     return temp_F;
 }
 
@@ -336,13 +651,14 @@ float TempSensor::get_Temp_F(){
  * @brief Read Config Register
  *
  * This function reads and sends the config register from the sensor
+ * or from the shadow copy if it is valid.
  *
  * @return uint8_t confifValue: the config register
  */
 uint8_t TempSensor::readConfigRegister(){
-    uint8_t configValue;
-    //Let controller know target address
-    Read_Reg(I2C_PIN, sensor_addr, CONFIG_REG, &configValue, 1);
+    uint8_t configValue = 0;
+    //Served from the shadow copy when the firmware already knows it
+    Read_Cached(CONFIG_REG, &configValue, 1);
 
     return configValue;
 }
@@ -367,7 +683,80 @@ void TempSensor::modifyConfigRegister(uint8_t mask, uint8_t value){
     configValue |= (value & mask);
 
     //i2c_write_blocking(I2C_PIN, sensor_addr, &configValue, 1, false);
-    Write_Reg(I2C_PIN, sensor_addr, CONFIG_REG, &configValue, 1);
+    Write_Cached(CONFIG_REG, &configValue, 1);
+}
+
+/**
+ * @brief Apply a batched Config Register change
+ *
+ * Applies every field of the edit with one read and one write,
+ * instead of one read-modify-write per setting. The read is
+ * served from the shadow copy when it is valid.
+ * The write is skipped when the register already holds the values.
+ * A sensor array polling the same address follows the new value.
+ *
+ * @param edit the field changes to apply
+ *
+ * @return bool true if the register was read and written
+ */
+bool TempSensor::applyConfig(const tcn75a::ConfigEdit& edit){
+    uint8_t configValue;
+    if(edit.empty()){
+        return true;
+    }
+    if(Read_Cached(CONFIG_REG, &configValue, 1) != 1){
+        return false;
+    }
+    if(edit.matches(configValue)){
+        return true;
+    }
+    configValue = edit.apply(configValue);
+    if(Write_Cached(CONFIG_REG, &configValue, 1) != 2){
+        return false;
+    }
+    if(sensor_array){
+        sensor_array->resync(sensor_addr, configValue);
+    }
+    return true;
+}
+
+/**
+ * @brief Change Config settings from the menus
+ *
+ * Applies the edit, prints the message and checks the
+ * result with VerifyReg so the LEDs show if it worked.
+ *
+ * @param edit the field changes to apply
+ * @param msg message printed once the change is sent
+ *
+ * @return void
+ */
+void TempSensor::changeConfig(const tcn75a::ConfigEdit& edit, const char* msg){
+    applyConfig(edit);
+    syncAlertMonitor();
+    std::cout << msg << std::endl;
+    VerifyReg(edit.mask(), edit.value());
+}
+
+/**
+ * @brief Queue a One-Shot conversion
+ *
+ * Writes SHUTDOWN and ONE-SHOT together: the sensor wakes up, runs
+ * one conversion and goes back to shutdown by itself. Queued right
+ * behind a temperature read, the next conversion starts as soon as the read
+ * is done without waking the CPU in between.
+ * The shadow copy is not updated: ONE-SHOT clears itself once the
+ * conversion is done, and SHUTDOWN is expected to be already set.
+ *
+ * @return bool true if the write was queued
+ */
+bool TempSensor::triggerOneShot_Async(){
+    using namespace tcn75a;
+    if(!oneshot_txn.done){
+        return false; //previous trigger still queued
+    }
+    oneshot_buf[0] = ConfigEdit().set(Shutdown::Enable).set(OneShot::Enable).apply(readConfigRegister());
+    return Write_Reg_Async(oneshot_txn, CONFIG_REG, oneshot_buf, 1);
 }
 
 //******************************************************//
@@ -383,10 +772,10 @@ void TempSensor::modifyConfigRegister(uint8_t mask, uint8_t value){
  */
 void TempSensor::Read_Hyst_Reg(){
     uint8_t temp[2] = {0,0};
-    Read_Reg(I2C_PIN, sensor_addr, HYST_TEMP_REG, temp, 2);
-    std::cout << "Minimum Temp Set to: " << fixedToFloat(temp[0], temp[1])
-    << std::endl;
-    sleep_ms(500);
+    char text[16];
+    Read_Cached(HYST_TEMP_REG, temp, 2);
+    tcn75a::formatLimit(tcn75a::limitWord(temp[0], temp[1]), text, sizeof(text));
+    std::cout << "Minimum Temp Set to: " << text << std::endl;
 }
 
 /**
@@ -394,10 +783,10 @@ void TempSensor::Read_Hyst_Reg(){
  *
  * This function write to the hysteresis register and changes the value
  *
- * @return void
+ * @return bool true if the sensor took the value
  */
-void TempSensor::Write_Hyst_Reg(){
-    Write_Reg(I2C_PIN, sensor_addr, HYST_TEMP_REG, hyst_limit, 2);
+bool TempSensor::Write_Hyst_Reg(){
+    return Write_Cached(HYST_TEMP_REG, hyst_limit, 2) == 3;
 }
 
 //******************************************************//
@@ -413,10 +802,10 @@ void TempSensor::Write_Hyst_Reg(){
  */
 void TempSensor::Read_Set_Reg(){
     uint8_t temp[2] = {0,0};
-    Read_Reg(I2C_PIN, sensor_addr, SET_TEMP_REG, temp, 2);
-    std::cout << "Maximum Temp Set to: " << fixedToFloat(temp[0], temp[1])
-    << std::endl;
-    sleep_ms(500);
+    char text[16];
+    Read_Cached(SET_TEMP_REG, temp, 2);
+    tcn75a::formatLimit(tcn75a::limitWord(temp[0], temp[1]), text, sizeof(text));
+    std::cout << "Maximum Temp Set to: " << text << std::endl;
 }
 
 /**
@@ -424,10 +813,219 @@ void TempSensor::Read_Set_Reg(){
  *
  * This function write to the Set register and changes the value
  *
+ * @return bool true if the sensor took the value
+ */
+bool TempSensor::Write_Set_Reg(){
+    return Write_Cached(SET_TEMP_REG, set_limit, 2) == 3;
+}
+
+//******************************************************//
+//**************SHADOW REGISTER FUNCTIONS***************//
+//******************************************************//
+
+/**
+ * @brief Cacheable register
+ *
+ * Only CONFIG, THYST and TSET are cached: the firmware is the
+ * only one writing them. The temperature register changes by itself.
+ *
+ * @param reg register pointer
+ * @param nbytes access size
+ *
+ * @return bool true if the access can use the shadow copy
+ */
+bool TempSensor::cacheable(const uint8_t reg, const uint8_t nbytes){
+    return reg >= CONFIG_REG && reg <= SET_TEMP_REG && nbytes >= 1 && nbytes <= 2;
+}
+
+/**
+ * @brief Config value for the shadow copy
+ *
+ * ONE-SHOT clears itself once its conversion is done. A copy that
+ * kept it would write it back with every later read-modify-write
+ * and start a conversion nobody asked for.
+ *
+ * @param config config register as written or read
+ *
+ * @return uint8_t the value without ONE-SHOT
+ */
+uint8_t TempSensor::cachedConfig(uint8_t config){
+    return (uint8_t)(config & ~tcn75a::OneShotField::mask);
+}
+
+/**
+ * @brief Cached register read
+ *
+ * Serves the read from the shadow copy when it is valid,
+ * otherwise reads the sensor and fills the shadow copy.
+ *
+ * @param reg The register address to read from.
+ * @param buf A pointer to the buffer to store the read data.
+ * @param nbytes The number of bytes to read from the register.
+ *
+ * @return The number of bytes read, or an error code
+ */
+int TempSensor::Read_Cached(const uint8_t reg, uint8_t *buf, const uint8_t nbytes){
+    if(!cacheable(reg, nbytes)){
+        return Read_Reg(sensor_addr, reg, buf, nbytes);
+    }
+    ShadowReg& sh = shadow[reg];
+    if(sh.valid){
+        sh.hits++;
+        for(int i = 0; i < nbytes; i++){
+            buf[i] = sh.data[i];
+        }
+        return nbytes;
+    }
+
+    sh.misses++;
+    uint8_t data[2] = {0, 0};
+    uint8_t size = (reg == CONFIG_REG) ? 1 : 2;
+    int ret = Read_Reg(sensor_addr, reg, data, size);
+    if(ret == size){
+        if(reg == CONFIG_REG){
+            data[0] = cachedConfig(data[0]);
+        }
+        sh.data[0] = data[0];
+        sh.data[1] = data[1];
+        sh.valid = true;
+        for(int i = 0; i < nbytes; i++){
+            buf[i] = data[i];
+        }
+        return nbytes;
+    }
+    return ret;
+}
+
+/**
+ * @brief Cached register write
+ *
+ * Writes the register and updates the shadow copy once the
+ * sensor acknowledged it. With write verify enabled the value
+ * is read back, and a mismatch invalidates the copy.
+ *
+ * @param reg The register address to write to.
+ * @param buf A pointer to the buffer containing the data to write.
+ * @param nbytes The number of bytes to write to the register.
+ *
+ * @return The number of bytes written, or an error code
+ */
+int TempSensor::Write_Cached(const uint8_t reg, uint8_t *buf, const uint8_t nbytes){
+    int ret = Write_Reg(sensor_addr, reg, buf, nbytes);
+    if(!cacheable(reg, nbytes)){
+        return ret;
+    }
+    ShadowReg& sh = shadow[reg];
+    uint8_t size = (reg == CONFIG_REG) ? 1 : 2;
+    if(ret != nbytes + 1 || nbytes != size){
+        sh.valid = false;
+        return ret;
+    }
+    sh.data[0] = (reg == CONFIG_REG) ? cachedConfig(buf[0]) : buf[0];
+    sh.data[1] = (size == 2) ? buf[1] : 0;
+    sh.valid = true;
+
+    if(shadow_verify){
+        uint8_t check[2] = {0, 0};
+        if(Read_Reg(sensor_addr, reg, check, size) != size ||
+           (reg == CONFIG_REG ? cachedConfig(check[0]) : check[0]) != sh.data[0] ||
+           (size == 2 && check[1] != sh.data[1])){
+            sh.valid = false;
+            return PICO_ERROR_GENERIC;
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief Invalidate the shadow registers
+ *
+ * Called after a bus error or an address change.
+ * The next read of each register goes to the sensor.
+ *
+ * @return void
+ */
+void TempSensor::invalidateShadow(){
+    for(int i = 0; i < 4; i++){
+        shadow[i].valid = false;
+    }
+}
+
+/**
+ * @brief Resync the shadow registers
+ *
+ * Reloads CONFIG, THYST and TSET from the sensor.
+ *
+ * @return void
+ */
+void TempSensor::resyncShadow(){
+    uint8_t data[2];
+    invalidateShadow();
+    Read_Cached(CONFIG_REG, data, 1);
+    Read_Cached(HYST_TEMP_REG, data, 2);
+    Read_Cached(SET_TEMP_REG, data, 2);
+}
+
+/**
+ * @brief Shadow write verify
+ *
+ * @param enable true to read every cached write back from the sensor
+ *
+ * @return void
+ */
+void TempSensor::setShadowVerify(bool enable){
+    shadow_verify = enable;
+}
+
+/**
+ * @brief Shadow register state
+ *
+ * @param reg register pointer
+ *
+ * @return const ShadowReg& the cached value and its hit/miss counters
+ */
+const ShadowReg& TempSensor::getShadow(const uint8_t reg) const{
+    return shadow[reg & 0x03];
+}
+
+/**
+ * @brief Print the shadow register counters
+ *
+ * Every hit is a bus transaction that was not needed.
+ *
+ * @return void
+ */
+void TempSensor::printShadowStats(){
+    const char* names[4] = {"TEMP", "CONFIG", "THYST", "TSET"};
+    uint32_t saved = 0;
+    std::cout << "Register | Hits | Misses | Valid" << std::endl;
+    for(int reg = CONFIG_REG; reg <= SET_TEMP_REG; reg++){
+        printf("%-8s | %4lu | %6lu | %s\n", names[reg], (unsigned long)shadow[reg].hits,
+               (unsigned long)shadow[reg].misses, shadow[reg].valid ? "yes" : "no");
+        saved += shadow[reg].hits;
+    }
+    printf("Bus transactions saved: %lu\n", (unsigned long)saved);
+}
+
+/**
+ * @brief Print the bus error counters
+ *
+ * Engine totals, then one line per address that ever failed.
+ *
  * @return void
  */
-void TempSensor::Write_Set_Reg(){
-    Write_Reg(I2C_PIN, sensor_addr, SET_TEMP_REG, set_limit, 2);
+void TempSensor::printBusErrors(){
+    const I2CEngine::Stats& st = engine.stats();
+    printf("Transfers: %lu ok, %lu failed, %lu timeouts, %lu retries, %lu recoveries (%lu stuck)\n",
+           (unsigned long)st.completed, (unsigned long)st.failed, (unsigned long)st.timeouts,
+           (unsigned long)st.retries, (unsigned long)st.recoveries, (unsigned long)st.stuck);
+    std::cout << "Address | NACKs | Timeouts | Retries | Failures" << std::endl;
+    for(uint8_t i = 0; i < I2CEngine::MAX_DEVICES; i++){
+        const I2CEngine::DeviceErrors& dev = engine.deviceErrors(i);
+        if(dev.addr){
+            printf("0x%02X    | %5u | %8u | %7u | %8u\n", dev.addr, dev.nacks, dev.timeouts, dev.retries, dev.failures);
+        }
+    }
 }
 
 /**
@@ -435,6 +1033,10 @@ void TempSensor::Write_Set_Reg(){
  *
  * This function checks if the proper bits were changed
  * in the register and blinks an LED accordingly.
+ * The register is read back from the sensor, not from the shadow copy
+ * the write just filled. The read is queued and this returns at once:
+ * the command path never waits on the bus for it, refreshDisplay
+ * compares the result and blinks once it has landed.
  *
  * @param mask the bits to mask in the register
  * @param data the value of the bits changed in the register
@@ -442,44 +1044,68 @@ void TempSensor::Write_Set_Reg(){
  * @return void
  */
 void TempSensor::VerifyReg(uint8_t mask, uint8_t data){
-    uint8_t configReg = readConfigRegister();
+    if(!verify_txn.done){
+        //queued before this write, let it land and report the previous change
+        engine.wait(verify_txn);
+    }
+    finishVerify();
 
-    //clear the bits that have to be masked/changed to prevent errors
-    configReg &= mask;
-    if(configReg == data){
-        //if setting change worked, blink green led 3 times
-        for(int i =0; i < 3; i++){
-            green_led.blinkLED();
-        }
-    } else {
-        //operation failed, blink red led 3 times
-        for(int i =0; i < 3; i++){
-            red_led.blinkLED();
-        }
+    verify_mask = mask;
+    verify_data = data;
+    verify_shadow = shadow[CONFIG_REG].data[0];
+    if(!Read_Reg_Async(verify_txn, CONFIG_REG, verify_buf, 1, &onVerifyRead, this)){
+        red_led.blink(3); //engine queue full, nothing to check against
     }
 }
 
+/**
+ * @brief Config read-back finished
+ *
+ * Completion callback of VerifyReg, runs in interrupt context.
+ *
+ * @param txn the finished transaction
+ * @param context the TempSensor that queued the read
+ *
+ * @return void
+ */
+void TempSensor::onVerifyRead(I2CTransaction& txn, void* context){
+    (void)txn;
+    static_cast<TempSensor*>(context)->verify_landed = true;
+}
 
 /**
- * @brief Reads user input from the console until Enter is pressed.
+ * @brief Show the result of a config change
  *
- * This function reads user input from the console until the Enter key is pressed.
- * The input is stored in the specified string.
+ * Blinks green 3 times if the read-back holds the changed bits, red
+ * otherwise. The shadow copy takes the value read, as does the sensor
+ * array, unless a later write already replaced it.
  *
- * @return The user input string.
+ * @return void
  */
-std::string TempSensor::get_input() {
-  std::string input;
-  char c;
-  while (true) {
-    c = getchar(); // Read a character from the console
-    if (c == '\n' || c == '\r') { // Check if Enter key is pressed
-      break; // Exit the loop
+void TempSensor::finishVerify(){
+    if(!verify_landed){
+        return;
+    }
+    verify_landed = false;
+
+    uint8_t configReg = verify_buf[0];
+    bool read = verify_txn.result == 1;
+    if(read && shadow[CONFIG_REG].data[0] == verify_shadow){
+        shadow[CONFIG_REG].data[0] = cachedConfig(configReg);
+        shadow[CONFIG_REG].valid = true;
+        if(sensor_array){
+            sensor_array->resync(sensor_addr, configReg);
+        }
+    }
+
+    //clear the bits that have to be masked/changed to prevent errors
+    configReg &= verify_mask;
+    if(read && configReg == verify_data){
+        //if setting change worked, blink green led 3 times
+        green_led.blink(3);
     } else {
-      input += c; // Append the character to the input string
+        //operation failed, blink red led 3 times
+        red_led.blink(3);
     }
-  }
-  return input;
 }
 
-
@@ -0,0 +1,374 @@
+#include "../inc/TempStats.hpp"
+#include "../inc/ConfigRegister.hpp"
+#include "../inc/Hal.hpp"
+#include "../inc/Probe.hpp"
+#include <cstdint>
+
+static const uint8_t MASK = RollingStats::MAX_WINDOW - 1;
+
+//Round a fixed-point value to its integer part, halves away from minus infinity
+static int32_t roundShift(int32_t value, uint8_t shift){
+    return (value + (1 << (shift - 1))) >> shift;
+}
+
+//Rounded division, the result of a signed numerator rounded half away from zero
+static int32_t roundDiv(int32_t num, int32_t den){
+    return num >= 0 ? (num + den / 2) / den : -((-num + den / 2) / den);
+}
+
+//******************************************************//
+//*****************ONE SENSOR STATISTICS****************//
+//******************************************************//
+
+/**
+ * @brief RollingStats Constructor
+ *
+ * @param window readings in the rolling window, 1 to MAX_WINDOW
+ * @param ewma_shift EWMA weight of a new reading is 1 / 2^ewma_shift
+ *
+ */
+RollingStats::RollingStats(uint8_t window, uint8_t ewma_shift): ring(), window_size(1), fill(0), seq(0),
+min_q(), max_q(), min_head(0), min_tail(0), max_head(0), max_tail(0), sum(0), sum_sq(0), ewma_shift(3),
+ewma(0), total(0), total_mean(0), total_carry(0), total_m2(0){
+    setWindow(window);
+    setEwmaShift(ewma_shift);
+}
+
+/**
+ * @brief Set the window length
+ *
+ * The window restarts empty, the totals and the EWMA are kept.
+ *
+ * @param window readings, clamped to 1..MAX_WINDOW
+ *
+ * @return void
+ */
+void RollingStats::setWindow(uint8_t window){
+    window_size = window == 0 ? 1 : (window > MAX_WINDOW ? MAX_WINDOW : window);
+    fill = 0;
+    sum = 0;
+    sum_sq = 0;
+    min_head = min_tail = 0;
+    max_head = max_tail = 0;
+}
+
+/**
+ * @brief Set the EWMA weight
+ *
+ * @param shift alpha = 1 / 2^shift, clamped to 0..EWMA_FRAC
+ *
+ * @return void
+ */
+void RollingStats::setEwmaShift(uint8_t shift){
+    ewma_shift = shift > EWMA_FRAC ? EWMA_FRAC : shift;
+}
+
+/**
+ * @brief Forget every reading
+ *
+ * @return void
+ */
+void RollingStats::reset(){
+    setWindow(window_size);
+    ewma = 0;
+    total = 0;
+    total_mean = 0;
+    total_carry = 0;
+    total_m2 = 0;
+}
+
+/**
+ * @brief Add a reading
+ *
+ * Constant time: the reading leaving the window is taken out of
+ * the sums, each deque pops the entries the new reading makes
+ * useless (it can only push one), and the front expires at most
+ * one entry. No division but the 32 bit one of Welford's mean
+ * (the hardware divider on the RP2040).
+ *
+ * @param raw temperature register word, Q8.8
+ *
+ * @return void
+ */
+void RollingStats::update(int16_t raw){
+    //Window sums: the oldest reading leaves once the window is full
+    if(fill == window_size){
+        int16_t old = ring[(seq - window_size) & MASK];
+        sum -= old;
+        sum_sq -= (int32_t)old * old;
+    } else {
+        fill++;
+    }
+    ring[seq & MASK] = raw;
+    sum += raw;
+    sum_sq += (int32_t)raw * raw;
+
+    //Deques: expire the front first so there is always room for the new entry
+    if(min_head != min_tail && seq - min_q[min_head & MASK].index >= window_size){
+        min_head++;
+    }
+    if(max_head != max_tail && seq - max_q[max_head & MASK].index >= window_size){
+        max_head++;
+    }
+    //an older reading not below the new one can never be the minimum again
+    while(min_head != min_tail && min_q[(uint8_t)(min_tail - 1) & MASK].value >= raw){
+        min_tail--;
+    }
+    min_q[min_tail++ & MASK] = {raw, seq};
+    while(max_head != max_tail && max_q[(uint8_t)(max_tail - 1) & MASK].value <= raw){
+        max_tail--;
+    }
+    max_q[max_tail++ & MASK] = {raw, seq};
+    seq++;
+
+    //EWMA, started at the first reading
+    int32_t x = (int32_t)raw << EWMA_FRAC;
+    ewma = total ? ewma + ((x - ewma) >> ewma_shift) : x;
+
+    //Welford: the mean moves by delta / n, M2 by delta * (x - new mean).
+    //The remainder of the division is carried to the next step, so the
+    //mean keeps moving when delta gets smaller than n.
+    total++;
+    int32_t xw = (int32_t)raw << WELFORD_FRAC;
+    int32_t delta = xw - total_mean;
+    int32_t moved = delta + total_carry;
+    int32_t step = moved / (int32_t)total;
+    total_carry = moved - step * (int32_t)total;
+    total_mean += step;
+    total_m2 += (uint64_t)(((int64_t)delta * (xw - total_mean)) >> WELFORD_FRAC);
+}
+
+uint32_t RollingStats::samples() const{
+    return total;
+}
+
+uint8_t RollingStats::windowFill() const{
+    return fill;
+}
+
+int16_t RollingStats::min() const{
+    return min_head != min_tail ? min_q[min_head & MASK].value : 0;
+}
+
+int16_t RollingStats::max() const{
+    return max_head != max_tail ? max_q[max_head & MASK].value : 0;
+}
+
+int32_t RollingStats::windowSum() const{
+    return sum;
+}
+
+int64_t RollingStats::windowSumSq() const{
+    return sum_sq;
+}
+
+int32_t RollingStats::ewmaFixed() const{
+    return ewma;
+}
+
+int32_t RollingStats::totalMeanFixed() const{
+    return total_mean;
+}
+
+uint64_t RollingStats::totalM2() const{
+    return total_m2;
+}
+
+/**
+ * @brief Results rounded to register units
+ *
+ * The deviations are square roots taken with 6 extra bits
+ * (variance with 12), then rounded to Q8.8.
+ *
+ * @param addr sensor address stored in the summary
+ *
+ * @return StatsSummary the statistics of this sensor
+ */
+StatsSummary RollingStats::summary(uint8_t addr) const{
+    StatsSummary s = StatsSummary();
+    s.addr = addr;
+    s.samples = total;
+    s.window = fill;
+    if(fill == 0){
+        return s;
+    }
+    s.min = min();
+    s.max = max();
+    s.mean = (int16_t)roundDiv(sum, fill);
+    //n * sum(x^2) - sum(x)^2 is exact and never negative
+    uint64_t spread = (uint64_t)((int64_t)fill * sum_sq - (int64_t)sum * sum);
+    s.stddev = (uint16_t)((isqrt((spread << 12) / ((uint32_t)fill * fill)) + 32) >> 6);
+    s.ewma = (int16_t)roundShift(ewma, EWMA_FRAC);
+    s.total_mean = (int16_t)roundShift(total_mean, WELFORD_FRAC);
+    s.total_stddev = (uint16_t)((isqrt(total_m2 / total) + 32) >> 6);
+    return s;
+}
+
+/**
+ * @brief Integer square root
+ *
+ * Bit by bit, two bits of the value per step.
+ *
+ * @param value number to take the root of
+ *
+ * @return uint32_t floor(sqrt(value))
+ */
+uint32_t RollingStats::isqrt(uint64_t value){
+    uint64_t root = 0;
+    uint64_t bit = 1ull << 62;
+    while(bit > value){
+        bit >>= 2;
+    }
+    while(bit){
+        if(value >= root + bit){
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+//******************************************************//
+//*****************STATISTICS OF THE BUS****************//
+//******************************************************//
+
+/**
+ * @brief StatsBank Constructor
+ *
+ * One RollingStats per TCN75A address, 16 reading window,
+ * EWMA weight 1/8.
+ *
+ */
+StatsBank::StatsBank(): sensors(), seq(0), req_window(16), req_shift(3), req_reset(false), cur_window(16),
+cur_shift(3), update_count(0), cpu_us(0){
+}
+
+/**
+ * @brief Add a sample
+ *
+ * Called by the sample consumer for every reading. Readings of an
+ * address outside the TCN75A range are ignored.
+ *
+ * @param sample reading from the sample ring
+ *
+ * @return void
+ */
+void StatsBank::update(const TempSample& sample){
+    PROBE_SCOPE(StatsUpdate);
+    uint8_t index = sample.addr - tcn75a::FIRST_ADDR;
+    if(index >= MAX_SENSORS){
+        return;
+    }
+    uint32_t start = hal::Clock::nowUs32();
+    seq.fetch_add(1, std::memory_order_acq_rel);
+    applyRequests();
+    sensors[index].update((int16_t)sample.raw);
+    seq.fetch_add(1, std::memory_order_release);
+    update_count++;
+    cpu_us += hal::Clock::nowUs32() - start;
+}
+
+/**
+ * @brief Apply the requests of the other core
+ *
+ * @return void
+ */
+void StatsBank::applyRequests(){
+    uint8_t window = req_window.load(std::memory_order_relaxed);
+    uint8_t shift = req_shift.load(std::memory_order_relaxed);
+    bool clear = req_reset.exchange(false, std::memory_order_acq_rel);
+    for(RollingStats& s : sensors){
+        if(window != cur_window){
+            s.setWindow(window);
+        }
+        if(shift != cur_shift){
+            s.setEwmaShift(shift);
+        }
+        if(clear){
+            s.reset();
+        }
+    }
+    cur_window = window;
+    cur_shift = shift;
+}
+
+/**
+ * @brief Copy the statistics
+ *
+ * Retries if the consumer updated the statistics during the copy.
+ *
+ * @param out destination array
+ * @param max size of the destination array
+ *
+ * @return uint8_t the number of sensors with readings, by address
+ */
+uint8_t StatsBank::summaries(StatsSummary *out, uint8_t max) const{
+    uint32_t before, after;
+    uint8_t n;
+    do{
+        before = seq.load(std::memory_order_acquire);
+        n = 0;
+        for(uint8_t i = 0; i < MAX_SENSORS && n < max; i++){
+            if(sensors[i].samples()){
+                out[n++] = sensors[i].summary(tcn75a::FIRST_ADDR + i);
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = seq.load(std::memory_order_relaxed);
+    } while((before & 1) || before != after);
+    return n;
+}
+
+/**
+ * @brief Copy the statistics of one sensor
+ *
+ * @param addr sensor address
+ * @param out destination
+ *
+ * @return bool false if the sensor has no readings
+ */
+bool StatsBank::summary(uint8_t addr, StatsSummary& out) const{
+    uint8_t index = addr - tcn75a::FIRST_ADDR;
+    if(index >= MAX_SENSORS){
+        return false;
+    }
+    uint32_t before, after;
+    do{
+        before = seq.load(std::memory_order_acquire);
+        out = sensors[index].summary(addr);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = seq.load(std::memory_order_relaxed);
+    } while((before & 1) || before != after);
+    return out.samples != 0;
+}
+
+void StatsBank::setWindow(uint8_t window){
+    req_window.store(window, std::memory_order_relaxed);
+}
+
+void StatsBank::setEwmaShift(uint8_t shift){
+    req_shift.store(shift, std::memory_order_relaxed);
+}
+
+void StatsBank::reset(){
+    req_reset.store(true, std::memory_order_release);
+}
+
+uint8_t StatsBank::window() const{
+    return req_window.load(std::memory_order_relaxed);
+}
+
+uint8_t StatsBank::ewmaShift() const{
+    return req_shift.load(std::memory_order_relaxed);
+}
+
+uint32_t StatsBank::updates() const{
+    return update_count;
+}
+
+uint32_t StatsBank::cpuUs() const{
+    return cpu_us;
+}
@@ -0,0 +1,216 @@
+#include "../inc/TextStream.hpp"
+#include "../inc/FixedTemp.hpp"
+#include "../inc/Hal.hpp"
+#include "../inc/Probe.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+/**
+ * @brief TextStream Constructor
+ *
+ * Constructor initializes an empty buffer with a full link budget,
+ * streaming is off.
+ *
+ * @param writer sends the text bytes
+ * @param bytes_per_s link budget, UNLIMITED if the writer may block
+ *
+ */
+TextStream::TextStream(Writer writer, uint32_t bytes_per_s): writer(writer), streaming(false), max_latency_us(20000),
+link_rate(bytes_per_s), credit(BUFFER_SIZE * 1000000ull), refill_us(0), pending_drops(0), buffer(), used(0), lines(0),
+first_us(0), stamp_sum(0), stat(){
+}
+
+/**
+ * @brief Start or stop streaming
+ *
+ * Called from the console on core 0, the samples are pushed on core 1.
+ * The consumer core is woken so it sends what is left in the buffer.
+ *
+ * @param enable true to stream
+ *
+ * @return void
+ */
+void TextStream::setEnabled(bool enable){
+    streaming.store(enable, std::memory_order_release);
+    hal::Cpu::signal();
+}
+
+bool TextStream::enabled() const{
+    return streaming.load(std::memory_order_acquire);
+}
+
+void TextStream::setMaxLatency(uint32_t ms){
+    max_latency_us = ms * 1000u;
+}
+
+void TextStream::setLinkRate(uint32_t bytes_per_s){
+    link_rate = bytes_per_s;
+}
+
+/**
+ * @brief Take from the link budget
+ *
+ * The budget refills at the link rate and holds two buffers at most,
+ * so a burst after a quiet period cannot overrun the link.
+ *
+ * @param len bytes about to be queued
+ * @param now_us current time
+ *
+ * @return bool true if the bytes fit the budget, which is then reduced
+ */
+bool TextStream::reserve(size_t len, uint64_t now_us){
+    if(link_rate == UNLIMITED){
+        return true;
+    }
+    const uint64_t cap = 2 * BUFFER_SIZE * 1000000ull;
+    credit += (now_us - refill_us) * link_rate;
+    refill_us = now_us;
+    if(credit > cap){
+        credit = cap;
+    }
+    uint64_t cost = len * 1000000ull;
+    if(credit < cost){
+        return false;
+    }
+    credit -= cost;
+    return true;
+}
+
+/**
+ * @brief Add a sample
+ *
+ * Converts and formats the line straight into the buffer, from the
+ * raw register word: integer only. The buffer is sent first if the
+ * line and a drop note might not fit in it. The drops are reported
+ * once per write, so a congested link does not spend its budget on
+ * notes.
+ *
+ * @param sample the reading to send
+ * @param now_us current time
+ *
+ * @return bool true if the line was queued, false if it was over the link budget
+ */
+bool TextStream::push(const TempSample& sample, uint64_t now_us){
+    PROBE_SCOPE(TextLine);
+    uint32_t start = hal::Clock::nowUs32();
+    char tempC[12], tempF[12];
+    TempQ8 temp = TempQ8::fromRaw(sample.raw);
+    temp.format(tempC, sizeof(tempC), TempUnit::Celsius);
+    temp.format(tempF, sizeof(tempF), TempUnit::Fahrenheit);
+    char line[MAX_LINE];
+    int len = snprintf(line, sizeof(line), "%7lu.%03lu s  0x%02X %8s C %8s F\n",
+                       (unsigned long)(sample.timestamp_us / 1000000), (unsigned long)(sample.timestamp_us / 1000 % 1000),
+                       sample.addr, tempC, tempF);
+    if(len < 0 || (size_t)len >= sizeof(line)){
+        len = sizeof(line) - 1;
+    }
+
+    if(used + MAX_LINE + MAX_NOTE > BUFFER_SIZE){
+        flush(now_us);
+    }
+    char note[MAX_NOTE];
+    int noteLen = 0;
+    if(pending_drops && lines == 0){
+        noteLen = snprintf(note, sizeof(note), "# %lu lines dropped\n", (unsigned long)pending_drops);
+    }
+    if(!reserve((size_t)(len + noteLen), now_us)){
+        pending_drops++;
+        stat.dropped++;
+        stat.cpu_us += hal::Clock::nowUs32() - start;
+        return false;
+    }
+    if(noteLen){
+        pending_drops = 0;
+        memcpy(&buffer[used], note, noteLen);
+        used += noteLen;
+    }
+    if(lines == 0){
+        first_us = sample.timestamp_us;
+        stamp_sum = 0;
+    }
+    memcpy(&buffer[used], line, len);
+    used += len;
+    lines++;
+    stamp_sum += sample.timestamp_us;
+
+    if(max_latency_us == 0){
+        flush(now_us);
+    }
+    stat.cpu_us += hal::Clock::nowUs32() - start;
+    return true;
+}
+
+/**
+ * @brief Send the buffer when it gets old
+ *
+ * Bounds the latency when samples come slowly.
+ *
+ * @param now_us current hal::Clock::nowUs
+ *
+ * @return bool true if the buffer was sent
+ */
+bool TextStream::flushDue(uint64_t now_us){
+    if(lines == 0 || now_us - first_us < max_latency_us){
+        return false;
+    }
+    flush(now_us);
+    return true;
+}
+
+/**
+ * @brief Next flush
+ *
+ * The consumer core sleeps until this time when no sample comes.
+ *
+ * @return uint64_t time the oldest line reaches the maximum latency, ~0 if the buffer is empty
+ */
+uint64_t TextStream::nextDueUs() const{
+    return lines ? first_us + max_latency_us : ~0ull;
+}
+
+/**
+ * @brief Send the buffer
+ *
+ * One writer call for every line in the buffer. The latency of each
+ * line is counted up to the end of the write.
+ *
+ * @param now_us current time, used when the writer returns at once
+ *
+ * @return void
+ */
+void TextStream::flush(uint64_t now_us){
+    if(used == 0){
+        return;
+    }
+    writer((const uint8_t*)buffer, used);
+    uint64_t done = hal::Clock::nowUs();
+    if(done < now_us){
+        done = now_us;
+    }
+
+    if(lines){
+        stat.latency_us += lines * done - stamp_sum;
+        if(done - first_us > stat.max_latency_us){
+            stat.max_latency_us = (uint32_t)(done - first_us);
+        }
+    }
+    stat.lines += lines;
+    stat.bytes += used;
+    stat.writes++;
+    used = 0;
+    lines = 0;
+}
+
+/**
+ * @brief Stream statistics
+ *
+ * @return const Stats& lines sent and dropped, bytes, latency
+ */
+const TextStream::Stats& TextStream::stats() const{
+    return stat;
+}
+
+void TextStream::resetStats(){
+    stat = Stats();
+}
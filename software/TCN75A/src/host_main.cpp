@@ -0,0 +1,243 @@
+#include "../inc/TempSensor.hpp"
+#include "../inc/SimTCN75A.hpp"
+#include "../inc/SamplingScheduler.hpp"
+#include "../inc/TempStats.hpp"
+#include "../inc/SampleLog.hpp"
+#include "../inc/AlertRules.hpp"
+#include "../inc/I2CBus.hpp"
+#include "../inc/LedEffects.hpp"
+#include "../inc/ButtonEvents.hpp"
+#include "../inc/EventLoop.hpp"
+#include "../inc/TextStream.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+//Host build entry point.
+//Runs the drivers against a simulated TCN75A and prints the bus cost of
+//each menu action, or runs the interactive menus with --menu. The checks
+//live in the test programs of test/.
+
+//Simulated bus with one sensor at 0x48, its ALERT output on gpio 0
+static hal::SimBus bus(1, 400 * 1000);
+static SimTCN75A sim(0x48, 0);
+
+//LED effects, played by the timer of the --menu loop
+static LedEffects leds;
+
+//Six buttons on gpio 2 to 7, pressed pulls the pin low
+static ButtonEvents buttonEvents(2);
+
+//Bus cost of one action
+struct ActionCost{
+    const char* name;
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t bus_us;
+    uint32_t reads;
+    uint32_t writes;
+};
+
+static ActionCost costs[16];
+static uint8_t costCount = 0;
+
+/**
+ * @brief Measure an action
+ *
+ * Resets the bus and sensor counters, runs the action and
+ * keeps what it cost on the bus.
+ *
+ * @param name label printed in the table
+ * @param action the action to run
+ *
+ * @return void
+ */
+template<typename F>
+static void measure(const char* name, F action){
+    bus.resetStats();
+    sim.resetStats();
+    action();
+
+    ActionCost& c = costs[costCount++ % 16];
+    const SimTCN75A::Stats& s = sim.stats();
+    c.name = name;
+    c.transactions = bus.stats().transactions;
+    c.bytes = bus.stats().bytes;
+    c.bus_us = (uint32_t)(bus.stats().bus_ns / 1000);
+    c.reads = s.reads[0] + s.reads[1] + s.reads[2] + s.reads[3];
+    c.writes = s.writes[0] + s.writes[1] + s.writes[2] + s.writes[3];
+}
+
+/**
+ * @brief Print the cost table
+ *
+ * @return void
+ */
+static void printCosts(){
+    printf("\n%-26s | txns | bytes | bus us | reg rd | reg wr\n", "Action");
+    printf("---------------------------+------+-------+--------+--------+-------\n");
+    for(uint8_t i = 0; i < costCount && i < 16; i++){
+        const ActionCost& c = costs[i];
+        printf("%-26s | %4lu | %5lu | %6lu | %6lu | %6lu\n", c.name, (unsigned long)c.transactions,
+               (unsigned long)c.bytes, (unsigned long)c.bus_us, (unsigned long)c.reads, (unsigned long)c.writes);
+    }
+}
+
+//******************************************************//
+//**********************EVENT LOOP**********************//
+//******************************************************//
+
+//Same tasks as the firmware, on the virtual clock
+static const uint32_t DISPLAY_PERIOD_US = 20 * 1000;
+static const uint32_t SAMPLE_DEADLINE_US = 1000;
+static const uint32_t READ_TIMEOUT_US = 10 * 1000;
+
+static uint64_t runSampler(void* context, uint64_t now_us){
+    SamplingScheduler* sampler = static_cast<SamplingScheduler*>(context);
+    sampler->poll(now_us);
+    if(sampler->readPending()){
+        return now_us + READ_TIMEOUT_US;
+    }
+    uint64_t due = sampler->nextDueUs();
+    return due > now_us ? due : now_us;
+}
+
+static bool sampleReady(void* context){
+    return static_cast<SamplingScheduler*>(context)->readDone();
+}
+
+static uint64_t runConsole(void* context, uint64_t now_us){
+    return static_cast<TempSensor*>(context)->pollInput() ? now_us : 0;
+}
+
+static bool consoleReady(void* context){
+    (void)context;
+    return hal::Cpu::inputReady();
+}
+
+static uint64_t runButtons(void* context, uint64_t now_us){
+    (void)now_us;
+    static_cast<TempSensor*>(context)->pollButtons();
+    return buttonEvents.nextDueUs();
+}
+
+static bool buttonsReady(void* context){
+    (void)context;
+    return buttonEvents.pending();
+}
+
+static uint64_t tickLeds(void* context, uint64_t now_us){
+    static_cast<LedEffects*>(context)->tick((uint32_t)(now_us / 1000));
+    return 0;
+}
+
+static uint64_t refreshDisplay(void* context, uint64_t now_us){
+    (void)now_us;
+    static_cast<TempSensor*>(context)->refreshDisplay();
+    return 0;
+}
+
+/**
+ * @brief Add the tasks of core 0
+ *
+ * The firmware also polls the sensor arrays, the host has none.
+ *
+ * @param loop the scheduler
+ * @param sensor driver of the console, buttons and display
+ * @param sampler scheduler of the reads
+ *
+ * @return void
+ */
+static void addTasks(EventLoop& loop, TempSensor& sensor, SamplingScheduler& sampler){
+    loop.addEvent("console", &consoleReady, &runConsole, &sensor);
+    loop.addEvent("buttons", &buttonsReady, &runButtons, &sensor);
+    uint8_t sampling = loop.addEvent("sampling", &sampleReady, &runSampler, &sampler, SAMPLE_DEADLINE_US);
+    loop.setDue(sampling, hal::Clock::nowUs());
+    loop.addTimer("leds", &tickLeds, &leds, LedEffects::TICK_MS * 1000);
+    loop.addTimer("display", &refreshDisplay, &sensor, DISPLAY_PERIOD_US);
+    sensor.setEventLoop(&loop);
+}
+
+int main(int argc, char** argv){
+    bus.attach(&sim);
+    sim.setTemperature(26300);
+
+    //same wiring as the board: SDA 14, SCL 15, LEDs 17 and 16, ALERT 0
+    hal::Cpu::initStdio();
+    I2CBus sensorBus(&bus, 14, 15, 400 * 1000);
+    sensorBus.begin();
+    TempSensor TCN(sensorBus, 17, 16, 0);
+    hal::Clock::sleepMs(100); //let the first conversions complete
+
+    SamplingScheduler sampler(TCN);
+
+    if(argc > 1 && strcmp(argv[1], "--menu") == 0){
+        //same loop as the firmware, typed lines come from stdin,
+        //the samples are drained into the statistics as core 1 does
+        static SampleQueue queue;
+        static StatsBank stats;
+        static RuleEngine rules;
+        static TextStream text(&hal::Cpu::writeRaw);
+        static SampleLog log(hal::Flash::SIZE - SampleLog::MAX_SECTORS * SampleLog::SECTOR_SIZE, SampleLog::MAX_SECTORS);
+        //the log survives between runs in a flash image file
+        hal::Flash::open("tcn75a_flash.bin");
+        log.mount();
+        TCN.setSampler(&sampler);
+        TCN.setSampleSink(&queue);
+        TCN.setStatistics(&stats);
+        TCN.setSampleLog(&log);
+        TCN.setRuleEngine(&rules);
+        TCN.setTextStream(&text);
+        hal::Cpu::useStdin(true);
+        static EventLoop loop;
+        addTasks(loop, TCN, sampler);
+        loop.addEvent("consumer", [](void* context){ return !static_cast<SampleQueue*>(context)->empty(); },
+                      [](void* context, uint64_t now_us) -> uint64_t {
+                          (void)context;
+                          TempSample sample;
+                          bool streaming = text.enabled();
+                          while(queue.pop(sample)){
+                              stats.update(sample);
+                              log.push(sample);
+                              rules.evaluate(sample);
+                              if(streaming){
+                                  text.push(sample, now_us);
+                              }
+                          }
+                          log.flushDue(now_us);
+                          if(streaming){
+                              text.flushDue(now_us);
+                          } else {
+                              text.flush(now_us);
+                          }
+                          return 0;
+                      }, &queue);
+        TCN.MainMenu();
+        loop.run();
+    }
+
+    measure("Temp read (blocking)", [&]{ TCN.get_Temp(); });
+    measure("Temp read (async)", [&]{
+        TCN.Raw_Temp_Read_Async();
+        while(!TCN.Temp_Ready()){
+            hal::Cpu::idle();
+        }
+    });
+    measure("Config read (cached)", [&]{ TCN.readConfigRegister(); });
+    measure("Menu: resolution 12 bit", [&]{ TCN.processResolution('3'); });
+    measure("Menu: fault queue 4", [&]{ TCN.processFaultQ('2'); });
+    measure("Menu: read THYST", [&]{ TCN.Read_Hyst_Reg(); });
+    measure("Scan (targeted)", [&]{ TCN.getScanner().scan(ScanMode::Targeted); });
+    measure("Scan (full)", [&]{ TCN.getScanner().scan(ScanMode::Full); });
+    measure("Max rate sample", [&]{ sampler.waitForSample(1000); });
+    sampler.setPolicy(SamplePolicy::OneShotBurst, 1000, 4);
+    measure("One-shot sample", [&]{ sampler.waitForSample(1000); });
+    sampler.setPolicy(SamplePolicy::MaxRate);
+
+    printCosts();
+
+    char text[16];
+    TCN.get_Temp().format(text, sizeof(text), TempUnit::Celsius);
+    printf("\nSimulated 26.300 C, sensor reads %s\n", text);
+    return 0;
+}
@@ -1,6 +1,21 @@
 #include "../inc/TempSensor.hpp"
+#include "../inc/SensorArray.hpp"
+#include "../inc/AlertMonitor.hpp"
+#include "../inc/SamplingScheduler.hpp"
+#include "../inc/Telemetry.hpp"
+#include "../inc/TextStream.hpp"
+#include "../inc/TempStats.hpp"
+#include "../inc/SampleLog.hpp"
+#include "../inc/AlertRules.hpp"
+#include "../inc/LimitCodec.hpp"
+#include "../inc/ButtonEvents.hpp"
+#include "../inc/EventLoop.hpp"
+#include "../inc/Probe.hpp"
+#include <cctype>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <string>
 
@@ -26,11 +41,11 @@ void TempSensor::ANSI_Codes(){
  * @brief Main Menu options
  *
  * This function prints all the main menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::MainMenu(){
-    
+    PROBE_SCOPE(MainMenu);
     ANSI_Codes();
     std::cout <<" _____ ____ _   _ _____ ____    _    "<< std::endl;
     std::cout <<"|_   _/ ___| \\ | |___  | ___|  / \\   "<< std::endl;
@@ -43,20 +58,24 @@ void TempSensor::MainMenu(){
     std::cout << "    [2] |       Device ID      |" << std::endl;
     std::cout << "    [3] |      Alert Menu      |" << std::endl;
     std::cout << "    [4] |       Temp Menu      |" << std::endl;
+    std::cout << "    [5] |     Sensor Array     |" << std::endl;
+    std::cout << "    [6] |     Binary Stream    |" << std::endl;
+    std::cout << "    [7] |      Statistics      |" << std::endl;
+    std::cout << "    [8] |      Sample Log      |" << std::endl;
+    std::cout << "    [9] |      Alert Rules     |" << std::endl;
 
     // Prompt user for selection
-    std::cout << "Enter your choice: " << std::endl;
-    //Take the user input
-    std::cin >> menu_choice;
-    // Process the user's choice
-    processMainMenu(menu_choice);
+    std::cout << "Enter your choice, or help for the commands: " << std::endl;
+    //the answer comes through pollConsole
+    menu_state = MenuState::Main;
+    redraw_us = 0;
 }
 
 /**
  * @brief Device ID Menu options
  *
  * This function prints all the Device ID menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::DeviceID_Menu(){
@@ -74,18 +93,16 @@ void TempSensor::DeviceID_Menu(){
 
     // Prompt user for selection
     std::cout << "Enter your choice: " << std::endl;
-    //Take the user input
-    std::cin >> ID_choice;
-
-    // // Process the user's choice
-    processDeviceIDMenu(ID_choice);
+    //the answer comes through pollConsole
+    menu_state = MenuState::DeviceID;
+    redraw_us = 0;
 }
 
 /**
  * @brief Alert Configuration Menu options
  *
  * This function prints all the Alert Configuration menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::AlertConfig_Menu(){
@@ -95,22 +112,21 @@ void TempSensor::AlertConfig_Menu(){
     std::cout << "[2] Set Hyst Limit" << std::endl;
     std::cout << "[3] Show Set Limit" << std::endl;
     std::cout << "[4] Show Hyst Limit" << std::endl;
+    std::cout << "[5] Alert History" << std::endl;
     std::cout << "[x] Return to Main Menu" << std::endl;
 
     // Prompt user for selection
     std::cout << "Enter your choice: " << std::endl;
-    //Take the user input
-    std::cin >> Alert_choice;
-    
-    // // Process the user's choice
-    processAlertMenu(Alert_choice);
+    //the answer comes through pollConsole
+    menu_state = MenuState::Alert;
+    redraw_us = 0;
 }
 
 /**
  * @brief Configuration settings Menu options
  *
  * This function prints all the Configuration settings menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::Config_Menu(){
@@ -121,15 +137,14 @@ void TempSensor::Config_Menu(){
     std::cout << "[3] FAULT QUEUE" << std::endl;
     std::cout << "[4] ADC RES" << std::endl;
     std::cout << "[5] ONE-SHOT" << std::endl;
+    std::cout << "[6] Register cache stats" << std::endl;
     std::cout << "[x] Return to Main Menu" << std::endl;
 
     // Prompt user for selection
     std::cout << "Enter your choice: " << std::endl;
-    //Take the user input
-    std::cin >> config_choice;
-
-    // // Process the user's choice
-    processConfigMenu(config_choice);
+    //the answer comes through pollConsole
+    menu_state = MenuState::Config;
+    redraw_us = 0;
 }
 
 /**
@@ -137,12 +152,13 @@ void TempSensor::Config_Menu(){
  *
  * This function prints The Temperature in Real time
  * using Celsius and Fahrenheit units.
- * At the moment I have it return to main menu automatically
- * because that makes it update the temperature much more frequently.
+ * The screen is redrawn by pollConsole until x is entered,
+ * showing the last scheduled sample so nothing waits on the bus.
  *
  */
 void TempSensor::Temperature_Read_Menu(){
-    char returnMenu;
+    PROBE_SCOPE(TempScreen);
+    char tempC[16], tempF[16];
     
     ANSI_Codes();
     std::cout << "REAL TIME TEMPERATURE" << std::endl;
@@ -150,9 +166,348 @@ void TempSensor::Temperature_Read_Menu(){
 
     std::cout << "   Temp C    |    Temp F   " << std::endl;
     std::cout << "-------------+-------------\n" << std::endl;
-    printf("   %0.4f   |    %0.4f    \n", get_Temp_C(), get_Temp_F());
+    //the sampler keeps the last reading up to date, without it read on demand
+    TempQ8 temp = sampler ? last_Temp() : get_Temp();
+    //format straight from the register value, no soft-float
+    temp.format(tempC, sizeof(tempC), TempUnit::Celsius);
+    temp.format(tempF, sizeof(tempF), TempUnit::Fahrenheit);
+    printf("   %s   |    %s    \n", tempC, tempF);
+    if(sampler){
+        printf("\n");
+        sampler->printStats();
+    }
     std::cout << "\n[x] Return to main\n" << std::endl;
-    sleep_ms(500); //delay the return to main menu
+    menu_state = MenuState::Temperature;
+    holdScreen(TEMP_REFRESH_MS);
+}
+
+/**
+ * @brief Binary stream
+ *
+ * Switches the sample output from text to framed binary records,
+ * sent in batches by the sample consumer. The terminal shows raw
+ * bytes until x is entered; the host decoder skips this menu text.
+ *
+ */
+void TempSensor::Stream_Menu(){
+    if(!telemetry){
+        std::cout << "Binary stream not available" << std::endl;
+        return;
+    }
+    ANSI_Codes();
+    std::cout << "BINARY STREAM" << std::endl;
+    std::cout << "[x] Stop streaming" << std::endl;
+
+    telemetry->setEnabled(true);
+    menu_state = MenuState::Stream;
+    redraw_us = 0;
+}
+
+/**
+ * @brief Text stream
+ *
+ * One readable line per sample. Core 0 only pushes the raw samples:
+ * the conversion, the formatting and the USB writes are done by the
+ * sample consumer on core 1, and lines over the link rate are dropped
+ * there instead of slowing the acquisition.
+ *
+ */
+void TempSensor::Text_Stream_Menu(){
+    if(!text_stream){
+        std::cout << "Text stream not available" << std::endl;
+        return;
+    }
+    ANSI_Codes();
+    std::cout << "TEXT STREAM" << std::endl;
+    std::cout << "[x] Stop streaming\n" << std::endl;
+
+    text_stream->resetStats();
+    text_stream->setEnabled(true);
+    menu_state = MenuState::Stream;
+    redraw_us = 0;
+}
+
+/**
+ * @brief Prints the statistics
+ *
+ * Rolling window min/max/mean/deviation, EWMA and the mean and
+ * deviation since the last reset of every sensor that has readings.
+ * The values come from the consumer core, formatted from Q8.8.
+ *
+ */
+void TempSensor::Stats_Menu(){
+    if(!stats_bank){
+        std::cout << "Statistics not available" << std::endl;
+        return;
+    }
+    StatsSummary table[StatsBank::MAX_SENSORS];
+    uint8_t n = stats_bank->summaries(table, StatsBank::MAX_SENSORS);
+
+    printf("STATISTICS (window %u, EWMA 1/%u)\n\n", stats_bank->window(), 1u << stats_bank->ewmaShift());
+    printf("Addr | Samples |   Min    |   Max    |   Mean   |  StdDev  |   EWMA   | All mean | All std\n");
+    printf("-----+---------+----------+----------+----------+----------+----------+----------+---------\n");
+    for(uint8_t i = 0; i < n; i++){
+        const StatsSummary& s = table[i];
+        char min[16], max[16], mean[16], dev[16], ewma[16], allMean[16], allDev[16];
+        TempQ8::fromRaw((uint16_t)s.min).format(min, sizeof(min), TempUnit::Celsius);
+        TempQ8::fromRaw((uint16_t)s.max).format(max, sizeof(max), TempUnit::Celsius);
+        TempQ8::fromRaw((uint16_t)s.mean).format(mean, sizeof(mean), TempUnit::Celsius);
+        TempQ8::fromRaw(s.stddev).format(dev, sizeof(dev), TempUnit::Celsius);
+        TempQ8::fromRaw((uint16_t)s.ewma).format(ewma, sizeof(ewma), TempUnit::Celsius);
+        TempQ8::fromRaw((uint16_t)s.total_mean).format(allMean, sizeof(allMean), TempUnit::Celsius);
+        TempQ8::fromRaw(s.total_stddev).format(allDev, sizeof(allDev), TempUnit::Celsius);
+        printf("0x%02X | %7lu | %8s | %8s | %8s | %8s | %8s | %8s | %7s\n", s.addr, (unsigned long)s.samples,
+               min, max, mean, dev, ewma, allMean, allDev);
+    }
+    if(n == 0){
+        printf("No readings yet\n");
+    }
+}
+
+//Line budget of a log dump, handed to the query callback
+struct LogDump{
+    uint16_t lines;
+    uint16_t max_lines;
+};
+
+//Prints one logged sample as "time, address, temperature"
+static void printLogged(const TempSample& sample, void* context){
+    LogDump* dump = static_cast<LogDump*>(context);
+    if(dump->lines++ >= dump->max_lines){
+        return;
+    }
+    char text[16];
+    TempQ8::fromRaw(sample.raw).format(text, sizeof(text), TempUnit::Celsius);
+    uint64_t ms = sample.timestamp_us / 1000;
+    printf("%10lu.%03u, 0x%02X, %s\n", (unsigned long)(ms / 1000), (unsigned)(ms % 1000), sample.addr, text);
+}
+
+/**
+ * @brief Prints logged samples
+ *
+ * @param from_ms first log time, inclusive
+ * @param to_ms last log time, inclusive
+ * @param max_lines samples printed at most, the rest are only counted
+ *
+ * @return void
+ */
+void TempSensor::dumpLog(uint64_t from_ms, uint64_t to_ms, uint16_t max_lines){
+    if(!sample_log){
+        std::cout << "Sample log not available" << std::endl;
+        return;
+    }
+    LogDump dump = {0, max_lines};
+    printf("Time (s), Addr, Temp (C)\n");
+    uint32_t found = sample_log->query(from_ms, to_ms, &printLogged, &dump);
+    const SampleLog::Stats& st = sample_log->stats();
+    printf("%lu samples (%lu sectors read, %lu skipped)\n", (unsigned long)found,
+           (unsigned long)st.decoded, (unsigned long)st.skipped);
+}
+
+/**
+ * @brief Prints the sample log
+ *
+ * Space used, compression and write cost of the flash log, then
+ * the last minute of samples. Times are seconds of log time,
+ * which carries on across reboots.
+ *
+ */
+void TempSensor::Log_Menu(){
+    if(!sample_log){
+        std::cout << "Sample log not available" << std::endl;
+        return;
+    }
+    const SampleLog::Stats& st = sample_log->stats();
+    printf("SAMPLE LOG\n\n");
+    printf("Stored samples : %lu\n", (unsigned long)sample_log->storedSamples());
+    printf("Logged (boot)  : %lu samples, %lu bytes", (unsigned long)st.samples, (unsigned long)st.bytes);
+    if(st.samples){
+        printf(", %lu.%02lu bytes/sample", (unsigned long)(st.bytes / st.samples),
+               (unsigned long)(st.bytes * 100 / st.samples % 100));
+    }
+    printf("\nSectors written: %lu, longest %lu us\n", (unsigned long)st.sectors, (unsigned long)st.max_commit_us);
+    printf("Mount          : %u valid, %u corrupt\n", st.mounted, st.corrupt);
+    printf("Dropped        : %lu\n\n", (unsigned long)st.dropped);
+
+    uint64_t last = sample_log->lastMs();
+    dumpLog(last > 60000 ? last - 60000 : 0, last, 20);
+}
+
+//Rule kinds and outputs as typed on the console, indexed by RuleKind / bit
+static const char* const ruleKindNames[] = {"above", "below", "rate", "time"};
+static const char* const ruleOutputNames[] = {"red", "green", "alert"};
+
+//Case-insensitive match of the first len characters of text against a whole name
+static bool matchName(const char* text, size_t len, const char* name){
+    if(strlen(name) != len){
+        return false;
+    }
+    for(size_t i = 0; i < len; i++){
+        if(tolower((unsigned char)text[i]) != name[i]){
+            return false;
+        }
+    }
+    return true;
+}
+
+//Typed temperature to a Q8.8 word, rounded to the register step
+static bool parseTemp(const char* text, int16_t& raw){
+    int32_t milli;
+    if(tcn75a::parseCelsius(text, milli) != tcn75a::ParseError::None || milli < -128000 || milli > 127996){
+        return false;
+    }
+    raw = (int16_t)TempQ8::fromMilliCelsius(milli).toRaw();
+    return true;
+}
+
+/**
+ * @brief Prints the alert rules
+ *
+ * Every rule with its sensor, threshold and LEDs, and whether it
+ * is active now, then the evaluation cost on the consumer core.
+ *
+ */
+void TempSensor::Rules_Menu(){
+    if(!rule_engine){
+        std::cout << "Alert rules not available" << std::endl;
+        return;
+    }
+    printf("ALERT RULES\n\n");
+    printf("  # | Addr | Kind  |  Limit C  | Hyst / time | LEDs            | State\n");
+    printf("----+------+-------+-----------+-------------+-----------------+-------\n");
+    for(uint16_t i = 0; i < rule_engine->count(); i++){
+        const RuleSpec& r = rule_engine->rule(i);
+        char addr[8], limit[16], param[16], leds[20] = "";
+        if(r.addr == RuleEngine::ANY_SENSOR){
+            snprintf(addr, sizeof(addr), "any");
+        } else {
+            snprintf(addr, sizeof(addr), "0x%02X", r.addr);
+        }
+        TempQ8::fromRaw((uint16_t)r.limit).format(limit, sizeof(limit), TempUnit::Celsius);
+        if(r.kind == RuleKind::Above || r.kind == RuleKind::Below){
+            TempQ8::fromRaw((uint16_t)r.hyst).format(param, sizeof(param), TempUnit::Celsius);
+        } else {
+            snprintf(param, sizeof(param), "%lu s", (unsigned long)(r.time_ms / 1000));
+        }
+        for(uint8_t o = 0; o < rule_out::COUNT; o++){
+            if(r.outputs & (1 << o)){
+                if(leds[0]){
+                    strncat(leds, "+", sizeof(leds) - strlen(leds) - 1);
+                }
+                strncat(leds, ruleOutputNames[o], sizeof(leds) - strlen(leds) - 1);
+            }
+        }
+        printf("%3u | %4s | %-5s | %9s | %11s | %-15s | %s\n", i, addr, ruleKindNames[(uint8_t)r.kind], limit,
+               param, leds, rule_engine->active(i) ? "ACTIVE" : "-");
+    }
+    if(rule_engine->count() == 0){
+        printf("No rules, add one with: rule <addr|any> above|below|rate|time <C> <hyst C|s> <red+green+alert>\n");
+    }
+    const RuleEngine::Stats& st = rule_engine->stats();
+    printf("\n%lu samples, %lu rule checks, %lu changes, %lu us\n", (unsigned long)st.samples,
+           (unsigned long)st.checks, (unsigned long)st.changes, (unsigned long)st.cpu_us);
+}
+
+/**
+ * @brief Add a rule from the console
+ *
+ * "rule 0x48 above 30 0.5 red": high band with 0.5 C hysteresis,
+ * "rule any below 5 1 green+alert": low band on every sensor,
+ * "rule 0x49 rate 2 60 alert": 2 C per minute measured over 60 s,
+ * "rule 0x48 time 28 300 red": above 28 C for 5 minutes.
+ *
+ * @param cmd words of the line, 6 of them
+ *
+ * @return bool false if the rule is not valid or does not fit
+ */
+bool TempSensor::addRule(const CommandParser::Command& cmd){
+    RuleSpec spec = RuleSpec();
+    if(CommandParser::equals(cmd.argv[1], "any")){
+        spec.addr = RuleEngine::ANY_SENSOR;
+    } else {
+        spec.addr = (uint8_t)strtoul(cmd.argv[1], nullptr, 16);
+    }
+
+    uint8_t kind = 0;
+    while(kind < 4 && !CommandParser::equals(cmd.argv[2], ruleKindNames[kind])){
+        kind++;
+    }
+    if(kind == 4 || !parseTemp(cmd.argv[3], spec.limit)){
+        return false;
+    }
+    spec.kind = (RuleKind)kind;
+    if(spec.kind == RuleKind::Above || spec.kind == RuleKind::Below){
+        if(!parseTemp(cmd.argv[4], spec.hyst)){
+            return false;
+        }
+    } else {
+        spec.time_ms = (uint32_t)strtoul(cmd.argv[4], nullptr, 10) * 1000;
+    }
+
+    //outputs joined with '+'
+    for(const char* p = cmd.argv[5]; *p;){
+        uint8_t o = 0;
+        size_t len = strcspn(p, "+");
+        while(o < rule_out::COUNT && !matchName(p, len, ruleOutputNames[o])){
+            o++;
+        }
+        if(o == rule_out::COUNT){
+            return false;
+        }
+        spec.outputs |= 1 << o;
+        p += len;
+        if(*p == '+'){
+            p++;
+        }
+    }
+    return spec.outputs && rule_engine->add(spec);
+}
+
+/**
+ * @brief Rule LEDs
+ *
+ * The red and green LEDs follow the outputs of the rules the
+ * consumer core evaluates. Only changes are written, so the
+ * menu blinks still show between them.
+ *
+ * @return void
+ */
+void TempSensor::updateRuleLeds(){
+    uint8_t bits = rule_engine->outputs();
+    uint8_t changed = bits ^ rule_leds;
+    if(changed & rule_out::RED){
+        red_led.changeState(bits & rule_out::RED ? 1 : 0);
+    }
+    if(changed & rule_out::GREEN){
+        green_led.changeState(bits & rule_out::GREEN ? 1 : 0);
+    }
+    rule_leds = bits;
+}
+
+/**
+ * @brief Stop the binary or text stream
+ *
+ * @return void
+ */
+void TempSensor::stopStream(){
+    if(text_stream && text_stream->enabled()){
+        text_stream->setEnabled(false);
+        const TextStream::Stats& ts = text_stream->stats();
+        printf("\nText stream stopped: %lu lines, %lu dropped over the link rate, latency avg %lu us max %lu us\n",
+               (unsigned long)ts.lines, (unsigned long)ts.dropped,
+               (unsigned long)(ts.lines ? ts.latency_us / ts.lines : 0), (unsigned long)ts.max_latency_us);
+        if(sample_sink){
+            printf("Samples dropped before core 1: %lu\n", (unsigned long)sample_sink->dropped());
+        }
+    }
+    if(!telemetry || !telemetry->enabled()){
+        return;
+    }
+    telemetry->setEnabled(false);
+
+    const TelemetryStream::Stats& st = telemetry->stats();
+    printf("\nStream stopped: %lu frames, %lu samples, %lu bytes\n", (unsigned long)st.frames,
+           (unsigned long)st.samples, (unsigned long)st.bytes);
 }
 
 /**
@@ -186,6 +541,32 @@ void TempSensor::processMainMenu(const char& choice) {
             // Handle option 4
             Temperature_Read_Menu();
             break;
+        case '5':
+            // Handle option 5
+            if(sensor_array){
+                ANSI_Codes();
+                sensor_array->printStatus();
+            }
+            break;
+        case '6':
+            // Handle option 6
+            Stream_Menu();
+            break;
+        case '7':
+            // Handle option 7
+            ANSI_Codes();
+            Stats_Menu();
+            break;
+        case '8':
+            // Handle option 8
+            ANSI_Codes();
+            Log_Menu();
+            break;
+        case '9':
+            // Handle option 9
+            ANSI_Codes();
+            Rules_Menu();
+            break;
         case 'x':
         case 'X':
             // Handle exit option
@@ -256,64 +637,28 @@ void TempSensor::processDeviceIDMenu(const char& choice) {
  *
  * This function handles the choice picked by the
  * user in the Alert menu options.
- * Depending on the choice, it will either set the MAX | MIN
+ * Depending on the choice, it will either ask for the MAX | MIN
  * limits, or it will read them and print them.
  *
  */
 void TempSensor::processAlertMenu(const char& choice) {
-    std::string input;
-    int temperature_tenths = 0;
-    uint8_t msb;
-    uint8_t lsb;
     switch (choice) {
         case '0':
             // Handle option 0
             break;
         case '1':
             // Handle option 1
-            std::cout << "Enter a MAX Temp limit of up to 1 decimal place" << std::endl;
-            //take the user inputted temperature
-            input = get_input();
-            
-            //Parse the input string into an integer representing temperature in tenths of a degree Celsius
-            for (int i = 0; i < input.length(); ++i) {
-                if (isdigit(input[i])) {
-                    temperature_tenths = temperature_tenths * 10 + (input[i] - '0');
-                } else if(input[i] == '.'){
-                    continue;
-                } else {
-                    std::cout << "Invalid input! Please try again" << std::endl;
-                }
-            }
-            
-            std::cout << "Limit set to: " << input << std::endl;
-            // Calculate MSB and LSB
-            msb = temperature_tenths / 10;  // Extract tens and units digits
-            lsb = (temperature_tenths % 10 == 5) ? 0x80 : 0;  // Extract tenths digit
-            set_limit[0] = msb;
-            set_limit[1] = lsb;
-            Write_Set_Reg();
+            std::cout << "Enter a MAX Temp limit in C, -40 to 125 (rounded to 0.5 C)" << std::endl;
+            //the next line typed is the limit
+            menu_state = MenuState::SetLimit;
+            redraw_us = 0;
             break;
         case '2':
             // Handle option 2
-            std::cout << "Enter a MIN Temp limit of up to 1 decimal place" << std::endl;
-            //take the user inputted temperature
-            input = get_input();
-            
-            // Parse the input string into an integer representing temperature in tenths of a degree Celsius
-            for (int i = 0; i < input.length(); ++i) {
-                if (isdigit(input[i])) {
-                    temperature_tenths = temperature_tenths * 10 + (input[i] - '0');
-                }
-            }
-            
-            std::cout << "Limit set to: " << input << std::endl;
-            // Calculate MSB and LSB
-            msb = temperature_tenths / 10;  // Extract tens and units digits
-            lsb = (temperature_tenths % 10 == 5) ? 0x80 : 0;  // Extract tenths digit
-            hyst_limit[0] = msb;
-            hyst_limit[1] = lsb;
-            Write_Hyst_Reg();
+            std::cout << "Enter a MIN Temp limit in C, -40 to 125 (rounded to 0.5 C)" << std::endl;
+            //the next line typed is the limit
+            menu_state = MenuState::HystLimit;
+            redraw_us = 0;
             break;
         case '3':
             // Handle option 3
@@ -323,6 +668,12 @@ void TempSensor::processAlertMenu(const char& choice) {
             // Handle option 4
             Read_Hyst_Reg();
             break;
+        case '5':
+            // Handle option 5
+            if(alert_monitor){
+                alert_monitor->printHistory();
+            }
+            break;
         case 'x':
         case 'X':
             // Handle exit option
@@ -369,6 +720,10 @@ void TempSensor::processConfigMenu(const char& choice) {
             // Handle option 5
             One_Shot_Menu();
             break;
+        case '6':
+            // Handle option 6
+            printShadowStats();
+            break;
         case 'x':
         case 'X':
             // Handle exit option
@@ -388,7 +743,7 @@ void TempSensor::processConfigMenu(const char& choice) {
  * @brief Shutdown Menu options
  *
  * This function prints all the menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::Shutdown_Menu(){
@@ -400,16 +755,16 @@ void TempSensor::Shutdown_Menu(){
 
     // Prompt user for selection
     std::cout << "Enter your choice: ";
-    std::cin >> Shutdown_choice;
-    // Process the user's choice
-    processShutdown(Shutdown_choice);
+    //the answer comes through pollConsole
+    menu_state = MenuState::Shutdown;
+    redraw_us = 0;
 }
 
 /**
  * @brief Comp/Int Menu options
  *
  * This function prints all the menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::COMP_INT_Menu(){
@@ -421,16 +776,16 @@ void TempSensor::COMP_INT_Menu(){
 
     // Prompt user for selection
     std::cout << "Enter your choice: ";
-    std::cin >> Comp_Int_Choice;
-    // Process the user's choice
-    processCompInt(Comp_Int_Choice);
+    //the answer comes through pollConsole
+    menu_state = MenuState::CompInt;
+    redraw_us = 0;
 }
 
 /**
  * @brief Alert Polarity Menu options
  *
  * This function prints all the menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::Alert_Polarity_Menu(){
@@ -442,16 +797,16 @@ void TempSensor::Alert_Polarity_Menu(){
 
     // Prompt user for selection
     std::cout << "Enter your choice: ";
-    std::cin >> Polarity_choice;
-    // Process the user's choice
-    processPolarity(Polarity_choice);
+    //the answer comes through pollConsole
+    menu_state = MenuState::Polarity;
+    redraw_us = 0;
 }
 
 /**
  * @brief Fault_Queue Menu options
  *
  * This function prints all the menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::FAULT_QUEUE_Menu(){
@@ -465,16 +820,16 @@ void TempSensor::FAULT_QUEUE_Menu(){
 
     // Prompt user for selection
     std::cout << "Enter your choice: ";
-    std::cin >> Fault_choice;
-    // Process the user's choice
-    processFaultQ(Fault_choice);
+    //the answer comes through pollConsole
+    menu_state = MenuState::FaultQueue;
+    redraw_us = 0;
 }
 
 /**
  * @brief ADC Resolution Menu options
  *
  * This function prints all the menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::ADC_RES(){
@@ -488,16 +843,16 @@ void TempSensor::ADC_RES(){
 
     // Prompt user for selection
     std::cout << "Enter your choice: ";
-    std::cin >> ADC_choice;
-    // Process the user's choice
-    processResolution(ADC_choice);
+    //the answer comes through pollConsole
+    menu_state = MenuState::Resolution;
+    redraw_us = 0;
 }
 
 /**
  * @brief One Shot Menu options
  *
  * This function prints all the menu 
- * options and waits for the user input
+ * options. The answer is read by pollConsole
  *
  */
 void TempSensor::One_Shot_Menu(){
@@ -505,51 +860,45 @@ void TempSensor::One_Shot_Menu(){
     std::cout << "One SHOT Setting" << std::endl;
     std::cout << "[0] Disable" << std::endl;
     std::cout << "[1] Enable" << std::endl;
+    std::cout << "[2] Low power logging (4 one-shots every 10 s)" << std::endl;
+    std::cout << "[3] Continuous sampling" << std::endl;
     std::cout << "[x] Return to Main Menu" << std::endl;
 
     // Prompt user for selection
     std::cout << "Enter your choice: ";
-    std::cin >> OneShot_choice;
-    // Process the user's choice
-    processOneShot(OneShot_choice);
+    //the answer comes through pollConsole
+    menu_state = MenuState::OneShot;
+    redraw_us = 0;
 }
 
 /**
  * @brief Process ADC Resolution choice
  *
- * This function will set the appropriate bits in
+ * This function will set the appropriate field in
  * the config register to change the proper setting.
- * The Verify Reg makes sure the proper bits were
- * correctly changed.
+ * The mask comes from the tcn75a register map and the
+ * Verify Reg makes sure the proper bits were correctly changed.
  *
  */
-void TempSensor::processResolution(const char& choice) {
-    uint8_t mask = 0b01100000;  // Mask for ADC resolution bits in the configuration register
-    
+void TempSensor::processResolution(const char& choice){
+    using namespace tcn75a;
+
     switch (choice) {
         case '0':
             // Set ADC resolution to 9 bits or 0.5 decimal value
-            modifyConfigRegister(mask, 0b00000000);
-            std::cout << "Changed Resolution to 9 bits" << std::endl;
-            VerifyReg(mask, 0b00000000);
+            changeConfig(ConfigEdit().set(Resolution::Bits9), "Changed Resolution to 9 bits");
             break;
         case '1':
             // Set ADC resolution to 10 bits or 0.25 decimal value
-            modifyConfigRegister(mask, 0b00100000);
-            std::cout << "Changed Resolution to 10 bits" << std::endl;
-            VerifyReg(mask, 0b00100000);
+            changeConfig(ConfigEdit().set(Resolution::Bits10), "Changed Resolution to 10 bits");
             break;
         case '2':
             // Set ADC resolution to 11 bits or 0.125 decimal value
-            modifyConfigRegister(mask, 0b01000000);
-            std::cout << "Changed Resolution to 11 bits" << std::endl;
-            VerifyReg(mask, 0b01000000);
+            changeConfig(ConfigEdit().set(Resolution::Bits11), "Changed Resolution to 11 bits");
             break;
         case '3':
             // Set ADC resolution to 12 bits or 0.0625 decimal value
-            modifyConfigRegister(mask, 0b01100000);
-            std::cout << "Changed Resolution to 12 bits" << std::endl;
-            VerifyReg(mask, 0b01100000);
+            changeConfig(ConfigEdit().set(Resolution::Bits12), "Changed Resolution to 12 bits");
             break;
         case 'x':
         case 'X':
@@ -565,28 +914,23 @@ void TempSensor::processResolution(const char& choice) {
 /**
  * @brief Process Shutdown choice
  *
- * This function will set the appropriate bits in
+ * This function will set the appropriate field in
  * the config register to change the proper setting.
- * The Verify Reg makes sure the proper bits were
- * correctly changed.
+ * The mask comes from the tcn75a register map and the
+ * Verify Reg makes sure the proper bits were correctly changed.
  *
  */
 void TempSensor::processShutdown(const char& choice){
-    // Mask for ADC resolution bits in the configuration register
-    uint8_t mask = 0b00000001;  
+    using namespace tcn75a;
 
     switch (choice) {
         case '0':
             // default: Disabled
-            modifyConfigRegister(mask, 0b00000000);
-            std::cout << "Shutdown Disabled" << std::endl;
-            VerifyReg(mask, 0b00000000);
+            changeConfig(ConfigEdit().set(Shutdown::Disable), "Shutdown Disabled");
             break;
         case '1':
             // Shutdown Enabled
-            modifyConfigRegister(mask, 0b00000001);
-            std::cout << "Shutdown enabled" << std::endl;
-            VerifyReg(mask, 0b00000001);
+            changeConfig(ConfigEdit().set(Shutdown::Enable), "Shutdown enabled");
             break;
         case 'x':
         case 'X':
@@ -602,28 +946,23 @@ void TempSensor::processShutdown(const char& choice){
 /**
  * @brief Process Comparator/Interrupt choice
  *
- * This function will set the appropriate bits in
+ * This function will set the appropriate field in
  * the config register to change the proper setting.
- * The Verify Reg makes sure the proper bits were
- * correctly changed.
+ * The mask comes from the tcn75a register map and the
+ * Verify Reg makes sure the proper bits were correctly changed.
  *
  */
 void TempSensor::processCompInt(const char& choice){
-    // Mask for ADC resolution bits in the configuration register
-    uint8_t mask = 0b00000010;  
+    using namespace tcn75a;
 
     switch (choice) {
         case '0':
             // Default: set Alert to comparator mode
-            modifyConfigRegister(mask, 0b00000000);
-            std::cout << "Comparator Mode" << std::endl;
-            VerifyReg(mask, 0b00000000);
+            changeConfig(ConfigEdit().set(AlertMode::Comparator), "Comparator Mode");
             break;
         case '1':
             // Set Alert to Interrupt mode
-            modifyConfigRegister(mask, 0b00000010);
-            std::cout << "Interrupt Mode" << std::endl;
-            VerifyReg(mask, 0b00000010);
+            changeConfig(ConfigEdit().set(AlertMode::Interrupt), "Interrupt Mode");
             break;
         case 'x':
         case 'X':
@@ -639,28 +978,23 @@ void TempSensor::processCompInt(const char& choice){
 /**
  * @brief Process Polarity choice
  *
- * This function will set the appropriate bits in
+ * This function will set the appropriate field in
  * the config register to change the proper setting.
- * The Verify Reg makes sure the proper bits were
- * correctly changed.
+ * The mask comes from the tcn75a register map and the
+ * Verify Reg makes sure the proper bits were correctly changed.
  *
  */
 void TempSensor::processPolarity(const char& choice){
-    // Mask for ADC resolution bits in the configuration register
-    uint8_t mask = 0b00000100;  
+    using namespace tcn75a;
 
     switch (choice) {
         case '0':
             // Default: active low 
-            modifyConfigRegister(mask, 0b00000000);
-            std::cout << "Active low" << std::endl;
-            VerifyReg(mask, 0b00000000);
+            changeConfig(ConfigEdit().set(Polarity::ActiveLow), "Active low");
             break;
         case '1':
             // Active high
-            modifyConfigRegister(mask, 0b00000100);
-            std::cout << "Active high" << std::endl;
-            VerifyReg(mask, 0b00000100);
+            changeConfig(ConfigEdit().set(Polarity::ActiveHigh), "Active high");
             break;
         case 'x':
         case 'X':
@@ -676,39 +1010,31 @@ void TempSensor::processPolarity(const char& choice){
 /**
  * @brief Process Fault Queue choice
  *
- * This function will set the appropriate bits in
+ * This function will set the appropriate field in
  * the config register to change the proper setting.
- * The Verify Reg makes sure the proper bits were
- * correctly changed.
+ * The mask comes from the tcn75a register map and the
+ * Verify Reg makes sure the proper bits were correctly changed.
  *
  */
 void TempSensor::processFaultQ(const char& choice){
-    uint8_t mask = 0b00011000;  // Mask for ADC resolution bits in the configuration register
-    
+    using namespace tcn75a;
+
     switch (choice) {
         case '0':
             // Default: a fault queue of 1
-            modifyConfigRegister(mask, 0b00000000);
-            std::cout << "1 queue" << std::endl;
-            VerifyReg(mask, 0b00000000);
+            changeConfig(ConfigEdit().set(FaultQueue::One), "1 queue");
             break;
         case '1':
             // Fault queue of 2
-            modifyConfigRegister(mask, 0b00001000);
-            std::cout << "2 queue" << std::endl;
-            VerifyReg(mask, 0b00001000);
+            changeConfig(ConfigEdit().set(FaultQueue::Two), "2 queue");
             break;
         case '2':
             // Fault queue of 4
-            modifyConfigRegister(mask, 0b00010000);
-            std::cout << "4 queue" << std::endl;
-            VerifyReg(mask, 0b00010000);
+            changeConfig(ConfigEdit().set(FaultQueue::Four), "4 queue");
             break;
         case '3':
             // Fault queue of 6
-            modifyConfigRegister(mask, 0b00011000);
-            std::cout << "6 queue" << std::endl;
-            VerifyReg(mask, 0b00011000);
+            changeConfig(ConfigEdit().set(FaultQueue::Six), "6 queue");
             break;
         case 'x':
         case 'X':
@@ -724,28 +1050,37 @@ void TempSensor::processFaultQ(const char& choice){
 /**
  * @brief Process One Shot choice
  *
- * This function will set the appropriate bits in
+ * This function will set the appropriate field in
  * the config register to change the proper setting.
- * The Verify Reg makes sure the proper bits were
- * correctly changed.
+ * The mask comes from the tcn75a register map and the
+ * Verify Reg makes sure the proper bits were correctly changed.
  *
  */
 void TempSensor::processOneShot(const char& choice){
-    // Mask for ADC resolution bits in the configuration register
-    uint8_t mask = 0b10000000;  
+    using namespace tcn75a;
 
     switch (choice) {
         case '0':
             // Default: Disable
-            modifyConfigRegister(mask, 0b00000000);
-            std::cout << "Disabled OneShot" << std::endl;
-            VerifyReg(mask, 0b00000000);
+            changeConfig(ConfigEdit().set(OneShot::Disable), "Disabled OneShot");
             break;
         case '1':
             // Enable
-            modifyConfigRegister(mask, 0b10000000);
-            std::cout << "Enabled Oneshot" << std::endl;
-            VerifyReg(mask, 0b10000000);
+            changeConfig(ConfigEdit().set(OneShot::Enable), "Enabled Oneshot");
+            break;
+        case '2':
+            // Shutdown between bursts of one-shot conversions
+            if(sampler){
+                sampler->setPolicy(SamplePolicy::OneShotBurst, 10000, 4);
+                std::cout << "Low power logging started" << std::endl;
+            }
+            break;
+        case '3':
+            // Back to continuous conversions
+            if(sampler){
+                sampler->setPolicy(SamplePolicy::MaxRate);
+                std::cout << "Continuous sampling" << std::endl;
+            }
             break;
         case 'x':
         case 'X':
@@ -756,4 +1091,614 @@ void TempSensor::processOneShot(const char& choice){
             std::cout << "Invalid choice. Please try again." << std::endl;
             break;
     }
-}
\ No newline at end of file
+}
+//******************************************************//
+//*******************CONSOLE FUNCTIONS******************//
+//******************************************************//
+
+//A value of a scripted command and the menu answer it stands for
+struct ConsoleChoice{
+    const char* value; //word typed, "" for a command without value
+    char choice;
+};
+
+//Scripted command, run through the same handler as its menu
+struct ConsoleCommand{
+    const char* verb;
+    const char* object; //second word, nullptr for commands of one word
+    void (TempSensor::*process)(const char& choice);
+    const ConsoleChoice* values;
+    uint8_t count;
+    const char* usage;
+};
+
+static const ConsoleChoice resValues[] = {{"9", '0'}, {"10", '1'}, {"11", '2'}, {"12", '3'}};
+static const ConsoleChoice shdnValues[] = {{"off", '0'}, {"0", '0'}, {"on", '1'}, {"1", '1'}};
+static const ConsoleChoice modeValues[] = {{"comp", '0'}, {"int", '1'}};
+static const ConsoleChoice polValues[] = {{"low", '0'}, {"high", '1'}};
+static const ConsoleChoice fqValues[] = {{"1", '0'}, {"2", '1'}, {"4", '2'}, {"6", '3'}};
+static const ConsoleChoice oneShotValues[] = {{"off", '0'}, {"on", '1'}, {"log", '2'}, {"cont", '3'}};
+static const ConsoleChoice addrValues[] = {{"0x48", '0'}, {"0x49", '1'}, {"0x4A", '2'}, {"0x4B", '3'},
+                                           {"0x4C", '4'}, {"0x4D", '5'}, {"0x4E", '6'}, {"0x4F", '7'}};
+static const ConsoleChoice streamValues[] = {{"on", 's'}, {"text", 'l'}, {"off", 'q'}};
+static const ConsoleChoice readTemp[] = {{"", 't'}};
+static const ConsoleChoice readConfig[] = {{"", 'c'}};
+static const ConsoleChoice readStats[] = {{"", 'p'}};
+static const ConsoleChoice readBus[] = {{"", 'b'}};
+static const ConsoleChoice readTasks[] = {{"", 'k'}};
+static const ConsoleChoice readSet[] = {{"", '3'}};
+static const ConsoleChoice readHyst[] = {{"", '4'}};
+static const ConsoleChoice readAlerts[] = {{"", '5'}};
+static const ConsoleChoice readArray[] = {{"", '5'}};
+static const ConsoleChoice readCache[] = {{"", '6'}};
+static const ConsoleChoice scanBus[] = {{"", '0'}};
+static const ConsoleChoice showMain[] = {{"", 'm'}};
+static const ConsoleChoice showHelp[] = {{"", 'h'}};
+static const ConsoleChoice statsValues[] = {{"", 'a'}, {"reset", 'r'}};
+static const ConsoleChoice logValues[] = {{"", 'g'}, {"flush", 'f'}};
+static const ConsoleChoice rulesValues[] = {{"", 'u'}};
+static const ConsoleChoice probeValues[] = {{"", 'o'}, {"reset", 'z'}};
+
+#define CHOICES(values) values, sizeof(values) / sizeof(values[0])
+
+static const ConsoleCommand commands[] = {
+    {"read", "temp", &TempSensor::processConsole, CHOICES(readTemp), "read temp"},
+    {"read", "config", &TempSensor::processConsole, CHOICES(readConfig), "read config"},
+    {"read", "set", &TempSensor::processAlertMenu, CHOICES(readSet), "read set"},
+    {"read", "hyst", &TempSensor::processAlertMenu, CHOICES(readHyst), "read hyst"},
+    {"read", "alerts", &TempSensor::processAlertMenu, CHOICES(readAlerts), "read alerts"},
+    {"read", "array", &TempSensor::processMainMenu, CHOICES(readArray), "read array"},
+    {"read", "cache", &TempSensor::processConfigMenu, CHOICES(readCache), "read cache"},
+    {"read", "stats", &TempSensor::processConsole, CHOICES(readStats), "read stats"},
+    {"read", "bus", &TempSensor::processConsole, CHOICES(readBus), "read bus"},
+    {"read", "tasks", &TempSensor::processConsole, CHOICES(readTasks), "read tasks"},
+    {"set", "res", &TempSensor::processResolution, CHOICES(resValues), "set res 9|10|11|12"},
+    {"set", "shdn", &TempSensor::processShutdown, CHOICES(shdnValues), "set shdn on|off"},
+    {"set", "mode", &TempSensor::processCompInt, CHOICES(modeValues), "set mode comp|int"},
+    {"set", "pol", &TempSensor::processPolarity, CHOICES(polValues), "set pol low|high"},
+    {"set", "fq", &TempSensor::processFaultQ, CHOICES(fqValues), "set fq 1|2|4|6"},
+    {"set", "oneshot", &TempSensor::processOneShot, CHOICES(oneShotValues), "set oneshot off|on|log|cont"},
+    {"set", "addr", &TempSensor::processDeviceIDMenu, CHOICES(addrValues), "set addr 0x48..0x4F"},
+    {"scan", nullptr, &TempSensor::processMainMenu, CHOICES(scanBus), "scan"},
+    {"stream", nullptr, &TempSensor::processConsole, CHOICES(streamValues), "stream on|text|off"},
+    {"stats", nullptr, &TempSensor::processConsole, CHOICES(statsValues), "stats [reset]"},
+    {"log", nullptr, &TempSensor::processConsole, CHOICES(logValues), "log [flush]"},
+    {"rules", nullptr, &TempSensor::processConsole, CHOICES(rulesValues), "rules"},
+    {"probes", nullptr, &TempSensor::processConsole, CHOICES(probeValues), "probes [reset]"},
+    {"menu", nullptr, &TempSensor::processConsole, CHOICES(showMain), "menu"},
+    {"help", nullptr, &TempSensor::processConsole, CHOICES(showHelp), "help"},
+};
+
+/**
+ * @brief Poll the console
+ *
+ * Called from the main loop between the sampler polls: the input,
+ * the buttons and the screen refresh in one call.
+ *
+ * @return void
+ */
+void TempSensor::pollConsole(){
+    pollInput();
+    pollButtons();
+    refreshDisplay();
+}
+
+/**
+ * @brief Read the console
+ *
+ * Reads what the terminal has sent without waiting and runs at most
+ * one complete line, so one call never takes more than one command.
+ *
+ * @return bool true if it stopped with characters possibly left: after a line or a full burst
+ */
+bool TempSensor::pollInput(){
+    for(uint8_t i = 0; i < CONSOLE_BURST; i++){
+        int c = hal::Cpu::readChar();
+        if(c < 0){
+            return false;
+        }
+        if(console.feed((char)c)){
+            handleLine(console.command());
+            return true;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Run the button gestures
+ *
+ * @return void
+ */
+void TempSensor::pollButtons(){
+    if(button_events){
+        ButtonEvent event;
+        while(button_events->next(event, hal::Clock::nowUs())){
+            processButton(event);
+        }
+    }
+}
+
+/**
+ * @brief Refresh the display
+ *
+ * Screens that are due for a redraw (main menu after a message, live
+ * temperature) are printed here, the result of the last config change
+ * is blinked and the rule LEDs are updated.
+ *
+ * @return void
+ */
+void TempSensor::refreshDisplay(){
+    if(redraw_us && hal::Clock::nowUs() >= redraw_us){
+        redraw_us = 0;
+        showMenu();
+    }
+    finishVerify();
+    if(rule_engine){
+        updateRuleLeds();
+    }
+    engine.watchdog(); //async reads stuck on the bus
+}
+
+/**
+ * @brief Process a board button
+ *
+ * A press picks the main menu choice of the button number, a long
+ * press goes back to the main menu. Button 5 also turns off the
+ * Alert LED, and a double press of it shows the alert history.
+ *
+ * @param event the gesture decoded from the button edges
+ *
+ * @return void
+ */
+void TempSensor::processButton(const ButtonEvent& event){
+    if(event.button == 5 && alert_monitor && event.gesture != ButtonGesture::Long){
+        alert_monitor->acknowledge();
+    }
+
+    switch (event.gesture) {
+        case ButtonGesture::Press:
+            processMainMenu((char)('0' + event.button));
+            break;
+        case ButtonGesture::Double:
+            if(event.button == 5 && alert_monitor){
+                ANSI_Codes();
+                alert_monitor->printHistory();
+            } else {
+                processMainMenu((char)('0' + event.button));
+            }
+            break;
+        case ButtonGesture::Long:
+            MainMenu();
+            break;
+    }
+}
+
+/**
+ * @brief Handle a complete line
+ *
+ * A limit prompt takes the line as the temperature, a single
+ * character answers the menu on screen, anything else is a command.
+ *
+ * @param cmd words of the line
+ *
+ * @return void
+ */
+void TempSensor::handleLine(const CommandParser::Command& cmd){
+    PROBE_SCOPE(Command);
+    const char* word = cmd.argv[0];
+
+    if(menu_state == MenuState::SetLimit || menu_state == MenuState::HystLimit){
+        bool max = menu_state == MenuState::SetLimit;
+        menu_state = MenuState::Main;
+        if(CommandParser::equals(word, "x")){
+            MainMenu();
+            return;
+        }
+        holdScreen(MENU_HOLD_MS);
+        setLimit(max, word);
+        return;
+    }
+
+    if(cmd.argc == 1 && word[1] == '\0'){
+        processMenuChoice(word[0]);
+        return;
+    }
+    if(!runCommand(cmd)){
+        std::cout << "Unknown command, enter help for the list" << std::endl;
+    }
+}
+
+/**
+ * @brief Process a menu answer
+ *
+ * Hands the choice to the handler of the screen it answers. A
+ * choice that opens no other screen leaves its output up for
+ * MENU_HOLD_MS, then pollConsole goes back to the main menu.
+ * The x cases now only print the main menu, so no call nests.
+ *
+ * @param choice character typed
+ *
+ * @return void
+ */
+void TempSensor::processMenuChoice(const char& choice){
+    MenuState state = menu_state;
+    menu_state = MenuState::Main;
+    holdScreen(MENU_HOLD_MS);
+
+    switch (state) {
+        case MenuState::Main:
+            processMainMenu(choice);
+            break;
+        case MenuState::Config:
+            processConfigMenu(choice);
+            break;
+        case MenuState::DeviceID:
+            processDeviceIDMenu(choice);
+            break;
+        case MenuState::Alert:
+            processAlertMenu(choice);
+            break;
+        case MenuState::Shutdown:
+            processShutdown(choice);
+            break;
+        case MenuState::CompInt:
+            processCompInt(choice);
+            break;
+        case MenuState::Polarity:
+            processPolarity(choice);
+            break;
+        case MenuState::FaultQueue:
+            processFaultQ(choice);
+            break;
+        case MenuState::Resolution:
+            processResolution(choice);
+            break;
+        case MenuState::OneShot:
+            processOneShot(choice);
+            break;
+        case MenuState::Temperature:
+            // Any answer leaves the live screen
+            MainMenu();
+            break;
+        case MenuState::Stream:
+            if(choice == 'x' || choice == 'X'){
+                stopStream();
+            } else {
+                // Keep streaming, the bytes on screen are not a menu
+                menu_state = MenuState::Stream;
+                redraw_us = 0;
+            }
+            break;
+        default:
+            MainMenu();
+            break;
+    }
+}
+
+/**
+ * @brief Run a scripted command
+ *
+ * Looks the first words up in the command table and hands the
+ * value to the same handler the menus use, e.g. "set res 12" is
+ * the '3' answer of the ADC resolution menu. The limits take a
+ * temperature: "set max 30.5" and "set min 25", the statistics a
+ * number: "set window 32", "set ewma 4", the log dump a range of
+ * seconds: "log dump 0 3600", a rule its fields: "rule 0x48 above 30 0.5 red".
+ * Commands do not change the screen, so they can be sent one
+ * after the other from a script.
+ *
+ * @param cmd words of the line
+ *
+ * @return bool false if the command is unknown
+ */
+bool TempSensor::runCommand(const CommandParser::Command& cmd){
+    const char* verb = cmd.argv[0];
+    const char* object = cmd.argc > 1 ? cmd.argv[1] : "";
+
+    if(CommandParser::equals(verb, "set") && cmd.argc == 3 &&
+       (CommandParser::equals(object, "max") || CommandParser::equals(object, "min"))){
+        setLimit(CommandParser::equals(object, "max"), cmd.argv[2]);
+        return true;
+    }
+    if(CommandParser::equals(verb, "set") && cmd.argc == 3 &&
+       (CommandParser::equals(object, "window") || CommandParser::equals(object, "ewma"))){
+        int value = atoi(cmd.argv[2]);
+        if(!stats_bank){
+            std::cout << "Statistics not available" << std::endl;
+        } else if(CommandParser::equals(object, "window") && value >= 1 && value <= RollingStats::MAX_WINDOW){
+            stats_bank->setWindow((uint8_t)value);
+        } else if(CommandParser::equals(object, "ewma") && value >= 0 && value <= RollingStats::EWMA_FRAC){
+            stats_bank->setEwmaShift((uint8_t)value);
+        } else {
+            std::cout << "Usage: set window 1..64 | set ewma 0..8" << std::endl;
+        }
+        return true;
+    }
+    if(CommandParser::equals(verb, "rule") && cmd.argc >= 2){
+        if(!rule_engine){
+            std::cout << "Alert rules not available" << std::endl;
+            return true;
+        }
+        bool ok;
+        if(CommandParser::equals(object, "clear") && cmd.argc == 2){
+            rule_engine->clear();
+            ok = true;
+        } else if(CommandParser::equals(object, "del") && cmd.argc == 3){
+            ok = rule_engine->remove((uint16_t)atoi(cmd.argv[2]));
+        } else {
+            ok = cmd.argc == 6 && addRule(cmd);
+        }
+        if(!ok){
+            std::cout << "Usage: rule <addr|any> above|below <C> <hyst C> <leds> | rule <addr|any> rate <C/min> <window s> <leds>" << std::endl;
+            std::cout << "       rule <addr|any> time <C> <hold s> <leds> | rule del <n> | rule clear, leds red+green+alert" << std::endl;
+        } else if(!rule_engine->compile()){
+            std::cout << "Rules not applied: too many, or the last change is not taken yet" << std::endl;
+        }
+        return true;
+    }
+    if(CommandParser::equals(verb, "log") && cmd.argc == 4 && CommandParser::equals(object, "dump")){
+        uint64_t from = strtoull(cmd.argv[2], nullptr, 10) * 1000;
+        uint64_t to = strtoull(cmd.argv[3], nullptr, 10) * 1000 + 999;
+        dumpLog(from, to, 0xFFFF);
+        return true;
+    }
+
+    for(const ConsoleCommand& entry : commands){
+        if(!CommandParser::equals(verb, entry.verb)){
+            continue;
+        }
+        uint8_t valueIndex = 1;
+        if(entry.object){
+            if(!CommandParser::equals(object, entry.object)){
+                continue;
+            }
+            valueIndex = 2;
+        }
+        const char* value = cmd.argc > valueIndex ? cmd.argv[valueIndex] : "";
+        for(uint8_t i = 0; i < entry.count; i++){
+            if(CommandParser::equals(value, entry.values[i].value)){
+                (this->*entry.process)(entry.values[i].choice);
+                return true;
+            }
+        }
+        std::cout << "Usage: " << entry.usage << std::endl;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Process console only actions
+ *
+ * Actions that have no menu entry of their own, reached
+ * through the command table.
+ *
+ * @param choice 't' temp, 'c' config, 'p' sampler stats, 'b' bus errors, 'k' task stats, 's' / 'l' / 'q' binary, text, stop stream
+ * on / off, 'a' statistics, 'r' statistics reset, 'g' sample log, 'f' log
+ * flush, 'u' alert rules, 'o' / 'z' probe times and their reset, 'm' main
+ * menu, 'h' help
+ *
+ * @return void
+ */
+void TempSensor::processConsole(const char& choice){
+    char text[16];
+    switch (choice) {
+        case 't':
+            // Last scheduled sample, or a read when nothing paces them
+            (sampler ? last_Temp() : get_Temp()).format(text, sizeof(text), TempUnit::Celsius);
+            printf("Temp: %s C\n", text);
+            break;
+        case 'c':
+            printf("Config: 0x%02X\n", readConfigRegister());
+            break;
+        case 'p':
+            if(sampler){
+                sampler->printStats();
+            }
+            break;
+        case 'b':
+            printBusErrors();
+            break;
+        case 'k':
+            if(event_loop){
+                event_loop->printStats();
+            }
+            break;
+        case 's':
+            Stream_Menu();
+            break;
+        case 'l':
+            Text_Stream_Menu();
+            break;
+        case 'q':
+            stopStream();
+            if(menu_state == MenuState::Stream){
+                menu_state = MenuState::Main;
+                holdScreen(MENU_HOLD_MS);
+            }
+            break;
+        case 'a':
+            Stats_Menu();
+            break;
+        case 'r':
+            if(stats_bank){
+                stats_bank->reset();
+            }
+            break;
+        case 'g':
+            Log_Menu();
+            break;
+        case 'u':
+            Rules_Menu();
+            break;
+        case 'o':
+            probe::print();
+            break;
+        case 'z':
+            probe::reset();
+            std::cout << "Probes cleared" << std::endl;
+            break;
+        case 'f':
+            // the writer core commits the sector, the flash is locked out from here
+            if(sample_log){
+                sample_log->requestFlush();
+            }
+            break;
+        case 'm':
+            MainMenu();
+            break;
+        case 'h':
+            printHelp();
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Print the commands
+ *
+ * @return void
+ */
+void TempSensor::printHelp(){
+    std::cout << "Commands:" << std::endl;
+    for(const ConsoleCommand& entry : commands){
+        std::cout << "  " << entry.usage << std::endl;
+    }
+    std::cout << "  set max <temp>" << std::endl;
+    std::cout << "  set min <temp>" << std::endl;
+    std::cout << "  set window 1..64" << std::endl;
+    std::cout << "  set ewma 0..8" << std::endl;
+    std::cout << "  log dump <from_s> <to_s>" << std::endl;
+    std::cout << "  rule <addr|any> above|below <C> <hyst C> <leds>" << std::endl;
+    std::cout << "  rule <addr|any> rate <C/min> <window s> <leds>" << std::endl;
+    std::cout << "  rule <addr|any> time <C> <hold s> <leds>" << std::endl;
+    std::cout << "  rule del <n> | rule clear" << std::endl;
+}
+
+/**
+ * @brief Print the current screen
+ *
+ * @return void
+ */
+void TempSensor::showMenu(){
+    switch (menu_state) {
+        case MenuState::Config:
+            Config_Menu();
+            break;
+        case MenuState::DeviceID:
+            DeviceID_Menu();
+            break;
+        case MenuState::Alert:
+            AlertConfig_Menu();
+            break;
+        case MenuState::Temperature:
+            Temperature_Read_Menu();
+            break;
+        case MenuState::Shutdown:
+            Shutdown_Menu();
+            break;
+        case MenuState::CompInt:
+            COMP_INT_Menu();
+            break;
+        case MenuState::Polarity:
+            Alert_Polarity_Menu();
+            break;
+        case MenuState::FaultQueue:
+            FAULT_QUEUE_Menu();
+            break;
+        case MenuState::Resolution:
+            ADC_RES();
+            break;
+        case MenuState::OneShot:
+            One_Shot_Menu();
+            break;
+        case MenuState::Stream:
+        case MenuState::SetLimit:
+        case MenuState::HystLimit:
+            // Waiting for input, nothing to redraw
+            break;
+        default:
+            MainMenu();
+            break;
+    }
+}
+
+/**
+ * @brief Redraw the screen later
+ *
+ * @param ms time the current output stays up
+ *
+ * @return void
+ */
+void TempSensor::holdScreen(uint32_t ms){
+    redraw_us = hal::Clock::nowUs() + ms * 1000ull;
+}
+
+/**
+ * @brief Parse a typed limit
+ *
+ * Signed decimal Celsius, rounded to the 0.5 C step of the limit
+ * registers. A value that is not a temperature or is out of range
+ * is refused with the reason, and the limit is left as it was.
+ *
+ * @param text temperature typed by the user
+ * @param limit register bytes, MSB first
+ *
+ * @return bool true if the limit was changed
+ */
+bool TempSensor::parseTypedLimit(const char* text, uint8_t* limit){
+    uint16_t raw;
+    tcn75a::ParseError error = tcn75a::parseLimit(text, raw);
+    if(error != tcn75a::ParseError::None){
+        std::cout << "Invalid input: " << tcn75a::parseErrorText(error) << ". Please try again" << std::endl;
+        return false;
+    }
+    limit[0] = (uint8_t)(raw >> 8);
+    limit[1] = (uint8_t)raw;
+    return true;
+}
+
+/**
+ * @brief Set a typed limit
+ *
+ * Parses the value, writes it to TSET or THYST and only confirms
+ * it once the sensor took it.
+ *
+ * @param max true for the MAX limit (TSET), false for MIN (THYST)
+ * @param text temperature typed by the user
+ *
+ * @return void
+ */
+void TempSensor::setLimit(bool max, const char* text){
+    uint8_t* limit = max ? set_limit : hyst_limit;
+    if(!parseTypedLimit(text, limit)){
+        return;
+    }
+    if(!(max ? Write_Set_Reg() : Write_Hyst_Reg())){
+        std::cout << "Limit not written: the sensor did not take it" << std::endl;
+        return;
+    }
+    char value[8];
+    tcn75a::formatLimit(tcn75a::limitWord(limit[0], limit[1]), value, sizeof(value));
+    std::cout << "Limit set to: " << value << std::endl;
+}
+
+/**
+ * @brief Screen the console is on
+ *
+ * @return MenuState the menu the next answer goes to
+ */
+MenuState TempSensor::getMenuState() const{
+    return menu_state;
+}
+
+/**
+ * @brief Console line parser
+ *
+ * @return const CommandParser& parser and its statistics
+ */
+const CommandParser& TempSensor::getConsole() const{
+    return console;
+}
@@ -8,13 +8,29 @@
  * @param pin the LED gpio pin number
  *
  */
-LED::LED(uint8_t pin): LED_PIN(pin) {
+LED::LED(uint8_t pin): LED_PIN(pin), effects(nullptr), channel(LedChannel::Red) {
     //stdio_init_all();
-    gpio_init(LED_PIN);
-    gpio_set_dir(LED_PIN, GPIO_OUT);
+    hal::Gpio::output(LED_PIN);
 }
 
 
+/**
+ * @brief Attach to the effects engine
+ *
+ * The pin becomes a PWM output of the engine, changeState sets the
+ * level shown between patterns and blink queues a pattern.
+ *
+ * @param effects the engine, its tick must be running
+ * @param channel which of its LEDs this one is
+ *
+ * @return void.
+ */
+void LED::attach(LedEffects* effects, LedChannel channel){
+    this->effects = effects;
+    this->channel = channel;
+    effects->bind(channel, LED_PIN);
+}
+
 /**
  * @brief Change LED state
  *
@@ -25,7 +41,31 @@ LED::LED(uint8_t pin): LED_PIN(pin) {
  * @return void.
  */
 void LED::changeState(uint8_t led_state){
-    gpio_put(LED_PIN,led_state); 
+    if(effects){
+        effects->setBase(channel, led_state ? 255 : 0);
+        return;
+    }
+    hal::Gpio::put(LED_PIN,led_state); 
+}
+
+/**
+ * @brief Blink the LED
+ *
+ * Queued as feedback on the effects engine when attached,
+ * otherwise blinks right here.
+ *
+ * @param times number of blinks
+ *
+ * @return void.
+ */
+void LED::blink(uint8_t times){
+    if(effects){
+        effects->play(channel, led_pattern::BLINK, times, LedPriority::Feedback);
+        return;
+    }
+    for(uint8_t i = 0; i < times; i++){
+        blinkLED();
+    }
 }
 
 /**
@@ -37,7 +77,7 @@ void LED::changeState(uint8_t led_state){
  */
 void LED::blinkLED(){
     changeState(1); //turn LED on
-    sleep_ms(LED_SLEEP_TIME);
+    hal::Clock::sleepMs(LED_SLEEP_TIME);
     changeState(0); //turn LED off
-    sleep_ms(LED_SLEEP_TIME);
+    hal::Clock::sleepMs(LED_SLEEP_TIME);
 }
\ No newline at end of file
@@ -4,49 +4,348 @@
 #include "../inc/button.hpp"
 #include "../inc/led.hpp"
 #include "pico/multicore.h"
+#include "../inc/SampleRing.hpp"
+#include "../inc/SampleMerger.hpp"
+#include "../inc/I2CBus.hpp"
+#include "../inc/SensorArray.hpp"
+#include "../inc/AlertMonitor.hpp"
+#include "../inc/SamplingScheduler.hpp"
+#include "../inc/Telemetry.hpp"
+#include "../inc/TempStats.hpp"
+#include "../inc/SampleLog.hpp"
+#include "../inc/AlertRules.hpp"
+#include "../inc/LedEffects.hpp"
+#include "../inc/ButtonEvents.hpp"
+#include "../inc/EventLoop.hpp"
+#include "../inc/TextStream.hpp"
+#include "../inc/Probe.hpp"
 #include <cstdint>
 
+//Raw samples going from core 0 (acquisition) to core 1 (consumer),
+//one ring per I2C controller, read back in timestamp order
+static SampleQueue samples[2];
+static SampleMerger mergedSamples;
+
+//Last sample drained by core 1 and how many were consumed
+static TempSample lastSample;
+static uint32_t samplesConsumed = 0;
+
+//ALERT pin edges, captured on core 0 and decoded on core 1
+static AlertMonitor alertMonitor(0);
+
+//Binary sample frames, filled and sent by core 1
+static TelemetryStream sampleStream(&hal::Cpu::writeRaw);
+
+//Readable sample lines, formatted and sent by core 1 within the USB rate
+static TextStream textStream(&hal::Cpu::writeRaw);
+
+//Rolling statistics of every sensor, updated by core 1
+static StatsBank sensorStats;
+static const uint32_t SUMMARY_PERIOD_US = 1000 * 1000; //statistics frame period while streaming
+
+//Every sample in the last 256 KB of flash, written by core 1
+static const uint16_t LOG_SECTORS = SampleLog::MAX_SECTORS;
+static SampleLog sampleLog(hal::Flash::size() - LOG_SECTORS * SampleLog::SECTOR_SIZE, LOG_SECTORS);
+
+//Software alert rules, edited on core 0 and evaluated by core 1
+static RuleEngine alertRules;
+
+//Blink patterns and brightness of the three LEDs, played by a timer on core 0
+static LedEffects ledEffects;
+
+//Button edges from the gpio ISR, acted on by the main loop
+static ButtonEvents buttonEvents(2);
+
+//Tasks of core 0: console, buttons, sampling, sensor arrays, LEDs, display
+static EventLoop loop;
+static const uint32_t SENSORS_PERIOD_US = 5 * 1000; //sensor array polls
+static const uint32_t DISPLAY_PERIOD_US = 20 * 1000; //screen redraws, rule LEDs, bus watchdog
+static const uint32_t SAMPLE_DEADLINE_US = 1000; //a scheduled read started later is a miss
+static const uint32_t READ_TIMEOUT_US = 10 * 1000; //look at a read again if its interrupt never came
+
 /**
  * @brief Pico Second Core
  *
  * This function sets what the second Pico board core should do.
- * In this case, it is constantly verifying the state of the
- * Alert pin and changes the Alert LED accordingly.
+ * It sleeps until core 0 signals an event (SEV), then drains the
+ * raw samples of both buses in time order and the Alert pin edges and
+ * changes the Alert LED accordingly.
+ * Every sample updates the statistics, goes to the flash log and is
+ * checked against the alert rules. While streaming, the samples are also
+ * batched into binary frames, with a statistics frame every second,
+ * or formatted into text lines: core 0 never waits on the USB output.
+ * The Alert LED is lit by the ALERT pin or by any rule driving it.
  *
  * @return void
  */
 void core1(){
-    //create an LED object for the alert
-    LED alertLED(17);
+    //the Alert LED (gpio 17, shared with the red LED) belongs to the effects engine
+    bool alertLit = false;
+    uint64_t lastSummary = 0;
+    probe::init(); //cycle counter of this core
     
     while(true){
-        //Blink Red Alert LED if the alert is ON
-        if(TempSensor::AlertState){
-            alertLED.changeState(1);
-        } else if (!TempSensor::AlertState) {
-            alertLED.changeState(0);
+        //Consume every sample published by the acquisition core
+        bool streaming = sampleStream.enabled();
+        bool text = textStream.enabled();
+        TempSample sample;
+        while(mergedSamples.pop(sample, time_us_64())){
+            lastSample = sample;
+            samplesConsumed++;
+            sensorStats.update(sample);
+            sampleLog.push(sample);
+            alertRules.evaluate(sample);
+            if(streaming){
+                sampleStream.push(sample);
+            }
+            if(text){
+                textStream.push(sample, time_us_64());
+            }
+        }
+        //bound the latency of a partial batch, send it all when stopped
+        if(streaming){
+            uint64_t now = time_us_64();
+            sampleStream.flushDue(now);
+            if(now - lastSummary >= SUMMARY_PERIOD_US){
+                StatsSummary table[StatsBank::MAX_SENSORS];
+                sampleStream.sendSummary(table, sensorStats.summaries(table, StatsBank::MAX_SENSORS), now);
+                lastSummary = now;
+            }
+        } else {
+            sampleStream.flush();
+        }
+        if(text){
+            textStream.flushDue(time_us_64());
+        } else {
+            textStream.flush(time_us_64());
+        }
+        //a sector write stalls core 0 (no XIP while the flash is busy)
+        sampleLog.flushDue(time_us_64());
+
+        //Red Alert LED follows the alert state and the rules
+        alertMonitor.process();
+        bool lit = alertMonitor.asserted() || (alertRules.outputs() & rule_out::ALERT);
+        if(lit != alertLit){
+            ledEffects.setBase(LedChannel::Alert, lit ? 255 : 0);
+            alertLit = lit;
+        }
+
+        //Nothing left to do: sleep until core 0 pushes something.
+        //An event sent while draining is latched, so none is missed.
+        //A sample kept back for ordering is due within HOLD_US, no sleep then.
+        //Buffered text lines wake the core when they reach their latency.
+        if(!mergedSamples.holding()){
+            if(textStream.nextDueUs() != ~0ull){
+                hal::Cpu::sleepUntil(textStream.nextDueUs());
+            } else {
+                hal::Cpu::waitForEvent();
+            }
         }
     }
 }
 
+/**
+ * @brief Sensor array task
+ *
+ * Queues the reads of every sensor whose conversion is ready, on
+ * both buses. The reads run on the I2C interrupts, so this returns
+ * right away and the two controllers transfer at the same time.
+ *
+ * @param context the array of SensorArray pointers
+ * @param now_us current time
+ *
+ * @return uint64_t 0, the task keeps its period
+ */
+uint64_t pollSensors(void* context, uint64_t now_us){
+    SensorArray** arrays = static_cast<SensorArray**>(context);
+    arrays[0]->poll(now_us);
+    arrays[1]->poll(now_us);
+    return 0;
+}
+
+/**
+ * @brief Sampling task
+ *
+ * Starts a read when the scheduler says it is due and takes the
+ * sample when the read interrupt completed it.
+ *
+ * @param context the SamplingScheduler
+ * @param now_us current time
+ *
+ * @return uint64_t time of the next read, or a late look at the read in flight
+ */
+uint64_t runSampler(void* context, uint64_t now_us){
+    SamplingScheduler* sampler = static_cast<SamplingScheduler*>(context);
+    sampler->poll(now_us);
+    if(sampler->readPending()){
+        return now_us + READ_TIMEOUT_US;
+    }
+    uint64_t due = sampler->nextDueUs();
+    return due > now_us ? due : now_us;
+}
+
+/**
+ * @brief Sampling event source
+ *
+ * @param context the SamplingScheduler
+ *
+ * @return bool true once the read in flight completed
+ */
+bool sampleReady(void* context){
+    return static_cast<SamplingScheduler*>(context)->readDone();
+}
+
+/**
+ * @brief Console task
+ *
+ * @param context the TempSensor
+ * @param now_us current time
+ *
+ * @return uint64_t now_us to read again on the next pass if characters may be left, 0 otherwise
+ */
+uint64_t runConsole(void* context, uint64_t now_us){
+    return static_cast<TempSensor*>(context)->pollInput() ? now_us : 0;
+}
+
+/**
+ * @brief Console event source
+ *
+ * @param context unused
+ *
+ * @return bool true if the USB/UART received characters
+ */
+bool consoleReady(void* context){
+    (void)context;
+    return hal::Cpu::inputReady();
+}
+
+/**
+ * @brief Button task
+ *
+ * Runs the actions of the completed gestures.
+ *
+ * @param context the TempSensor
+ * @param now_us current time
+ *
+ * @return uint64_t the next long press, double press or debounce timeout
+ */
+uint64_t runButtons(void* context, uint64_t now_us){
+    (void)now_us;
+    static_cast<TempSensor*>(context)->pollButtons();
+    return buttonEvents.nextDueUs();
+}
+
+/**
+ * @brief Button event source
+ *
+ * @param context unused
+ *
+ * @return bool true if the gpio ISR queued edges
+ */
+bool buttonsReady(void* context){
+    (void)context;
+    return buttonEvents.pending();
+}
+
+/**
+ * @brief LED effects task
+ *
+ * Advances the blink patterns, nothing else waits on them.
+ *
+ * @param context the LedEffects
+ * @param now_us current time
+ *
+ * @return uint64_t 0, the task keeps its period
+ */
+uint64_t tickLeds(void* context, uint64_t now_us){
+    static_cast<LedEffects*>(context)->tick((uint32_t)(now_us / 1000));
+    return 0;
+}
+
+/**
+ * @brief Display task
+ *
+ * @param context the TempSensor
+ * @param now_us current time
+ *
+ * @return uint64_t 0, the task keeps its period
+ */
+uint64_t refreshDisplay(void* context, uint64_t now_us){
+    (void)now_us;
+    static_cast<TempSensor*>(context)->refreshDisplay();
+    return 0;
+}
 
 int main(){
     stdio_init_all();
-    
+    probe::init();
+
+    //Both controllers, each with its own transaction queue and interrupt:
+    //i2c1 on 14/15 carries the menu sensor, i2c0 on 20/21 up to 8 more
+    I2CBus bus1(i2c1, 14, 15, 400 * 1000);
+    I2CBus bus0(i2c0, 20, 21, 400 * 1000);
+    bus1.begin();
+    bus0.begin();
+    mergedSamples.addSource(&samples[0]);
+    mergedSamples.addSource(&samples[1]);
+
     //Set up the TempSensor object
     //Constructor Arguments: 
-    //TempSensor(i2c_inst_t *i2c, int sda, int scl, int freq,int redLED, int greenLED)
-    TempSensor TCN(i2c1, 14, 15, 400 * 1000, 17, 16, 0);
+    //TempSensor(I2CBus& bus, int redLED, int greenLED, int alert)
+    TempSensor TCN(bus1, 17, 16, 0);
+    TCN.setSampleSink(&samples[1]);
+
+    //Every other TCN75A on each bus, polled in the background:
+    //the menu sensor is left to the sampler so it is read once
+    SensorArray sensors(bus1.engine());
+    sensors.setSampleSink(&samples[1]);
+    TCN.setSensorArray(&sensors);
+    sensors.discover(&bus1.scanner());
+    SensorArray sensors0(bus0.engine());
+    sensors0.setSampleSink(&samples[0]);
+    sensors0.discover();
+    SensorArray* arrays[2] = {&sensors0, &sensors};
+    TCN.setAlertMonitor(&alertMonitor);
+
+    //Reads paced by the conversion time of the configured resolution
+    SamplingScheduler sampler(TCN);
+    sampler.setPolicy(SamplePolicy::MaxRate);
+    TCN.setSampler(&sampler);
+    TCN.setTelemetry(&sampleStream);
+    TCN.setTextStream(&textStream);
+    TCN.setStatistics(&sensorStats);
+    sampleLog.mount();
+    TCN.setSampleLog(&sampleLog);
+    TCN.setRuleEngine(&alertRules);
+    TCN.setLedEffects(&ledEffects);
+    ledEffects.bind(LedChannel::Alert, 17);
+    button::setAlertMonitor(&alertMonitor);
     
-    // Initialize buttons
-    button buttons[] = {button(2, TCN), button(3, TCN), button(4, TCN), button(5, TCN), button(6, TCN), button(7, TCN)};
+    // Initialize buttons, a double press of button 5 shows the alert history
+    button buttons[] = {button(2, buttonEvents), button(3, buttonEvents), button(4, buttonEvents),
+                        button(5, buttonEvents), button(6, buttonEvents), button(7, buttonEvents)};
+    (void)buttons; //they only install their gpio interrupts
+    buttonEvents.enableDouble(5);
+    TCN.setButtonEvents(&buttonEvents);
 
+    //core 1 writes the log, core 0 is parked in RAM while it does
+    multicore_lockout_victim_init();
     multicore_launch_core1(core1);
 
-    while(true){
-        TCN.MainMenu();
-        sleep_ms(700);
+    //Everything on core 0 is a task: the event sources are filled by the
+    //USB, gpio and I2C interrupts, the timers are ordered by due time, and
+    //the core sleeps when nothing is ready
+    hal::Cpu::watchInput();
+    loop.addEvent("console", &consoleReady, &runConsole, &TCN);
+    loop.addEvent("buttons", &buttonsReady, &runButtons, &TCN);
+    uint8_t sampling = loop.addEvent("sampling", &sampleReady, &runSampler, &sampler, SAMPLE_DEADLINE_US);
+    loop.setDue(sampling, time_us_64());
+    loop.addTimer("sensors", &pollSensors, arrays, SENSORS_PERIOD_US);
+    loop.addTimer("leds", &tickLeds, &ledEffects, LedEffects::TICK_MS * 1000);
+    loop.addTimer("display", &refreshDisplay, &TCN, DISPLAY_PERIOD_US);
+    TCN.setEventLoop(&loop);
 
-    }
+    TCN.MainMenu();
+    loop.run();
     return 0;
 }
\ No newline at end of file
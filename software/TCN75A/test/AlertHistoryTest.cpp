@@ -0,0 +1,164 @@
+#include "../inc/AlertMonitor.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+
+//ALERT pin edges replayed into AlertMonitor at set virtual times, and
+//the episodes it records compared with the ones the edges describe:
+//both polarities, comparator and interrupt output, pulses faster than
+//the interrupt, acknowledge, history wrap and a full edge queue.
+
+//One edge as the GPIO interrupt reports it
+struct Edge{
+    uint32_t at_us; //from the start of the replay
+    uint32_t events; //hal::Gpio::EDGE_FALL and / or EDGE_RISE
+    bool level; //pin level read in the ISR
+};
+
+//Episode the replay must leave, times from the start of the replay
+struct Expected{
+    uint32_t assert_us;
+    uint32_t deassert_us; //0: still active
+};
+
+static const uint32_t FALL = hal::Gpio::EDGE_FALL;
+static const uint32_t RISE = hal::Gpio::EDGE_RISE;
+static const uint32_t SLACK_US = 8; //the virtual clock moves 1 us on every read
+
+static bool near(uint64_t got, uint64_t base, uint32_t expect){
+    return got >= base + expect && got <= base + expect + SLACK_US;
+}
+
+/**
+ * @brief Replay edges and compare the history
+ *
+ * Each edge is taken by onEdge at its time and core 1 drains it
+ * right away, as it does once the ISR wakes it.
+ *
+ * @param name what the edges are
+ * @param activeHigh ALERT POLARITY of the sensor config
+ * @param interruptMode COMP/INT of the sensor config
+ * @param edges the edges, in time order
+ * @param edgeCount number of edges
+ * @param expect the episodes, oldest first
+ * @param expectCount number of episodes
+ *
+ * @return void
+ */
+static void replay(const char* name, bool activeHigh, bool interruptMode, const Edge* edges, uint8_t edgeCount,
+                   const Expected* expect, uint8_t expectCount){
+    AlertMonitor monitor(0);
+    monitor.configure(activeHigh, interruptMode);
+    uint64_t base = hal::Clock::nowUs();
+    for(uint8_t i = 0; i < edgeCount; i++){
+        uint64_t at = base + edges[i].at_us;
+        uint64_t now = hal::Clock::nowUs();
+        if(at > now){
+            hal::Clock::sleepUs(at - now);
+        }
+        monitor.onEdge(edges[i].events, edges[i].level);
+        monitor.process();
+    }
+
+    AlertEpisode got[AlertMonitor::HISTORY_SIZE];
+    uint8_t n = monitor.snapshot(got, AlertMonitor::HISTORY_SIZE);
+    uint8_t wrong = n == expectCount ? 0 : 1;
+    for(uint8_t i = 0; i < n && i < expectCount; i++){
+        bool open = expect[i].deassert_us == 0;
+        wrong += !near(got[i].assert_us, base, expect[i].assert_us);
+        wrong += open ? got[i].deassert_us != 0 : !near(got[i].deassert_us, base, expect[i].deassert_us);
+    }
+    bool active = expectCount && expect[expectCount - 1].deassert_us == 0;
+    printf("%-34s | %5u | %8u | %s\n", name, edgeCount, n, wrong ? "FAIL" : "ok");
+    CHECK(wrong == 0);
+    CHECK(monitor.asserted() == active);
+    CHECK(monitor.edgesLost() == 0);
+}
+
+/**
+ * @brief Acknowledge, history wrap and edge queue overflow
+ *
+ * @return void
+ */
+static void checkLimits(){
+    //acknowledge closes the open episode, the next active edge opens one
+    AlertMonitor monitor(0);
+    monitor.onEdge(FALL, false);
+    monitor.process();
+    hal::Clock::sleepUs(1000);
+    monitor.acknowledge();
+    CHECK(monitor.process() && !monitor.asserted());
+    AlertEpisode got[AlertMonitor::HISTORY_SIZE];
+    CHECK(monitor.snapshot(got, AlertMonitor::HISTORY_SIZE) == 1 && got[0].deassert_us >= got[0].assert_us + 1000);
+    monitor.acknowledge();
+    CHECK(!monitor.process()); //nothing to clear
+    monitor.onEdge(FALL, false);
+    CHECK(monitor.process() && monitor.asserted());
+    CHECK(monitor.snapshot(got, AlertMonitor::HISTORY_SIZE) == 2 && got[1].deassert_us == 0);
+
+    //20 episodes: the 16 latest are kept, oldest first
+    AlertMonitor wrap(0);
+    uint64_t first = 0;
+    for(uint8_t i = 0; i < 20; i++){
+        wrap.onEdge(FALL, false);
+        wrap.onEdge(RISE, true);
+        wrap.process();
+        if(i == 20 - AlertMonitor::HISTORY_SIZE){
+            //the oldest episode left once all 20 are recorded
+            first = got[wrap.snapshot(got, AlertMonitor::HISTORY_SIZE) - 1].assert_us;
+        }
+        hal::Clock::sleepUs(100);
+    }
+    uint8_t n = wrap.snapshot(got, AlertMonitor::HISTORY_SIZE);
+    bool ordered = n == AlertMonitor::HISTORY_SIZE && got[0].assert_us == first;
+    for(uint8_t i = 1; i < n; i++){
+        ordered = ordered && got[i].assert_us > got[i - 1].deassert_us && got[i].deassert_us != 0;
+    }
+    CHECK(ordered);
+    CHECK(wrap.snapshot(got, 4) == 4 && got[0].assert_us < got[3].assert_us);
+
+    //core 1 late: the edge queue holds 32, the rest are counted lost
+    AlertMonitor burst(0);
+    for(uint8_t i = 0; i < 40; i++){
+        burst.onEdge(i & 1 ? RISE : FALL, i & 1);
+    }
+    CHECK(burst.edgesLost() == 8);
+    burst.process();
+    CHECK(burst.snapshot(got, AlertMonitor::HISTORY_SIZE) == AlertMonitor::HISTORY_SIZE && !burst.asserted());
+    printf("%-34s | %5u | %8u | %s\n", "40 edges, core 1 late", 40, AlertMonitor::HISTORY_SIZE,
+           burst.edgesLost() == 8 ? "ok" : "FAIL");
+}
+
+int main(){
+    printf("\n%-34s | edges | episodes | check\n", "Alert edge replay");
+    printf("-----------------------------------+-------+----------+------\n");
+
+    //comparator, active low: the pin level is the alert
+    const Edge comparator[] = {{1000, FALL, false}, {5000, RISE, true}, {9000, FALL, false}, {9500, RISE, true},
+                               {12000, FALL, false}};
+    const Expected comparatorEpisodes[] = {{1000, 5000}, {9000, 9500}, {12000, 0}};
+    replay("comparator, active low", false, false, comparator, 5, comparatorEpisodes, 3);
+
+    //the same level twice (an edge the ISR saw late) changes nothing
+    const Edge repeated[] = {{1000, FALL, false}, {2000, FALL, false}, {3000, RISE, true}, {4000, RISE, true}};
+    const Expected repeatedEpisodes[] = {{1000, 3000}};
+    replay("comparator, repeated levels", false, false, repeated, 4, repeatedEpisodes, 1);
+
+    const Edge high[] = {{500, RISE, true}, {2500, FALL, false}};
+    const Expected highEpisodes[] = {{500, 2500}};
+    replay("comparator, active high", true, false, high, 2, highEpisodes, 1);
+
+    //pulse shorter than the interrupt latency: both edges in one event
+    const Edge pulse[] = {{700, FALL | RISE, true}};
+    const Expected pulseEpisodes[] = {{700, 700}};
+    replay("comparator, pulse in one event", false, false, pulse, 1, pulseEpisodes, 1);
+
+    //interrupt mode: every active edge toggles, the inactive ones are ignored
+    const Edge pulses[] = {{1000, FALL, false}, {1100, RISE, true}, {6000, FALL, false}, {6100, RISE, true},
+                           {8000, FALL | RISE, true}};
+    const Expected pulsesEpisodes[] = {{1000, 6000}, {8000, 0}};
+    replay("interrupt, active low", false, true, pulses, 5, pulsesEpisodes, 2);
+
+    checkLimits();
+    return check::result();
+}
@@ -0,0 +1,130 @@
+#include "../inc/AlertRules.hpp"
+#include "../inc/FixedTemp.hpp"
+#include "Check.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+//Alert rules over a heating profile, the LEDs they drive at fixed points,
+//and the host cost of evaluating a few hundred compiled rules per reading.
+
+//Profile of the rule scenario, in milli C: 25 C, up to 31 C at 3 C/min, hold, back down
+static int32_t profileMilli(uint32_t ms){
+    if(ms < 60000){
+        return 25000;
+    }
+    if(ms < 180000){
+        return 25000 + (int32_t)(ms - 60000) / 20;
+    }
+    if(ms < 300000){
+        return 31000;
+    }
+    if(ms < 420000){
+        return 31000 - (int32_t)(ms - 300000) / 20;
+    }
+    return 25000;
+}
+
+/**
+ * @brief Alert rule results and cost
+ *
+ * Runs one sensor through a heating profile against a band, a rate
+ * and a time-above rule and checks the LEDs at fixed points. Then
+ * times the evaluation of a few hundred random rules over a 12 bit
+ * random walk of 8 sensors: a reading only visits the rules of its
+ * sensor and the any-sensor ones.
+ *
+ * @return void
+ */
+static void runRules(){
+    typedef std::chrono::steady_clock Clock;
+    std::unique_ptr<RuleEngine> rules(new RuleEngine());
+    rules->add({0x48, RuleKind::Above, 30 * 256, 128, 0, rule_out::RED});
+    rules->add({0x48, RuleKind::Below, 26 * 256, 128, 0, rule_out::GREEN});
+    rules->add({0x48, RuleKind::Rate, 2 * 256, 0, 30000, rule_out::ALERT});
+    rules->add({RuleEngine::ANY_SENSOR, RuleKind::TimeAbove, 28 * 256, 0, 60000, rule_out::ALERT});
+    rules->compile();
+
+    const uint32_t checkMs[] = {30000, 150000, 170000, 290000, 470000};
+    const uint8_t expect[] = {rule_out::GREEN, rule_out::ALERT, rule_out::RED | rule_out::ALERT,
+                              rule_out::RED | rule_out::ALERT, rule_out::GREEN};
+    uint8_t got[5] = {0};
+    uint8_t c = 0;
+    for(uint32_t ms = 0; ms <= 480000; ms += 250){
+        TempSample sample;
+        sample.timestamp_us = (uint64_t)ms * 1000;
+        sample.raw = TempQ8::fromMilliCelsius(profileMilli(ms)).toRaw() & ~15;
+        sample.addr = 0x48;
+        uint8_t bits = rules->evaluate(sample);
+        if(c < 5 && ms == checkMs[c]){
+            got[c++] = bits;
+        }
+    }
+    printf("Scenario (band, rate, time above): LEDs at 30/150/170/290/470 s = %u/%u/%u/%u/%u, %lu changes\n",
+           got[0], got[1], got[2], got[3], got[4], (unsigned long)rules->stats().changes);
+    CHECK(memcmp(got, expect, sizeof(expect)) == 0);
+
+    //Random rules spread over the sensors, or "any sensor" rules
+    struct Setup{
+        const char* name;
+        uint16_t rules;
+        bool any;
+        uint8_t sensors;
+    };
+    const Setup setups[] = {{"256 rules, 8 sensors", 256, false, 8}, {"64 any-sensor rules", 64, true, 8},
+                            {"256 rules, 1 sensor", 256, false, 1}};
+    for(const Setup& setup : setups){
+        rules.reset(new RuleEngine());
+        uint32_t lcg = 99;
+        for(uint16_t i = 0; i < setup.rules; i++){
+            lcg = lcg * 1664525u + 1013904223u;
+            RuleSpec spec;
+            spec.addr = setup.any ? RuleEngine::ANY_SENSOR : (uint8_t)(0x48 + i % setup.sensors);
+            spec.kind = (RuleKind)((lcg >> 28) % 4);
+            spec.limit = (int16_t)((20 + (lcg >> 16) % 12) * 256);
+            spec.hyst = 128;
+            spec.time_ms = 10000 + (lcg >> 8) % 50000;
+            spec.outputs = (uint8_t)(1 << ((lcg >> 4) % 3));
+            rules->add(spec);
+        }
+        rules->compile();
+
+        const uint32_t n = 400000;
+        int32_t level[8];
+        for(int32_t& l : level){
+            l = 26 * 16;
+        }
+        std::vector<TempSample> feed(n);
+        for(uint32_t i = 0; i < n; i++){
+            lcg = lcg * 1664525u + 1013904223u;
+            uint8_t s = i % setup.sensors;
+            level[s] += (int32_t)((lcg >> 24) % 3) - 1;
+            feed[i].timestamp_us = (uint64_t)i * 250000 / setup.sensors; //4 Hz per sensor
+            feed[i].raw = (uint16_t)(level[s] << 4);
+            feed[i].addr = 0x48 + s;
+        }
+        for(uint32_t i = 0; i < n / 4; i++){
+            rules->evaluate(feed[i]); //warm up
+        }
+        uint32_t checks = rules->stats().checks;
+        Clock::time_point t0 = Clock::now();
+        for(uint32_t i = 0; i < n; i++){
+            rules->evaluate(feed[i]);
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+        checks = rules->stats().checks - checks;
+        printf("%-26s | %12.1f | %9.1f | %8.2f | %7lu\n", setup.name, ns / n, (double)checks / n, ns / checks,
+               (unsigned long)rules->stats().changes);
+        CHECK(checks == (uint64_t)n * (setup.any ? setup.rules : setup.rules / setup.sensors));
+    }
+}
+
+int main(){
+    printf("\n%-26s | ns/sample    | rules/smp | ns/rule  | changes\n", "Alert rules (host)");
+    printf("---------------------------+--------------+-----------+----------+--------\n");
+    runRules();
+    return check::result();
+}
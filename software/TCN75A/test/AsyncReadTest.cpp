@@ -0,0 +1,220 @@
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+
+//Blocking and async temperature reads: the CPU time each one costs the
+//caller, the CPU time the engine counts for itself, and the guards of
+//the async path.
+
+//Cost of a batch of reads
+struct ReadCost{
+    uint64_t cpu_ns; //host time in the calls the caller makes, hal::Cycles
+    uint64_t call_us; //virtual time in those calls
+    uint64_t bus_ns; //time the bus was busy
+    uint32_t failed; //reads that did not return the register
+};
+
+/**
+ * @brief Blocking reads
+ *
+ * The caller spins in I2CEngine::wait until the STOP: the whole
+ * call, clock stretching included, is CPU time.
+ *
+ * @param sensor driver to read with
+ * @param n number of reads
+ *
+ * @return ReadCost what the reads cost
+ */
+static ReadCost blockingReads(TempSensor& sensor, uint32_t n){
+    ReadCost cost = ReadCost();
+    uint64_t bus0 = bus.stats().bus_ns;
+    for(uint32_t i = 0; i < n; i++){
+        uint64_t start = hal::Clock::nowUs();
+        hal::Cycles::Stamp cycles = hal::Cycles::now();
+        bool ok = sensor.Raw_Temp_Read();
+        cost.cpu_ns += hal::Cycles::since(cycles);
+        cost.call_us += hal::Clock::nowUs() - start;
+        if(!ok){
+            cost.failed++;
+        }
+    }
+    cost.bus_ns = bus.stats().bus_ns - bus0;
+    return cost;
+}
+
+/**
+ * @brief Async reads
+ *
+ * Only the call that queues the read is CPU time, measured the same
+ * way as the blocking call. Waiting for the interrupt is free for the
+ * caller, it idles outside the measurement.
+ *
+ * @param sensor driver to read with
+ * @param n number of reads
+ *
+ * @return ReadCost what the reads cost
+ */
+static ReadCost asyncReads(TempSensor& sensor, uint32_t n){
+    ReadCost cost = ReadCost();
+    uint64_t bus0 = bus.stats().bus_ns;
+    for(uint32_t i = 0; i < n; i++){
+        uint64_t start = hal::Clock::nowUs();
+        hal::Cycles::Stamp cycles = hal::Cycles::now();
+        bool queued = sensor.Raw_Temp_Read_Async();
+        cost.cpu_ns += hal::Cycles::since(cycles);
+        cost.call_us += hal::Clock::nowUs() - start;
+        while(queued && !sensor.Temp_Ready()){
+            hal::Cpu::idle();
+        }
+        if(!queued || !sensor.Temp_Ok()){
+            cost.failed++;
+        }
+    }
+    cost.bus_ns = bus.stats().bus_ns - bus0;
+    return cost;
+}
+
+/**
+ * @brief CPU time, blocking vs async
+ *
+ * Both calls are timed the same way, in host time and in virtual
+ * time. The host controller clocks the bytes inside the call that
+ * starts the transfer, on the Pico the hardware does, so the async
+ * call is slower here than on the target. A stretching sensor keeps
+ * the blocking caller spinning while the async caller is already back.
+ *
+ * @param sensor driver to read with
+ * @param stretch_us clock stretching of the sensor in every transfer
+ *
+ * @return void
+ */
+static void benchReads(TempSensor& sensor, uint32_t stretch_us){
+    const uint32_t n = 1000;
+    sim.setStretchUs(stretch_us);
+    ReadCost blocking = blockingReads(sensor, n);
+    ReadCost async = asyncReads(sensor, n);
+    sim.setStretchUs(0);
+
+    double blockingNs = (double)blocking.cpu_ns / n, asyncNs = (double)async.cpu_ns / n;
+    printf("stretch %4lu us            | %11.0f | %8.0f | %9.1f | %9.1f | %9.1f\n", (unsigned long)stretch_us,
+           blockingNs, asyncNs, async.bus_ns / 1000.0 / n, (double)blocking.call_us / n, (double)async.call_us / n);
+    CHECK(blocking.failed == 0);
+    CHECK(async.failed == 0);
+    CHECK(blocking.bus_ns == async.bus_ns);
+    CHECK(blocking.call_us >= stretch_us * n);
+    CHECK(async.call_us <= blocking.call_us);
+    if(stretch_us){
+        //the host bus time is in both calls, the stretch only in the blocking one
+        CHECK(async.call_us * 2 < blocking.call_us);
+        CHECK(async.cpu_ns < blocking.cpu_ns);
+    }
+}
+
+/**
+ * @brief Engine CPU time of transfers done inside other calls
+ *
+ * On the host the interrupt handler runs inside submit, and the next
+ * queued transfer completes inside the handler of the previous one.
+ * Each piece of time is counted once: never more than the time spent
+ * in the outer call.
+ *
+ * @param engine the transaction engine
+ *
+ * @return void
+ */
+static void checkEngineCpu(I2CEngine& engine){
+    const uint8_t n = 4;
+    uint8_t config[n];
+    I2CTransaction txns[n];
+
+    uint32_t before = engine.stats().cpu_us;
+    uint64_t start = hal::Clock::nowUs();
+    I2CEngine::prepareRead(txns[0], sim.address(), tcn75a::CONFIG_REG, &config[0], 1);
+    CHECK(engine.submit(txns[0]) && txns[0].done);
+    uint64_t spent = hal::Clock::nowUs() - start;
+    uint32_t counted = engine.stats().cpu_us - before;
+    printf("%-26s | %lu us counted, %lu us in the call\n", "submit, done inside", (unsigned long)counted,
+           (unsigned long)spent);
+    CHECK(counted <= spent);
+
+    //queued behind acquire, the release runs them back to back
+    engine.acquire();
+    for(uint8_t i = 0; i < n; i++){
+        I2CEngine::prepareRead(txns[i], sim.address(), tcn75a::CONFIG_REG, &config[i], 1);
+        CHECK(engine.submit(txns[i]));
+    }
+    before = engine.stats().cpu_us;
+    start = hal::Clock::nowUs();
+    engine.release();
+    spent = hal::Clock::nowUs() - start;
+    counted = engine.stats().cpu_us - before;
+    printf("%-26s | %lu us counted, %lu us in the call\n", "4 queued, done in release", (unsigned long)counted,
+           (unsigned long)spent);
+    CHECK(txns[n - 1].done && txns[n - 1].result == 1);
+    CHECK(counted <= spent);
+}
+
+/**
+ * @brief Async read guards
+ *
+ * A read in flight is not queued again, a read the full engine
+ * rejected does not block the next ones.
+ *
+ * @param sensor driver to read with
+ * @param engine its transaction engine
+ *
+ * @return void
+ */
+static void checkGuards(TempSensor& sensor, I2CEngine& engine){
+    //in flight: the sensor stretches the clock, the interrupt comes later
+    sim.setStretchUs(500);
+    CHECK(sensor.Raw_Temp_Read_Async());
+    CHECK(!sensor.Raw_Temp_Read_Async());
+    CHECK(!sensor.Temp_Ready());
+    engine.drain();
+    CHECK(sensor.Temp_Ready() && sensor.Temp_Ok());
+
+    //engine full: the read is rejected, and taken once there is room
+    I2CTransaction fill[I2CEngine::QUEUE_SIZE];
+    uint8_t buf[I2CEngine::QUEUE_SIZE];
+    uint8_t queued = 0;
+    for(I2CTransaction& txn : fill){
+        I2CEngine::prepareRead(txn, sim.address(), tcn75a::CONFIG_REG, &buf[queued], 1);
+        if(engine.submit(txn)){
+            queued++;
+        }
+    }
+    CHECK(queued == I2CEngine::QUEUE_SIZE - 1);
+    CHECK(!sensor.Raw_Temp_Read_Async());
+    engine.drain();
+    sim.setStretchUs(0);
+    CHECK(sensor.Raw_Temp_Read_Async());
+    engine.drain();
+    CHECK(sensor.Temp_Ready() && sensor.Temp_Ok());
+
+    //no answer: the read completes as failed, the last temperature stays
+    TempQ8 last = sensor.last_Temp();
+    sim.setResponding(false);
+    CHECK(sensor.Raw_Temp_Read_Async());
+    engine.drain();
+    sim.setResponding(true);
+    CHECK(sensor.Temp_Ready() && !sensor.Temp_Ok());
+    CHECK(sensor.last_Temp() == last);
+}
+
+int main(){
+    sim.setTemperature(26300);
+    TempSensor& sensor = boardSensor();
+    hal::Clock::sleepMs(100); //let the first conversions complete
+
+    printf("\n%-26s | blocking ns | async ns | bus us    | blocking  | async\n", "Temp read, per read");
+    printf("%-26s | (host)      | (host)   |           | call us   | call us\n", "");
+    printf("---------------------------+-------------+----------+-----------+-----------+----------\n");
+    benchReads(sensor, 0);
+    benchReads(sensor, 200);
+
+    checkEngineCpu(boardBus().engine());
+    checkGuards(sensor, boardBus().engine());
+    return check::result();
+}
@@ -0,0 +1,104 @@
+#include "../inc/I2CEngine.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+
+//Temperature reads against the faults the simulated sensor can inject:
+//NACKs, clock stretching and a held SDA line, then an async read that
+//only the engine watchdog can end.
+
+//One fault scenario and what the retry policy should give
+struct BusFault{
+    const char* name;
+    uint8_t nacks; //transfers refused
+    uint32_t stretch_us; //SCL held low in every transfer
+    uint8_t sda_clocks; //SDA held until this many SCL pulses
+    bool ok; //expected read result
+    uint32_t attempts; //expected tries
+    uint32_t timeouts; //expected attempts given up on the bus
+};
+
+static const BusFault busFaults[] = {
+    {"clean read", 0, 0, 0, true, 1, 0},
+    {"NACK x1", 1, 0, 0, true, 2, 0},
+    {"NACK x3", 3, 0, 0, true, 4, 0},
+    {"NACK x20 (gone)", 20, 0, 0, false, 4, 0},
+    {"stretch 2 ms", 0, 2000, 0, true, 1, 0},
+    {"stretch 20 ms", 0, 20000, 0, false, 4, 4},
+    {"SDA held 5 clocks", 0, 0, 5, true, 2, 1},
+    {"SDA held for good", 0, 0, SimTCN75A::HOLD_FOREVER, false, 4, 4},
+};
+
+/**
+ * @brief Bus fault injection
+ *
+ * Blocking temperature reads against NACKs, clock stretching and a
+ * held SDA line: result, attempts, timeouts and recoveries against
+ * what the retry policy should give, and the last good reading must
+ * survive a failed read. Then an async read stuck on the bus, which
+ * only the watchdog can fail.
+ *
+ * @param sensor driver whose engine is exercised
+ *
+ * @return void
+ */
+static void checkBusFaults(TempSensor& sensor){
+    I2CEngine& engine = sensor.getEngine();
+    const I2CEngine::Stats& st = engine.stats();
+    for(const BusFault& f : busFaults){
+        uint16_t before = sensor.get_Temp().toRaw();
+        sim.injectNacks(f.nacks);
+        sim.setStretchUs(f.stretch_us);
+        sim.holdSda(f.sda_clocks);
+        uint32_t retries = st.retries, timeouts = st.timeouts, recoveries = st.recoveries;
+        uint64_t start = hal::Clock::nowUs();
+        bool ok = sensor.Raw_Temp_Read();
+        uint32_t us = (uint32_t)(hal::Clock::nowUs() - start);
+        uint32_t attempts = st.retries - retries + 1;
+        timeouts = st.timeouts - timeouts;
+        recoveries = st.recoveries - recoveries;
+        bool kept = ok || sensor.last_Temp().toRaw() == before;
+
+        sim.injectNacks(0);
+        sim.setStretchUs(0);
+        sim.holdSda(0);
+        printf("%-26s | %-4s | %8lu | %8lu | %10lu | %8lu\n", f.name, ok ? "ok" : "fail",
+               (unsigned long)attempts, (unsigned long)timeouts, (unsigned long)recoveries, (unsigned long)us);
+        CHECK(ok == f.ok && attempts == f.attempts);
+        CHECK(timeouts == f.timeouts && recoveries == timeouts);
+        CHECK(kept); //a failed read leaves the last good reading
+    }
+
+    //async read on a held bus: nobody waits for it, the watchdog fails it
+    sim.holdSda(SimTCN75A::HOLD_FOREVER);
+    uint32_t timeouts = st.timeouts;
+    uint64_t start = hal::Clock::nowUs();
+    sensor.Raw_Temp_Read_Async();
+    while(!sensor.Temp_Ready() && hal::Clock::nowUs() - start < 100000){
+        engine.watchdog();
+        hal::Clock::sleepUs(500);
+    }
+    uint32_t us = (uint32_t)(hal::Clock::nowUs() - start);
+    bool expired = sensor.Temp_Ready() && st.timeouts == timeouts + 1;
+    sim.holdSda(0);
+    bool back = sensor.Raw_Temp_Read();
+    printf("%-26s | %-4s | %8s | %8lu | %10s | %8lu\n", "async, watchdog", back ? "ok" : "fail", "-",
+           (unsigned long)(st.timeouts - timeouts), "-", (unsigned long)us);
+    CHECK(expired);
+    CHECK(back); //the bus works again once SDA is released
+    printf("Policy: %lu us timeout, %u attempts, backoff %u..%u us\n", (unsigned long)engine.retryPolicy().timeout_us,
+           engine.retryPolicy().attempts, engine.retryPolicy().backoff_us, engine.retryPolicy().backoff_max_us);
+    sensor.printBusErrors();
+}
+
+int main(){
+    sim.setTemperature(26300);
+    TempSensor& sensor = boardSensor();
+    hal::Clock::sleepMs(100);
+
+    printf("\n%-26s | read | attempts | timeouts | recoveries | virt. us\n", "Bus faults (temp read)");
+    printf("---------------------------+------+----------+----------+------------+---------\n");
+    checkBusFaults(sensor);
+    return check::result();
+}
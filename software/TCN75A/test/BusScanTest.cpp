@@ -0,0 +1,93 @@
+#include "../inc/BusScanner.hpp"
+#include "../inc/SimTCN75A.hpp"
+#include "../inc/I2CBus.hpp"
+#include "../inc/ConfigRegister.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+//Bus scan wall time per mode, in virtual us: a targeted scan probes the
+//8 TCN75A addresses, a full scan the 112 non reserved ones, and a device
+//stretching the clock costs at most the probe timeout.
+
+using namespace tcn75a;
+
+static const uint8_t MAX_DEVICES = 10;
+
+//Devices on one bus and its scanner
+struct Rig{
+    hal::SimBus bus;
+    std::unique_ptr<SimTCN75A> sims[MAX_DEVICES];
+    uint8_t devices;
+    I2CBus sensorBus;
+
+    Rig(): bus(0, 400 * 1000), devices(0), sensorBus(&bus, 20, 21, 400 * 1000){
+        sensorBus.begin();
+    }
+
+    SimTCN75A& add(uint8_t addr){
+        sims[devices].reset(new SimTCN75A(addr));
+        bus.attach(sims[devices].get());
+        return *sims[devices++];
+    }
+};
+
+/**
+ * @brief Scan in one mode and check what it saw
+ *
+ * @param rig the bus
+ * @param name what is on the bus
+ * @param mode the scan mode
+ * @param found devices the scan must find
+ * @param timeouts probes cut by the probe timeout, never completed on the bus
+ * @param maxUs longest the scan may take
+ *
+ * @return uint32_t scan time in virtual us
+ */
+static uint32_t scanOnce(Rig& rig, const char* name, ScanMode mode, uint8_t found, uint8_t timeouts, uint32_t maxUs){
+    BusScanner& scanner = rig.sensorBus.scanner();
+    uint8_t probes = mode == ScanMode::Targeted ? LAST_ADDR - FIRST_ADDR + 1 : 0x77 - 0x08 + 1;
+    rig.bus.resetStats();
+    uint64_t start = hal::Clock::nowUs();
+    uint8_t count = scanner.scan(mode);
+    uint64_t elapsed = hal::Clock::nowUs() - start;
+    const hal::SimBus::Stats& bus = rig.bus.stats();
+    printf("%-26s | %-8s | %6lu | %5lu | %5u | %8.1f\n", name, mode == ScanMode::Full ? "full" : "targeted",
+           (unsigned long)scanner.durationUs(mode), (unsigned long)bus.transactions, count,
+           (double)scanner.durationUs(mode) / probes);
+    CHECK(count == found);
+    CHECK(bus.transactions + timeouts == probes);
+    CHECK(scanner.durationUs(mode) <= elapsed && scanner.durationUs(mode) <= maxUs);
+    return scanner.durationUs(mode);
+}
+
+int main(){
+    //one 9 bit probe at 400 kHz: address and data byte, ~50 us
+    const uint32_t probeUs = 60;
+    printf("\n%-26s | mode     | us     | done  | found | us/probe\n", "Bus scan, virtual time");
+    printf("---------------------------+----------+--------+-------+-------+---------\n");
+
+    Rig one;
+    one.add(FIRST_ADDR);
+    uint32_t targeted = scanOnce(one, "1 sensor", ScanMode::Targeted, 1, 0, 8 * probeUs);
+    uint32_t full = scanOnce(one, "1 sensor", ScanMode::Full, 1, 0, 112 * probeUs);
+    CHECK(targeted * 10 < full);
+
+    Rig eight;
+    for(uint8_t addr = FIRST_ADDR; addr <= LAST_ADDR; addr++){
+        eight.add(addr);
+    }
+    eight.add(0x20); //an expander outside the TCN75A window
+    scanOnce(eight, "8 sensors, 1 other", ScanMode::Targeted, 8, 0, 8 * probeUs);
+    scanOnce(eight, "8 sensors, 1 other", ScanMode::Full, 9, 0, 112 * probeUs);
+    CHECK(eight.sensorBus.scanner().found(0x20) && !eight.sensorBus.scanner().probed(0x07));
+
+    //a stretching device costs the probe timeout, not its whole stretch
+    Rig slow;
+    slow.add(FIRST_ADDR + 1).setStretchUs(5000);
+    slow.sensorBus.scanner().setProbeTimeout(500);
+    scanOnce(slow, "1 sensor, 5 ms stretch", ScanMode::Targeted, 0, 1, 8 * probeUs + 500);
+    scanOnce(slow, "1 sensor, 5 ms stretch", ScanMode::Full, 0, 1, 112 * probeUs + 500);
+    return check::result();
+}
@@ -0,0 +1,212 @@
+#include "../inc/ButtonEvents.hpp"
+#include "../inc/button.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+//Buttons on the simulated gpio: the ISR cost against the menu action it
+//used to run, bouncing contacts, a lost release, two buttons at once,
+//long and double presses.
+
+//Six buttons on gpio 2 to 7, pressed pulls the pin low
+static ButtonEvents buttonEvents(2);
+
+/**
+ * @brief Drive a button pin
+ *
+ * The contact bounces before it settles: the pin flips back and
+ * forth every 300 us first.
+ *
+ * @param pin button gpio
+ * @param pressed level to settle at, pressed is low
+ * @param bounces number of times the contact opens again
+ *
+ * @return void
+ */
+static void pushButton(uint8_t pin, bool pressed, uint8_t bounces){
+    for(uint8_t i = 0; i < bounces; i++){
+        hal::Gpio::drive(pin, !pressed);
+        hal::Clock::sleepUs(300);
+        hal::Gpio::drive(pin, pressed);
+        hal::Clock::sleepUs(300);
+    }
+    hal::Gpio::drive(pin, !pressed);
+}
+
+/**
+ * @brief Run the main loop for the buttons
+ *
+ * @param ms virtual time to run, the gestures are read every millisecond
+ * @param out destination of the gestures
+ *
+ * @return void
+ */
+static void runButtons(uint32_t ms, std::vector<ButtonEvent>& out){
+    for(uint32_t i = 0; i < ms; i++){
+        ButtonEvent event;
+        while(buttonEvents.next(event, hal::Clock::nowUs())){
+            out.push_back(event);
+        }
+        hal::Clock::sleepUs(1000);
+    }
+}
+
+/**
+ * @brief Gestures as text
+ *
+ * @param events gestures to print
+ * @param text destination, "P0 L1 D5" for press, long, double
+ * @param size size of the destination
+ *
+ * @return void
+ */
+static void gestureText(const std::vector<ButtonEvent>& events, char* text, size_t size){
+    size_t n = 0;
+    text[0] = '\0';
+    for(const ButtonEvent& e : events){
+        char g = e.gesture == ButtonGesture::Press ? 'P' : e.gesture == ButtonGesture::Double ? 'D' : 'L';
+        n += snprintf(text + n, n < size ? size - n : 0, "%s%c%u", n ? " " : "", g, (unsigned)e.button);
+        if(n >= size){
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Buttons
+ *
+ * The gpio ISR only queues debounced edges: its cost is timed on the
+ * virtual clock, against the menu action it used to run, now run by
+ * pollConsole. Then bouncing contacts, a release lost in a bounce,
+ * two buttons pressed together (each has its own debounce), long and
+ * double presses.
+ *
+ * @param sensor driver running the button actions
+ *
+ * @return void
+ */
+static void checkButtons(TempSensor& sensor){
+    char text[64];
+    static button buttons[] = {button(2, buttonEvents), button(3, buttonEvents), button(4, buttonEvents),
+                               button(5, buttonEvents), button(6, buttonEvents), button(7, buttonEvents)};
+    (void)buttons; //they only install their gpio interrupts
+    buttonEvents.enableDouble(5);
+    std::vector<ButtonEvent> events;
+
+    //press and release of button 0 (scan): the ISR returns at once
+    uint64_t start = hal::Clock::nowUs();
+    hal::Gpio::drive(2, false);
+    uint32_t isrUs = (uint32_t)(hal::Clock::nowUs() - start);
+    runButtons(30, events);
+    start = hal::Clock::nowUs();
+    hal::Gpio::drive(2, true);
+    isrUs = std::max(isrUs, (uint32_t)(hal::Clock::nowUs() - start));
+    sensor.setButtonEvents(&buttonEvents);
+    start = hal::Clock::nowUs();
+    quietStdout(true);
+    sensor.pollConsole();
+    quietStdout(false);
+    uint32_t actionUs = (uint32_t)(hal::Clock::nowUs() - start);
+    sensor.setButtonEvents(nullptr);
+    bool ran = sensor.getMenuState() == MenuState::Main && buttonEvents.stats().presses == 1;
+    snprintf(text, sizeof(text), "ISR %lu us, scan %lu us in main loop", (unsigned long)isrUs, (unsigned long)actionUs);
+    printf("%-26s | %s\n", "ISR latency", text);
+    CHECK(isrUs <= 3); //the ISR only queues the edge
+    CHECK(ran && actionUs > 100); //the scan runs from the main loop
+
+    //6 bounces on each edge of a press of button 1
+    ButtonEvents::Stats before = buttonEvents.stats();
+    events.clear();
+    pushButton(3, true, 6);
+    runButtons(100, events);
+    pushButton(3, false, 6);
+    runButtons(50, events);
+    gestureText(events, text, sizeof(text));
+    uint32_t bounces = buttonEvents.stats().bounces - before.bounces;
+    snprintf(text + strlen(text), sizeof(text) - strlen(text), ", %lu bounces dropped", (unsigned long)bounces);
+    printf("%-26s | %s\n", "bouncing contact", text);
+    CHECK(events.size() == 1 && events[0].button == 1 && events[0].gesture == ButtonGesture::Press);
+    CHECK(bounces == 24);
+
+    //a tap shorter than the debounce: the release is dropped, the pin level fixes it
+    before = buttonEvents.stats();
+    events.clear();
+    pushButton(4, true, 0);
+    runButtons(5, events);
+    pushButton(4, false, 0);
+    runButtons(50, events);
+    gestureText(events, text, sizeof(text));
+    uint32_t resyncs = buttonEvents.stats().resyncs - before.resyncs;
+    snprintf(text + strlen(text), sizeof(text) - strlen(text), ", %lu resync", (unsigned long)resyncs);
+    printf("%-26s | %s\n", "release lost in bounce", text);
+    CHECK(events.size() == 1 && events[0].button == 2 && resyncs == 1);
+
+    //buttons 3 and 4 pressed 1 ms apart, the old shared debounce kept one
+    events.clear();
+    pushButton(5, true, 0);
+    hal::Clock::sleepUs(1000);
+    pushButton(6, true, 0);
+    runButtons(50, events);
+    pushButton(5, false, 0);
+    pushButton(6, false, 0);
+    runButtons(50, events);
+    gestureText(events, text, sizeof(text));
+    printf("%-26s | %s\n", "two buttons at once", text);
+    CHECK(events.size() == 2 && events[0].button == 3 && events[1].button == 4);
+
+    //button 1 held for a second: long press reported while held, nothing on release
+    events.clear();
+    start = hal::Clock::nowUs();
+    pushButton(3, true, 0);
+    runButtons(1000, events);
+    bool held = events.size() == 1 && events[0].gesture == ButtonGesture::Long &&
+                events[0].timestamp_us - start < ButtonEvents::LONG_US + 1000;
+    pushButton(3, false, 0);
+    runButtons(400, events);
+    gestureText(events, text, sizeof(text));
+    printf("%-26s | %s\n", "long press (1 s)", text);
+    CHECK(held && events.size() == 1);
+
+    //button 5: two presses 100 ms apart, then a single one
+    events.clear();
+    for(uint8_t i = 0; i < 2; i++){
+        pushButton(7, true, 2);
+        runButtons(80, events);
+        pushButton(7, false, 2);
+        runButtons(100, events);
+    }
+    runButtons(400, events);
+    size_t doubles = events.size();
+    pushButton(7, true, 2);
+    runButtons(80, events);
+    pushButton(7, false, 2);
+    start = hal::Clock::nowUs();
+    runButtons(400, events);
+    gestureText(events, text, sizeof(text));
+    bool twice = doubles == 1 && events.size() == 2 && events[0].gesture == ButtonGesture::Double &&
+                 events[1].gesture == ButtonGesture::Press && events[1].button == 5;
+    printf("%-26s | %s\n", "double press (button 5)", text);
+    CHECK(twice);
+
+    //the main loop does not run while a contact bounces here, 3.6 ms at most
+    ButtonEvents::Stats st = buttonEvents.stats();
+    snprintf(text, sizeof(text), "%lu edges, %lu lost, max wait %lu us", (unsigned long)st.edges,
+             (unsigned long)buttonEvents.edgesLost(), (unsigned long)st.max_wait_us);
+    printf("%-26s | %s\n", "queue", text);
+    CHECK(buttonEvents.edgesLost() == 0 && st.max_wait_us < 5000);
+}
+
+int main(){
+    sim.setTemperature(26300);
+    TempSensor& sensor = boardSensor();
+    hal::Clock::sleepMs(100);
+
+    printf("\n%-26s | result\n", "Buttons (virtual time)");
+    printf("---------------------------+-----------------------------------------\n");
+    checkButtons(sensor);
+    return check::result();
+}
@@ -0,0 +1,37 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <cstdint>
+#include <cstdio>
+
+//Checks of the host tests.
+//A failed CHECK prints its file, line and condition and the test goes
+//on; main() returns check::result(), non-zero if any check failed, so
+//CTest reports it. Benchmarks print their tables and only check what
+//the virtual clock and the counters make exact, never host timings.
+
+namespace check {
+
+inline uint32_t& failures(){
+    static uint32_t count = 0;
+    return count;
+}
+
+inline bool expect(bool ok, const char* what, const char* file, int line){
+    if(!ok){
+        printf("%s:%d: FAIL %s\n", file, line, what);
+        failures()++;
+    }
+    return ok;
+}
+
+inline int result(){
+    printf("%lu failed checks\n", (unsigned long)failures());
+    return failures() ? 1 : 0;
+}
+
+}
+
+#define CHECK(cond) check::expect((cond), #cond, __FILE__, __LINE__)
+
+#endif
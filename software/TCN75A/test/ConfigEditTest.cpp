@@ -0,0 +1,98 @@
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+
+//Batched config register edits, counted on the sensor side: one read and
+//one write however many fields change, none when nothing has to.
+
+using namespace tcn75a;
+
+//CONFIG register traffic seen by the sensor
+struct ConfigTraffic{
+    uint32_t reads;
+    uint32_t writes;
+};
+
+static ConfigTraffic traffic(){
+    ConfigTraffic t;
+    t.reads = sim.stats().reads[CONFIG_REG];
+    t.writes = sim.stats().writes[CONFIG_REG];
+    return t;
+}
+
+/**
+ * @brief Print and check the traffic of one step
+ *
+ * @param name what the step did
+ * @param before traffic() before the step
+ * @param reads expected CONFIG reads
+ * @param writes expected CONFIG writes
+ *
+ * @return void
+ */
+static void expectTraffic(const char* name, const ConfigTraffic& before, uint32_t reads, uint32_t writes){
+    ConfigTraffic after = traffic();
+    uint32_t r = after.reads - before.reads, w = after.writes - before.writes;
+    printf("%-34s | %5lu | %6lu\n", name, (unsigned long)r, (unsigned long)w);
+    CHECK(r == reads);
+    CHECK(w == writes);
+}
+
+int main(){
+    TempSensor& sensor = boardSensor();
+
+    const ConfigEdit edit = ConfigEdit().set(Resolution::Bits12).set(FaultQueue::Four).set(Polarity::ActiveHigh);
+    printf("\n%-34s | reads | writes\n", "CONFIG register traffic");
+    printf("-----------------------------------+-------+-------\n");
+
+    //3 fields, cold cache: one read-modify-write
+    sensor.invalidateShadow();
+    ConfigTraffic before = traffic();
+    CHECK(sensor.applyConfig(edit));
+    expectTraffic("3 fields, cold cache", before, 1, 1);
+    CHECK(edit.matches((uint8_t)sim.reg(CONFIG_REG)));
+    CHECK(sensor.getShadow(CONFIG_REG).valid && sensor.getShadow(CONFIG_REG).data[0] == (uint8_t)sim.reg(CONFIG_REG));
+
+    //the same fields again: the shadow copy already holds them
+    before = traffic();
+    CHECK(sensor.applyConfig(edit));
+    expectTraffic("same 3 fields, warm cache", before, 0, 0);
+
+    //another change: the read comes from the shadow copy
+    before = traffic();
+    CHECK(sensor.applyConfig(ConfigEdit().set(Resolution::Bits9).set(AlertMode::Interrupt)));
+    expectTraffic("2 fields, warm cache", before, 0, 1);
+    CHECK(get<Resolution>((uint8_t)sim.reg(CONFIG_REG)) == Resolution::Bits9);
+    CHECK(get<FaultQueue>((uint8_t)sim.reg(CONFIG_REG)) == FaultQueue::Four); //untouched fields stay
+
+    //the same register already set on the sensor, cache cold: read only
+    sensor.invalidateShadow();
+    before = traffic();
+    CHECK(sensor.applyConfig(ConfigEdit().set(Resolution::Bits9)));
+    expectTraffic("field already set, cold cache", before, 1, 0);
+
+    before = traffic();
+    CHECK(sensor.applyConfig(ConfigEdit()));
+    expectTraffic("empty edit", before, 0, 0);
+
+    //what the batch replaces: one read-modify-write per field
+    before = traffic();
+    sensor.invalidateShadow();
+    sensor.modifyConfigRegister(ResolutionField::mask, ResolutionField::encode(Resolution::Bits12));
+    sensor.invalidateShadow();
+    sensor.modifyConfigRegister(FaultQueueField::mask, FaultQueueField::encode(FaultQueue::Two));
+    sensor.invalidateShadow();
+    sensor.modifyConfigRegister(PolarityField::mask, PolarityField::encode(Polarity::ActiveLow));
+    expectTraffic("3 fields, one by one, uncached", before, 3, 3);
+
+    //no answer: the edit fails before anything is written
+    sensor.invalidateShadow();
+    sim.setResponding(false);
+    before = traffic();
+    CHECK(!sensor.applyConfig(edit));
+    sim.setResponding(true);
+    CHECK(sim.stats().writes[CONFIG_REG] == before.writes);
+    CHECK(!sensor.getShadow(CONFIG_REG).valid);
+    return check::result();
+}
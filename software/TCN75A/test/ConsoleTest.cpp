@@ -0,0 +1,171 @@
+#include "../inc/SamplingScheduler.hpp"
+#include "../inc/LedEffects.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ucontext.h>
+
+//The polled console typed at about 115200 baud, in virtual time: menu
+//navigation, a limit prompt and commands, once and 100 times. The stack
+//it uses must not grow with the rounds, as the old recursive menus did,
+//and sampling goes on while the commands run.
+
+using namespace tcn75a;
+
+//Longest a sample may come after the time the scheduler set for it
+static const uint32_t SAMPLE_DEADLINE_US = 1000;
+
+//Console script: menu navigation, a limit prompt and scripted commands
+static const char consoleScript[] =
+    "1\n4\n3\n" //CONFIG > ADC RES > 12 bit
+    "3\n3\n" //Alert > show MAX limit
+    "3\n1\n30.5\n" //Alert > MAX limit prompt
+    "1\nx\n" //CONFIG and back
+    "4\nx\n" //live temperature and back
+    "set res 11\r\n"
+    "read temp\n"
+    "set fq 2\n"
+    "read hyst\n";
+static const uint32_t SCRIPT_LINES = 16;
+
+//The script runs on its own stack, painted to find how deep it went
+static const size_t SCRIPT_STACK = 256 * 1024;
+static uint8_t scriptStack[SCRIPT_STACK];
+static ucontext_t mainContext, scriptContext;
+
+//Result of one console run
+struct ConsoleRun{
+    TempSensor* sensor;
+    SamplingScheduler* sampler;
+    uint32_t rounds; //times the script is typed
+    uint32_t lines; //lines the parser completed
+    uint32_t samples; //samples taken while typing
+    uint64_t elapsed_us;
+    uint64_t max_poll_us; //longest pass of the console and display tasks
+    uint64_t max_gap_us; //longest time between two samples
+    uint64_t max_late_us; //longest gap past the time the sampler scheduled
+    size_t stack; //deepest stack use
+};
+static ConsoleRun consoleRun;
+
+/**
+ * @brief Type the console script
+ *
+ * Feeds one character every 100 us (about 115200 baud) and runs
+ * the main loop of the firmware in between: pollConsole, the display
+ * task that shows the config feedback, then the sampler. Runs on
+ * scriptStack.
+ *
+ * @return void
+ */
+static void typeScript(){
+    ConsoleRun& r = consoleRun;
+    uint64_t start = hal::Clock::nowUs();
+    uint64_t lastSample = start;
+    uint64_t due = r.sampler->nextDueUs();
+    uint32_t period = (uint32_t)(due > start ? due - start : 0); //time the next read was scheduled with
+    uint32_t firstSample = r.sampler->samples();
+    uint32_t firstLine = r.sensor->getConsole().stats().lines;
+
+    for(uint32_t round = 0; round < r.rounds; round++){
+        for(const char* p = consoleScript; *p; p++){
+            hal::Cpu::feedInput(p, 1);
+            uint64_t next = hal::Clock::nowUs() + 100;
+            uint64_t now;
+            while((now = hal::Clock::nowUs()) < next){
+                r.sensor->pollConsole();
+                r.sensor->refreshDisplay();
+                uint64_t after = hal::Clock::nowUs();
+                if(after - now > r.max_poll_us){
+                    r.max_poll_us = after - now;
+                }
+                if(r.sampler->poll(after)){
+                    uint64_t gap = after - lastSample;
+                    if(gap > r.max_gap_us){
+                        r.max_gap_us = gap;
+                    }
+                    if(gap > period && gap - period > r.max_late_us){
+                        r.max_late_us = gap - period;
+                    }
+                    lastSample = after;
+                    due = r.sampler->nextDueUs();
+                    period = (uint32_t)(due > after ? due - after : 0);
+                }
+            }
+        }
+    }
+    r.samples = r.sampler->samples() - firstSample;
+    r.lines = r.sensor->getConsole().stats().lines - firstLine;
+    r.elapsed_us = hal::Clock::nowUs() - start;
+}
+
+/**
+ * @brief Console stack and latency
+ *
+ * Types the script a number of times with the menus hidden.
+ *
+ * @param name row name in the table
+ * @param sensor sensor whose console is driven
+ * @param sampler sampler polled by the loop
+ * @param rounds times the script is typed
+ *
+ * @return ConsoleRun what the run measured
+ */
+static ConsoleRun runConsole(const char* name, TempSensor& sensor, SamplingScheduler& sampler, uint32_t rounds){
+    consoleRun = ConsoleRun();
+    consoleRun.sensor = &sensor;
+    consoleRun.sampler = &sampler;
+    consoleRun.rounds = rounds;
+
+    memset(scriptStack, 0xA5, sizeof(scriptStack));
+    getcontext(&scriptContext);
+    scriptContext.uc_stack.ss_sp = scriptStack;
+    scriptContext.uc_stack.ss_size = sizeof(scriptStack);
+    scriptContext.uc_link = &mainContext;
+    makecontext(&scriptContext, typeScript, 0);
+
+    quietStdout(true);
+    swapcontext(&mainContext, &scriptContext);
+    quietStdout(false);
+
+    //the stack grows down, the first byte changed is the deepest
+    size_t untouched = 0;
+    while(untouched < sizeof(scriptStack) && scriptStack[untouched] == 0xA5){
+        untouched++;
+    }
+    consoleRun.stack = sizeof(scriptStack) - untouched;
+
+    const ConsoleRun& r = consoleRun;
+    printf("%-26s | %5lu | %7lu | %8lu | %11lu | %10lu | %7lu | %5lu\n",
+           name, (unsigned long)r.lines, (unsigned long)r.samples,
+           (unsigned long)(r.elapsed_us / 1000), (unsigned long)r.max_poll_us, (unsigned long)r.max_gap_us,
+           (unsigned long)r.max_late_us, (unsigned long)r.stack);
+    CHECK(r.lines == SCRIPT_LINES * rounds);
+    //no sample later than scheduled plus one read
+    CHECK(r.max_late_us <= SAMPLE_DEADLINE_US);
+    return r;
+}
+
+int main(){
+    sim.setTemperature(26300);
+    TempSensor& sensor = boardSensor();
+    SamplingScheduler sampler(sensor);
+    sensor.setSampler(&sampler);
+    static LedEffects leds; //feedback blinks play on it, as on the board
+    sensor.setLedEffects(&leds);
+    hal::Clock::sleepMs(100);
+
+    printf("\n%-26s | lines | samples | virt. ms | max poll us | max gap us | late us | stack\n", "Console");
+    printf("---------------------------+-------+---------+----------+-------------+------------+---------+------\n");
+    //the first pass also runs what the C library sets up on first use
+    runConsole("Console script, first", sensor, sampler, 1);
+    ConsoleRun once = runConsole("Console script x1", sensor, sampler, 1);
+    ConsoleRun many = runConsole("Console script x100", sensor, sampler, 100);
+    CHECK(many.stack == once.stack); //nothing left on the stack between lines
+    CHECK(many.samples > 0); //sampling goes on while typing
+    CHECK(get<Resolution>((uint8_t)sim.reg(CONFIG_REG)) == Resolution::Bits11);
+    CHECK(get<FaultQueue>((uint8_t)sim.reg(CONFIG_REG)) == FaultQueue::Two);
+    return check::result();
+}
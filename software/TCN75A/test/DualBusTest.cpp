@@ -0,0 +1,104 @@
+#include "../inc/SimTCN75A.hpp"
+#include "../inc/I2CBus.hpp"
+#include "../inc/SensorArray.hpp"
+#include "../inc/SampleMerger.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+//Eight sensors on one bus against eight on each of two buses, polled by
+//one SensorArray per bus and merged back into one stream in time order.
+
+/**
+ * @brief Buses in parallel
+ *
+ * Eight sensors on each bus (every TCN75A address), polled by one
+ * SensorArray per bus as the poll timer does, the rings merged back
+ * into one stream. Time is virtual and the host runs the transfers
+ * one after the other, so the rate is what the sensors deliver, not
+ * what the two controllers could overlap. The merged stream must
+ * come out in time order.
+ *
+ * @param busCount 1 or 2
+ * @param ms virtual time to run
+ * @param single rate of one bus, 0 when this is the one bus run
+ *
+ * @return uint32_t aggregate samples per second
+ */
+static uint32_t runBuses(uint8_t busCount, uint32_t ms, uint32_t single){
+    hal::SimBus simBus[2] = {hal::SimBus(0, 400 * 1000), hal::SimBus(1, 400 * 1000)};
+    std::vector<std::unique_ptr<SimTCN75A>> sims;
+    std::unique_ptr<I2CBus> buses[2];
+    std::unique_ptr<SensorArray> arrays[2];
+    SampleQueue rings[2];
+    SampleMerger merger;
+    uint8_t found = 0;
+
+    for(uint8_t b = 0; b < busCount; b++){
+        for(uint8_t a = tcn75a::FIRST_ADDR; a <= tcn75a::LAST_ADDR; a++){
+            sims.emplace_back(new SimTCN75A(a));
+            sims.back()->setTemperature(20000 + 500 * (int32_t)sims.size());
+            simBus[b].attach(sims.back().get());
+        }
+        buses[b].reset(new I2CBus(&simBus[b], 20, 21, 400 * 1000));
+        buses[b]->begin();
+        arrays[b].reset(new SensorArray(buses[b]->engine()));
+        arrays[b]->setSampleSink(&rings[b]);
+        found += arrays[b]->discover();
+        merger.addSource(&rings[b]);
+    }
+
+    hal::Clock::sleepMs(40); //first conversions at 9 bit
+    uint64_t start = hal::Clock::nowUs();
+    TempSample sample;
+    uint64_t busNs = 0, last = 0;
+    uint32_t unordered = 0;
+    for(uint8_t b = 0; b < busCount; b++){
+        simBus[b].resetStats();
+    }
+    while(hal::Clock::nowUs() - start < (uint64_t)ms * 1000){
+        uint64_t now = hal::Clock::nowUs();
+        for(uint8_t b = 0; b < busCount; b++){
+            arrays[b]->poll(now);
+        }
+        while(merger.pop(sample, hal::Clock::nowUs())){
+            unordered += sample.timestamp_us < last;
+            last = sample.timestamp_us;
+        }
+        hal::Clock::sleepUs(1000); //poll timer period of the firmware is 5 ms, finer here
+    }
+    uint64_t elapsed = hal::Clock::nowUs() - start;
+    hal::Clock::sleepUs(SampleMerger::HOLD_US);
+    while(merger.pop(sample, hal::Clock::nowUs())){
+        unordered += sample.timestamp_us < last;
+        last = sample.timestamp_us;
+    }
+    for(uint8_t b = 0; b < busCount; b++){
+        busNs += simBus[b].stats().bus_ns;
+    }
+
+    uint32_t rate = (uint32_t)((uint64_t)merger.stats().merged * 1000000 / elapsed);
+    char name[32], gain[16];
+    snprintf(name, sizeof(name), "%u bus%s, %u sensors", busCount, busCount > 1 ? "es" : "", found);
+    snprintf(gain, sizeof(gain), single ? "x%.2f" : "-", single ? (double)rate / single : 0.0);
+    printf("%-26s | %9lu | %7s | %6.1f %% | %4lu | %5lu | %9lu\n", name, (unsigned long)rate, gain,
+           100.0 * busNs / busCount / (elapsed * 1000.0), (unsigned long)merger.stats().late,
+           (unsigned long)merger.dropped(), (unsigned long)unordered);
+    CHECK(found == 8 * busCount);
+    CHECK(merger.stats().late == 0 && merger.dropped() == 0 && unordered == 0);
+    for(uint8_t b = 0; b < busCount; b++){
+        CHECK(merger.stats().per_source[b] * busCount >= merger.stats().merged * 9 / 10); //no bus starved
+    }
+    return rate;
+}
+
+int main(){
+    printf("\n%-26s | samples/s | vs one  | bus busy | late | drops | unordered\n", "Dual bus (9 bit, 1 s)");
+    printf("---------------------------+-----------+---------+----------+------+-------+----------\n");
+    uint32_t one = runBuses(1, 1000, 0);
+    uint32_t two = runBuses(2, 1000, one);
+    CHECK(two * 10 >= one * 19); //the second bus adds its own sensors' rate
+    return check::result();
+}
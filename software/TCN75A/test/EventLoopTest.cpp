@@ -0,0 +1,207 @@
+#include "../inc/SamplingScheduler.hpp"
+#include "../inc/EventLoop.hpp"
+#include "../inc/LedEffects.hpp"
+#include "../inc/ButtonEvents.hpp"
+#include "../inc/button.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+//The core 0 event loop of the firmware on the virtual clock: sampling
+//keeps its rate and deadline, the timers only wait for a task running to
+//completion, console and button events are served, and the core sleeps
+//in between.
+
+//LEDs of the board: red and Alert on gpio 17
+static LedEffects leds;
+static const uint8_t RED_PIN = 17;
+
+//Six buttons on gpio 2 to 7, pressed pulls the pin low
+static ButtonEvents buttonEvents(2);
+static button buttons[] = {button(2, buttonEvents), button(3, buttonEvents), button(4, buttonEvents),
+                           button(5, buttonEvents), button(6, buttonEvents), button(7, buttonEvents)};
+
+//Same tasks as the firmware, on the virtual clock
+static const uint32_t DISPLAY_PERIOD_US = 20 * 1000;
+static const uint32_t SAMPLE_DEADLINE_US = 1000;
+static const uint32_t READ_TIMEOUT_US = 10 * 1000;
+
+static uint64_t runSampler(void* context, uint64_t now_us){
+    SamplingScheduler* sampler = static_cast<SamplingScheduler*>(context);
+    sampler->poll(now_us);
+    if(sampler->readPending()){
+        return now_us + READ_TIMEOUT_US;
+    }
+    uint64_t due = sampler->nextDueUs();
+    return due > now_us ? due : now_us;
+}
+
+static bool sampleReady(void* context){
+    return static_cast<SamplingScheduler*>(context)->readDone();
+}
+
+static uint64_t runConsole(void* context, uint64_t now_us){
+    return static_cast<TempSensor*>(context)->pollInput() ? now_us : 0;
+}
+
+static bool consoleReady(void* context){
+    (void)context;
+    return hal::Cpu::inputReady();
+}
+
+static uint64_t runButtons(void* context, uint64_t now_us){
+    (void)now_us;
+    static_cast<TempSensor*>(context)->pollButtons();
+    return buttonEvents.nextDueUs();
+}
+
+static bool buttonsReady(void* context){
+    (void)context;
+    return buttonEvents.pending();
+}
+
+static uint64_t tickLeds(void* context, uint64_t now_us){
+    static_cast<LedEffects*>(context)->tick((uint32_t)(now_us / 1000));
+    return 0;
+}
+
+static uint64_t refreshDisplay(void* context, uint64_t now_us){
+    (void)now_us;
+    static_cast<TempSensor*>(context)->refreshDisplay();
+    return 0;
+}
+
+/**
+ * @brief Add the tasks of core 0
+ *
+ * The firmware also polls the sensor arrays, the board of the test
+ * has none.
+ *
+ * @param loop the scheduler
+ * @param sensor driver of the console, buttons and display
+ * @param sampler scheduler of the reads
+ *
+ * @return void
+ */
+static void addTasks(EventLoop& loop, TempSensor& sensor, SamplingScheduler& sampler){
+    loop.addEvent("console", &consoleReady, &runConsole, &sensor);
+    loop.addEvent("buttons", &buttonsReady, &runButtons, &sensor);
+    uint8_t sampling = loop.addEvent("sampling", &sampleReady, &runSampler, &sampler, SAMPLE_DEADLINE_US);
+    loop.setDue(sampling, hal::Clock::nowUs());
+    loop.addTimer("leds", &tickLeds, &leds, LedEffects::TICK_MS * 1000);
+    loop.addTimer("display", &refreshDisplay, &sensor, DISPLAY_PERIOD_US);
+    sensor.setEventLoop(&loop);
+}
+
+//Test user: presses button 0 (scan) at 500 ms and releases it 2 ms before an LED tick
+struct ScriptedUser{
+    uint64_t start_us;
+    uint8_t step;
+};
+
+static uint64_t runUser(void* context, uint64_t now_us){
+    ScriptedUser* user = static_cast<ScriptedUser*>(context);
+    switch (user->step++) {
+        case 0:
+            return user->start_us + 500 * 1000;
+        case 1:
+            hal::Gpio::drive(2, false);
+            return now_us + 98 * 1000;
+        case 2:
+            hal::Gpio::drive(2, true);
+            break;
+    }
+    return EventLoop::NEVER;
+}
+
+static bool never(void* context){
+    (void)context;
+    return false;
+}
+
+/**
+ * @brief Event loop
+ *
+ * Two seconds of the firmware loop on the virtual clock: sampling at
+ * the maximum rate, the LED and display timers, a typed command and a
+ * button press whose action (a 3 ms scan) runs in the loop. The timer
+ * jitter comes from the tasks running to completion: the LED tick
+ * waits for the scan. A start later than the deadline is a miss. The
+ * number of samples is the same as with the old busy loop, and the
+ * core sleeps between the tasks.
+ *
+ * @param sensor driver of the console, buttons and display
+ * @param sampler scheduler of the reads
+ *
+ * @return void
+ */
+static void checkEventLoop(TempSensor& sensor, SamplingScheduler& sampler){
+    printf("\nEvent loop (virtual time, 2 s, max rate, one command, one button press)\n");
+    uint32_t samples = sampler.samples();
+    sampler.runUntil(hal::Clock::nowUs() + 2000 * 1000);
+    uint32_t busyLoop = sampler.samples() - samples;
+
+    EventLoop loop;
+    addTasks(loop, sensor, sampler);
+    ScriptedUser user = {hal::Clock::nowUs(), 0};
+    uint8_t script = loop.addEvent("user", &never, &runUser, &user);
+    loop.setDue(script, user.start_us);
+
+    samples = sampler.samples();
+    uint32_t presses = buttonEvents.stats().presses;
+    const char* line = "read temp\n";
+    hal::Cpu::feedInput(line, strlen(line));
+    loop.resetStats();
+    quietStdout(true);
+    loop.runUntil(user.start_us + 2000 * 1000);
+    quietStdout(false);
+    loop.printStats();
+    sensor.setEventLoop(nullptr);
+
+    const EventLoop::TaskStats& console = loop.stats(0);
+    const EventLoop::TaskStats& buttons = loop.stats(1);
+    const EventLoop::TaskStats& sampling = loop.stats(2);
+    const EventLoop::TaskStats& ledTimer = loop.stats(3);
+    const EventLoop::TaskStats& display = loop.stats(4);
+    char text[64];
+    printf("%-26s | result\n", "");
+    printf("---------------------------+-----------------------------------------\n");
+    samples = sampler.samples() - samples;
+    snprintf(text, sizeof(text), "%lu samples (busy loop %lu), %lu misses", (unsigned long)samples,
+             (unsigned long)busyLoop, (unsigned long)sampling.misses);
+    printf("%-26s | %s\n", "sampling", text);
+    CHECK(samples + 1 >= busyLoop && samples <= busyLoop + 1); //as many as the busy loop took
+    CHECK(sampling.misses == 0);
+    snprintf(text, sizeof(text), "%lu ticks, jitter %lu us, %lu misses", (unsigned long)ledTimer.runs,
+             (unsigned long)ledTimer.max_late_us, (unsigned long)ledTimer.misses);
+    printf("%-26s | %s\n", "LED timer (10 ms)", text);
+    CHECK(ledTimer.runs >= 199 && ledTimer.misses == 0 && ledTimer.skipped == 0);
+    CHECK(ledTimer.max_late_us > 100 && ledTimer.max_late_us < buttons.max_us); //waited for the scan, no longer
+    snprintf(text, sizeof(text), "%lu redraws, jitter %lu us", (unsigned long)display.runs, (unsigned long)display.max_late_us);
+    printf("%-26s | %s\n", "display timer (20 ms)", text);
+    CHECK(display.runs >= 99 && display.misses == 0);
+    snprintf(text, sizeof(text), "%lu console runs, %lu button runs", (unsigned long)console.runs, (unsigned long)buttons.runs);
+    printf("%-26s | %s\n", "event sources", text);
+    CHECK(console.runs >= 1);
+    CHECK(buttonEvents.stats().presses == presses + 1 && buttons.max_us > 1000); //the scan ran in the loop
+    uint32_t idle = (uint32_t)(loop.idleUs() / 20000);
+    snprintf(text, sizeof(text), "%lu %% asleep, %lu wakeups", (unsigned long)idle, (unsigned long)loop.wakeups());
+    printf("%-26s | %s\n", "idle", text);
+    CHECK(idle >= 50);
+}
+
+int main(){
+    sim.setTemperature(26300);
+    TempSensor& sensor = boardSensor();
+    hal::Clock::sleepMs(100);
+    SamplingScheduler sampler(sensor);
+    sensor.setButtonEvents(&buttonEvents);
+    sensor.setLedEffects(&leds);
+    leds.bind(LedChannel::Alert, RED_PIN);
+    (void)buttons; //they only install their gpio interrupts
+
+    checkEventLoop(sensor, sampler);
+    return check::result();
+}
@@ -0,0 +1,163 @@
+#include "../inc/FixedTemp.hpp"
+#include "Check.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//TempQ8 against the float code it replaced, over every 16 bit register
+//word: conversions, rounding and formatting in the three units, then
+//what each one costs on the host.
+
+//Float reference of a register word in a unit, as the old code computed it
+static float reference(uint16_t raw, TempUnit unit){
+    float c = (float)(int16_t)raw / 256.0f; //exact: 16 significant bits
+    return unit == TempUnit::Fahrenheit ? c * 1.8f + 32.0f : unit == TempUnit::Kelvin ? c + 273.15f : c;
+}
+
+static const char* unitName(TempUnit unit){
+    return unit == TempUnit::Fahrenheit ? "F" : unit == TempUnit::Kelvin ? "K" : "C";
+}
+
+//Mismatches of one unit over the 65536 words
+struct UnitErrors{
+    uint32_t milli; //milli() off the reference by more than rounding
+    uint32_t whole; //whole() off the reference by more than rounding
+    uint32_t text; //format() not the printf text (Celsius) or off by more than half a digit
+    double worst; //largest |milli() - 1000 * reference|
+};
+
+/**
+ * @brief printf text of a Celsius value, without the sign of a zero
+ *
+ * format() prints "0.0" where printf prints "-0.0".
+ *
+ * @param out destination buffer
+ * @param size size of the destination buffer
+ * @param value the temperature
+ * @param decimals number of digits after the point
+ *
+ * @return void
+ */
+static void printfText(char* out, size_t size, float value, uint8_t decimals){
+    snprintf(out, size, "%.*f", (int)decimals, (double)value);
+    if(out[0] == '-' && strspn(out + 1, "0.") == strlen(out + 1)){
+        memmove(out, out + 1, strlen(out));
+    }
+}
+
+/**
+ * @brief Every register word in one unit
+ *
+ * Celsius is exact in float, so its text must match printf to the
+ * character at every precision. Fahrenheit and Kelvin have float
+ * rounding in the reference: the fixed-point result must be within
+ * half a step of it, plus the float error.
+ *
+ * @param unit unit to convert to
+ *
+ * @return UnitErrors what did not match
+ */
+static UnitErrors checkUnit(TempUnit unit){
+    const double floatError = 1e-4; //a few float ulps at 300, covers the cancellation of F near 0
+    UnitErrors errors = UnitErrors();
+    char text[24], expect[24];
+    for(uint32_t w = 0; w <= 0xFFFF; w++){
+        uint16_t raw = (uint16_t)w;
+        TempQ8 temp = TempQ8::fromRaw(raw);
+        double ref = reference(raw, unit);
+
+        double off = fabs(temp.milli(unit) - ref * 1000);
+        errors.worst = off > errors.worst ? off : errors.worst;
+        errors.milli += off > 0.5 + floatError * 1000;
+        errors.whole += fabs(temp.whole(unit) - ref) > 0.5 + floatError;
+
+        for(uint8_t decimals = 0; decimals <= 6; decimals++){
+            int n = temp.format(text, sizeof(text), unit, decimals);
+            bool ok = n == (int)strlen(text);
+            if(unit == TempUnit::Celsius){
+                printfText(expect, sizeof(expect), (float)ref, decimals);
+                ok = ok && strcmp(text, expect) == 0;
+            } else {
+                ok = ok && fabs(atof(text) - ref) <= 0.5 * pow(10.0, -decimals) + floatError;
+            }
+            errors.text += !ok;
+        }
+    }
+    return errors;
+}
+
+/**
+ * @brief Register word round trips
+ *
+ * @return void
+ */
+static void checkRoundTrips(){
+    uint32_t wrong = 0;
+    for(uint32_t w = 0; w <= 0xFFFF; w++){
+        uint16_t raw = (uint16_t)w;
+        TempQ8 temp = TempQ8::fromRaw(raw);
+        wrong += temp.toRaw() != raw;
+        wrong += TempQ8::fromBytes((uint8_t)(raw >> 8), (uint8_t)raw) != temp;
+        wrong += TempQ8::fromMilliCelsius(temp.milli()) != temp; //1 mC is finer than a step
+    }
+    CHECK(wrong == 0);
+}
+
+//Keeps the benchmark loops from being optimized away
+static volatile int32_t sink;
+
+/**
+ * @brief Host cost of a conversion, fixed point vs float
+ *
+ * Printed only: the host has an FPU and a 64 bit divide, the RP2040
+ * has neither, so only the order of magnitude carries over.
+ *
+ * @return void
+ */
+static void benchConversions(){
+    const uint32_t rounds = 16;
+    char text[24];
+    typedef std::chrono::steady_clock clock;
+    double ns[4];
+    for(uint8_t kind = 0; kind < 4; kind++){
+        int32_t acc = 0;
+        auto start = clock::now();
+        for(uint32_t r = 0; r < rounds; r++){
+            for(uint32_t w = 0; w <= 0xFFFF; w++){
+                uint16_t raw = (uint16_t)(w ^ (r << 4)) ^ (uint16_t)sink;
+                switch(kind){
+                    case 0: acc += TempQ8::fromRaw(raw).milli(TempUnit::Fahrenheit); break;
+                    case 1: acc += (int32_t)lroundf(reference(raw, TempUnit::Fahrenheit) * 1000.0f); break;
+                    case 2: acc += TempQ8::fromRaw(raw).format(text, sizeof(text)); break;
+                    default: acc += snprintf(text, sizeof(text), "%.4f", (double)reference(raw, TempUnit::Celsius)); break;
+                }
+            }
+        }
+        ns[kind] = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (rounds * 65536.0);
+        sink = acc;
+    }
+    printf("\n%-26s | fixed ns | float ns\n", "TempQ8 vs float, host");
+    printf("---------------------------+----------+---------\n");
+    printf("%-26s | %8.1f | %8.1f\n", "milli degrees F", ns[0], ns[1]);
+    printf("%-26s | %8.1f | %8.1f\n", "text, 4 decimals", ns[2], ns[3]);
+}
+
+int main(){
+    const TempUnit units[] = {TempUnit::Celsius, TempUnit::Fahrenheit, TempUnit::Kelvin};
+    printf("\n%-26s | milli | whole | text  | worst mdeg\n", "TempQ8, 65536 words");
+    printf("---------------------------+-------+-------+-------+-----------\n");
+    for(TempUnit unit : units){
+        UnitErrors errors = checkUnit(unit);
+        printf("%-26s | %5lu | %5lu | %5lu | %10.4f\n", unitName(unit), (unsigned long)errors.milli,
+               (unsigned long)errors.whole, (unsigned long)errors.text, errors.worst);
+        CHECK(errors.milli == 0);
+        CHECK(errors.whole == 0);
+        CHECK(errors.text == 0);
+    }
+    checkRoundTrips();
+    benchConversions();
+    return check::result();
+}
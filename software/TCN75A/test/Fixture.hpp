@@ -0,0 +1,84 @@
+#ifndef FIXTURE_HPP
+#define FIXTURE_HPP
+
+#include "../inc/TempSensor.hpp"
+#include "../inc/SimTCN75A.hpp"
+#include "../inc/I2CBus.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+//Board of the host tests: one simulated TCN75A at 0x48 on i2c1 at
+//400 kHz, its ALERT output on gpio 0, wired as on the PCB with SDA on 14,
+//SCL on 15 and the LEDs on 17 and 16. A test program includes it once
+//and reaches the sensor through bus and sim.
+
+static const uint32_t BOARD_BAUD = 400 * 1000;
+static hal::SimBus bus(1, BOARD_BAUD);
+static SimTCN75A sim(0x48, 0);
+
+//I2C controller of the board, started with the simulated sensor on its bus
+struct BoardBus : I2CBus{
+    BoardBus(): I2CBus(&bus, 14, 15, BOARD_BAUD){
+        bus.attach(&sim);
+        begin();
+    }
+};
+
+/**
+ * @brief I2C controller of the board
+ *
+ * @return I2CBus& the controller of bus, created on the first call
+ */
+inline I2CBus& boardBus(){
+    static BoardBus sensorBus;
+    return sensorBus;
+}
+
+/**
+ * @brief Hide what the firmware prints
+ *
+ * Points stdout at /dev/null, for the menus and prints of a run whose
+ * own output is only the table printed after it.
+ *
+ * @param quiet true to hide, false to show again
+ *
+ * @return void
+ */
+inline void quietStdout(bool quiet){
+    static int saved = -1;
+    std::cout.flush();
+    fflush(stdout);
+    if(quiet){
+        saved = dup(STDOUT_FILENO);
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    } else if(saved >= 0){
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+        saved = -1;
+    }
+}
+
+/**
+ * @brief Driver of the board's sensor
+ *
+ * Created on the first call, with what the constructor prints (the
+ * bus scan table) kept off the output. Set the ambient with
+ * sim.setTemperature before: the first conversion starts with the
+ * simulated sensor.
+ *
+ * @return TempSensor& the driver, on boardBus
+ */
+inline TempSensor& boardSensor(){
+    I2CBus& sensorBus = boardBus();
+    quietStdout(true);
+    static TempSensor sensor(sensorBus, 17, 16, 0);
+    quietStdout(false);
+    return sensor;
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include "../inc/SamplingScheduler.hpp"
+#include "../inc/LedEffects.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+//LED effects on the virtual clock: a setting change no longer blocks on
+//its feedback blinks, status patterns give way to feedback and come
+//back, and the red and Alert LEDs share a pin.
+
+//LEDs of the board: red and Alert on gpio 17, green on 16
+static LedEffects leds;
+static const uint8_t RED_PIN = 17, GREEN_PIN = 16;
+
+/**
+ * @brief Run the firmware loop
+ *
+ * Sampler and display polled every millisecond and the LED timer
+ * every TICK_MS, the pin levels recorded at each change.
+ *
+ * @param sensor driver whose display task runs
+ * @param sampler the scheduler of the main loop
+ * @param ms virtual time to run
+ * @param pin pin whose changes are recorded
+ * @param edges destination, time of each change from the start in ms
+ * @param levels optional, every level the pin took
+ *
+ * @return void
+ */
+static void runLeds(TempSensor& sensor, SamplingScheduler& sampler, uint32_t ms, uint8_t pin,
+                    std::vector<uint32_t>& edges, std::vector<uint8_t>* levels = nullptr){
+    uint32_t start = hal::Clock::nowMs();
+    uint32_t lastTick = start - LedEffects::TICK_MS;
+    uint8_t level = hal::HostPwm::level(pin);
+    while(hal::Clock::nowMs() - start < ms){
+        uint32_t now = hal::Clock::nowMs();
+        sampler.poll(hal::Clock::nowUs());
+        sensor.refreshDisplay();
+        if(now - lastTick >= LedEffects::TICK_MS){
+            lastTick += LedEffects::TICK_MS;
+            leds.tick(lastTick);
+        }
+        if(hal::HostPwm::level(pin) != level){
+            level = hal::HostPwm::level(pin);
+            edges.push_back(lastTick - start);
+            if(levels){
+                levels->push_back(level);
+            }
+        }
+        hal::Clock::sleepUs(1000);
+    }
+}
+
+/**
+ * @brief LED effects
+ *
+ * A setting change with the old blocking blinks, then through the
+ * effects engine: the call returns at once, the three green blinks
+ * keep their 250 ms timing on the timer and sampling goes on under
+ * them. Then a status pattern preempted by feedback and resumed,
+ * the PWM levels of the breathe pattern, and the red and Alert LEDs
+ * sharing a pin.
+ *
+ * @param sensor driver whose feedback is checked
+ * @param sampler paces the reads while the LEDs play
+ *
+ * @return void
+ */
+static void checkLedEffects(TempSensor& sensor, SamplingScheduler& sampler){
+    char text[64];
+
+    //set fq 2, verified with three green blinks
+    quietStdout(true);
+    sensor.refreshDisplay(); //feedback still pending from the start
+    quietStdout(false);
+    uint64_t start = hal::Clock::nowUs();
+    quietStdout(true);
+    sensor.processFaultQ('1');
+    sensor.refreshDisplay();
+    quietStdout(false);
+    uint32_t blockingMs = (uint32_t)((hal::Clock::nowUs() - start) / 1000);
+
+    sensor.setLedEffects(&leds);
+    leds.bind(LedChannel::Alert, RED_PIN);
+    leds.tick(hal::Clock::nowMs());
+    start = hal::Clock::nowUs();
+    quietStdout(true);
+    sensor.processFaultQ('0');
+    quietStdout(false);
+    uint32_t queuedUs = (uint32_t)(hal::Clock::nowUs() - start);
+    snprintf(text, sizeof(text), "%lu us, was %lu ms blocking", (unsigned long)queuedUs, (unsigned long)blockingMs);
+    printf("%-26s | %s\n", "setting change returns", text);
+    CHECK(queuedUs < 10000);
+
+    std::vector<uint32_t> edges;
+    uint32_t samples = sampler.samples();
+    runLeds(sensor, sampler, 1600, GREEN_PIN, edges);
+    samples = sampler.samples() - samples;
+    bool timing = edges.size() == 6;
+    for(size_t i = 1; i < edges.size(); i++){
+        timing = timing && edges[i] - edges[i - 1] >= 250 && edges[i] - edges[i - 1] < 250 + LedEffects::TICK_MS;
+    }
+    snprintf(text, sizeof(text), "%u edges, %lu ms on/off", (unsigned)edges.size(),
+             (unsigned long)(edges.size() > 1 ? edges[1] - edges[0] : 0));
+    printf("%-26s | %s\n", "3 green blinks", text);
+    CHECK(timing);
+    snprintf(text, sizeof(text), "%lu samples in 1.6 s", (unsigned long)samples);
+    printf("%-26s | %s\n", "sampling during feedback", text);
+    CHECK(samples > 0);
+
+    //status breathe on red, a feedback blink takes over and hands it back
+    uint32_t preempted = leds.stats().preempted;
+    std::vector<uint8_t> levels;
+    edges.clear();
+    leds.play(LedChannel::Red, led_pattern::BREATHE, 0, LedPriority::Status);
+    runLeds(sensor, sampler, 300, RED_PIN, edges);
+    leds.play(LedChannel::Red, led_pattern::FAST_BLINK, 2, LedPriority::Feedback);
+    edges.clear();
+    runLeds(sensor, sampler, 1600, RED_PIN, edges, &levels);
+    bool resumed = leds.stats().preempted == preempted + 1 && leds.busy(LedChannel::Red) && levels.size() > 4 &&
+                   levels[0] == 255 && levels[1] == 0 && levels[2] == 255 && levels[3] == 0 && edges[3] - edges[0] == 300;
+    printf("%-26s | %s\n", "feedback preempts status", "2 fast blinks, then breathe again");
+    CHECK(resumed);
+    uint8_t distinct = 0;
+    for(uint16_t l = 1; l < 255; l++){
+        for(uint8_t v : levels){
+            if(v == l){
+                distinct++;
+                break;
+            }
+        }
+    }
+    snprintf(text, sizeof(text), "%u PWM levels between off and full", distinct);
+    printf("%-26s | %s\n", "breathe", text);
+    CHECK(distinct >= 7);
+    leds.cancel(LedChannel::Red, LedPriority::Status);
+
+    //Alert lit by core 1 while the red LED is idle: the shared pin shows it
+    leds.setBase(LedChannel::Alert, 255);
+    leds.tick(hal::Clock::nowMs());
+    bool alertShown = hal::HostPwm::level(RED_PIN) == 255;
+    leds.setBase(LedChannel::Alert, 0);
+    leds.tick(hal::Clock::nowMs());
+    bool cleared = hal::HostPwm::level(RED_PIN) == 0 && !leds.busy(LedChannel::Red);
+    printf("%-26s | %s\n", "red + Alert on gpio 17", "Alert shown, then off");
+    CHECK(alertShown && cleared);
+}
+
+int main(){
+    sim.setTemperature(26300);
+    TempSensor& sensor = boardSensor();
+    SamplingScheduler sampler(sensor);
+    sensor.setSampler(&sampler);
+    hal::Clock::sleepMs(100);
+
+    printf("\n%-26s | result\n", "LED effects (virtual time)");
+    printf("---------------------------+-----------------------------------------\n");
+    checkLedEffects(sensor, sampler);
+    return check::result();
+}
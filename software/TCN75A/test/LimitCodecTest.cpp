@@ -0,0 +1,88 @@
+#include "../inc/LimitCodec.hpp"
+#include "../inc/FixedTemp.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+
+//Limit register codec: every register word formatted and parsed back,
+//every Q8.8 temperature rounded to its half degree, and typed values
+//with known results.
+
+using namespace tcn75a;
+
+/**
+ * @brief Limit codec round trips
+ *
+ * Every 9 bit limit register value is formatted and parsed back,
+ * every Q8.8 temperature printed with 4 decimals is parsed and
+ * compared with the nearest 0.5 C step computed from the word
+ * itself, then a list of typed values with known results.
+ *
+ * @return void
+ */
+static void checkLimitCodec(){
+    uint32_t wordFailures = 0, textFailures = 0, typedFailures = 0, inRange = 0;
+    char text[16];
+
+    //every register value: back to the same word, or refused as out of range
+    for(int16_t half = -256; half < 256; half++){
+        uint16_t raw = encodeLimit(half), back = 0;
+        formatLimit(raw, text, sizeof(text));
+        ParseError error = parseLimit(text, back);
+        bool valid = half >= LIMIT_MIN_HALF && half <= LIMIT_MAX_HALF;
+        inRange += valid;
+        wordFailures += valid ? (error != ParseError::None || back != raw || decodeLimit(back) != half)
+                              : error != ParseError::Range;
+    }
+
+    //every Q8.8 word: rounded to the nearest half degree, ties away from zero
+    for(uint32_t w = 0; w < 0x10000; w++){
+        int16_t q8 = (int16_t)w;
+        TempQ8::fromRaw((uint16_t)w).format(text, sizeof(text), TempUnit::Celsius, 4);
+        int32_t mag = q8 < 0 ? -q8 : q8;
+        int32_t half = (mag + 64) / 128 * (q8 < 0 ? -1 : 1);
+        uint16_t back = 0;
+        ParseError error = parseLimit(text, back);
+        bool valid = half >= LIMIT_MIN_HALF && half <= LIMIT_MAX_HALF;
+        textFailures += valid ? (error != ParseError::None || decodeLimit(back) != half) : error != ParseError::Range;
+    }
+
+    struct Typed{
+        const char* text;
+        ParseError error;
+        int16_t half;
+    };
+    const Typed typed[] = {
+        {"", ParseError::Empty, 0}, {"-", ParseError::Empty, 0}, {".", ParseError::Syntax, 0},
+        {"1.2.3", ParseError::Syntax, 0}, {"abc", ParseError::Syntax, 0}, {"12a", ParseError::Syntax, 0},
+        {"1e3", ParseError::Syntax, 0}, {"--5", ParseError::Syntax, 0}, {"125.5", ParseError::Range, 0},
+        {"-40.5", ParseError::Range, 0}, {"99999999999", ParseError::Range, 0}, {"-40", ParseError::None, -80},
+        {"125", ParseError::None, 250}, {"+30", ParseError::None, 60}, {"29.75", ParseError::None, 60},
+        {"-29.75", ParseError::None, -60}, {"0.2499", ParseError::None, 0}, {"-0.25", ParseError::None, -1},
+        {"25.", ParseError::None, 50}, {".5", ParseError::None, 1}, {"30.2499999", ParseError::None, 60},
+        {"-0", ParseError::None, 0},
+    };
+    for(const Typed& t : typed){
+        uint16_t raw = 0;
+        ParseError error = parseLimit(t.text, raw);
+        if(error != t.error || (error == ParseError::None && decodeLimit(raw) != t.half)){
+            printf("Limit \"%s\": %s, %d half degrees\n", t.text, parseErrorText(error), decodeLimit(raw));
+            typedFailures++;
+        }
+    }
+    printf("%-26s | %5u | %8lu | %5lu\n", "register words", 512u, (unsigned long)inRange, (unsigned long)wordFailures);
+    printf("%-26s | %5u | %8s | %5lu\n", "Q8.8 words, 4 decimals", 65536u, "-", (unsigned long)textFailures);
+    printf("%-26s | %5u | %8s | %5lu\n", "typed values", (unsigned)(sizeof(typed) / sizeof(typed[0])), "-",
+           (unsigned long)typedFailures);
+    CHECK(inRange == LIMIT_MAX_HALF - LIMIT_MIN_HALF + 1);
+    CHECK(wordFailures == 0);
+    CHECK(textFailures == 0);
+    CHECK(typedFailures == 0);
+}
+
+int main(){
+    printf("\n%-26s | cases | in range | fails\n", "Limit codec");
+    printf("---------------------------+-------+----------+------\n");
+    checkLimitCodec();
+    return check::result();
+}
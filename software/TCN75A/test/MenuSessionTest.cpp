@@ -0,0 +1,179 @@
+#include "../inc/LimitCodec.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+//A menu session typed on the console, as a user would, with the shadow
+//register cache counted at every step: the first read of a register goes
+//on the bus, the ones after it and the reads after a write come from
+//memory, and a bus error on this sensor empties the cache. A typed limit
+//is only confirmed once the sensor took it.
+
+using namespace tcn75a;
+
+//Hits and misses of the three cached registers, indexed by pointer
+struct CacheCounts{
+    uint32_t hits[4];
+    uint32_t misses[4];
+};
+
+static CacheCounts counts(const TempSensor& sensor){
+    CacheCounts c = CacheCounts();
+    for(uint8_t reg = CONFIG_REG; reg <= SET_TEMP_REG; reg++){
+        c.hits[reg] = sensor.getShadow(reg).hits;
+        c.misses[reg] = sensor.getShadow(reg).misses;
+    }
+    return c;
+}
+
+/**
+ * @brief Type lines on the console
+ *
+ * Each line is handled by one pollConsole call, with the menus kept
+ * off the output. The time after it lets a config read-back land and
+ * the next poll take it.
+ *
+ * @param sensor driver of the console
+ * @param lines lines to type, each ending with a newline
+ *
+ * @return void
+ */
+static void type(TempSensor& sensor, const char* lines){
+    std::cout.setstate(std::ios::failbit);
+    for(const char* line = lines; *line; ){
+        const char* end = strchr(line, '\n');
+        size_t len = end ? (size_t)(end - line) + 1 : strlen(line);
+        hal::Cpu::feedInput(line, len);
+        sensor.pollConsole();
+        hal::Clock::sleepMs(5);
+        sensor.pollConsole();
+        line += len;
+    }
+    std::cout.clear();
+}
+
+/**
+ * @brief Type lines and keep what the console printed
+ *
+ * @param sensor driver of the console
+ * @param lines lines to type, each ending with a newline
+ *
+ * @return std::string the console output
+ */
+static std::string typeAndRead(TempSensor& sensor, const char* lines){
+    std::ostringstream out;
+    std::streambuf* old = std::cout.rdbuf(out.rdbuf());
+    for(const char* line = lines; *line; ){
+        const char* end = strchr(line, '\n');
+        size_t len = end ? (size_t)(end - line) + 1 : strlen(line);
+        hal::Cpu::feedInput(line, len);
+        sensor.pollConsole();
+        line += len;
+    }
+    std::cout.rdbuf(old);
+    return out.str();
+}
+
+//One step of the session and the cache traffic it should cost
+struct Step{
+    const char* name;
+    const char* lines;
+    uint8_t reg; //register the step reads or writes
+    uint32_t hits;
+    uint32_t misses;
+};
+
+int main(){
+    sim.setTemperature(24500);
+    TempSensor& sensor = boardSensor();
+
+    const Step session[] = {
+        {"alert, read MAX", "3\n3\n", SET_TEMP_REG, 0, 1},
+        {"alert, read MAX again", "3\n3\n", SET_TEMP_REG, 1, 0},
+        {"alert, read MIN", "3\n4\n", HYST_TEMP_REG, 0, 1},
+        {"alert, read MIN again", "3\n4\n", HYST_TEMP_REG, 1, 0},
+        {"config, resolution 12 bits", "1\n4\n3\n", CONFIG_REG, 0, 1},
+        {"config, resolution 9 bits", "1\n4\n0\n", CONFIG_REG, 1, 0},
+        {"config, fault queue 4", "1\n3\n2\n", CONFIG_REG, 1, 0},
+        {"read config", "read config\n", CONFIG_REG, 1, 0},
+        {"set max 30.5, read MAX", "set max 30.5\n3\n3\n", SET_TEMP_REG, 1, 0},
+        {"alert, MIN prompt 21, read MIN", "3\n2\n21\n3\n4\n", HYST_TEMP_REG, 1, 0},
+    };
+
+    printf("\n%-32s | reg | hits | misses\n", "Menu session, shadow cache");
+    printf("---------------------------------+-----+------+-------\n");
+    for(const Step& step : session){
+        CacheCounts before = counts(sensor);
+        type(sensor, step.lines);
+        CacheCounts after = counts(sensor);
+        uint32_t others = 0;
+        for(uint8_t reg = CONFIG_REG; reg <= SET_TEMP_REG; reg++){
+            if(reg != step.reg){
+                others += after.hits[reg] - before.hits[reg] + after.misses[reg] - before.misses[reg];
+            }
+        }
+        uint32_t hits = after.hits[step.reg] - before.hits[step.reg];
+        uint32_t misses = after.misses[step.reg] - before.misses[step.reg];
+        printf("%-32s | %3u | %4lu | %6lu\n", step.name, step.reg, (unsigned long)hits, (unsigned long)misses);
+        CHECK(hits == step.hits);
+        CHECK(misses == step.misses);
+        CHECK(others == 0);
+    }
+
+    //what the session left on the sensor
+    uint8_t config = (uint8_t)sim.reg(CONFIG_REG);
+    CHECK(get<Resolution>(config) == Resolution::Bits9);
+    CHECK(get<FaultQueue>(config) == FaultQueue::Four);
+    CHECK(sensor.getShadow(CONFIG_REG).data[0] == config);
+    CHECK(limitWord(sensor.getShadow(SET_TEMP_REG).data[0], sensor.getShadow(SET_TEMP_REG).data[1]) == sim.reg(SET_TEMP_REG));
+
+    //a failed temperature read empties the cache: the next read goes on the bus
+    sim.setResponding(false);
+    type(sensor, "read temp\n");
+    sim.setResponding(true);
+    CacheCounts before = counts(sensor);
+    type(sensor, "read config\n");
+    CacheCounts after = counts(sensor);
+    CHECK(after.misses[CONFIG_REG] - before.misses[CONFIG_REG] == 1);
+    CHECK(after.hits[CONFIG_REG] == before.hits[CONFIG_REG]);
+    CHECK(sensor.getShadow(CONFIG_REG).valid && sensor.getShadow(CONFIG_REG).data[0] == config);
+
+    //an error from another address leaves this sensor's cache alone
+    uint8_t byte = 0;
+    CHECK(sensor.Read_Reg(FIRST_ADDR + 1, CONFIG_REG, &byte, 1) < 0);
+    CHECK(sensor.getShadow(CONFIG_REG).valid);
+
+    //ONE-SHOT clears itself: the cache never keeps it, so a later edit
+    //in shutdown does not start a conversion nobody asked for
+    type(sensor, "1\n0\n1\n"); //CONFIG > SHUTDOWN > enable
+    type(sensor, "1\n5\n1\n"); //CONFIG > ONE-SHOT > enable
+    hal::Clock::sleepMs(conversionTimeMaxMs(Resolution::Bits9));
+    CHECK(get<OneShot>((uint8_t)sim.reg(CONFIG_REG)) == OneShot::Disable); //conversion done
+    CHECK(get<OneShot>(sensor.getShadow(CONFIG_REG).data[0]) == OneShot::Disable);
+    uint32_t conversions = sim.stats().conversions;
+    type(sensor, "1\n3\n1\n"); //CONFIG > FAULT QUEUE > 2
+    hal::Clock::sleepMs(conversionTimeMaxMs(Resolution::Bits9));
+    printf("%-32s | %lu conversion(s)\n", "edit after a one-shot", (unsigned long)(sim.stats().conversions - conversions));
+    CHECK(sim.stats().conversions == conversions);
+    CHECK(get<Shutdown>((uint8_t)sim.reg(CONFIG_REG)) == Shutdown::Enable);
+    CHECK(get<FaultQueue>((uint8_t)sim.reg(CONFIG_REG)) == FaultQueue::Two);
+
+    //a limit is only confirmed once the sensor took it
+    std::string out = typeAndRead(sensor, "set max 40\n");
+    CHECK(out.find("Limit set to: 40.0") != std::string::npos);
+    CHECK(sim.reg(SET_TEMP_REG) == 0x2800);
+    sim.setResponding(false);
+    out = typeAndRead(sensor, "set min 35\n");
+    sim.setResponding(true);
+    printf("%-32s | %s", "set min, no answer", out.c_str());
+    CHECK(out.find("Limit set to") == std::string::npos && out.find("not written") != std::string::npos);
+    CHECK(sim.reg(HYST_TEMP_REG) != 0x2300);
+    out = typeAndRead(sensor, "set min x\n");
+    CHECK(out.find("Invalid input") != std::string::npos && out.find("Limit set to") == std::string::npos);
+    return check::result();
+}
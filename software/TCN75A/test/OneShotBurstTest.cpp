@@ -0,0 +1,73 @@
+#include "../inc/SamplingScheduler.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+
+//OneShotBurst costs in virtual time: the sensor stays in shutdown and each
+//sample is one trigger and one read, the next trigger queued behind the
+//read inside a burst. The sensor on-time the scheduler reports must be the
+//time the simulated sensor really spent converting.
+
+using namespace tcn75a;
+
+/**
+ * @brief Run bursts and compare the counts with the bus and the sensor
+ *
+ * Stops between two bursts, so every triggered conversion is done
+ * and read when the counts are taken.
+ *
+ * @param sensor driver of the sensor
+ * @param sampler the scheduler
+ * @param resolution resolution to sample at
+ * @param burst samples per burst
+ * @param bursts bursts to run
+ *
+ * @return void
+ */
+static void runBursts(TempSensor& sensor, SamplingScheduler& sampler, Resolution resolution, uint8_t burst,
+                      uint8_t bursts){
+    const uint32_t maxUs = conversionTimeMaxMs(resolution) * 1000u;
+    const uint32_t period_ms = (burst * maxUs + maxUs) / 1000 + 100; //the burst plus some time off
+    sampler.setPolicy(SamplePolicy::MaxRate);
+    sensor.applyConfig(ConfigEdit().set(resolution));
+    sampler.setPolicy(SamplePolicy::OneShotBurst, period_ms, burst);
+    sim.reg(CONFIG_REG); //conversion dropped by the shutdown
+    sim.resetStats();
+    bus.resetStats();
+
+    uint64_t start = hal::Clock::nowUs();
+    sampler.runUntil(start + (uint64_t)(bursts - 1) * period_ms * 1000 + burst * maxUs + maxUs);
+    uint64_t now = hal::Clock::nowUs();
+    uint64_t on = sampler.sensorOnUs(now);
+    uint32_t samples = sampler.samples();
+    uint32_t txns = sampler.busTransactions();
+    uint32_t config = sim.reg(CONFIG_REG); //runs the conversions due
+    const SimTCN75A::Stats& st = sim.stats();
+
+    printf("%6u bit | %5u | %7lu | %7.2f | %12.1f | %11.1f\n", 9 + (unsigned)resolution, burst,
+           (unsigned long)samples, samples ? (double)txns / samples : 0.0, on / 1000.0, st.on_us / 1000.0);
+    CHECK(samples == (uint32_t)burst * bursts && sampler.failedReads() == 0);
+    CHECK(txns == 2 * samples); //one trigger and one read per sample
+    CHECK(bus.stats().transactions == txns);
+    CHECK(st.writes[CONFIG_REG] == samples && st.reads[TEMP_REG] == samples);
+    CHECK(st.conversions == samples);
+    CHECK(on == st.on_us);
+    CHECK(get<Shutdown>((uint8_t)config) == Shutdown::Enable && get<OneShot>((uint8_t)config) == OneShot::Disable);
+}
+
+int main(){
+    sim.setTemperature(21000);
+    TempSensor& sensor = boardSensor();
+    SamplingScheduler sampler(sensor);
+    sensor.setSampler(&sampler);
+    hal::Clock::sleepMs(100);
+
+    printf("\n%-10s | burst | samples | txn/smp | on ms (sch.) | on ms (sim)\n", "One-shot");
+    printf("-----------+-------+---------+---------+--------------+------------\n");
+    runBursts(sensor, sampler, Resolution::Bits9, 1, 3);
+    runBursts(sensor, sampler, Resolution::Bits9, 4, 3);
+    runBursts(sensor, sampler, Resolution::Bits12, 4, 2);
+    runBursts(sensor, sampler, Resolution::Bits10, 8, 2);
+    return check::result();
+}
@@ -0,0 +1,104 @@
+#include "../inc/Probe.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+
+//Timing probes: the log-linear buckets and percentiles of a histogram,
+//the probes built into the driver counting its calls, and what an empty
+//probe scope costs on the host.
+
+/**
+ * @brief Timing probes
+ *
+ * The bucket of every value up to 2^20 and of each power of two
+ * holds it and is within 25 % of it, percentiles of a known spread
+ * come out within a bucket. Then the probes of the driver count the
+ * calls made, and the cost of an empty scope is measured.
+ *
+ * @param sensor driver whose reads and menus are probed
+ *
+ * @return void
+ */
+static void checkProbes(TempSensor& sensor){
+    printf("\nProbes (%s, %lu bytes per point)\n", probe::ENABLED ? "built in" : "not built in",
+           (unsigned long)sizeof(probe::Histogram));
+    bool ordered = true;
+    uint8_t last = 0;
+    for(uint32_t v = 0; v <= (1u << 20) && ordered; v++){
+        uint8_t b = probe::Histogram::bucketOf(v);
+        uint32_t low = probe::Histogram::bucketLow(b);
+        ordered = b >= last && low <= v && (v - low) * 4 <= v && b < probe::Histogram::BUCKETS;
+        last = b;
+    }
+    for(uint8_t bit = 20; bit < 32 && ordered; bit++){
+        uint32_t v = (1u << bit) + (1u << bit) / 2 - 1;
+        uint32_t low = probe::Histogram::bucketLow(probe::Histogram::bucketOf(v));
+        ordered = low <= v && (v - low) / 4 <= v / 16;
+    }
+    ordered = ordered && probe::Histogram::bucketOf(UINT32_MAX) == probe::Histogram::BUCKETS - 1;
+
+    probe::Histogram h;
+    for(uint32_t v = 1; v <= 1000; v++){
+        h.record(v);
+    }
+    uint32_t p50 = h.percentile(50), p99 = h.percentile(99);
+    bool spread = h.count() == 1000 && h.min() == 1 && h.max() == 1000 && h.sum() == 500500 &&
+                  p50 >= 500 && p50 <= 500 * 5 / 4 && p99 >= 990 && p99 <= 1000 && h.percentile(100) == 1000;
+
+    char text[80];
+    printf("%-26s | result\n", "");
+    printf("---------------------------+-----------------------------------------\n");
+    snprintf(text, sizeof(text), "%u buckets, 0 to 2^32", probe::Histogram::BUCKETS);
+    printf("%-26s | %s\n", "log-linear buckets", text);
+    CHECK(ordered);
+    snprintf(text, sizeof(text), "p50 %lu p99 %lu of 1..1000", (unsigned long)p50, (unsigned long)p99);
+    printf("%-26s | %s\n", "percentiles", text);
+    CHECK(spread);
+    if(!probe::ENABLED){
+        probe::print();
+        return;
+    }
+
+    probe::reset();
+    quietStdout(true);
+    for(uint8_t i = 0; i < 10; i++){
+        sensor.get_Temp();
+    }
+    sensor.bus_scan(ScanMode::Targeted);
+    sensor.MainMenu();
+    quietStdout(false);
+    const probe::Histogram* reads = probe::histogram(probe::Point::TempRead);
+    const probe::Histogram* regs = probe::histogram(probe::Point::ReadReg);
+    const probe::Histogram* scans = probe::histogram(probe::Point::BusScan);
+    const probe::Histogram* menus = probe::histogram(probe::Point::MainMenu);
+    snprintf(text, sizeof(text), "%lu get_Temp, %lu Read_Reg, %lu scan, %lu menu", (unsigned long)reads->count(),
+             (unsigned long)regs->count(), (unsigned long)scans->count(), (unsigned long)menus->count());
+    printf("%-26s | %s\n", "driver probes", text);
+    CHECK(reads->count() == 10 && regs->count() >= 10);
+    CHECK(scans->count() == 1 && menus->count() == 1);
+    probe::print();
+
+    //cost of a probe: empty scopes timing themselves
+    const uint32_t n = 100000;
+    const probe::Histogram* lines = probe::histogram(probe::Point::TextLine);
+    uint32_t before = lines->count();
+    hal::Cycles::Stamp start = hal::Cycles::now();
+    for(uint32_t i = 0; i < n; i++){
+        PROBE_SCOPE(TextLine);
+    }
+    uint32_t ns = hal::Cycles::since(start);
+    snprintf(text, sizeof(text), "%.1f ns per scope (host)", (double)ns / n);
+    printf("%-26s | %s\n", "overhead", text);
+    CHECK(lines->count() == before + n);
+    probe::reset();
+}
+
+int main(){
+    sim.setTemperature(26300);
+    TempSensor& sensor = boardSensor();
+    hal::Clock::sleepMs(100);
+
+    checkProbes(sensor);
+    return check::result();
+}
@@ -0,0 +1,141 @@
+#include "../inc/SampleLog.hpp"
+#include "Check.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+//Flash sample log on the simulated flash: size of a record, host cost of
+//a push and the stall of a sector write, a query the index narrows, and
+//a power cut in the middle of a sector write followed by a remount.
+
+//Log region of the test: the last 16 sectors of the simulated flash
+static const uint16_t LOG_SECTORS = 16;
+static const uint32_t LOG_OFFSET = hal::Flash::SIZE - LOG_SECTORS * SampleLog::SECTOR_SIZE;
+
+//Readings of a two sensor board: a 12 bit random walk each, one read every 250 ms
+static TempSample logSample(uint32_t i){
+    static int32_t level[2] = {26 * 16, 21 * 16};
+    static uint32_t lcg = 777;
+    lcg = lcg * 1664525u + 1013904223u;
+    uint8_t s = i & 1;
+    level[s] += (int32_t)((lcg >> 24) % 3) - 1;
+    TempSample sample;
+    sample.timestamp_us = (uint64_t)i * 125000;
+    sample.raw = (uint16_t)(level[s] << 4);
+    sample.addr = 0x48 + s;
+    return sample;
+}
+
+//Collects what a query returns
+static void keepLogged(const TempSample& sample, void* context){
+    static_cast<std::vector<TempSample>*>(context)->push_back(sample);
+}
+
+//Same readings at the same millisecond
+static bool sameSamples(const std::vector<TempSample>& a, const std::vector<TempSample>& b){
+    if(a.size() != b.size()){
+        return false;
+    }
+    for(size_t i = 0; i < a.size(); i++){
+        if(a[i].raw != b[i].raw || a[i].addr != b[i].addr || a[i].timestamp_us / 1000 != b[i].timestamp_us / 1000){
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Flash log size, cost and recovery
+ *
+ * Logs a two sensor random walk and reads it back: bytes per
+ * sample, host cost of a push, sector writes and their stall in
+ * virtual time (erase and program times of a typical QSPI NOR
+ * part), then a one minute query and what the index let it skip.
+ * Last, the power is cut in the middle of a sector write and the
+ * log is mounted again from flash, as after a reboot.
+ *
+ * @param n samples logged, less than the ring holds
+ *
+ * @return void
+ */
+static void runLog(uint32_t n){
+    typedef std::chrono::steady_clock Clock;
+    std::unique_ptr<SampleLog> log(new SampleLog(LOG_OFFSET, LOG_SECTORS));
+    log->format();
+    log->mount();
+    hal::Flash::resetStats();
+
+    std::vector<TempSample> written;
+    double pushNs = 0;
+    for(uint32_t i = 0; i < n; i++){
+        TempSample sample = logSample(i);
+        written.push_back(sample);
+        Clock::time_point t0 = Clock::now();
+        log->push(sample);
+        pushNs += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    }
+    pushNs /= n;
+    const SampleLog::Stats st = log->stats();
+    const hal::Flash::Stats fst = hal::Flash::stats();
+
+    std::vector<TempSample> all;
+    log->query(0, ~0ull, &keepLogged, &all);
+    bool lossless = sameSamples(all, written);
+
+    //one minute in the middle of the log
+    std::vector<TempSample> range;
+    uint64_t from = written[n / 2].timestamp_us / 1000;
+    Clock::time_point t0 = Clock::now();
+    uint32_t inRange = log->query(from, from + 59999, &keepLogged, &range);
+    double queryUs = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+
+    double perSample = (double)st.bytes / st.samples;
+    double hours = (double)(LOG_SECTORS - 1) * (SampleLog::SECTOR_SIZE - SampleLog::HEADER_SIZE) / perSample / 8 / 3600;
+    printf("%-26s | %12.2f | %7.1f | %7lu | %12.1f\n", "Flash log, 2 sensors 4 Hz", perSample, pushNs,
+           (unsigned long)st.sectors, st.max_commit_us / 1000.0);
+    printf("Raw TempSample %u bytes. Flash busy %.1f ms (%lu erases, %lu pages) for %.2f h, %.1f h kept in %u KB\n",
+           (unsigned)(sizeof(uint64_t) + sizeof(uint16_t) + sizeof(uint8_t)), fst.busy_ns / 1e6,
+           (unsigned long)fst.erases, (unsigned long)fst.pages, n / 8.0 / 3600, hours,
+           (unsigned)(LOG_SECTORS * SampleLog::SECTOR_SIZE / 1024));
+    printf("Query 60 s: %lu samples, %lu sectors decoded, %lu skipped, %.1f us (host)\n", (unsigned long)inRange,
+           (unsigned long)log->stats().decoded, (unsigned long)log->stats().skipped, queryUs);
+    CHECK(lossless && st.samples == n && st.dropped == 0);
+    CHECK(perSample < sizeof(TempSample) / 2.0); //the point of the delta records
+    CHECK(inRange == 60 * 8 && range.size() == inRange); //8 samples a second
+    CHECK(range.front().timestamp_us / 1000 >= from && range.back().timestamp_us / 1000 <= from + 59999);
+    CHECK(log->stats().skipped > log->stats().decoded); //the index spared most of the log
+
+    //Commit what is staged, then cut the power 300 bytes into the next sector write
+    log->flush();
+    std::vector<TempSample> before;
+    uint32_t kept = log->query(0, ~0ull, &keepLogged, &before);
+    uint32_t sectors = log->stats().sectors;
+    hal::Flash::cutPowerAfter(300);
+    for(uint32_t i = n; log->stats().sectors == sectors; i++){
+        log->push(logSample(i));
+    }
+    bool cut = hal::Flash::powerLost();
+    hal::Flash::restorePower();
+
+    //reboot: a new log over the same flash
+    log.reset(new SampleLog(LOG_OFFSET, LOG_SECTORS));
+    uint16_t mounted = log->mount();
+    std::vector<TempSample> after;
+    uint32_t recovered = log->query(0, ~0ull, &keepLogged, &after);
+    bool intact = sameSamples(after, before);
+    printf("Power cut mid-write: %s, %u sectors mounted, %u corrupt, %lu of %lu committed samples back, "
+           "log time resumes at %.3f s\n", cut ? "yes" : "no", mounted, log->stats().corrupt, (unsigned long)recovered,
+           (unsigned long)kept, log->logTimeMs(0) / 1000.0);
+    CHECK(cut && mounted > 0);
+    CHECK(intact && recovered == kept);
+    CHECK(log->logTimeMs(0) >= before.back().timestamp_us / 1000); //time never goes back
+}
+
+int main(){
+    printf("\n%-26s | bytes/sample | push ns | sectors | max stall ms\n", "Sample log");
+    printf("---------------------------+--------------+---------+---------+-------------\n");
+    runLog(20000);
+    return check::result();
+}
@@ -0,0 +1,133 @@
+#include "../inc/SampleRing.hpp"
+#include "Check.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+//SampleRing with a real producer and consumer thread, as core 0 and
+//core 1 use it. Every sample carries its sequence number three times:
+//a torn slot, a lost or repeated sample, or a reordering shows up in
+//the consumer.
+
+//Fields of the sample derived from the sequence number
+static TempSample make(uint32_t seq){
+    TempSample s;
+    s.timestamp_us = seq;
+    s.raw = (uint16_t)(seq * 40503u);
+    s.addr = (uint8_t)(0x48 + (seq ^ (seq >> 8) ^ (seq >> 16)) % 8);
+    return s;
+}
+
+static bool intact(const TempSample& s){
+    TempSample expect = make((uint32_t)s.timestamp_us);
+    return s.raw == expect.raw && s.addr == expect.addr;
+}
+
+//What the consumer saw
+struct RingRun{
+    uint32_t received;
+    uint32_t torn; //slots whose fields do not match
+    uint32_t gaps; //sequence numbers skipped (lossless run) or going back (lossy run)
+    uint32_t dropped; //pushes the ring rejected
+    double ms; //host time, printed only
+};
+
+/**
+ * @brief Run a producer and a consumer thread
+ *
+ * Lossless: the producer waits for room, every sequence number
+ * must arrive once and in order. Lossy: the producer pushes once, the
+ * ring counts what it rejects, and what arrives must still be in order
+ * and account for every push.
+ *
+ * @tparam N ring capacity
+ * @param n samples to push
+ * @param lossless retry the pushes the ring rejects
+ *
+ * @return RingRun what the consumer saw
+ */
+template<uint32_t N>
+static RingRun runRing(uint32_t n, bool lossless){
+    std::unique_ptr<SampleRing<TempSample, N>> owned(new SampleRing<TempSample, N>());
+    SampleRing<TempSample, N>& ring = *owned;
+    std::atomic<bool> done(false);
+    RingRun run = RingRun();
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]{
+        TempSample s;
+        int64_t last = -1;
+        for(;;){
+            bool finished = done.load(std::memory_order_acquire);
+            if(!ring.pop(s)){
+                if(finished){
+                    break;
+                }
+                std::this_thread::yield(); //one CPU on the test host: let the producer run
+                continue;
+            }
+            run.received++;
+            if(!intact(s)){
+                run.torn++;
+            }
+            int64_t seq = (int64_t)s.timestamp_us;
+            if(lossless ? seq != last + 1 : seq <= last){
+                run.gaps++;
+            }
+            last = seq;
+        }
+    });
+    uint32_t rejected = 0; //lossless pushes refused with room seen
+    for(uint32_t seq = 0; seq < n; seq++){
+        //lossless: wait for room, so the ring never has to reject
+        while(lossless && ring.size() == N){
+            std::this_thread::yield();
+        }
+        if(!ring.push(make(seq)) && lossless){
+            rejected++;
+        }
+        //lossy: hand the CPU over now and then, so pops run between the pushes
+        if(!lossless && seq % 64 == 0){
+            std::this_thread::yield();
+        }
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    run.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    run.dropped = ring.dropped();
+
+    char name[32];
+    snprintf(name, sizeof(name), "%lu slots, %s", (unsigned long)N, lossless ? "lossless" : "lossy");
+    printf("%-26s | %9lu | %8lu | %7lu | %4lu | %4lu | %7.1f\n", name, (unsigned long)n, (unsigned long)run.received,
+           (unsigned long)run.dropped, (unsigned long)run.torn, (unsigned long)run.gaps, run.ms);
+    CHECK(run.torn == 0);
+    CHECK(run.gaps == 0);
+    CHECK(run.received + run.dropped == n);
+    CHECK(!lossless || (run.dropped == 0 && rejected == 0));
+    return run;
+}
+
+int main(){
+    const uint32_t n = 200000;
+    printf("\n%-26s | pushed    | received | dropped | torn | gaps | host ms\n", "SampleRing, 2 threads");
+    printf("---------------------------+-----------+----------+---------+------+------+--------\n");
+    runRing<2>(n, true);
+    runRing<64>(n, true);
+    runRing<2>(n, false);
+    runRing<64>(n, false);
+
+    //single thread edges: full, empty, peek
+    static SampleQueue queue;
+    TempSample s;
+    CHECK(!queue.pop(s) && !queue.peek(s) && queue.empty());
+    for(uint32_t i = 0; i < SampleQueue::capacity(); i++){
+        CHECK(queue.push(make(i)));
+    }
+    CHECK(!queue.push(make(99)) && queue.dropped() == 1 && queue.size() == SampleQueue::capacity());
+    CHECK(queue.peek(s) && s.timestamp_us == 0 && queue.size() == SampleQueue::capacity());
+    CHECK(queue.pop(s) && s.timestamp_us == 0 && intact(s));
+    return check::result();
+}
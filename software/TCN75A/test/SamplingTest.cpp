@@ -0,0 +1,138 @@
+#include "../inc/SamplingScheduler.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+
+//SamplingScheduler counters in virtual time, with a rising temperature
+//so every conversion returns a new word: reads paced on the worst case
+//conversion time are never stale, reads faster than the part converts
+//are, a failed read is not a sample, and a policy change does not hang
+//on a read the bus never finishes.
+
+using namespace tcn75a;
+
+static int32_t ambient = 22000;
+
+//0.75 C per worst case 9 bit conversion: two conversions never round to
+//the same 0.5 C word
+static const int32_t RAMP_MILLI_PER_MS = 10;
+
+/**
+ * @brief Run the scheduler while the temperature rises
+ *
+ * @param sampler the scheduler
+ * @param ms virtual time to run
+ *
+ * @return void
+ */
+static void runRamp(SamplingScheduler& sampler, uint32_t ms){
+    for(uint32_t i = 0; i < ms; i++){
+        ambient += RAMP_MILLI_PER_MS;
+        sim.setTemperature(ambient);
+        sampler.runUntil(hal::Clock::nowUs() + 1000);
+    }
+}
+
+//What one run of the scheduler counted
+struct SamplingRun{
+    uint32_t samples;
+    uint32_t stale;
+    uint32_t failed;
+};
+
+/**
+ * @brief Run a policy and print its counters
+ *
+ * @param sampler the scheduler
+ * @param name what the run is
+ * @param policy how the reads are paced
+ * @param period_ms FixedRate period
+ * @param ms virtual time to run
+ *
+ * @return SamplingRun what it counted
+ */
+static SamplingRun runPolicy(SamplingScheduler& sampler, const char* name, SamplePolicy policy, uint32_t period_ms,
+                             uint32_t ms){
+    sampler.setPolicy(policy, period_ms);
+    runRamp(sampler, ms);
+    SamplingRun run;
+    run.samples = sampler.samples();
+    run.stale = sampler.staleSamples();
+    run.failed = sampler.failedReads();
+    printf("%-34s | %7lu | %5lu | %6lu\n", name, (unsigned long)run.samples, (unsigned long)run.stale,
+           (unsigned long)run.failed);
+    return run;
+}
+
+int main(){
+    sim.setTemperature(ambient);
+    TempSensor& sensor = boardSensor();
+    SamplingScheduler sampler(sensor);
+    sensor.setSampler(&sampler);
+    hal::Clock::sleepMs(100);
+
+    const uint32_t typMs = conversionTimeMs(Resolution::Bits9);
+    const uint32_t maxMs = conversionTimeMaxMs(Resolution::Bits9);
+    printf("\n%-34s | samples | stale | failed\n", "Sampling, 9 bit, rising 10 C/s");
+    printf("-----------------------------------+---------+-------+-------\n");
+
+    //one read per worst case conversion time: a new conversion every time,
+    //on a part at the typical time and on one at the maximum time
+    SamplingRun fast = runPolicy(sampler, "max rate, 1 s", SamplePolicy::MaxRate, 0, 1000);
+    CHECK(fast.samples >= 1000 / maxMs - 1 && fast.samples <= 1000 / maxMs + 1 && fast.failed == 0);
+    CHECK(fast.stale == 0);
+    sampler.setPolicy(SamplePolicy::MaxRate);
+    sampler.runUntil(hal::Clock::nowUs() + 1000 * 1000);
+    printf("%-34s | %7lu | %5lu | %6lu\n", "max rate, steady temperature, 1 s", (unsigned long)sampler.samples(),
+           (unsigned long)sampler.staleSamples(), (unsigned long)sampler.failedReads());
+    CHECK(sampler.samples() >= 1000 / maxMs - 1 && sampler.staleSamples() == 0); //same word, new conversions
+    sim.setWorstCaseTiming(true);
+    SamplingRun slowPart = runPolicy(sampler, "max rate, slow part, 1 s", SamplePolicy::MaxRate, 0, 1000);
+    CHECK(slowPart.samples >= 1000 / maxMs - 1 && slowPart.stale == 0 && slowPart.failed == 0);
+
+    //paced on the typical time, the slow part is read about 2.5 times per
+    //conversion: the repeats are stale, the reads with a new word are not
+    SamplingRun typical = runPolicy(sampler, "fixed rate 1 ms, slow part, 1 s", SamplePolicy::FixedRate, 1, 1000);
+    CHECK(typical.samples >= 1000 / typMs - 1 && typical.failed == 0);
+    CHECK(typical.stale > 0 && typical.stale < typical.samples);
+    CHECK(typical.samples - typical.stale >= 1000 / maxMs - 1);
+    sim.setWorstCaseTiming(false);
+
+    //reads further apart than the worst case are always a new conversion
+    SamplingRun slow = runPolicy(sampler, "fixed rate, max conversion + 5 ms", SamplePolicy::FixedRate, maxMs + 5, 1000);
+    CHECK(slow.samples >= 1000 / (maxMs + 5) - 1 && slow.stale == 0 && slow.failed == 0);
+
+    //the sensor stops answering: its reads fail and are no samples
+    sampler.setPolicy(SamplePolicy::MaxRate);
+    sampler.runUntil(hal::Clock::nowUs() + 300 * 1000);
+    uint32_t before = sampler.samples();
+    sim.setResponding(false);
+    sampler.runUntil(hal::Clock::nowUs() + 300 * 1000);
+    uint32_t failed = sampler.failedReads();
+    uint32_t during = sampler.samples() - before;
+    sim.setResponding(true);
+    sampler.runUntil(hal::Clock::nowUs() + 300 * 1000);
+    printf("%-34s | %7lu | %5lu | %6lu\n", "max rate, 300 ms without answer", (unsigned long)during,
+           (unsigned long)sampler.staleSamples(), (unsigned long)failed);
+    CHECK(during == 0 && failed >= 300 / maxMs - 1);
+    CHECK(sampler.samples() > before); //reads come back with the sensor
+    CHECK(sampler.failedReads() == failed);
+
+    //a read stuck behind a 1 s clock stretch: the policy change gives up on it
+    sampler.setPolicy(SamplePolicy::MaxRate);
+    sim.setStretchUs(1000 * 1000);
+    while(!sampler.readPending()){
+        sampler.poll(hal::Clock::nowUs());
+        hal::Cpu::idle();
+    }
+    uint64_t start = hal::Clock::nowUs();
+    sampler.setPolicy(SamplePolicy::FixedRate, 500);
+    uint64_t waited = hal::Clock::nowUs() - start;
+    sim.setStretchUs(0);
+    printf("%-34s | %lu us\n", "policy change, read stuck 1 s", (unsigned long)waited);
+    CHECK(!sampler.readPending() && sampler.getPolicy() == SamplePolicy::FixedRate);
+    CHECK(waited < 100 * 1000);
+    CHECK(sampler.waitForSample(1000));
+    return check::result();
+}
@@ -0,0 +1,148 @@
+#include "../inc/SensorArray.hpp"
+#include "../inc/SimTCN75A.hpp"
+#include "../inc/I2CBus.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+//SensorArray throughput from 1 to 8 sensors on one bus, in virtual time:
+//each sensor delivers one sample per conversion, so the rate must grow
+//with the number of sensors while the bus stays mostly idle. Then the
+//sensor left to TempSensor and a resolution written behind the array.
+
+using namespace tcn75a;
+
+//Sensors at 0x48 and up on one bus, with the array polling them
+struct Rig{
+    hal::SimBus bus;
+    std::unique_ptr<SimTCN75A> sims[SensorArray::MAX_SENSORS];
+    I2CBus sensorBus;
+    SensorArray array;
+    SampleQueue ring;
+
+    explicit Rig(uint8_t sensors): bus(0, 400 * 1000), sensorBus(&bus, 20, 21, 400 * 1000), array(sensorBus.engine()){
+        for(uint8_t i = 0; i < sensors; i++){
+            sims[i].reset(new SimTCN75A((uint8_t)(FIRST_ADDR + i)));
+            sims[i]->setTemperature(20000 + 500 * i);
+            bus.attach(sims[i].get());
+        }
+        sensorBus.begin();
+        array.setSampleSink(&ring);
+    }
+};
+
+/**
+ * @brief Poll the array as the poll timer does
+ *
+ * @param rig the sensors and their array
+ * @param ms virtual time to run
+ *
+ * @return uint32_t samples that reached the ring
+ */
+static uint32_t run(Rig& rig, uint32_t ms){
+    uint64_t start = hal::Clock::nowUs();
+    uint32_t received = 0;
+    TempSample sample;
+    while(hal::Clock::nowUs() - start < (uint64_t)ms * 1000){
+        rig.array.poll(hal::Clock::nowUs());
+        while(rig.ring.pop(sample)){
+            received++;
+        }
+        hal::Clock::sleepUs(1000);
+    }
+    rig.sensorBus.engine().drain();
+    while(rig.ring.pop(sample)){
+        received++;
+    }
+    return received;
+}
+
+/**
+ * @brief Samples per second with a number of sensors
+ *
+ * @param sensors sensors on the bus, 1 to 8
+ * @param single rate with one sensor, 0 when this is that run
+ *
+ * @return uint32_t aggregate samples per second
+ */
+static uint32_t benchSensors(uint8_t sensors, uint32_t single){
+    const uint32_t ms = 2000;
+    Rig rig(sensors);
+    CHECK(rig.array.discover() == sensors);
+    rig.bus.resetStats();
+    uint64_t start = hal::Clock::nowUs();
+    uint32_t received = run(rig, ms);
+    uint64_t elapsed = hal::Clock::nowUs() - start;
+    uint32_t rate = rig.array.samplesPerSecond(hal::Clock::nowUs());
+
+    uint32_t fewest = UINT32_MAX, most = 0, errors = 0;
+    for(uint8_t i = 0; i < rig.array.count(); i++){
+        const SensorNode& n = rig.array.node(i);
+        fewest = n.samples < fewest ? n.samples : fewest;
+        most = n.samples > most ? n.samples : most;
+        errors += n.errors;
+    }
+    double busPct = 100.0 * rig.bus.stats().bus_ns / (elapsed * 1000.0);
+    printf("%7u | %9lu | %8.2f | %6.2f %% | %lu..%lu\n", sensors, (unsigned long)rate,
+           single ? (double)rate / single : 1.0, busPct, (unsigned long)fewest, (unsigned long)most);
+
+    CHECK(received == rig.array.totalSamples());
+    CHECK(rig.ring.dropped() == 0 && errors == 0);
+    CHECK(most - fewest <= 1); //round robin: no sensor starves
+    CHECK(!single || (rate * 100 >= single * sensors * 95 && rate * 100 <= single * sensors * 105));
+    return rate;
+}
+
+/**
+ * @brief Excluded sensor and config written elsewhere
+ *
+ * The sensor TempSensor reads is left out of the polls, and a
+ * resolution it writes slows that one sensor down to its new
+ * conversion time.
+ *
+ * @return void
+ */
+static void checkExcludeResync(){
+    Rig rig(SensorArray::MAX_SENSORS);
+    rig.array.exclude(FIRST_ADDR);
+    CHECK(rig.array.discover() == SensorArray::MAX_SENSORS - 1);
+    for(uint8_t i = 0; i < rig.array.count(); i++){
+        CHECK(rig.array.node(i).addr != FIRST_ADDR);
+    }
+
+    //12 bits on 0x49, as TempSensor::applyConfig would write it
+    uint8_t config = ConfigEdit().set(Resolution::Bits12).apply(rig.array.node(0).config);
+    I2CTransaction txn;
+    I2CEngine::prepareWrite(txn, FIRST_ADDR + 1, CONFIG_REG, &config, 1);
+    CHECK(rig.sensorBus.engine().submit(txn) && rig.sensorBus.engine().wait(txn) == 2);
+    rig.array.resync(FIRST_ADDR + 1, config);
+    uint64_t start = hal::Clock::nowUs();
+    run(rig, 2000);
+    double seconds = (hal::Clock::nowUs() - start) / 1e6;
+
+    const SensorNode& slow = rig.array.node(0);
+    const SensorNode& fast = rig.array.node(1);
+    printf("resync 0x%02X to 12 bits     | %lu samples, 0x%02X: %lu\n", slow.addr, (unsigned long)slow.samples, fast.addr,
+           (unsigned long)fast.samples);
+    CHECK(slow.addr == FIRST_ADDR + 1 && get<Resolution>(slow.config) == Resolution::Bits12);
+    CHECK(slow.samples <= seconds * 1000 / conversionTimeMs(Resolution::Bits12) + 1);
+    CHECK(slow.samples + 2 >= seconds * 1000 / conversionTimeMs(Resolution::Bits12)); //slower, not stalled
+    CHECK(fast.samples * conversionTimeMs(Resolution::Bits9) >= seconds * 1000 * 9 / 10);
+    CHECK(rig.sims[0]->stats().reads[TEMP_REG] == 0);
+
+    rig.array.exclude(0);
+    CHECK(rig.array.discover() == SensorArray::MAX_SENSORS);
+}
+
+int main(){
+    printf("\n%-7s | samples/s | scaling  | bus busy | samples per sensor\n", "sensors");
+    printf("--------+-----------+----------+----------+-------------------\n");
+    uint32_t single = benchSensors(1, 0);
+    for(uint8_t sensors = 2; sensors <= SensorArray::MAX_SENSORS; sensors++){
+        benchSensors(sensors, single);
+    }
+    printf("\n");
+    checkExcludeResync();
+    return check::result();
+}
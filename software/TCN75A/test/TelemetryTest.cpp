@@ -0,0 +1,144 @@
+#include "../inc/Telemetry.hpp"
+#include "../inc/TelemetryDecoder.hpp"
+#include "../inc/FixedTemp.hpp"
+#include "Check.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+//Binary telemetry frames against a printf line per sample: bytes and host
+//time per sample, then the stream decoded back with menu text mixed in,
+//fed byte by byte, and with a corrupted frame.
+
+//Bytes the stream wrote, instead of stdout
+static std::vector<uint8_t> captured;
+
+static void captureWrite(const uint8_t *data, size_t len){
+    captured.insert(captured.end(), data, data + len);
+}
+
+static void keepSample(const TelemetryDecoder::Sample& sample, void* context){
+    static_cast<std::vector<TelemetryDecoder::Sample>*>(context)->push_back(sample);
+}
+
+//Reading i of the benchmark, 4 kHz
+static TempSample benchSample(uint32_t i){
+    TempSample sample;
+    sample.addr = 0x48;
+    sample.timestamp_us = 1000000ull + i * 250ull;
+    sample.raw = (uint16_t)(0x1A00 + (i & 0xFF) * 16);
+    return sample;
+}
+
+/**
+ * @brief Decode the captured stream
+ *
+ * @param stream the bytes
+ * @param chunk bytes per feed call
+ * @param out the samples decoded
+ *
+ * @return TelemetryDecoder::Stats what the decoder counted
+ */
+static TelemetryDecoder::Stats decode(const std::vector<uint8_t>& stream, size_t chunk,
+                                      std::vector<TelemetryDecoder::Sample>& out){
+    out.clear();
+    TelemetryDecoder decoder(&keepSample, &out);
+    for(size_t at = 0; at < stream.size(); at += chunk){
+        decoder.feed(stream.data() + at, at + chunk < stream.size() ? chunk : stream.size() - at);
+    }
+    return decoder.stats();
+}
+
+/**
+ * @brief Samples decoded as they were sent
+ *
+ * @param got decoded samples
+ * @param first index of the first one in the benchmark
+ * @param count how many to compare
+ *
+ * @return bool true if seq, time, address and word all match
+ */
+static bool matches(const std::vector<TelemetryDecoder::Sample>& got, uint32_t first, uint32_t count){
+    if(got.size() < count){
+        return false;
+    }
+    for(uint32_t i = 0; i < count; i++){
+        TempSample sent = benchSample(first + i);
+        const TelemetryDecoder::Sample& s = got[i];
+        if(s.seq != first + i || s.timestamp_us != sent.timestamp_us || s.addr != sent.addr || s.raw != sent.raw){
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(){
+    typedef std::chrono::steady_clock Clock;
+    const uint32_t n = 100000;
+
+    captured.reserve(n * 8);
+    TelemetryStream stream(&captureWrite);
+    Clock::time_point t0 = Clock::now();
+    for(uint32_t i = 0; i < n; i++){
+        stream.push(benchSample(i));
+    }
+    stream.flush();
+    double binNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+    std::vector<uint8_t> frames = captured;
+
+    std::vector<char> text;
+    text.reserve(n * 32);
+    char line[48], temp[16];
+    t0 = Clock::now();
+    for(uint32_t i = 0; i < n; i++){
+        TempSample sample = benchSample(i);
+        TempQ8::fromRaw(sample.raw).format(temp, sizeof(temp), TempUnit::Celsius);
+        int len = snprintf(line, sizeof(line), "%lu,%llu,0x%02X,%s\n", (unsigned long)i,
+                           (unsigned long long)sample.timestamp_us, sample.addr, temp);
+        text.insert(text.end(), line, line + len);
+    }
+    double txtNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+
+    printf("\n%-26s | bytes/sample | ns/sample (host)\n", "Output");
+    printf("---------------------------+--------------+-----------------\n");
+    printf("%-26s | %12.2f | %15.1f\n", "Binary frames", (double)frames.size() / n, binNs);
+    printf("%-26s | %12.2f | %15.1f\n", "printf text", (double)text.size() / n, txtNs);
+    const uint32_t frameCount = (n + telemetry::MAX_BATCH - 1) / telemetry::MAX_BATCH;
+    CHECK(stream.stats().samples == n && stream.stats().frames == frameCount);
+    CHECK(frames.size() == stream.stats().bytes);
+    CHECK(frames.size() * 3 < text.size());
+
+    printf("\n%-26s | samples | frames | CRC err | skipped | lost\n", "Decode");
+    printf("---------------------------+---------+--------+---------+---------+-----\n");
+    std::vector<TelemetryDecoder::Sample> got;
+
+    //a menu print between two frames: stdio never splits a frame
+    const char noise[] = "Changed Resolution to 12 bits\n";
+    size_t half = telemetry::MAX_FRAME * (frameCount / 2);
+    std::vector<uint8_t> mixed(frames.begin(), frames.begin() + half);
+    mixed.insert(mixed.end(), noise, noise + sizeof(noise) - 1);
+    mixed.insert(mixed.end(), frames.begin() + half, frames.end());
+    TelemetryDecoder::Stats d = decode(mixed, 4096, got);
+    printf("%-26s | %7lu | %6lu | %7lu | %7lu | %4lu\n", "menu text mixed in", (unsigned long)got.size(),
+           (unsigned long)d.frames, (unsigned long)d.crc_errors, (unsigned long)d.skipped, (unsigned long)d.lost);
+    CHECK(got.size() == n && d.frames == frameCount && matches(got, 0, n));
+    CHECK(d.crc_errors == 0 && d.skipped == sizeof(noise) - 1 && d.lost == 0);
+
+    //any chunking decodes the same
+    d = decode(frames, 1, got);
+    printf("%-26s | %7lu | %6lu | %7lu | %7lu | %4lu\n", "one byte per feed", (unsigned long)got.size(),
+           (unsigned long)d.frames, (unsigned long)d.crc_errors, (unsigned long)d.skipped, (unsigned long)d.lost);
+    CHECK(got.size() == n && matches(got, 0, n) && d.skipped == 0);
+
+    //a flipped bit: the CRC drops that frame, the sequence numbers count it
+    std::vector<uint8_t> corrupt = frames;
+    corrupt[telemetry::MAX_FRAME * 10 + telemetry::HEADER_SIZE + 3] ^= 0x04;
+    d = decode(corrupt, 4096, got);
+    printf("%-26s | %7lu | %6lu | %7lu | %7lu | %4lu\n", "one bit flipped", (unsigned long)got.size(),
+           (unsigned long)d.frames, (unsigned long)d.crc_errors, (unsigned long)d.skipped, (unsigned long)d.lost);
+    CHECK(d.crc_errors == 1 && d.frames == frameCount - 1);
+    CHECK(got.size() == n - telemetry::MAX_BATCH && d.lost == telemetry::MAX_BATCH);
+    CHECK(matches(got, 0, 10 * telemetry::MAX_BATCH) && got[10 * telemetry::MAX_BATCH].seq == 11 * telemetry::MAX_BATCH);
+    return check::result();
+}
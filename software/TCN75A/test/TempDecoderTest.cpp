@@ -0,0 +1,89 @@
+#include "../inc/TempDecoder.hpp"
+#include "../inc/FixedTemp.hpp"
+#include "Fixture.hpp"
+#include "Check.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+//Signed temperature decoding at the four resolutions over the whole
+//datasheet range, and a reading below zero through the simulated sensor.
+
+using namespace tcn75a;
+
+/**
+ * @brief Signed decoding at every resolution
+ *
+ * Every step of the datasheet range (-40 C to +125 C) at 9, 10, 11
+ * and 12 bits, with the unused low bits set to catch a missing mask:
+ * exact micro degrees, rounded milli degrees and the float of
+ * fixedToFloat against a double reference. Then a sub-zero reading
+ * through the simulated sensor.
+ *
+ * @param sensor driver whose fixedToFloat is checked
+ *
+ * @return void
+ */
+static void checkDecoders(TempSensor& sensor){
+    for(uint8_t r = 0; r < 4; r++){
+        Resolution res = (Resolution)r;
+        const Decoder& dec = decoderFor(res);
+        uint8_t shift = 7 - r;
+        int32_t perDegree = 2 << r;
+        int32_t stepMicro = 1000000 / perDegree;
+        quietStdout(true);
+        sensor.processResolution((char)('0' + r));
+        quietStdout(false);
+
+        uint32_t steps = 0, failures = 0, oldWrong = 0;
+        for(int32_t n = -40 * perDegree; n <= 125 * perDegree; n++){
+            uint16_t word = (uint16_t)(n << shift);
+            uint16_t raw = word | (uint16_t)((1u << shift) - 1); //unused bits set
+            double exact = (double)n / perDegree;
+            float viaFloat = sensor.fixedToFloat((uint8_t)(raw >> 8), (uint8_t)raw);
+            failures += dec.q8(raw) != (int16_t)word;
+            failures += dec.micro(raw) != n * stepMicro;
+            failures += dec.milli(raw) != (int32_t)llround(exact * 1000);
+            failures += viaFloat != (float)exact;
+            failures += TempQ8::fromRaw((uint16_t)dec.q8(raw)).milli() != dec.milli(raw);
+            oldWrong += fabs((double)word / 256 - exact) > 0.5; //the unsigned cast of the old fixedToFloat
+            steps++;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "%d bit", 9 + r);
+        printf("%-26s | %5lu | %7ld | %8lu | %lu\n", name, (unsigned long)steps, (long)stepMicro,
+               (unsigned long)failures, (unsigned long)oldWrong);
+        CHECK(steps == (uint32_t)(165 * perDegree + 1) && failures == 0);
+        CHECK(oldWrong == (uint32_t)(40 * perDegree)); //every reading below zero
+    }
+
+    //freezer reading through the bus: -18.0625 C, floored to each step by the sensor
+    sim.setTemperature(-18062);
+    char text[16], name[16];
+    printf("Simulated -18.062 C reads:");
+    for(uint8_t r = 0; r < 4; r++){
+        quietStdout(true);
+        sensor.processResolution((char)('0' + r));
+        quietStdout(false);
+        hal::Clock::sleepMs(conversionTimeMaxMs((Resolution)r));
+        float c = sensor.get_Temp_C();
+        sensor.last_Temp().format(text, sizeof(text), TempUnit::Celsius);
+        snprintf(name, sizeof(name), "%.4f", c);
+        printf(" %d bit %s (float %s)%s", 9 + r, text, name, r < 3 ? "," : "\n");
+        int32_t perDegree = 2 << r;
+        double floored = floor(-18.0625 * perDegree) / perDegree;
+        CHECK(c == (float)floored);
+        CHECK(sensor.last_Temp().milli() == (int32_t)llround(floored * 1000));
+    }
+}
+
+int main(){
+    sim.setTemperature(26300);
+    TempSensor& sensor = boardSensor();
+    hal::Clock::sleepMs(100);
+
+    printf("\n%-26s | steps | step uC | failures | old unsigned decode wrong\n", "Decoder (-40 to 125 C)");
+    printf("---------------------------+-------+---------+----------+--------------------------\n");
+    checkDecoders(sensor);
+    return check::result();
+}
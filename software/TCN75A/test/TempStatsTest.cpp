@@ -0,0 +1,150 @@
+#include "../inc/TempStats.hpp"
+#include "../inc/Telemetry.hpp"
+#include "../inc/TelemetryDecoder.hpp"
+#include "Check.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+//Rolling statistics against a double precision reference over the same
+//noisy readings, the host cost of an update and of a summary, and a
+//summary sent through the telemetry frames and decoded back.
+
+//Q8.8 step in C, the integer results may be off by one of it
+static const double LSB = 1.0 / 256;
+
+//Bytes the statistics frames wrote, instead of stdout
+static std::vector<uint8_t> captured;
+
+static void captureWrite(const uint8_t *data, size_t len){
+    captured.insert(captured.end(), data, data + len);
+}
+
+static void countSample(const TelemetryDecoder::Sample& sample, void* context){
+    (void)sample;
+    (*static_cast<uint32_t*>(context))++;
+}
+
+static void keepSummary(const StatsSummary& summary, uint64_t timestamp_us, void* context){
+    (void)timestamp_us;
+    *static_cast<StatsSummary*>(context) = summary;
+}
+
+/**
+ * @brief Statistics cost and accuracy
+ *
+ * Feeds a noisy random walk (12 bit readings) to RollingStats and
+ * checks every result against a double precision reference taken
+ * over the same readings: window min/max/mean/deviation recomputed
+ * from the window, EWMA and Welford in double. Then times the
+ * updates and sends a summary through the telemetry frames and back.
+ *
+ * @param n number of readings
+ * @param window rolling window length
+ *
+ * @return void
+ */
+static void runStats(uint32_t n, uint8_t window){
+    typedef std::chrono::steady_clock Clock;
+    const uint8_t shift = 3;
+
+    //noisy random walk around 26 C, 0.0625 C steps
+    std::vector<int16_t> raw(n);
+    uint32_t lcg = 12345;
+    int32_t level = 26 * 256;
+    for(uint32_t i = 0; i < n; i++){
+        lcg = lcg * 1664525u + 1013904223u;
+        level += (int32_t)((lcg >> 24) % 5) - 2;
+        raw[i] = (int16_t)((level + (int32_t)((lcg >> 16) % 9) * 16 - 64) & ~15);
+    }
+
+    RollingStats stats(window, shift);
+    std::deque<double> ref;
+    double ewma = 0, mean = 0, m2 = 0;
+    double errMean = 0, errDev = 0, errEwma = 0, errAllMean = 0, errAllDev = 0;
+    uint32_t minMaxMiss = 0;
+    for(uint32_t i = 0; i < n; i++){
+        double x = raw[i] * LSB;
+        stats.update(raw[i]);
+        ref.push_back(x);
+        if(ref.size() > window){
+            ref.pop_front();
+        }
+        ewma = i ? ewma + (x - ewma) / (1 << shift) : x;
+        double delta = x - mean;
+        mean += delta / (i + 1);
+        m2 += delta * (x - mean);
+        if(i % 97){
+            continue; //the window reference is O(window), check a sample of the steps
+        }
+
+        double lo = ref[0], hi = ref[0], sum = 0, sq = 0;
+        for(double v : ref){
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+            sum += v;
+        }
+        double wmean = sum / ref.size();
+        for(double v : ref){
+            sq += (v - wmean) * (v - wmean);
+        }
+        StatsSummary s = stats.summary(0x48);
+        minMaxMiss += (s.min * LSB != lo) + (s.max * LSB != hi);
+        errMean = fmax(errMean, fabs(s.mean * LSB - wmean));
+        errDev = fmax(errDev, fabs(s.stddev * LSB - sqrt(sq / ref.size())));
+        errEwma = fmax(errEwma, fabs(s.ewma * LSB - ewma));
+        errAllMean = fmax(errAllMean, fabs(s.total_mean * LSB - mean));
+        errAllDev = fmax(errAllDev, fabs(s.total_stddev * LSB - sqrt(m2 / (i + 1))));
+    }
+
+    //update cost alone
+    RollingStats timed(window, shift);
+    for(uint32_t i = 0; i < n; i++){
+        timed.update(raw[i]); //warm up
+    }
+    Clock::time_point t0 = Clock::now();
+    for(uint32_t i = 0; i < n; i++){
+        timed.update(raw[i]);
+    }
+    double updateNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+    volatile int16_t sink = timed.min();
+    (void)sink;
+    t0 = Clock::now();
+    for(uint32_t i = 0; i < 10000; i++){
+        sink = timed.summary(0x48).stddev;
+    }
+    double summaryNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / 10000;
+
+    //statistics frame through the stream and the decoder
+    captured.clear();
+    StatsSummary sent = stats.summary(0x48), got = StatsSummary();
+    TelemetryStream stream(&captureWrite);
+    stream.sendSummary(&sent, 1, 1000000);
+    uint32_t decoded = 0;
+    TelemetryDecoder decoder(&countSample, &decoded);
+    decoder.setSummaryHandler(&keepSummary, &got);
+    decoder.feed(captured.data(), captured.size());
+
+    printf("%-26s | %9.1f | %10.1f | %6lu | %7.5f | %7.5f | %7.5f | %7.5f | %7.5f\n",
+           window == 16 ? "Stats, window 16" : "Stats, window 64", updateNs, summaryNs, (unsigned long)minMaxMiss,
+           errMean, errDev, errEwma, errAllMean, errAllDev);
+    CHECK(minMaxMiss == 0);
+    CHECK(errMean <= LSB && errDev <= LSB && errEwma <= LSB);
+    CHECK(errAllMean <= LSB && errAllDev <= LSB);
+    CHECK(decoder.stats().summaries == 1 && decoded == 0);
+    CHECK(memcmp(&sent.samples, &got.samples, sizeof(got.samples)) == 0 && got.window == sent.window);
+    CHECK(got.min == sent.min && got.max == sent.max && got.mean == sent.mean && got.stddev == sent.stddev);
+    CHECK(got.ewma == sent.ewma && got.total_mean == sent.total_mean && got.total_stddev == sent.total_stddev);
+}
+
+int main(){
+    printf("\n%-26s | update ns | summary ns | minmax | mean C  | std C   | ewma C  | all mean| all std\n", "Statistics (vs double)");
+    printf("---------------------------+-----------+------------+--------+---------+---------+---------+---------+--------\n");
+    runStats(200000, 16);
+    runStats(200000, 64);
+    return check::result();
+}
@@ -0,0 +1,115 @@
+#include "../inc/TextStream.hpp"
+#include "../inc/SampleRing.hpp"
+#include "../inc/Hal.hpp"
+#include "Check.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+
+//Readable sample lines formatted on core 0 against core 1, on the virtual
+//clock with the USB link rate: where the formatting is done decides
+//whether sampling keeps its rate once the lines outrun the link.
+
+//Bytes the text stream wrote
+static uint32_t linkBytes = 0;
+
+//USB CDC write from core 0: putchar blocks until the host took the bytes
+static void blockingWrite(const uint8_t *data, size_t len){
+    (void)data;
+    linkBytes += len;
+    hal::Clock::sleepUs((uint32_t)(len * 1000000ull / TextStream::USB_RATE));
+}
+
+//The same write from core 1 within the link budget: the bytes fit the USB buffer
+static void queuedWrite(const uint8_t *data, size_t len){
+    (void)data;
+    linkBytes += len;
+}
+
+/**
+ * @brief Text output on core 0 vs core 1
+ *
+ * Samples come at a fixed rate for 1 s of virtual time. Before, core 0
+ * formats and writes each line itself and the USB link blocks it: the
+ * next sample starts late. After, core 0 only pushes the raw sample to
+ * the ring, core 1 formats the lines and drops those over the link
+ * rate. The clock is shared, core 1 costs core 0 nothing but the
+ * push here.
+ *
+ * @param rate samples per second offered
+ * @param offload false to format on core 0 (before), true on core 1 (after)
+ *
+ * @return uint32_t samples taken on time
+ */
+static uint32_t runPipeline(uint32_t rate, bool offload){
+    TextStream stream(offload ? &queuedWrite : &blockingWrite, offload ? TextStream::USB_RATE : TextStream::UNLIMITED);
+    if(!offload){
+        stream.setMaxLatency(0);
+    }
+    SampleQueue ring;
+    linkBytes = 0;
+
+    uint64_t start = hal::Clock::nowUs();
+    uint64_t period = 1000000 / rate;
+    uint32_t acquired = 0;
+    uint32_t maxLag = 0;
+    TempSample sample;
+    sample.addr = 0x48;
+    for(uint64_t due = start; due < start + 1000000; due += period){
+        uint64_t now = hal::Clock::nowUs();
+        if(now < due){
+            hal::Clock::sleepUs((uint32_t)(due - now));
+            now = due;
+        } else if(now - due > maxLag){
+            maxLag = (uint32_t)(now - due);
+        }
+        if(now >= start + 1000000){
+            break;
+        }
+        sample.timestamp_us = now;
+        sample.raw = (uint16_t)(0x1A00 + (acquired & 0xFF) * 16);
+        acquired++;
+
+        if(!offload){
+            stream.push(sample, now);
+            continue;
+        }
+        ring.push(sample);
+        while(ring.pop(sample)){
+            stream.push(sample, hal::Clock::nowUs());
+        }
+        stream.flushDue(hal::Clock::nowUs());
+    }
+    stream.flush(hal::Clock::nowUs());
+
+    const TextStream::Stats& s = stream.stats();
+    uint32_t avg = (uint32_t)(s.lines ? s.latency_us / s.lines : 0);
+    char name[32];
+    snprintf(name, sizeof(name), "%s, %lu/s", offload ? "after (core 1)" : "before (core 0)", (unsigned long)rate);
+    printf("%-26s | %9lu | %7lu | %7lu | %7lu | %8lu | %8lu | %5lu\n", name, (unsigned long)acquired,
+           (unsigned long)s.lines, (unsigned long)s.dropped, (unsigned long)maxLag, (unsigned long)avg,
+           (unsigned long)s.max_latency_us, (unsigned long)ring.dropped());
+    if(offload){
+        //every sample taken on time, what the link cannot carry counted
+        CHECK(acquired == rate && ring.dropped() == 0);
+        CHECK(s.lines + s.dropped == acquired);
+        CHECK(s.max_latency_us <= 21000);
+        CHECK(linkBytes <= TextStream::USB_RATE + 2 * TextStream::BUFFER_SIZE);
+    } else {
+        //the link paces the sampling: over its rate the samples come late
+        CHECK(s.lines == acquired && s.dropped == 0);
+        CHECK(linkBytes < TextStream::USB_RATE || maxLag > 0);
+    }
+    return acquired;
+}
+
+int main(){
+    printf("\n%-26s | samples/s | lines/s | dropped | max lag | avg lat. | max lat. | ring\n", "Text output (1 s, us)");
+    printf("---------------------------+-----------+---------+---------+---------+----------+----------+------\n");
+    for(uint32_t rate : {500u, 1000u, 2000u, 4000u}){
+        uint32_t before = runPipeline(rate, false);
+        uint32_t after = runPipeline(rate, true);
+        CHECK(after >= before);
+    }
+    return check::result();
+}